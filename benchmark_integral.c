@@ -0,0 +1,470 @@
+/**
+ * @file benchmark_integral.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Simple program to benchmark integral image calculation.
+ *
+ * Copyright (c) 2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_memory.h"
+#include "cvsu_pixel_image.h"
+#include "cvsu_integral.h"
+#include "cvsu_simd.h"
+
+string main_name = "benchmark_integral";
+string measure_update_name = "measure_update";
+string measure_queries_name = "measure_queries";
+string measure_threshold_name = "measure_threshold";
+
+#define FRAME_SIZE_COUNT 5
+/* box size used for measuring box queries */
+#define QUERY_BOX_SIZE 15
+/* window radius used for measuring thresholds */
+#define THRESHOLD_RADIUS 7
+
+uint32 frame_widths[FRAME_SIZE_COUNT] = { 640, 1280, 1920, 2560, 3840 };
+uint32 frame_heights[FRAME_SIZE_COUNT] = { 480, 720, 1080, 1440, 2160 };
+
+void print_usage()
+{
+  printf("benchmark_integral\n");
+  printf("Measures the speed of integral image calculation and box queries\n");
+  printf("with separate and interleaved integral layouts, and the speed of\n");
+  printf("thresholding with integral images.\n\n");
+  printf("Usage:\n\n");
+  printf("benchmark_integral [pixels] [threads]\n");
+  printf("  pixels: amount of megapixels to process per measurement (>= 1)\n");
+  printf("  threads: also measure parallel update and thresholding with this\n");
+  printf("           many threads\n\n");
+}
+
+double get_time()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+void fill_image
+(
+  pixel_image *target
+)
+{
+  uint32 x, y, seed;
+  byte *pos;
+
+  seed = 12345;
+  for (y = 0; y < target->height; y++) {
+    pos = (byte *)target->rows[y];
+    for (x = 0; x < target->width; x++) {
+      seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+      pos[x] = (byte)(seed >> 16);
+    }
+  }
+}
+
+/* compare the integrals element by element, any difference is an error */
+/* the values of all integral storages are exact in integral_value */
+truth_value integral_image_identical
+(
+  integral_image *a,
+  integral_image *b
+)
+{
+  uint32 x, y, pos_a, pos_b;
+
+  for (y = 0; y <= a->height; y++) {
+    for (x = 0; x <= a->width; x++) {
+      pos_a = y * a->stride + x * a->step;
+      pos_b = y * b->stride + x * b->step;
+      if (integral_image_get_value_1(a, pos_a) !=
+          integral_image_get_value_1(b, pos_b) ||
+          integral_image_get_value_2(a, pos_a) !=
+          integral_image_get_value_2(b, pos_b)) {
+        return FALSE;
+      }
+    }
+  }
+  return TRUE;
+}
+
+/* print one line of results */
+void print_result
+(
+  pixel_image *source,
+  string path,
+  uint32 threads,
+  double speed,
+  truth_value identical
+)
+{
+  printf("%4lux%-5lu %-8s %8lu %12.1f %10s\n", source->width, source->height,
+         path, threads, speed, IS_TRUE(identical) ? "yes" : "NO");
+}
+
+/* run the update enough times to process the given amount of pixels */
+/* returns the speed in megapixels per second */
+result measure_update
+(
+  integral_image *target,
+  uint32 megapixels,
+  uint32 threads,
+  double *speed
+)
+{
+  TRY();
+  uint32 i, rounds;
+  double start, end;
+
+  CHECK_POINTER(target);
+
+  rounds = (megapixels * 1000000) / (target->width * target->height);
+  if (rounds < 1) rounds = 1;
+
+  start = get_time();
+  for (i = 0; i < rounds; i++) {
+    if (threads > 1) {
+      CHECK(integral_image_update_parallel(target, threads));
+    }
+    else {
+      CHECK(integral_image_update(target));
+    }
+  }
+  end = get_time();
+  *speed = ((double)(rounds * target->width * target->height)) /
+           ((end - start) * 1000000.0);
+
+  FINALLY(measure_update);
+  RETURN();
+}
+
+/* run box queries for the given amount of pixels using the box macros */
+/* scattered queries use pseudorandom positions, like the quad forest trees */
+/* returns the speed in megaqueries per second and the sum of all results */
+result measure_queries
+(
+  integral_image *target,
+  uint32 megapixels,
+  truth_value scattered,
+  double *speed,
+  integral_value *checksum
+)
+{
+  TRY();
+  INTEGRAL_IMAGE_1BOX_VARIABLES();
+  uint32 i, x, y, cols, rows, queries, count, seed, offset;
+  double start, end;
+
+  CHECK_POINTER(target);
+
+  INTEGRAL_IMAGE_INIT_1BOX(target, QUERY_BOX_SIZE, QUERY_BOX_SIZE);
+  cols = target->width - QUERY_BOX_SIZE + 1;
+  rows = target->height - QUERY_BOX_SIZE + 1;
+  queries = megapixels * 1000000;
+  seed = 12345;
+  *checksum = 0;
+
+  start = get_time();
+  for (count = 0, x = 0, y = 0, i = 0; i < queries; i++) {
+    if (IS_TRUE(scattered)) {
+      seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+      x = (seed >> 8) % cols;
+      y = (seed >> 4) % rows;
+    }
+    else {
+      x++;
+      if (x >= cols) {
+        x = 0;
+        y++;
+        if (y >= rows) {
+          y = 0;
+        }
+      }
+    }
+    offset = y * target->stride + x * target->step;
+    iA = I_1_data + offset;
+    i2A = I_2_data + offset;
+    sum = INTEGRAL_IMAGE_SUM();
+    sumsqr = INTEGRAL_IMAGE_SUMSQR();
+    *checksum += sumsqr / N - (sum / N) * (sum / N);
+    count++;
+  }
+  end = get_time();
+  *speed = ((double)count) / ((end - start) * 1000000.0);
+
+  FINALLY(measure_queries);
+  RETURN();
+}
+
+/* run the threshold enough times to process the given amount of pixels */
+/* feng uses estimated minimum, sauvola calculates the maximum deviation */
+/* returns the speed in megapixels per second */
+result measure_threshold
+(
+  integral_image *source,
+  uint32 megapixels,
+  truth_value feng,
+  uint32 threads,
+  pixel_image *target,
+  double *speed
+)
+{
+  TRY();
+  uint32 i, rounds;
+  double start, end;
+
+  rounds = (megapixels * 1000000) / (source->width * source->height);
+  if (rounds < 1) rounds = 1;
+
+  start = get_time();
+  for (i = 0; i < rounds; i++) {
+    CHECK(pixel_image_destroy(target));
+    if (IS_TRUE(feng)) {
+      CHECK(integral_image_threshold_feng_parallel(source, target, FALSE,
+                                                   THRESHOLD_RADIUS, 3, TRUE,
+                                                   0.1, threads));
+    }
+    else {
+      CHECK(integral_image_threshold_sauvola_parallel(source, target, FALSE,
+                                                      THRESHOLD_RADIUS, 0.2,
+                                                      TRUE, 0, FALSE,
+                                                      threads));
+    }
+  }
+  end = get_time();
+  *speed = ((double)(rounds * source->width * source->height)) /
+           ((end - start) * 1000000.0);
+
+  FINALLY(measure_threshold);
+  RETURN();
+}
+
+/* compare the thresholded images pixel by pixel */
+truth_value pixel_image_identical
+(
+  pixel_image *a,
+  pixel_image *b
+)
+{
+  uint32 x, y;
+
+  for (y = 0; y < a->height; y++) {
+    for (x = 0; x < a->width; x++) {
+      if (((byte *)a->rows[y])[x] != ((byte *)b->rows[y])[x]) {
+        return FALSE;
+      }
+    }
+  }
+  return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+  TRY();
+  pixel_image source, thresholded, reference_thresholded;
+  integral_image integral, exact, interleaved, reference;
+  simd_level level, max_level;
+  uint32 i, megapixels, threads;
+  double speed, separate_speed;
+  integral_value separate_checksum, checksum;
+  truth_value identical, scattered, feng;
+
+  megapixels = 200;
+  threads = 1;
+  if (argc > 1) {
+    int scan_result;
+
+    scan_result = sscanf(argv[1], "%lu", &megapixels);
+    if (scan_result != 1 || megapixels < 1) {
+      printf("\nError: failed to parse parameter pixels\n\n");
+      print_usage();
+      return 1;
+    }
+    if (argc > 2) {
+      scan_result = sscanf(argv[2], "%lu", &threads);
+      if (scan_result != 1 || threads < 1) {
+        printf("\nError: failed to parse parameter threads\n\n");
+        print_usage();
+        return 1;
+      }
+    }
+  }
+
+  pixel_image_nullify(&source);
+  pixel_image_nullify(&thresholded);
+  pixel_image_nullify(&reference_thresholded);
+  integral_image_nullify(&integral);
+  integral_image_nullify(&exact);
+  integral_image_nullify(&interleaved);
+  integral_image_nullify(&reference);
+
+  max_level = simd_get_level();
+  printf("cpu supports %s\n\n", simd_level_name(max_level));
+  printf("%-10s %-8s %8s %12s %10s\n", "frame", "path", "threads", "MPixel/s",
+         "identical");
+
+  for (i = 0; i < FRAME_SIZE_COUNT; i++) {
+    CHECK(pixel_image_create(&source, p_U8, GREY, frame_widths[i],
+                             frame_heights[i], 1, frame_widths[i]));
+    fill_image(&source);
+    CHECK(integral_image_create(&integral, &source));
+    CHECK(integral_image_create(&reference, &source));
+
+    simd_set_max_level(s_NONE);
+    CHECK(integral_image_update(&reference));
+
+    for (level = s_NONE; level <= max_level; level++) {
+      simd_set_max_level(level);
+      CHECK(measure_update(&integral, megapixels, 1, &speed));
+      identical = integral_image_identical(&integral, &reference);
+      print_result(&source, simd_level_name(level), 1, speed, identical);
+      if (threads > 1) {
+        CHECK(measure_update(&integral, megapixels, threads, &speed));
+        identical = integral_image_identical(&integral, &reference);
+        print_result(&source, simd_level_name(level), threads, speed,
+                     identical);
+      }
+    }
+    simd_set_max_level(max_level);
+
+    /* exact integer storage */
+    CHECK(integral_image_create_with_storage(&exact, &source, i_EXACT));
+    CHECK(measure_update(&exact, megapixels, 1, &speed));
+    identical = integral_image_identical(&exact, &reference);
+    print_result(&source, "exact", 1, speed, identical);
+    if (threads > 1) {
+      CHECK(measure_update(&exact, megapixels, threads, &speed));
+      identical = integral_image_identical(&exact, &reference);
+      print_result(&source, "exact", threads, speed, identical);
+    }
+    CHECK(integral_image_destroy(&exact));
+
+    /* tile-relative single precision storage */
+    CHECK(integral_image_create_with_storage(&exact, &source, i_TILED));
+    CHECK(measure_update(&exact, megapixels, 1, &speed));
+    identical = integral_image_identical(&exact, &reference);
+    print_result(&source, "tiled", 1, speed, identical);
+    CHECK(integral_image_destroy(&exact));
+
+    /* interleaved layout */
+    CHECK(integral_image_create_with_layout(&interleaved, &source, i_REAL,
+                                            l_INTERLEAVED));
+    CHECK(measure_update(&interleaved, megapixels, 1, &speed));
+    identical = integral_image_identical(&interleaved, &reference);
+    print_result(&source, "interlv", 1, speed, identical);
+    CHECK(integral_image_destroy(&interleaved));
+
+    CHECK(integral_image_destroy(&reference));
+    CHECK(integral_image_destroy(&integral));
+    CHECK(pixel_image_destroy(&source));
+  }
+
+  printf("\n%-10s %-10s %12s %12s %10s\n", "frame", "queries", "separate",
+         "interleaved", "identical");
+  for (i = 0; i < FRAME_SIZE_COUNT; i++) {
+    CHECK(pixel_image_create(&source, p_U8, GREY, frame_widths[i],
+                             frame_heights[i], 1, frame_widths[i]));
+    fill_image(&source);
+    CHECK(integral_image_create(&reference, &source));
+    CHECK(integral_image_create_with_layout(&interleaved, &source, i_REAL,
+                                            l_INTERLEAVED));
+    CHECK(integral_image_update(&reference));
+    CHECK(integral_image_update(&interleaved));
+
+    for (scattered = FALSE; scattered <= TRUE; scattered++) {
+      CHECK(measure_queries(&reference, megapixels, scattered, &separate_speed,
+                            &separate_checksum));
+      CHECK(measure_queries(&interleaved, megapixels, scattered, &speed,
+                            &checksum));
+      printf("%4lux%-5lu %-10s %12.1f %12.1f %10s\n", frame_widths[i],
+             frame_heights[i], IS_TRUE(scattered) ? "scattered" : "sliding",
+             separate_speed, speed,
+             (checksum == separate_checksum) ? "yes" : "NO");
+    }
+
+    CHECK(integral_image_destroy(&interleaved));
+    CHECK(integral_image_destroy(&reference));
+    CHECK(pixel_image_destroy(&source));
+  }
+
+  printf("\n%-10s %-8s %-8s %8s %12s %10s\n", "frame", "method", "path",
+         "threads", "MPixel/s", "identical");
+  for (i = 0; i < FRAME_SIZE_COUNT; i++) {
+    CHECK(pixel_image_create(&source, p_U8, GREY, frame_widths[i],
+                             frame_heights[i], 1, frame_widths[i]));
+    fill_image(&source);
+    CHECK(integral_image_create(&reference, &source));
+    CHECK(integral_image_update(&reference));
+
+    for (feng = FALSE; feng <= TRUE; feng++) {
+      for (level = s_NONE; level <= max_level; level++) {
+        simd_set_max_level(level);
+        CHECK(measure_threshold(&reference, megapixels, feng, 1,
+                                &thresholded, &speed));
+        if (level == s_NONE) {
+          CHECK(pixel_image_destroy(&reference_thresholded));
+          CHECK(pixel_image_clone(&reference_thresholded, &thresholded));
+          CHECK(pixel_image_copy(&reference_thresholded, &thresholded));
+        }
+        identical = pixel_image_identical(&thresholded, &reference_thresholded);
+        printf("%4lux%-5lu %-8s %-8s %8lu %12.1f %10s\n", frame_widths[i],
+               frame_heights[i], IS_TRUE(feng) ? "feng" : "sauvola",
+               simd_level_name(level), 1UL, speed,
+               IS_TRUE(identical) ? "yes" : "NO");
+      }
+      if (threads > 1) {
+        CHECK(measure_threshold(&reference, megapixels, feng, threads,
+                                &thresholded, &speed));
+        identical = pixel_image_identical(&thresholded, &reference_thresholded);
+        printf("%4lux%-5lu %-8s %-8s %8lu %12.1f %10s\n", frame_widths[i],
+               frame_heights[i], IS_TRUE(feng) ? "feng" : "sauvola",
+               simd_level_name(max_level), threads, speed,
+               IS_TRUE(identical) ? "yes" : "NO");
+      }
+    }
+    simd_set_max_level(max_level);
+
+    CHECK(integral_image_destroy(&reference));
+    CHECK(pixel_image_destroy(&source));
+  }
+
+  FINALLY(main);
+  pixel_image_destroy(&reference_thresholded);
+  pixel_image_destroy(&thresholded);
+  integral_image_destroy(&interleaved);
+  integral_image_destroy(&exact);
+  integral_image_destroy(&reference);
+  integral_image_destroy(&integral);
+  pixel_image_destroy(&source);
+
+  return (r == SUCCESS) ? 0 : 1;
+}
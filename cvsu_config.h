@@ -106,6 +106,38 @@
 #define OUTPUT_LEVEL_DEBUG 4
 #define OUTPUT_LEVEL OUTPUT_LEVEL_ERRORS
 
+/**
+ * Define threading method.
+ * @note If threads are disabled, the parallel functions run all their tasks
+ * sequentially in the calling thread. Programs must be linked with -lpthread
+ * when using THREADS_WITH_PTHREAD.
+ */
+#define THREADS_DISABLED 0
+#define THREADS_WITH_PTHREAD 1
+/* #define THREADS_WITH_XXX 2*/
+#define THREADS_METHOD THREADS_WITH_PTHREAD
+
+/**
+ * Maximum number of threads started at once by the parallel functions.
+ * @note Tasks beyond this are run in further batches, so the task state can be
+ * kept on the stack instead of being allocated on every call.
+ */
+#define PARALLEL_MAX_THREADS 64
+
+/**
+ * Define file mapping method.
+ * @note If file mapping is disabled, the mapped pnm functions fail with
+ * NOT_IMPLEMENTED, and the stdio based functions must be used instead.
+ */
+#define FILE_MAPPING_DISABLED 0
+#define FILE_MAPPING_WITH_MMAP 1
+/* #define FILE_MAPPING_WITH_XXX 2*/
+#if defined(__unix__) || defined(__APPLE__)
+#define FILE_MAPPING_METHOD FILE_MAPPING_WITH_MMAP
+#else
+#define FILE_MAPPING_METHOD FILE_MAPPING_DISABLED
+#endif
+
 /**
  * If fmin and fmax functions are not needed by your compiler, undef this
  */
@@ -120,6 +152,22 @@
 /* #define INTEGRAL_IMAGE_DATA_TYPE INTEGRAL_IMAGE_USING_FLOAT */
 #define INTEGRAL_IMAGE_DATA_TYPE INTEGRAL_IMAGE_USING_DOUBLE
 
+/**
+ * Define to store the higher order moments in statistics structures. The
+ * integrals of powers three and four are built at runtime only for the
+ * integral images that are asked for higher order statistics.
+ */
 #undef INTEGRAL_IMAGE_HIGHER_ORDER_STATISTICS
 
+/**
+ * Define SIMD support.
+ * If the compiler supports x86 vector intrinsics and function target
+ * attributes, the kernels with SSE2 and AVX2 code paths are compiled in, and
+ * the fastest path supported by the cpu is selected at runtime.
+ * @see simd_get_level
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#endif
+
 #endif /* CVSU_CONFIG_H */
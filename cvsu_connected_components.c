@@ -42,6 +42,8 @@
 string connected_components_alloc_name = "connected_components_alloc";
 string connected_components_free_name = "connected_components_free";
 string connected_components_create_name = "connected_components_create";
+string connected_components_create_stream_name = "connected_components_create_stream";
+string connected_components_add_row_name = "connected_components_add_row";
 string connected_components_destroy_name = "connected_components_destroy";
 string connected_components_nullify_name = "connected_components_nullify";
 string connected_components_update_name = "connected_components_update";
@@ -191,6 +193,50 @@ result connected_components_create
 
 /******************************************************************************/
 
+result connected_components_create_stream
+(
+  connected_components *target,
+  uint32 width,
+  uint32 height
+)
+{
+  TRY();
+  uint32 x, y;
+  region_info *pixel;
+  byte *value;
+
+  CHECK_POINTER(target);
+  connected_components_nullify(target);
+  CHECK_PARAM(width > 0 && height > 0);
+
+  CHECK(memory_allocate((data_pointer *)&target->pixels, width*height, sizeof(region_info)));
+  CHECK(memory_clear((data_pointer)target->pixels, width*height, sizeof(region_info)));
+  CHECK(memory_allocate((data_pointer *)&target->values, width*height, sizeof(byte)));
+
+  target->width = width;
+  target->height = height;
+  target->channels = 1;
+
+  for (y = 0, pixel = target->pixels, value = target->values; y < height; y++) {
+    for (x = 0; x < width; x++, pixel++, value++) {
+      pixel->id = pixel;
+      pixel->x1 = x;
+      pixel->y1 = y;
+      pixel->x2 = x;
+      pixel->y2 = y;
+      pixel->value = value;
+    }
+  }
+
+  FINALLY(connected_components_create_stream);
+  if (r != SUCCESS) {
+    connected_components_destroy(target);
+  }
+  RETURN();
+}
+
+/******************************************************************************/
+
 result connected_components_destroy
 (
   connected_components *target
@@ -206,6 +252,9 @@ result connected_components_destroy
   if (target->regions != NULL) {
       CHECK(memory_deallocate((data_pointer*)&target->regions));
   }
+  if (target->values != NULL) {
+      CHECK(memory_deallocate((data_pointer*)&target->values));
+  }
   connected_components_nullify(target);
 
   FINALLY(connected_components_destroy);
@@ -230,6 +279,8 @@ result connected_components_nullify
   target->pixels = NULL;
   target->regions = NULL;
   target->count = 0;
+  target->values = NULL;
+  target->rows = 0;
 
   FINALLY(connected_components_nullify);
   RETURN();
@@ -243,7 +294,8 @@ truth_value connected_components_is_null
 )
 {
   if (target != NULL) {
-    if (target->original != NULL && target->pixels != NULL) {
+    if ((target->original != NULL || target->values != NULL) &&
+        target->pixels != NULL) {
       return FALSE;
     }
   }
@@ -266,31 +318,33 @@ truth_value connected_components_is_null
     region_union(pixel, neighbor);\
   }
 
-result connected_components_update
+/******************************************************************************/
+/* private function for merging the pixels of a row with the regions on the  */
+/* left and top                                                               */
+
+void connected_components_merge_row
 (
-  connected_components *target
+  connected_components *target,
+  uint32 y
 )
 {
-  TRY();
-  uint32 x, y, width, height, i, channels, count;
+  uint32 x, i, width, channels;
   truth_value is_equal;
-  region_info *pixel, *neighbor, *id, **region;
-
-  CHECK_POINTER(target);
+  region_info *pixel, *neighbor;
 
   width = target->width;
-  height = target->height;
   channels = target->channels;
+  pixel = target->pixels + y * width;
 
-  /* first, handle first row comparing only to left */
-  y = 0;
-  pixel = target->pixels;
-  neighbor = pixel++;
-  for (x = 1; x < width; x++, pixel++) {
-    COMPARE_REGIONS();
-    neighbor = pixel;
+  if (y == 0) {
+    /* first, handle first row comparing only to left */
+    neighbor = pixel++;
+    for (x = 1; x < width; x++, pixel++) {
+      COMPARE_REGIONS();
+      neighbor = pixel;
+    }
   }
-  for (y = 1; y < height; y++) {
+  else {
     /* for the first item of each row, compare only to top */
     neighbor = pixel - width;
     COMPARE_REGIONS();
@@ -304,6 +358,59 @@ result connected_components_update
       neighbor = pixel;
     }
   }
+}
+
+/******************************************************************************/
+
+result connected_components_add_row
+(
+  pointer params,
+  uint32 row,
+  const byte *source
+)
+{
+  TRY();
+  connected_components *target;
+  byte *value;
+  uint32 x;
+
+  CHECK_POINTER(params);
+  CHECK_POINTER(source);
+  target = (connected_components *)params;
+  CHECK_POINTER(target->values);
+  CHECK_PARAM(row == target->rows);
+  CHECK_PARAM(row < target->height);
+
+  value = target->values + row * target->width;
+  for (x = 0; x < target->width; x++) {
+    value[x] = source[x];
+  }
+  connected_components_merge_row(target, row);
+  target->rows = row + 1;
+
+  FINALLY(connected_components_add_row);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result connected_components_update
+(
+  connected_components *target
+)
+{
+  TRY();
+  uint32 y, width, height, i, count;
+  region_info *pixel, *id, **region;
+
+  CHECK_POINTER(target);
+
+  width = target->width;
+  height = target->height;
+
+  for (y = target->rows; y < height; y++) {
+    connected_components_merge_row(target, y);
+  }
 
   /* count the regions and set up colors */
   count = 0;
@@ -72,6 +72,10 @@ typedef struct connected_components_t
   region_info *pixels;
   region_info **regions;
   uint32 count;
+  /** Pixel values owned by the structure when the rows are added one by one */
+  byte *values;
+  /** Number of rows already merged with their neighbors */
+  uint32 rows;
 } connected_components;
 
 /**
@@ -100,6 +104,36 @@ result connected_components_create
   pixel_image *source
 );
 
+/**
+ * Creates a connected_components structure for a single-channel image that is
+ * provided one row at a time with @see connected_components_add_row. The pixel
+ * values are stored in the structure, so the image does not need to exist as
+ * a whole. The memory use is NOT bounded by the row count: one region_info and
+ * one value are kept for every pixel of the image until the structure is
+ * destroyed, which takes considerably more memory than the image itself.
+ */
+result connected_components_create_stream
+(
+  connected_components *target,
+  uint32 width,
+  uint32 height
+);
+
+/**
+ * Adds the next row to a connected_components structure created with
+ * @see connected_components_create_stream and merges its pixels with the
+ * regions on the left and top right away. The regions are collected by
+ * @see connected_components_update after the last row. The signature matches
+ * image_row_writer, so the function can be used as the writer of row based
+ * functions by passing the structure as the params.
+ */
+result connected_components_add_row
+(
+  pointer params,
+  uint32 row,
+  const byte *source
+);
+
 /**
  * Destroys a connected_components structure and deallocates all memory.
  */
@@ -130,7 +164,8 @@ truth_value connected_components_is_null
  * Updates a connected_components structure: compares each pixel to neighbors
  * on left and top and merges regions with those that have the same value.
  * Assigns a color for each resulting connected region and collects all regions
- * into the regions array.
+ * into the regions array. Rows already merged by
+ * @see connected_components_add_row are not compared again.
  */
 result connected_components_update
 (
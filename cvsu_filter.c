@@ -33,18 +33,40 @@
 #include "cvsu_macros.h"
 #include "cvsu_memory.h"
 #include "cvsu_filter.h"
+#include "cvsu_simd.h"
+#include "cvsu_parallel.h"
+
+#include <string.h>
+#include <math.h>
 
 /******************************************************************************/
 /* constants for reporting function names in error messages                   */
 
 string threshold_name = "threshold";
+string threshold_stream_name = "threshold_stream";
 string smooth_binomial_name = "smooth_binomial";
+string smooth_binomial_buffered_name = "smooth_binomial_buffered";
+string smooth_binomial_with_buffer_name = "smooth_binomial_with_buffer";
+string smooth_binomial_stream_name = "smooth_binomial_stream";
+string smooth_binomial_stream_push_name = "smooth_binomial_stream_push";
 string sobel_x_name = "sobel_x";
 string abs_sobel_x_name = "abs_sobel_x";
 string sobel_y_name = "sobel_y";
 string abs_sobel_y_name = "abs_sobel_y";
+string sobel_gradient_name = "sobel_gradient";
 string extrema_x_name = "extrema_x";
+string extrema_x_parallel_name = "extrema_x_parallel";
 string extrema_y_name = "extrema_y";
+string extrema_y_parallel_name = "extrema_y_parallel";
+string filter_chain_create_name = "filter_chain_create";
+string filter_chain_destroy_name = "filter_chain_destroy";
+string filter_chain_nullify_name = "filter_chain_nullify";
+string filter_chain_add_name = "filter_chain_add";
+string filter_stage_get_info_name = "filter_stage_get_info";
+string filter_stage_apply_name = "filter_stage_apply";
+string filter_chain_run_band_name = "filter_chain_run_band";
+string filter_chain_run_name = "filter_chain_run";
+string convolve_separable_name = "convolve_separable";
 
 /******************************************************************************/
 
@@ -101,6 +123,280 @@ result threshold
 
 /******************************************************************************/
 
+result threshold_stream
+(
+  image_row_reader reader,
+  pointer reader_params,
+  image_row_writer writer,
+  pointer writer_params,
+  uint32 width,
+  uint32 height,
+  byte t
+)
+{
+  TRY();
+  byte *row;
+  uint32 x, y;
+
+  row = NULL;
+  CHECK_POINTER(reader);
+  CHECK_POINTER(writer);
+  CHECK_PARAM(width > 0);
+
+  CHECK(memory_allocate((data_pointer *)&row, width, sizeof(byte)));
+  for (y = 0; y < height; y++) {
+    CHECK(reader(reader_params, y, row));
+    for (x = 0; x < width; x++) {
+      row[x] = (byte)((row[x] >= t) ? 255 : 0);
+    }
+    CHECK(writer(writer_params, y, row));
+  }
+
+  FINALLY(threshold_stream);
+  memory_deallocate((data_pointer *)&row);
+  RETURN();
+}
+
+/******************************************************************************/
+
+/******************************************************************************/
+/* row kernels applying the binomial mask [ 1/4 1/2 1/4 ] to three rows of   */
+/* values; each term is shifted separately, as in the original sweeps, so    */
+/* the sum always fits in a byte                                              */
+
+typedef void (*binomial_row_function)
+(
+  const byte *prev,
+  const byte *curr,
+  const byte *next,
+  byte *target,
+  uint32 count
+);
+
+void binomial_row
+(
+  const byte *prev,
+  const byte *curr,
+  const byte *next,
+  byte *target,
+  uint32 count
+)
+{
+  uint32 x;
+
+  for (x = 0; x < count; x++) {
+    target[x] = (byte)((prev[x] >> 2) + (curr[x] >> 1) + (next[x] >> 2));
+  }
+}
+
+#ifdef HAVE_X86_SIMD
+
+SIMD_TARGET_SSE2
+void binomial_row_sse2
+(
+  const byte *prev,
+  const byte *curr,
+  const byte *next,
+  byte *target,
+  uint32 count
+)
+{
+  __m128i mask_2, mask_1, a, b, c;
+  uint32 x;
+
+  /* bytes are shifted as 16-bit values, and the bits shifted in from the */
+  /* neighboring byte are masked out */
+  mask_2 = _mm_set1_epi8(0x3F);
+  mask_1 = _mm_set1_epi8(0x7F);
+  for (x = 0; x + 16 <= count; x += 16) {
+    a = _mm_loadu_si128((const __m128i *)(prev + x));
+    b = _mm_loadu_si128((const __m128i *)(curr + x));
+    c = _mm_loadu_si128((const __m128i *)(next + x));
+    a = _mm_and_si128(_mm_srli_epi16(a, 2), mask_2);
+    b = _mm_and_si128(_mm_srli_epi16(b, 1), mask_1);
+    c = _mm_and_si128(_mm_srli_epi16(c, 2), mask_2);
+    _mm_storeu_si128((__m128i *)(target + x),
+                     _mm_add_epi8(_mm_add_epi8(a, b), c));
+  }
+  binomial_row(prev + x, curr + x, next + x, target + x, count - x);
+}
+
+SIMD_TARGET_AVX2
+void binomial_row_avx2
+(
+  const byte *prev,
+  const byte *curr,
+  const byte *next,
+  byte *target,
+  uint32 count
+)
+{
+  __m256i mask_2, mask_1, a, b, c;
+  uint32 x;
+
+  mask_2 = _mm256_set1_epi8(0x3F);
+  mask_1 = _mm256_set1_epi8(0x7F);
+  for (x = 0; x + 32 <= count; x += 32) {
+    a = _mm256_loadu_si256((const __m256i *)(prev + x));
+    b = _mm256_loadu_si256((const __m256i *)(curr + x));
+    c = _mm256_loadu_si256((const __m256i *)(next + x));
+    a = _mm256_and_si256(_mm256_srli_epi16(a, 2), mask_2);
+    b = _mm256_and_si256(_mm256_srli_epi16(b, 1), mask_1);
+    c = _mm256_and_si256(_mm256_srli_epi16(c, 2), mask_2);
+    _mm256_storeu_si256((__m256i *)(target + x),
+                        _mm256_add_epi8(_mm256_add_epi8(a, b), c));
+  }
+  binomial_row_sse2(prev + x, curr + x, next + x, target + x, count - x);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+binomial_row_function binomial_get_row_function()
+{
+#ifdef HAVE_X86_SIMD
+  if (simd_get_level() >= s_AVX2) {
+    return &binomial_row_avx2;
+  }
+  if (simd_get_level() >= s_SSE2) {
+    return &binomial_row_sse2;
+  }
+#endif
+  return &binomial_row;
+}
+
+/******************************************************************************/
+/* private structure and function for smoothing an image row by row; each    */
+/* pass keeps the three latest horizontally filtered rows and emits the      */
+/* vertically filtered row to the next pass as soon as its lower neighbor has */
+/* arrived, so all passes are done in one sweep over the image, and the      */
+/* result is the same as with separate sweeps over the whole image           */
+
+typedef struct binomial_stream_t {
+  image_row_writer writer;
+  pointer writer_params;
+  binomial_row_function filter_row;
+  uint32 width;
+  uint32 height;
+  uint32 passes;
+  /* for each pass three input rows and one output row */
+  byte *rows;
+} binomial_stream;
+
+result smooth_binomial_stream_push
+(
+  binomial_stream *stream,
+  uint32 pass,
+  uint32 row,
+  const byte *source
+)
+{
+  TRY();
+  byte *rows, *curr_row, *prev_row, *next_row, *output;
+  uint32 width;
+
+  CHECK_POINTER(stream);
+
+  width = stream->width;
+  rows = stream->rows + 4 * width * pass;
+  output = rows + 3 * width;
+
+  /* filter the new row horizontally, skipping first and last column */
+  next_row = rows + (row % 3) * width;
+  next_row[0] = source[0];
+  stream->filter_row(source, source + 1, source + 2, next_row + 1, width - 2);
+  next_row[width - 1] = source[width - 1];
+
+  /* first row is not filtered vertically */
+  if (row == 0) {
+    if (pass + 1 < stream->passes) {
+      CHECK(smooth_binomial_stream_push(stream, pass + 1, 0, next_row));
+    }
+    else {
+      CHECK(stream->writer(stream->writer_params, 0, next_row));
+    }
+  }
+  /* the previous row can be filtered vertically when this one has arrived */
+  if (row > 1) {
+    prev_row = rows + ((row - 2) % 3) * width;
+    curr_row = rows + ((row - 1) % 3) * width;
+    stream->filter_row(prev_row, curr_row, next_row, output, width);
+    if (pass + 1 < stream->passes) {
+      CHECK(smooth_binomial_stream_push(stream, pass + 1, row - 1, output));
+    }
+    else {
+      CHECK(stream->writer(stream->writer_params, row - 1, output));
+    }
+  }
+  /* last row is not filtered vertically */
+  if (row > 0 && row == stream->height - 1) {
+    if (pass + 1 < stream->passes) {
+      CHECK(smooth_binomial_stream_push(stream, pass + 1, row, next_row));
+    }
+    else {
+      CHECK(stream->writer(stream->writer_params, row, next_row));
+    }
+  }
+
+  FINALLY(smooth_binomial_stream_push);
+  RETURN();
+}
+
+/******************************************************************************/
+
+/* smoothes using a buffer of (4 * passes + 1) * width bytes given by caller */
+result smooth_binomial_buffered
+(
+  const pixel_image *source,
+  pixel_image *target,
+  uint32 passes,
+  byte *rows
+)
+{
+  TRY();
+  binomial_stream stream;
+  const byte *source_pos;
+  byte *row;
+  uint32 x, y;
+
+  CHECK_POINTER(source);
+  CHECK_POINTER(target);
+  CHECK_POINTER(rows);
+
+  /* the channels that are not smoothed are copied as they are */
+  if (source->step != 1 || target->step != 1 || passes == 0) {
+    CHECK(pixel_image_copy(target, source));
+    if (passes == 0) {
+      TERMINATE(SUCCESS);
+    }
+  }
+
+  /* the rows are written behind the rows read, so target can be source */
+  stream.writer = &pixel_image_write_row;
+  stream.writer_params = target;
+  stream.filter_row = binomial_get_row_function();
+  stream.width = source->width;
+  stream.height = source->height;
+  stream.passes = passes;
+  stream.rows = rows;
+  /* one extra row for picking the smoothed channel of the source */
+  row = stream.rows + 4 * passes * source->width;
+  for (y = 0; y < source->height; y++) {
+    source_pos = (const byte *)source->rows[y];
+    if (source->step != 1) {
+      for (x = 0; x < source->width; x++, source_pos += source->step) {
+        row[x] = *source_pos;
+      }
+      source_pos = row;
+    }
+    CHECK(smooth_binomial_stream_push(&stream, 0, y, source_pos));
+  }
+
+  FINALLY(smooth_binomial_buffered);
+  RETURN();
+}
+
+/******************************************************************************/
+
 result smooth_binomial
 (
   const pixel_image *source,
@@ -109,7 +405,9 @@ result smooth_binomial
 )
 {
   TRY();
+  byte *rows;
 
+  rows = NULL;
   CHECK_POINTER(source);
   CHECK_POINTER(target);
   CHECK_POINTER(source->data);
@@ -118,56 +416,103 @@ result smooth_binomial
   CHECK_PARAM(target->type == p_U8);
   CHECK_PARAM(source->width == target->width);
   CHECK_PARAM(source->height == target->height);
+  CHECK_PARAM(source->width > 1);
+  CHECK_PARAM(source->height > 1);
 
-  /* copy source image data for 'pass 0' result */
-  CHECK(pixel_image_copy(target, source));
+  CHECK(memory_allocate((data_pointer *)&rows,
+                        (4 * passes + 1) * source->width, sizeof(byte)));
+  CHECK(smooth_binomial_buffered(source, target, passes, rows));
 
-  {
-    uint32 x, y, pass, target_stride;
-    byte prev, curr, next;
-    SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(target, byte);
-    target_stride = target->stride;
-
-    /* smooth out the 'pass 0' result with binomial filter */
-    for (pass = 0; pass < passes; pass++) {
-      /* filter row by row */
-      FOR_DISCONTINUOUS_IMAGE_ROW(target)
-      {
-        prev = PIXEL_VALUE(target);
-        target_pos += target_step;
-        curr = PIXEL_VALUE(target);
-        next = PIXEL_VALUE_PLUS(target, target_step);
-        /* skipping first and last column */
-        for (x = target->width - 2; x--; ) {
-          /* apply binomial mask [ 1/4 1/2 1/4 ] */
-          PIXEL_VALUE(target) = (byte)((prev >> 2) + (curr >> 1) + (next >> 2));
-          prev = curr;
-          curr = next;
-          target_pos += target_step;
-          next = PIXEL_VALUE_PLUS(target, target_step);
-        }
-      }
-      /* filter column by column */
-      FOR_DISCONTINUOUS_IMAGE_COL(target)
-      {
-        prev = PIXEL_VALUE(target);
-        target_pos += target_stride;
-        curr = PIXEL_VALUE(target);
-        next = PIXEL_VALUE_PLUS(target, target_stride);
-        /* skipping first and last row */
-        for (y = target->height - 2; y--; ) {
-          /* apply binomial mask [ 1/4 1/2 1/4 ] */
-          PIXEL_VALUE(target) = (byte)((prev >> 2) + (curr >> 1) + (next >> 2));
-          prev = curr;
-          curr = next;
-          target_pos += target_stride;
-          next = PIXEL_VALUE_PLUS(target, target_stride);
-        }
-      }
+  FINALLY(smooth_binomial);
+  memory_deallocate((data_pointer *)&rows);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result smooth_binomial_with_buffer
+(
+  const pixel_image *source,
+  pixel_image *target,
+  uint32 passes,
+  pixel_image *buffer
+)
+{
+  TRY();
+
+  CHECK_POINTER(source);
+  CHECK_POINTER(target);
+  CHECK_POINTER(buffer);
+  CHECK_POINTER(source->data);
+  CHECK_POINTER(target->data);
+  CHECK_POINTER(buffer->data);
+  CHECK_PARAM(source->type == p_U8);
+  CHECK_PARAM(target->type == p_U8);
+  CHECK_PARAM(buffer->type == p_U8);
+  CHECK_PARAM(source->width == target->width);
+  CHECK_PARAM(source->height == target->height);
+  CHECK_PARAM(source->width > 1);
+  CHECK_PARAM(source->height > 1);
+  /* the rows are kept one after another in the data of the buffer */
+  CHECK_PARAM(buffer->size >= (4 * passes + 1) * source->width);
+
+  CHECK(smooth_binomial_buffered(source, target, passes,
+                                 (byte *)buffer->data));
+
+  FINALLY(smooth_binomial_with_buffer);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result smooth_binomial_stream
+(
+  image_row_reader reader,
+  pointer reader_params,
+  image_row_writer writer,
+  pointer writer_params,
+  uint32 width,
+  uint32 height,
+  uint32 passes
+)
+{
+  TRY();
+  binomial_stream stream;
+  byte *row;
+  uint32 y;
+
+  row = NULL;
+  stream.rows = NULL;
+  CHECK_POINTER(reader);
+  CHECK_POINTER(writer);
+  CHECK_PARAM(width > 1);
+  CHECK_PARAM(height > 1);
+
+  CHECK(memory_allocate((data_pointer *)&row, width, sizeof(byte)));
+  if (passes == 0) {
+    for (y = 0; y < height; y++) {
+      CHECK(reader(reader_params, y, row));
+      CHECK(writer(writer_params, y, row));
     }
+    TERMINATE(SUCCESS);
   }
 
-  FINALLY(smooth_binomial);
+  stream.writer = writer;
+  stream.writer_params = writer_params;
+  stream.filter_row = binomial_get_row_function();
+  stream.width = width;
+  stream.height = height;
+  stream.passes = passes;
+  CHECK(memory_allocate((data_pointer *)&stream.rows, 4 * width * passes,
+                        sizeof(byte)));
+  for (y = 0; y < height; y++) {
+    CHECK(reader(reader_params, y, row));
+    CHECK(smooth_binomial_stream_push(&stream, 0, y, row));
+  }
+
+  FINALLY(smooth_binomial_stream);
+  memory_deallocate((data_pointer *)&row);
+  memory_deallocate((data_pointer *)&stream.rows);
   RETURN();
 }
 
@@ -436,172 +781,1767 @@ result abs_sobel_y
 }
 
 /******************************************************************************/
+/* row kernels for the fused sobel gradient; each output is optional, and    */
+/* the kernels process the pixels 0..count-1 of the rows, reading also the   */
+/* pixels at -1 and count                                                     */
 
-result extrema_x
+typedef void (*sobel_row_function)
 (
-  const pixel_image *source,
-  pixel_image *target
-)
-{
-  TRY();
+  const byte *prev,
+  const byte *curr,
+  const byte *next,
+  sint16 *dx,
+  sint16 *dy,
+  uint16 *magnitude,
+  byte *orientation,
+  uint32 count
+);
 
-  CHECK_POINTER(source);
-  CHECK_POINTER(target);
-  CHECK_POINTER(source->data);
-  CHECK_POINTER(target->data);
-  CHECK_PARAM(source->type == p_S32);
-  CHECK_PARAM(target->type == p_S32);
-  CHECK_PARAM(source->width == target->width);
-  CHECK_PARAM(source->height == target->height);
+/* the sectors of width 45 degrees are separated by comparing the gradient  */
+/* components; 12/29 approximates tan(22.5 degrees) with small integers, so */
+/* that the products of 10-bit components fit in 16 bits                    */
+#define SOBEL_SECTOR_NUMERATOR 12
+#define SOBEL_SECTOR_DENOMINATOR 29
 
-  {
-    uint32 x, y, x_end, y_end;
-    long value, prev;
-    truth_value is_rising, is_falling;
-    DISCONTINUOUS_IMAGE_VARIABLES(long, long);
-    y_end = source->height;
-    x_end = source->width - 2;
+void sobel_gradient_row
+(
+  const byte *prev,
+  const byte *curr,
+  const byte *next,
+  sint16 *dx,
+  sint16 *dy,
+  uint16 *magnitude,
+  byte *orientation,
+  uint32 count
+)
+{
+  uint32 x;
+  sint32 gx, gy, ax, ay;
 
-    for (y = y_end; y--; ) {
-      /* keep target one step behind source */
-      source_pos = source_rows[y] + 2 * source_step;
-      /* this is because target is always updated by previous value */
-      target_pos = target_rows[y] + 1 * target_step;
-      /* initialize direction and prev value */
-      value = PIXEL_VALUE_MINUS(source, 1);
-      prev = PIXEL_VALUE_MINUS(source, 2);
-      if (value < prev) {
-        is_falling = TRUE;
-        is_rising = FALSE;
+  for (x = 0; x < count; x++) {
+    gx = (sint32)(prev[x + 1] - prev[x - 1]) +
+         2 * (sint32)(curr[x + 1] - curr[x - 1]) +
+         (sint32)(next[x + 1] - next[x - 1]);
+    gy = (sint32)(next[x - 1] - prev[x - 1]) +
+         2 * (sint32)(next[x] - prev[x]) +
+         (sint32)(next[x + 1] - prev[x + 1]);
+    if (dx != NULL) {
+      dx[x] = (sint16)gx;
+    }
+    if (dy != NULL) {
+      dy[x] = (sint16)gy;
+    }
+    if (magnitude != NULL) {
+      /* rounded in single precision, the same way as the vector kernels */
+      magnitude[x] = (uint16)((float)sqrt((double)(gx * gx + gy * gy)) +
+                              0.5f);
+    }
+    if (orientation != NULL) {
+      ax = (gx < 0) ? -gx : gx;
+      ay = (gy < 0) ? -gy : gy;
+      if (SOBEL_SECTOR_DENOMINATOR * ay <= SOBEL_SECTOR_NUMERATOR * ax) {
+        orientation[x] = (byte)((gx < 0) ? 4 : 0);
       }
-      else {
-        is_falling = FALSE;
-        if (value > prev) {
-          is_rising = TRUE;
-        }
-        else {
-          is_rising = FALSE;
-        }
+      else
+      if (SOBEL_SECTOR_DENOMINATOR * ax <= SOBEL_SECTOR_NUMERATOR * ay) {
+        orientation[x] = (byte)((gy < 0) ? 6 : 2);
       }
-      prev = value;
-      /* now find extrema row by row */
-      for (x = x_end; x--; source_pos += source_step, target_pos += target_step) {
-        value = PIXEL_VALUE(source);
-        if (value < prev) {
-          if (IS_TRUE(is_rising)) {
-            PIXEL_VALUE(target) = value;
-            is_rising = FALSE;
-          }
-          else {
-            PIXEL_VALUE(target) = 0;
-          }
-          is_falling = TRUE;
-        }
-        else if (value > prev) {
-          if (IS_TRUE(is_falling)) {
-            PIXEL_VALUE(target) = value;
-            is_falling = FALSE;
-          }
-          else {
-            PIXEL_VALUE(target) = 0;
-          }
-          is_rising = TRUE;
-        }
-        else {
-          PIXEL_VALUE(target) = 0;
-        }
-        prev = value;
+      else
+      if (gy > 0) {
+        orientation[x] = (byte)((gx < 0) ? 3 : 1);
+      }
+      else {
+        orientation[x] = (byte)((gx < 0) ? 5 : 7);
       }
     }
   }
+}
 
-  FINALLY(extrema_x);
-  RETURN();
+#ifdef HAVE_X86_SIMD
+
+/* computes the gradient components of 8 pixels as 16-bit values */
+#define SOBEL_SSE2_COMPONENTS(gx, gy, unpack)\
+  {\
+    __m128i p_l, p_r, c_l, c_r, n_l, n_r, p_c, n_c;\
+    p_l = unpack(_mm_loadu_si128((const __m128i *)(prev + x - 1)), zero);\
+    p_c = unpack(_mm_loadu_si128((const __m128i *)(prev + x)), zero);\
+    p_r = unpack(_mm_loadu_si128((const __m128i *)(prev + x + 1)), zero);\
+    c_l = unpack(_mm_loadu_si128((const __m128i *)(curr + x - 1)), zero);\
+    c_r = unpack(_mm_loadu_si128((const __m128i *)(curr + x + 1)), zero);\
+    n_l = unpack(_mm_loadu_si128((const __m128i *)(next + x - 1)), zero);\
+    n_c = unpack(_mm_loadu_si128((const __m128i *)(next + x)), zero);\
+    n_r = unpack(_mm_loadu_si128((const __m128i *)(next + x + 1)), zero);\
+    gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(p_r, p_l),\
+                                     _mm_slli_epi16(_mm_sub_epi16(c_r, c_l), 1)),\
+                       _mm_sub_epi16(n_r, n_l));\
+    gy = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(n_l, p_l),\
+                                     _mm_slli_epi16(_mm_sub_epi16(n_c, p_c), 1)),\
+                       _mm_sub_epi16(n_r, p_r));\
+  }
+
+/* calculates the rounded magnitude of 4 pixels from interleaved components */
+#define SOBEL_SSE2_MAGNITUDE(pairs)\
+  _mm_cvttps_epi32(_mm_add_ps(_mm_sqrt_ps(_mm_cvtepi32_ps(\
+    _mm_madd_epi16(pairs, pairs))), half))
+
+SIMD_TARGET_SSE2
+__m128i sobel_orientation_sse2
+(
+  __m128i gx,
+  __m128i gy
+)
+{
+  __m128i zero, ax, ay, horizontal, vertical, neg_x, neg_y, two, four, seven;
+  __m128i horizontal_bin, vertical_bin, diagonal_bin, numerator, denominator;
+
+  zero = _mm_setzero_si128();
+  two = _mm_set1_epi16(2);
+  four = _mm_set1_epi16(4);
+  seven = _mm_set1_epi16(7);
+  numerator = _mm_set1_epi16(SOBEL_SECTOR_NUMERATOR);
+  denominator = _mm_set1_epi16(SOBEL_SECTOR_DENOMINATOR);
+  ax = _mm_max_epi16(gx, _mm_sub_epi16(zero, gx));
+  ay = _mm_max_epi16(gy, _mm_sub_epi16(zero, gy));
+  /* the masks are inverted, as there is no compare for less or equal */
+  horizontal = _mm_cmpgt_epi16(_mm_mullo_epi16(ay, denominator),
+                               _mm_mullo_epi16(ax, numerator));
+  vertical = _mm_cmpgt_epi16(_mm_mullo_epi16(ax, denominator),
+                             _mm_mullo_epi16(ay, numerator));
+  neg_x = _mm_cmpgt_epi16(zero, gx);
+  neg_y = _mm_cmpgt_epi16(zero, gy);
+  horizontal_bin = _mm_and_si128(neg_x, four);
+  vertical_bin = _mm_add_epi16(two, _mm_and_si128(neg_y, four));
+  diagonal_bin = _mm_or_si128(
+      _mm_and_si128(neg_y, _mm_sub_epi16(seven, _mm_and_si128(neg_x, two))),
+      _mm_andnot_si128(neg_y, _mm_add_epi16(_mm_set1_epi16(1),
+                                            _mm_and_si128(neg_x, two))));
+  diagonal_bin = _mm_or_si128(_mm_and_si128(vertical, diagonal_bin),
+                              _mm_andnot_si128(vertical, vertical_bin));
+  return _mm_or_si128(_mm_and_si128(horizontal, diagonal_bin),
+                      _mm_andnot_si128(horizontal, horizontal_bin));
+}
+
+SIMD_TARGET_SSE2
+void sobel_gradient_row_sse2
+(
+  const byte *prev,
+  const byte *curr,
+  const byte *next,
+  sint16 *dx,
+  sint16 *dy,
+  uint16 *magnitude,
+  byte *orientation,
+  uint32 count
+)
+{
+  __m128i zero, gx_lo, gy_lo, gx_hi, gy_hi, mag_lo, mag_hi;
+  __m128 half;
+  uint32 x;
+
+  zero = _mm_setzero_si128();
+  half = _mm_set1_ps(0.5f);
+  /* the loads reach one pixel past the sixteen pixels */
+  for (x = 0; x + 17 <= count + 1; x += 16) {
+    SOBEL_SSE2_COMPONENTS(gx_lo, gy_lo, _mm_unpacklo_epi8);
+    SOBEL_SSE2_COMPONENTS(gx_hi, gy_hi, _mm_unpackhi_epi8);
+    if (dx != NULL) {
+      _mm_storeu_si128((__m128i *)(dx + x), gx_lo);
+      _mm_storeu_si128((__m128i *)(dx + x + 8), gx_hi);
+    }
+    if (dy != NULL) {
+      _mm_storeu_si128((__m128i *)(dy + x), gy_lo);
+      _mm_storeu_si128((__m128i *)(dy + x + 8), gy_hi);
+    }
+    if (magnitude != NULL) {
+      mag_lo = _mm_packs_epi32(
+          SOBEL_SSE2_MAGNITUDE(_mm_unpacklo_epi16(gx_lo, gy_lo)),
+          SOBEL_SSE2_MAGNITUDE(_mm_unpackhi_epi16(gx_lo, gy_lo)));
+      mag_hi = _mm_packs_epi32(
+          SOBEL_SSE2_MAGNITUDE(_mm_unpacklo_epi16(gx_hi, gy_hi)),
+          SOBEL_SSE2_MAGNITUDE(_mm_unpackhi_epi16(gx_hi, gy_hi)));
+      _mm_storeu_si128((__m128i *)(magnitude + x), mag_lo);
+      _mm_storeu_si128((__m128i *)(magnitude + x + 8), mag_hi);
+    }
+    if (orientation != NULL) {
+      _mm_storeu_si128((__m128i *)(orientation + x),
+                       _mm_packus_epi16(sobel_orientation_sse2(gx_lo, gy_lo),
+                                        sobel_orientation_sse2(gx_hi, gy_hi)));
+    }
+  }
+  sobel_gradient_row(prev + x, curr + x, next + x,
+                     (dx != NULL) ? dx + x : NULL,
+                     (dy != NULL) ? dy + x : NULL,
+                     (magnitude != NULL) ? magnitude + x : NULL,
+                     (orientation != NULL) ? orientation + x : NULL,
+                     count - x);
 }
 
+#endif /* HAVE_X86_SIMD */
+
 /******************************************************************************/
+/* private function for zeroing the first and last rows and columns of an    */
+/* output of sobel_gradient, as the kernels write only the inner pixels      */
 
-result extrema_y
+void sobel_gradient_clear_border
+(
+  pixel_image *target,
+  uint32 value_size
+)
+{
+  uint32 y, row_size;
+  byte *target_pos;
+
+  if (target->width == 0 || target->height == 0) {
+    return;
+  }
+  row_size = target->width * value_size;
+  memset(target->rows[0], 0, row_size);
+  memset(target->rows[target->height - 1], 0, row_size);
+  for (y = 1; y + 1 < target->height; y++) {
+    target_pos = (byte *)target->rows[y];
+    memset(target_pos, 0, value_size);
+    memset(target_pos + row_size - value_size, 0, value_size);
+  }
+}
+
+/******************************************************************************/
+
+result sobel_gradient
 (
   const pixel_image *source,
-  pixel_image *target
+  pixel_image *dx,
+  pixel_image *dy,
+  pixel_image *magnitude,
+  pixel_image *orientation
 )
 {
   TRY();
+  sobel_row_function gradient_row;
+  pixel_image *outputs[4];
+  const byte *rows[3];
+  const byte *source_pos;
+  byte *buffer;
+  uint32 i, x, y, width, height;
 
+  buffer = NULL;
   CHECK_POINTER(source);
-  CHECK_POINTER(target);
   CHECK_POINTER(source->data);
-  CHECK_POINTER(target->data);
-  CHECK_PARAM(source->type == p_S32);
-  CHECK_PARAM(target->type == p_S32);
-  CHECK_PARAM(source->width == target->width);
-  CHECK_PARAM(source->height == target->height);
+  CHECK_PARAM(source->type == p_U8);
+  CHECK_PARAM(dx == NULL || dx->type == p_S16);
+  CHECK_PARAM(dy == NULL || dy->type == p_S16);
+  CHECK_PARAM(magnitude == NULL || magnitude->type == p_U16);
+  CHECK_PARAM(orientation == NULL || orientation->type == p_U8);
 
-  {
-    uint32 x, y, x_end, y_end, source_stride, target_stride;
-    long value, prev;
-    truth_value is_rising, is_falling;
-    DISCONTINUOUS_IMAGE_VARIABLES(long, long);
-    x_end = source->width;
-    y_end = source->height - 2;
-    source_stride = source->stride;
-    target_stride = target->stride;
-
-    for (x = x_end; x--; ) {
-      /* keep target one step behind source */
-      source_pos = source_rows[2] + x * source_step;
-      /* this is because target is always updated by previous value */
-      target_pos = target_rows[1] + x * target_step;
-      /* initialize direction and prev value */
-      value = PIXEL_VALUE_MINUS(source, 1 * source_stride);
-      prev = PIXEL_VALUE_MINUS(source, 2 * source_stride);
-      if (value < prev) {
-        is_falling = TRUE;
-        is_rising = FALSE;
-      }
-      else {
-          is_falling = FALSE;
-        if (value > prev) {
-          is_rising = TRUE;
-        }
-        else {
-          is_rising = FALSE;
-        }
-      }
-      prev = value;
-      /* now find extrema col by col */
-      for (y = y_end; y--; source_pos += source_stride, target_pos += target_stride) {
-        value = PIXEL_VALUE(source);
-        if (value < prev) {
-          if (IS_TRUE(is_rising)) {
-            PIXEL_VALUE(target) = value;
-            is_rising = FALSE;
-          }
-          else {
-            PIXEL_VALUE(target) = 0;
-          }
-          is_falling = TRUE;
-        }
-        else if (value > prev) {
-          if (IS_TRUE(is_falling)) {
-            PIXEL_VALUE(target) = value;
-            is_falling = FALSE;
-          }
-          else {
-            PIXEL_VALUE(target) = 0;
-          }
-          is_rising = TRUE;
-        }
-        else {
-          PIXEL_VALUE(target) = 0;
-        }
-        prev = value;
+  width = source->width;
+  height = source->height;
+  outputs[0] = dx;
+  outputs[1] = dy;
+  outputs[2] = magnitude;
+  outputs[3] = orientation;
+  for (i = 0; i < 4; i++) {
+    if (outputs[i] != NULL) {
+      CHECK_POINTER(outputs[i]->data);
+      CHECK_PARAM(outputs[i]->width == width);
+      CHECK_PARAM(outputs[i]->height == height);
+      CHECK_PARAM(outputs[i]->step == 1);
+      sobel_gradient_clear_border(outputs[i],
+                                  (outputs[i]->type == p_U8) ? 1 : 2);
+    }
+  }
+  if (width < 3 || height < 3) {
+    TERMINATE(SUCCESS);
+  }
+
+  gradient_row = &sobel_gradient_row;
+#ifdef HAVE_X86_SIMD
+  if (simd_get_level() >= s_SSE2) {
+    gradient_row = &sobel_gradient_row_sse2;
+  }
+#endif
+
+  /* multi-channel sources are picked into a ring of three rows */
+  if (source->step != 1) {
+    CHECK(memory_allocate((data_pointer *)&buffer, 3 * width, sizeof(byte)));
+  }
+  for (y = 0; y < height; y++) {
+    if (buffer != NULL) {
+      source_pos = (const byte *)source->rows[y];
+      for (x = 0; x < width; x++, source_pos += source->step) {
+        buffer[(y % 3) * width + x] = *source_pos;
       }
+      rows[y % 3] = buffer + (y % 3) * width;
+    }
+    else {
+      rows[y % 3] = (const byte *)source->rows[y];
+    }
+    if (y < 2) {
+      continue;
     }
+    /* each source row is read once, when it becomes the next row */
+    gradient_row(rows[(y - 2) % 3] + 1, rows[(y - 1) % 3] + 1, rows[y % 3] + 1,
+                 (dx != NULL) ? (sint16 *)dx->rows[y - 1] + 1 : NULL,
+                 (dy != NULL) ? (sint16 *)dy->rows[y - 1] + 1 : NULL,
+                 (magnitude != NULL) ?
+                     (uint16 *)magnitude->rows[y - 1] + 1 : NULL,
+                 (orientation != NULL) ?
+                     (byte *)orientation->rows[y - 1] + 1 : NULL,
+                 width - 2);
   }
 
-  FINALLY(extrema_y);
+  FINALLY(sobel_gradient);
+  memory_deallocate((data_pointer *)&buffer);
+  RETURN();
+}
+
+/******************************************************************************/
+/* the extrema are found by following the direction of the last change along */
+/* a scanline, 1 for rising, -1 for falling and 0 before the first change;    */
+/* a value is marked where the direction turns, so the value after a peak or  */
+/* a valley is written and all others are set to 0                            */
+
+/* the direction of the change from prev to next */
+#define EXTREMA_DIRECTION(prev, next)\
+  (((next) > (prev)) ? 1 : (((next) < (prev)) ? -1 : 0))
+
+/******************************************************************************/
+/* finds the extrema of a row; the first and last position are not written  */
+
+void extrema_x_row
+(
+  const long *source,
+  long *target,
+  uint32 source_step,
+  uint32 target_step,
+  uint32 width
+)
+{
+  uint32 x;
+  long value, prev, trend;
+
+  trend = EXTREMA_DIRECTION(source[0], source[source_step]);
+  /* target is written behind source, so target can be source */
+  for (x = 1; x + 1 < width; x++) {
+    prev = source[x * source_step];
+    value = source[(x + 1) * source_step];
+    if (value < prev) {
+      target[x * target_step] = (trend > 0) ? value : 0;
+      trend = -1;
+    }
+    else
+    if (value > prev) {
+      target[x * target_step] = (trend < 0) ? value : 0;
+      trend = 1;
+    }
+    else {
+      target[x * target_step] = 0;
+    }
+  }
+}
+
+/******************************************************************************/
+/* row kernels for extrema_y; the scanlines are columns, so a row of values  */
+/* is processed at a time, keeping the direction of each column in a row     */
+
+typedef void (*extrema_y_row_function)
+(
+  const long *prev,
+  const long *next,
+  long *target,
+  long *trend,
+  uint32 source_step,
+  uint32 target_step,
+  uint32 width
+);
+
+void extrema_y_row
+(
+  const long *prev,
+  const long *next,
+  long *target,
+  long *trend,
+  uint32 source_step,
+  uint32 target_step,
+  uint32 width
+)
+{
+  uint32 x;
+  long value;
+
+  for (x = 0; x < width; x++) {
+    value = next[x * source_step];
+    if (value < prev[x * source_step]) {
+      target[x * target_step] = (trend[x] > 0) ? value : 0;
+      trend[x] = -1;
+    }
+    else
+    if (value > prev[x * source_step]) {
+      target[x * target_step] = (trend[x] < 0) ? value : 0;
+      trend[x] = 1;
+    }
+    else {
+      target[x * target_step] = 0;
+    }
+  }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* the vector kernel assumes 64-bit long and step 1; sse2 has no 64-bit     */
+/* compare, and emulating it was slower than the scalar rows               */
+
+SIMD_TARGET_AVX2
+void extrema_y_row_avx2
+(
+  const long *prev,
+  const long *next,
+  long *target,
+  long *trend,
+  uint32 source_step,
+  uint32 target_step,
+  uint32 width
+)
+{
+  __m256i zero, one, a, b, d, up, down, emit;
+  uint32 x;
+
+  (void)source_step;
+  (void)target_step;
+  zero = _mm256_setzero_si256();
+  one = _mm256_set1_epi64x(1);
+  for (x = 0; x + 4 <= width; x += 4) {
+    a = _mm256_loadu_si256((const __m256i *)(prev + x));
+    b = _mm256_loadu_si256((const __m256i *)(next + x));
+    d = _mm256_loadu_si256((const __m256i *)(trend + x));
+    up = _mm256_cmpgt_epi64(b, a);
+    down = _mm256_cmpgt_epi64(a, b);
+    emit = _mm256_or_si256(
+        _mm256_and_si256(up, _mm256_cmpgt_epi64(zero, d)),
+        _mm256_and_si256(down, _mm256_cmpgt_epi64(d, zero)));
+    _mm256_storeu_si256((__m256i *)(target + x), _mm256_and_si256(emit, b));
+    d = _mm256_or_si256(_mm256_andnot_si256(_mm256_or_si256(up, down), d),
+                        _mm256_or_si256(_mm256_and_si256(up, one), down));
+    _mm256_storeu_si256((__m256i *)(trend + x), d);
+  }
+  extrema_y_row(prev + x, next + x, target + x, trend + x, 1, 1, width - x);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+extrema_y_row_function extrema_y_get_row_function
+(
+  uint32 source_step,
+  uint32 target_step
+)
+{
+#ifdef HAVE_X86_SIMD
+  if (source_step == 1 && target_step == 1 && sizeof(long) == 8) {
+    if (simd_get_level() >= s_AVX2) {
+      return &extrema_y_row_avx2;
+    }
+  }
+#endif
+  return &extrema_y_row;
+}
+
+/******************************************************************************/
+/* private functions for finding the extrema in strips of rows in parallel   */
+
+typedef struct extrema_strips_t {
+  const pixel_image *source;
+  pixel_image *target;
+  /* for each strip of extrema_y, the directions before its first row and */
+  /* a copy of the row below its last row with the source step, as target */
+  /* can be source and the next strip may already have written the row    */
+  long *rows;
+} extrema_strips;
+
+void extrema_x_strip
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+)
+{
+  extrema_strips *strips;
+  uint32 y, first, last;
+
+  strips = (extrema_strips *)params;
+  first = (strips->source->height * index) / count;
+  last = (strips->source->height * (index + 1)) / count;
+
+  for (y = first; y < last; y++) {
+    extrema_x_row((const long *)strips->source->rows[y],
+                  (long *)strips->target->rows[y], strips->source->step,
+                  strips->target->step, strips->source->width);
+  }
+}
+
+/* the rows 1 to height - 2 are divided into strips */
+void extrema_y_get_strip
+(
+  const pixel_image *source,
+  uint32 index,
+  uint32 count,
+  uint32 *first,
+  uint32 *last
+)
+{
+  *first = 1 + ((source->height - 2) * index) / count;
+  *last = 1 + ((source->height - 2) * (index + 1)) / count;
+}
+
+/* finds the directions before the first row of a strip, and copies the row */
+/* below the last row; done for all strips before any row is written        */
+void extrema_y_prepare_strip
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+)
+{
+  extrema_strips *strips;
+  const pixel_image *source;
+  const long *prev, *next;
+  long *trend, *copy;
+  uint32 x, y, first, last, width, step, unknown;
+
+  strips = (extrema_strips *)params;
+  source = strips->source;
+  width = source->width;
+  step = source->step;
+  trend = strips->rows + (1 + step) * width * index;
+  copy = trend + width;
+  extrema_y_get_strip(source, index, count, &first, &last);
+
+  /* the direction comes from the last change above, usually right above */
+  for (x = 0; x < width; x++) {
+    trend[x] = 0;
+  }
+  unknown = width;
+  for (y = first; unknown > 0 && y > 0; y--) {
+    prev = (const long *)source->rows[y - 1];
+    next = (const long *)source->rows[y];
+    unknown = 0;
+    for (x = 0; x < width; x++) {
+      if (trend[x] == 0) {
+        trend[x] = EXTREMA_DIRECTION(prev[x * step], next[x * step]);
+        if (trend[x] == 0) {
+          unknown++;
+        }
+      }
+    }
+  }
+  next = (const long *)source->rows[last];
+  for (x = 0; x < width; x++) {
+    copy[x * step] = next[x * step];
+  }
+}
+
+void extrema_y_strip
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+)
+{
+  extrema_strips *strips;
+  extrema_y_row_function extrema_row;
+  const long *next;
+  long *trend;
+  uint32 y, first, last, width, step;
+
+  strips = (extrema_strips *)params;
+  width = strips->source->width;
+  step = strips->source->step;
+  trend = strips->rows + (1 + step) * width * index;
+  extrema_y_get_strip(strips->source, index, count, &first, &last);
+  extrema_row = extrema_y_get_row_function(step, strips->target->step);
+
+  for (y = first; y < last; y++) {
+    /* the row below the strip is read from the copy */
+    if (y + 1 < last) {
+      next = (const long *)strips->source->rows[y + 1];
+    }
+    else {
+      next = trend + width;
+    }
+    extrema_row((const long *)strips->source->rows[y], next,
+                (long *)strips->target->rows[y], trend, step,
+                strips->target->step, width);
+  }
+}
+
+/* with one thread, the columns are done in blocks narrow enough for their  */
+/* directions to be kept on the stack, so that no memory is allocated       */
+
+#define EXTREMA_Y_BLOCK 256
+
+void extrema_y_blocks
+(
+  const pixel_image *source,
+  pixel_image *target
+)
+{
+  extrema_y_row_function extrema_row;
+  const long *prev, *next;
+  long trend[EXTREMA_Y_BLOCK];
+  uint32 x, y, i, block, width, source_step, target_step;
+
+  width = source->width;
+  source_step = source->step;
+  target_step = target->step;
+  extrema_row = extrema_y_get_row_function(source_step, target_step);
+
+  for (x = 0; x < width; x += block) {
+    block = width - x;
+    if (block > EXTREMA_Y_BLOCK) {
+      block = EXTREMA_Y_BLOCK;
+    }
+    prev = (const long *)source->rows[0] + x * source_step;
+    next = (const long *)source->rows[1] + x * source_step;
+    for (i = 0; i < block; i++) {
+      trend[i] = EXTREMA_DIRECTION(prev[i * source_step],
+                                   next[i * source_step]);
+    }
+    /* the row below is read before it is written, so target can be source */
+    for (y = 1; y + 1 < source->height; y++) {
+      extrema_row((const long *)source->rows[y] + x * source_step,
+                  (const long *)source->rows[y + 1] + x * source_step,
+                  (long *)target->rows[y] + x * target_step, trend,
+                  source_step, target_step, block);
+    }
+  }
+}
+
+/******************************************************************************/
+
+result extrema_x
+(
+  const pixel_image *source,
+  pixel_image *target
+)
+{
+  TRY();
+
+  CHECK(extrema_x_parallel(source, target, 1));
+
+  FINALLY(extrema_x);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result extrema_x_parallel
+(
+  const pixel_image *source,
+  pixel_image *target,
+  uint32 threads
+)
+{
+  TRY();
+  extrema_strips strips;
+
+  CHECK_POINTER(source);
+  CHECK_POINTER(target);
+  CHECK_POINTER(source->data);
+  CHECK_POINTER(target->data);
+  CHECK_PARAM(source->type == p_S32);
+  CHECK_PARAM(target->type == p_S32);
+  CHECK_PARAM(source->width == target->width);
+  CHECK_PARAM(source->height == target->height);
+  CHECK_PARAM(threads > 0);
+
+  if (source->width < 3) {
+    TERMINATE(SUCCESS);
+  }
+  if (threads > source->height) {
+    threads = source->height;
+  }
+  strips.source = source;
+  strips.target = target;
+  strips.rows = NULL;
+  CHECK(parallel_run(&extrema_x_strip, &strips, threads));
+
+  FINALLY(extrema_x_parallel);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result extrema_y
+(
+  const pixel_image *source,
+  pixel_image *target
+)
+{
+  TRY();
+
+  CHECK(extrema_y_parallel(source, target, 1));
+
+  FINALLY(extrema_y);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result extrema_y_parallel
+(
+  const pixel_image *source,
+  pixel_image *target,
+  uint32 threads
+)
+{
+  TRY();
+  extrema_strips strips;
+
+  strips.rows = NULL;
+  CHECK_POINTER(source);
+  CHECK_POINTER(target);
+  CHECK_POINTER(source->data);
+  CHECK_POINTER(target->data);
+  CHECK_PARAM(source->type == p_S32);
+  CHECK_PARAM(target->type == p_S32);
+  CHECK_PARAM(source->width == target->width);
+  CHECK_PARAM(source->height == target->height);
+  CHECK_PARAM(threads > 0);
+
+  if (source->height < 3) {
+    TERMINATE(SUCCESS);
+  }
+  if (threads > source->height - 2) {
+    threads = source->height - 2;
+  }
+  if (threads == 1) {
+    extrema_y_blocks(source, target);
+    TERMINATE(SUCCESS);
+  }
+  strips.source = source;
+  strips.target = target;
+  CHECK(memory_allocate((data_pointer *)&strips.rows,
+                        (1 + source->step) * source->width * threads,
+                        sizeof(long)));
+  CHECK(parallel_run(&extrema_y_prepare_strip, &strips, threads));
+  CHECK(parallel_run(&extrema_y_strip, &strips, threads));
+
+  FINALLY(extrema_y_parallel);
+  memory_deallocate((data_pointer *)&strips.rows);
+  RETURN();
+}
+
+/******************************************************************************/
+/* a stage applied to a range of rows gives the same result as applied to the */
+/* whole image, except for the rows within the stage radius from the ends of  */
+/* the range that are not image borders; so each stage is applied to the band */
+/* extended by the radius of itself and all stages after it                   */
+
+/* the rows of a band are chosen to fit the intermediate images in L2 cache, */
+/* but not fewer than make the halo rows calculated twice a small overhead   */
+#define FILTER_CHAIN_CACHE_SIZE 262144
+#define FILTER_CHAIN_MIN_BAND_HEIGHT 16
+
+/* the buffers used by one thread for filtering its bands */
+typedef struct filter_chain_buffers_t {
+  /* the result of each stage for one band and its halo rows */
+  pixel_image *images;
+  /* the rows needed by smoothing */
+  byte *rows;
+  /* the result of filtering the bands of the thread */
+  result status;
+} filter_chain_buffers;
+
+typedef struct filter_chain_task_t {
+  const filter_chain *chain;
+  const pixel_image *source;
+  pixel_image *target;
+  /* for each stage, the rows needed above and below the band by the stage */
+  /* and the stages after it; one extra element for the end of the chain  */
+  uint32 *halo;
+  uint32 band_height;
+  uint32 band_count;
+  filter_chain_buffers *buffers;
+} filter_chain_task;
+
+/******************************************************************************/
+
+result filter_chain_create
+(
+  filter_chain *target,
+  uint32 size
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+  CHECK_PARAM(size > 0);
+
+  CHECK(filter_chain_nullify(target));
+  CHECK(memory_allocate((data_pointer *)&target->stages, size,
+                        sizeof(filter_stage)));
+  target->size = size;
+
+  FINALLY(filter_chain_create);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result filter_chain_destroy
+(
+  filter_chain *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  CHECK(memory_deallocate((data_pointer *)&target->stages));
+  CHECK(filter_chain_nullify(target));
+
+  FINALLY(filter_chain_destroy);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result filter_chain_nullify
+(
+  filter_chain *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  target->stages = NULL;
+  target->size = 0;
+  target->count = 0;
+  target->band_height = 0;
+
+  FINALLY(filter_chain_nullify);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result filter_chain_add
+(
+  filter_chain *target,
+  filter_stage_type type,
+  uint32 param
+)
+{
+  TRY();
+  filter_stage *stages;
+
+  stages = NULL;
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->stages);
+  CHECK_PARAM(type != f_THRESHOLD || param < 256);
+
+  if (target->count == target->size) {
+    CHECK(memory_allocate((data_pointer *)&stages, 2 * target->size,
+                          sizeof(filter_stage)));
+    CHECK(memory_copy((data_pointer)stages, (data_pointer)target->stages,
+                      target->count, sizeof(filter_stage)));
+    CHECK(memory_deallocate((data_pointer *)&target->stages));
+    target->stages = stages;
+    target->size = 2 * target->size;
+    stages = NULL;
+  }
+
+  target->stages[target->count].type = type;
+  target->stages[target->count].param = param;
+  target->count++;
+
+  FINALLY(filter_chain_add);
+  memory_deallocate((data_pointer *)&stages);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result filter_stage_get_info
+(
+  const filter_stage *stage,
+  pixel_type *input,
+  pixel_type *output,
+  uint32 *radius
+)
+{
+  TRY();
+
+  CHECK_POINTER(stage);
+  CHECK_POINTER(input);
+  CHECK_POINTER(output);
+  CHECK_POINTER(radius);
+
+  switch (stage->type) {
+  case f_SMOOTH_BINOMIAL:
+    *input = p_U8;
+    *output = p_U8;
+    /* each pass needs one row above and below */
+    *radius = stage->param;
+    break;
+  case f_SOBEL_X:
+  case f_ABS_SOBEL_X:
+  case f_SOBEL_Y:
+  case f_ABS_SOBEL_Y:
+    *input = p_U8;
+    *output = p_S32;
+    *radius = 1;
+    break;
+  case f_EXTREMA_X:
+    *input = p_S32;
+    *output = p_S32;
+    *radius = 0;
+    break;
+  case f_THRESHOLD:
+    *input = p_U8;
+    *output = p_U8;
+    *radius = 0;
+    break;
+  default:
+    ERROR(BAD_PARAM);
+  }
+
+  FINALLY(filter_stage_get_info);
+  RETURN();
+}
+
+/******************************************************************************/
+/* makes an image of a range of rows, sharing the data of the given image    */
+
+void filter_chain_view
+(
+  pixel_image *view,
+  const pixel_image *image,
+  uint32 first,
+  uint32 count
+)
+{
+  *view = *image;
+  view->rows = image->rows + first;
+  view->dy = image->dy + first;
+  view->height = count;
+  /* the size is needed for continuous images, which start from first row */
+  view->size = (view->dy + count) * image->stride;
+}
+
+/******************************************************************************/
+
+void filter_chain_copy_rows
+(
+  pixel_image *target,
+  const pixel_image *source
+)
+{
+  uint32 y, size;
+
+  size = source->width *
+      (uint32)((source->type == p_U8) ? sizeof(byte) : sizeof(sint32));
+  for (y = 0; y < source->height; y++) {
+    memcpy(target->rows[y], source->rows[y], size);
+  }
+}
+
+/******************************************************************************/
+
+result filter_stage_apply
+(
+  const filter_stage *stage,
+  const pixel_image *source,
+  pixel_image *target,
+  byte *rows
+)
+{
+  TRY();
+
+  CHECK_POINTER(stage);
+
+  switch (stage->type) {
+  case f_SMOOTH_BINOMIAL:
+    if (stage->param == 0) {
+      filter_chain_copy_rows(target, source);
+    }
+    else {
+      CHECK(smooth_binomial_buffered(source, target, stage->param, rows));
+    }
+    break;
+  case f_SOBEL_X:
+    CHECK(sobel_x(source, target));
+    break;
+  case f_ABS_SOBEL_X:
+    CHECK(abs_sobel_x(source, target));
+    break;
+  case f_SOBEL_Y:
+    CHECK(sobel_y(source, target));
+    break;
+  case f_ABS_SOBEL_Y:
+    CHECK(abs_sobel_y(source, target));
+    break;
+  case f_EXTREMA_X:
+    /* extrema_x leaves the first and last column as they are */
+    CHECK(pixel_image_clear(target));
+    CHECK(extrema_x(source, target));
+    break;
+  case f_THRESHOLD:
+    CHECK(threshold(source, target, (byte)stage->param));
+    break;
+  default:
+    ERROR(BAD_PARAM);
+  }
+
+  FINALLY(filter_stage_apply);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result filter_chain_run_band
+(
+  filter_chain_task *task,
+  filter_chain_buffers *buffers,
+  uint32 band
+)
+{
+  TRY();
+  pixel_image input, output;
+  uint32 i, count, height, band_first, band_last, first, last, next_first;
+  uint32 next_last;
+
+  CHECK_POINTER(task);
+  CHECK_POINTER(buffers);
+
+  count = task->chain->count;
+  height = task->source->height;
+  band_first = band * task->band_height;
+  band_last = band_first + task->band_height;
+  if (band_last > height) {
+    band_last = height;
+  }
+
+  first = (band_first > task->halo[0]) ? band_first - task->halo[0] : 0;
+  last = (band_last + task->halo[0] < height) ? band_last + task->halo[0] :
+      height;
+  filter_chain_view(&input, task->source, first, last - first);
+  for (i = 0; i < count; i++) {
+    /* without halo rows the last stage can write directly to target */
+    if (i + 1 == count && task->halo[i] == 0) {
+      filter_chain_view(&output, task->target, first, last - first);
+    }
+    else {
+      filter_chain_view(&output, &buffers->images[i], 0, last - first);
+    }
+    CHECK(filter_stage_apply(&task->chain->stages[i], &input, &output,
+                             buffers->rows));
+    /* the rows at range ends that are not valid are left behind */
+    next_first = (band_first > task->halo[i + 1]) ?
+        band_first - task->halo[i + 1] : 0;
+    next_last = (band_last + task->halo[i + 1] < height) ?
+        band_last + task->halo[i + 1] : height;
+    filter_chain_view(&input, &output, next_first - first,
+                      next_last - next_first);
+    first = next_first;
+    last = next_last;
+  }
+  if (task->halo[count - 1] > 0) {
+    filter_chain_view(&output, task->target, band_first,
+                      band_last - band_first);
+    filter_chain_copy_rows(&output, &input);
+  }
+
+  FINALLY(filter_chain_run_band);
+  RETURN();
+}
+
+/******************************************************************************/
+
+void filter_chain_run_strip
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+)
+{
+  filter_chain_task *task;
+  filter_chain_buffers *buffers;
+  uint32 band, first, last;
+
+  task = (filter_chain_task *)params;
+  buffers = task->buffers + index;
+  first = (task->band_count * index) / count;
+  last = (task->band_count * (index + 1)) / count;
+
+  buffers->status = SUCCESS;
+  for (band = first; band < last; band++) {
+    buffers->status = filter_chain_run_band(task, buffers, band);
+    if (buffers->status != SUCCESS) {
+      break;
+    }
+  }
+}
+
+/******************************************************************************/
+
+result filter_chain_run
+(
+  const filter_chain *chain,
+  const pixel_image *source,
+  pixel_image *target,
+  uint32 threads
+)
+{
+  TRY();
+  filter_chain_task task;
+  filter_chain_buffers *buffers;
+  pixel_type input, output, previous;
+  uint32 i, j, count, width, height, radius, passes, row_size;
+
+  task.halo = NULL;
+  task.buffers = NULL;
+  count = 0;
+  CHECK_POINTER(chain);
+  CHECK_POINTER(source);
+  CHECK_POINTER(target);
+  CHECK_POINTER(source->data);
+  CHECK_POINTER(target->data);
+  CHECK_PARAM(chain->count > 0);
+  CHECK_PARAM(threads > 0);
+  CHECK_PARAM(source->type == p_U8);
+  CHECK_PARAM(source->step == 1);
+  CHECK_PARAM(target->step == 1);
+  CHECK_PARAM(source->width == target->width);
+  CHECK_PARAM(source->height == target->height);
+  CHECK_PARAM(source->width > 2);
+  CHECK_PARAM(source->height > 2);
+
+  width = source->width;
+  height = source->height;
+  task.chain = chain;
+  task.source = source;
+  task.target = target;
+
+  /* check that the stages fit together, and sum the halos from the end */
+  CHECK(memory_allocate((data_pointer *)&task.halo, chain->count + 1,
+                        sizeof(uint32)));
+  previous = p_U8;
+  passes = 0;
+  row_size = width;
+  for (i = 0; i < chain->count; i++) {
+    CHECK(filter_stage_get_info(&chain->stages[i], &input, &output, &radius));
+    CHECK_PARAM(input == previous);
+    previous = output;
+    task.halo[i] = radius;
+    if (chain->stages[i].type == f_SMOOTH_BINOMIAL && radius > passes) {
+      passes = radius;
+    }
+    row_size += width *
+        (uint32)((output == p_U8) ? sizeof(byte) : sizeof(sint32));
+  }
+  CHECK_PARAM(target->type == previous);
+  task.halo[chain->count] = 0;
+  for (i = chain->count; i--; ) {
+    task.halo[i] += task.halo[i + 1];
+  }
+
+  task.band_height = chain->band_height;
+  if (task.band_height == 0) {
+    task.band_height = FILTER_CHAIN_CACHE_SIZE / row_size;
+    if (task.band_height < FILTER_CHAIN_MIN_BAND_HEIGHT) {
+      task.band_height = FILTER_CHAIN_MIN_BAND_HEIGHT;
+    }
+  }
+  if (task.band_height > height) {
+    task.band_height = height;
+  }
+  task.band_count = (height + task.band_height - 1) / task.band_height;
+  if (threads > task.band_count) {
+    threads = task.band_count;
+  }
+
+  /* all buffers are allocated here, so the threads do not allocate memory */
+  CHECK(memory_allocate((data_pointer *)&task.buffers, threads,
+                        sizeof(filter_chain_buffers)));
+  for (count = 0; count < threads; count++) {
+    buffers = task.buffers + count;
+    buffers->images = NULL;
+    buffers->rows = NULL;
+    buffers->status = SUCCESS;
+  }
+  for (i = 0; i < threads; i++) {
+    buffers = task.buffers + i;
+    CHECK(memory_allocate((data_pointer *)&buffers->images, chain->count,
+                          sizeof(pixel_image)));
+    for (j = 0; j < chain->count; j++) {
+      CHECK(pixel_image_nullify(&buffers->images[j]));
+    }
+    for (j = 0; j < chain->count; j++) {
+      CHECK(filter_stage_get_info(&chain->stages[j], &input, &output,
+                                  &radius));
+      CHECK(pixel_image_create(&buffers->images[j], output, GREY, width,
+                               task.band_height + 2 * task.halo[j], 1,
+                               width));
+    }
+    CHECK(memory_allocate((data_pointer *)&buffers->rows,
+                          (4 * passes + 1) * width, sizeof(byte)));
+  }
+
+  CHECK(parallel_run(&filter_chain_run_strip, &task, threads));
+  for (i = 0; i < threads; i++) {
+    CHECK(task.buffers[i].status);
+  }
+
+  FINALLY(filter_chain_run);
+  if (task.buffers != NULL) {
+    for (i = 0; i < count; i++) {
+      buffers = task.buffers + i;
+      if (buffers->images != NULL) {
+        for (j = 0; j < chain->count; j++) {
+          pixel_image_destroy(&buffers->images[j]);
+        }
+        memory_deallocate((data_pointer *)&buffers->images);
+      }
+      memory_deallocate((data_pointer *)&buffers->rows);
+    }
+  }
+  memory_deallocate((data_pointer *)&task.buffers);
+  memory_deallocate((data_pointer *)&task.halo);
+  RETURN();
+}
+
+/******************************************************************************/
+/* row kernels for separable convolution; both passes calculate the sums of  */
+/* taps rows multiplied by the weights, the horizontal pass with the rows    */
+/* pointing to consecutive pixels of a padded row, and the vertical pass     */
+/* with the rows of the horizontally filtered values; all kernels sum the    */
+/* products in the same order, so they give identical results                */
+
+typedef void (*convolution_row_function)
+(
+  const real32 **rows,
+  const real32 *weights,
+  real32 *target,
+  uint32 count,
+  uint32 taps
+);
+
+#define CONVOLUTION_MAX_SPECIALIZED_TAPS 7
+
+/* finishes the row from x as scalars */
+#define CONVOLUTION_ROW_TAIL(TAPS)\
+  for (; x < count; x++) {\
+    sum = 0;\
+    for (k = 0; k < (TAPS); k++) {\
+      sum += weights[k] * rows[k][x];\
+    }\
+    target[x] = sum;\
+  }
+
+/* defines a row kernel; when TAPS is a constant, the loops over the taps */
+/* are unrolled by the compiler                                           */
+#define CONVOLUTION_ROW_FUNCTION(name, TAPS)\
+void name\
+(\
+  const real32 **rows,\
+  const real32 *weights,\
+  real32 *target,\
+  uint32 count,\
+  uint32 taps\
+)\
+{\
+  uint32 x, k;\
+  real32 sum;\
+  (void)taps;\
+  x = 0;\
+  CONVOLUTION_ROW_TAIL(TAPS)\
+}
+
+CONVOLUTION_ROW_FUNCTION(convolution_row, taps)
+CONVOLUTION_ROW_FUNCTION(convolution_row_3, 3)
+CONVOLUTION_ROW_FUNCTION(convolution_row_5, 5)
+CONVOLUTION_ROW_FUNCTION(convolution_row_7, 7)
+
+#ifdef HAVE_X86_SIMD
+
+/* defines a vector row kernel; the weights are broadcast once for the row */
+/* when TAPS is a constant, and for each vector otherwise                  */
+#define CONVOLUTION_ROW_FUNCTION_SIMD(name, TAPS, TARGET, VECTOR, N, SET1,\
+                                      SETZERO, LOAD, STORE, ADD, MUL)\
+TARGET \
+void name\
+(\
+  const real32 **rows,\
+  const real32 *weights,\
+  real32 *target,\
+  uint32 count,\
+  uint32 taps\
+)\
+{\
+  VECTOR w[CONVOLUTION_MAX_SPECIALIZED_TAPS], sum_v;\
+  uint32 x, k;\
+  real32 sum;\
+  truth_value fixed;\
+  (void)taps;\
+  fixed = ((TAPS) <= CONVOLUTION_MAX_SPECIALIZED_TAPS) ? TRUE : FALSE;\
+  if (IS_TRUE(fixed)) {\
+    for (k = 0; k < (TAPS); k++) {\
+      w[k] = SET1(weights[k]);\
+    }\
+  }\
+  for (x = 0; x + (N) <= count; x += (N)) {\
+    sum_v = SETZERO();\
+    for (k = 0; k < (TAPS); k++) {\
+      sum_v = ADD(sum_v, MUL(IS_TRUE(fixed) ? w[k] : SET1(weights[k]),\
+                             LOAD(rows[k] + x)));\
+    }\
+    STORE(target + x, sum_v);\
+  }\
+  CONVOLUTION_ROW_TAIL(TAPS)\
+}
+
+#define CONVOLUTION_ROW_FUNCTION_SSE2(name, TAPS)\
+  CONVOLUTION_ROW_FUNCTION_SIMD(name, TAPS, SIMD_TARGET_SSE2, __m128, 4,\
+                                _mm_set1_ps, _mm_setzero_ps, _mm_loadu_ps,\
+                                _mm_storeu_ps, _mm_add_ps, _mm_mul_ps)
+
+#define CONVOLUTION_ROW_FUNCTION_AVX2(name, TAPS)\
+  CONVOLUTION_ROW_FUNCTION_SIMD(name, TAPS, SIMD_TARGET_AVX2, __m256, 8,\
+                                _mm256_set1_ps, _mm256_setzero_ps,\
+                                _mm256_loadu_ps, _mm256_storeu_ps,\
+                                _mm256_add_ps, _mm256_mul_ps)
+
+CONVOLUTION_ROW_FUNCTION_SSE2(convolution_row_sse2, taps)
+CONVOLUTION_ROW_FUNCTION_SSE2(convolution_row_sse2_3, 3)
+CONVOLUTION_ROW_FUNCTION_SSE2(convolution_row_sse2_5, 5)
+CONVOLUTION_ROW_FUNCTION_SSE2(convolution_row_sse2_7, 7)
+CONVOLUTION_ROW_FUNCTION_AVX2(convolution_row_avx2, taps)
+CONVOLUTION_ROW_FUNCTION_AVX2(convolution_row_avx2_3, 3)
+CONVOLUTION_ROW_FUNCTION_AVX2(convolution_row_avx2_5, 5)
+CONVOLUTION_ROW_FUNCTION_AVX2(convolution_row_avx2_7, 7)
+
+#endif /* HAVE_X86_SIMD */
+
+convolution_row_function convolution_get_row_function
+(
+  uint32 taps
+)
+{
+#ifdef HAVE_X86_SIMD
+  if (simd_get_level() >= s_AVX2) {
+    switch (taps) {
+    case 3: return &convolution_row_avx2_3;
+    case 5: return &convolution_row_avx2_5;
+    case 7: return &convolution_row_avx2_7;
+    default: return &convolution_row_avx2;
+    }
+  }
+  if (simd_get_level() >= s_SSE2) {
+    switch (taps) {
+    case 3: return &convolution_row_sse2_3;
+    case 5: return &convolution_row_sse2_5;
+    case 7: return &convolution_row_sse2_7;
+    default: return &convolution_row_sse2;
+    }
+  }
+#endif
+  switch (taps) {
+  case 3: return &convolution_row_3;
+  case 5: return &convolution_row_5;
+  case 7: return &convolution_row_7;
+  default: return &convolution_row;
+  }
+}
+
+/******************************************************************************/
+/* private functions for convolving strips of rows in parallel               */
+
+typedef struct convolution_strips_t {
+  const pixel_image *source;
+  pixel_image *target;
+  const real32 *weights_x;
+  const real32 *weights_y;
+  uint32 radius_x;
+  uint32 radius_y;
+  convolution_border border;
+  convolution_row_function filter_x;
+  convolution_row_function filter_y;
+  /* for each strip, a padded source row, a ring of 2 * radius_y + 1 rows */
+  /* filtered horizontally, and a row filtered vertically                 */
+  real32 *rows;
+  uint32 rows_size;
+  /* for each strip, the rows given to the row kernels */
+  const real32 **pointers;
+  uint32 pointers_size;
+} convolution_strips;
+
+/* maps a coordinate inside the image, or to -1 when the value is 0 */
+sint32 convolution_border_index
+(
+  sint32 i,
+  sint32 size,
+  convolution_border border
+)
+{
+  if (i >= 0 && i < size) {
+    return i;
+  }
+  switch (border) {
+  case c_CLAMP:
+    return (i < 0) ? 0 : size - 1;
+  case c_REFLECT:
+    if (size == 1) {
+      return 0;
+    }
+    /* kernels wider than the image are reflected more than once */
+    while (i < 0 || i >= size) {
+      i = (i < 0) ? -i : 2 * (size - 1) - i;
+    }
+    return i;
+  default:
+    return -1;
+  }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* converts the contiguous pixels of a row to real32 in groups of 8, and */
+/* returns the count of converted pixels                                 */
+SIMD_TARGET_SSE2
+uint32 convolution_read_row_sse2
+(
+  const pixel_image *source,
+  uint32 row,
+  real32 *target
+)
+{
+  __m128i zero, values;
+  uint32 x, width;
+
+  width = source->width;
+  zero = _mm_setzero_si128();
+  for (x = 0; x + 8 <= width; x += 8) {
+    if (source->type == p_U8) {
+      values = _mm_unpacklo_epi8(_mm_loadl_epi64(
+          (const __m128i *)((const byte *)source->rows[row] + x)), zero);
+      _mm_storeu_ps(target + x,
+                    _mm_cvtepi32_ps(_mm_unpacklo_epi16(values, zero)));
+      _mm_storeu_ps(target + x + 4,
+                    _mm_cvtepi32_ps(_mm_unpackhi_epi16(values, zero)));
+    }
+    else
+    if (source->type == p_S16) {
+      values = _mm_loadu_si128(
+          (const __m128i *)((const sint16 *)source->rows[row] + x));
+      _mm_storeu_ps(target + x, _mm_cvtepi32_ps(
+          _mm_srai_epi32(_mm_unpacklo_epi16(values, values), 16)));
+      _mm_storeu_ps(target + x + 4, _mm_cvtepi32_ps(
+          _mm_srai_epi32(_mm_unpackhi_epi16(values, values), 16)));
+    }
+    else {
+      _mm_storeu_ps(target + x,
+                    _mm_loadu_ps((const real32 *)source->rows[row] + x));
+      _mm_storeu_ps(target + x + 4,
+                    _mm_loadu_ps((const real32 *)source->rows[row] + x + 4));
+    }
+  }
+  return x;
+}
+
+/* rounds 4 values, already saturated to the range of the target, half away */
+/* from zero; truncating and converting back to real32 is exact there       */
+SIMD_TARGET_SSE2
+__m128i convolution_round_sse2
+(
+  __m128 values
+)
+{
+  __m128i truncated;
+  __m128 fraction;
+
+  truncated = _mm_cvttps_epi32(values);
+  fraction = _mm_sub_ps(values, _mm_cvtepi32_ps(truncated));
+  /* the comparison masks are -1 where true */
+  truncated = _mm_sub_epi32(truncated, _mm_castps_si128(
+      _mm_cmpge_ps(fraction, _mm_set1_ps(0.5f))));
+  return _mm_add_epi32(truncated, _mm_castps_si128(
+      _mm_cmple_ps(fraction, _mm_set1_ps(-0.5f))));
+}
+
+/* converts real32 values to the contiguous pixels of a row in groups of 8, */
+/* and returns the count of converted pixels                                */
+SIMD_TARGET_SSE2
+uint32 convolution_write_row_sse2
+(
+  pixel_image *target,
+  uint32 row,
+  const real32 *values
+)
+{
+  __m128 low, high;
+  __m128i packed;
+  uint32 x, width;
+
+  width = target->width;
+  if (target->type == p_U8) {
+    low = _mm_setzero_ps();
+    high = _mm_set1_ps(255);
+  }
+  else {
+    low = _mm_set1_ps(-32768);
+    high = _mm_set1_ps(32767);
+  }
+  for (x = 0; x + 8 <= width; x += 8) {
+    if (target->type == p_F32) {
+      _mm_storeu_ps((real32 *)target->rows[row] + x, _mm_loadu_ps(values + x));
+      _mm_storeu_ps((real32 *)target->rows[row] + x + 4,
+                    _mm_loadu_ps(values + x + 4));
+      continue;
+    }
+    packed = _mm_packs_epi32(
+        convolution_round_sse2(_mm_min_ps(_mm_max_ps(
+            _mm_loadu_ps(values + x), low), high)),
+        convolution_round_sse2(_mm_min_ps(_mm_max_ps(
+            _mm_loadu_ps(values + x + 4), low), high)));
+    if (target->type == p_U8) {
+      _mm_storel_epi64((__m128i *)((byte *)target->rows[row] + x),
+                       _mm_packus_epi16(packed, packed));
+    }
+    else {
+      _mm_storeu_si128((__m128i *)((sint16 *)target->rows[row] + x), packed);
+    }
+  }
+  return x;
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* reads a row of the source as real32 values into the middle of the padded */
+/* row, and fills the padding according to the border                        */
+#define CONVOLUTION_READ_ROW(type)\
+  {\
+    const type *source_pos;\
+    source_pos = (const type *)source->rows[row] + x * step;\
+    for (; x < (uint32)width; x++, source_pos += step) {\
+      padded[radius + x] = (real32)*source_pos;\
+    }\
+  }
+
+void convolution_read_row
+(
+  convolution_strips *strips,
+  sint32 row,
+  real32 *padded
+)
+{
+  const pixel_image *source;
+  sint32 i, index, width;
+  uint32 x, radius, step;
+
+  source = strips->source;
+  width = (sint32)source->width;
+  radius = strips->radius_x;
+  step = source->step;
+  x = 0;
+#ifdef HAVE_X86_SIMD
+  if (step == 1 && simd_get_level() >= s_SSE2) {
+    x = convolution_read_row_sse2(source, (uint32)row, padded + radius);
+  }
+#endif
+  switch (source->type) {
+  case p_U8:
+    CONVOLUTION_READ_ROW(byte);
+    break;
+  case p_S16:
+    CONVOLUTION_READ_ROW(sint16);
+    break;
+  default:
+    CONVOLUTION_READ_ROW(real32);
+    break;
+  }
+  for (i = 1; i <= (sint32)radius; i++) {
+    index = convolution_border_index(-i, width, strips->border);
+    padded[(sint32)radius - i] = (index < 0) ? 0 :
+        padded[(sint32)radius + index];
+    index = convolution_border_index(width - 1 + i, width, strips->border);
+    padded[(sint32)radius + width - 1 + i] = (index < 0) ? 0 :
+        padded[(sint32)radius + index];
+  }
+}
+
+/* rounds half away from zero; adding 0.5 before truncating would round */
+/* values just below one half up, as the sum is rounded to float         */
+#define CONVOLUTION_ROUND(value)\
+  (((value) - (real32)(sint32)(value) >= 0.5f) ? (sint32)(value) + 1 :\
+   ((value) - (real32)(sint32)(value) <= -0.5f) ? (sint32)(value) - 1 :\
+   (sint32)(value))
+
+/* writes a row of real32 values to the target, rounding to nearest and */
+/* saturating for integer types                                         */
+void convolution_write_row
+(
+  pixel_image *target,
+  uint32 row,
+  const real32 *values
+)
+{
+  uint32 x, width, step;
+  real32 value;
+
+  width = target->width;
+  step = target->step;
+  x = 0;
+#ifdef HAVE_X86_SIMD
+  if (step == 1 && simd_get_level() >= s_SSE2) {
+    x = convolution_write_row_sse2(target, row, values);
+  }
+#endif
+  switch (target->type) {
+  case p_U8:
+    {
+      byte *target_pos = (byte *)target->rows[row] + x * step;
+      for (; x < width; x++, target_pos += step) {
+        value = values[x];
+        *target_pos = (byte)((value <= 0) ? 0 : (value >= 255) ? 255 :
+                             CONVOLUTION_ROUND(value));
+      }
+    }
+    break;
+  case p_S16:
+    {
+      sint16 *target_pos = (sint16 *)target->rows[row] + x * step;
+      for (; x < width; x++, target_pos += step) {
+        value = values[x];
+        *target_pos = (sint16)((value <= -32768) ? -32768 :
+                               (value >= 32767) ? 32767 :
+                               CONVOLUTION_ROUND(value));
+      }
+    }
+    break;
+  default:
+    {
+      real32 *target_pos = (real32 *)target->rows[row] + x * step;
+      for (; x < width; x++, target_pos += step) {
+        *target_pos = values[x];
+      }
+    }
+    break;
+  }
+}
+
+void convolution_strip
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+)
+{
+  convolution_strips *strips;
+  const real32 **pointers;
+  real32 *padded, *ring, *output, *slot;
+  sint32 i, next, row, height, first, last, y;
+  uint32 k, width, taps_x, taps_y;
+
+  strips = (convolution_strips *)params;
+  width = strips->source->width;
+  height = (sint32)strips->source->height;
+  taps_x = 2 * strips->radius_x + 1;
+  taps_y = 2 * strips->radius_y + 1;
+  padded = strips->rows + strips->rows_size * index;
+  ring = padded + width + 2 * strips->radius_x;
+  output = ring + taps_y * width;
+  pointers = strips->pointers + strips->pointers_size * index;
+  first = (sint32)(((uint32)height * index) / count);
+  last = (sint32)(((uint32)height * (index + 1)) / count);
+
+  /* each row is filtered horizontally once, when entering the ring */
+  next = first - (sint32)strips->radius_y;
+  for (y = first; y < last; y++) {
+    for (; next <= y + (sint32)strips->radius_y; next++) {
+      slot = ring + (uint32)(next - first + (sint32)strips->radius_y) % taps_y *
+          width;
+      row = convolution_border_index(next, height, strips->border);
+      if (row < 0) {
+        for (k = 0; k < width; k++) {
+          slot[k] = 0;
+        }
+        continue;
+      }
+      convolution_read_row(strips, row, padded);
+      for (k = 0; k < taps_x; k++) {
+        pointers[k] = padded + k;
+      }
+      strips->filter_x(pointers, strips->weights_x, slot, width, taps_x);
+    }
+    for (k = 0; k < taps_y; k++) {
+      i = y - (sint32)strips->radius_y + (sint32)k;
+      pointers[k] = ring +
+          (uint32)(i - first + (sint32)strips->radius_y) % taps_y * width;
+    }
+    strips->filter_y(pointers, strips->weights_y, output, width, taps_y);
+    convolution_write_row(strips->target, (uint32)y, output);
+  }
+}
+
+/******************************************************************************/
+
+result convolve_separable
+(
+  const pixel_image *source,
+  pixel_image *target,
+  const real32 *weights_x,
+  uint32 radius_x,
+  const real32 *weights_y,
+  uint32 radius_y,
+  convolution_border border,
+  uint32 threads
+)
+{
+  TRY();
+  convolution_strips strips;
+
+  strips.rows = NULL;
+  strips.pointers = NULL;
+  CHECK_POINTER(source);
+  CHECK_POINTER(target);
+  CHECK_POINTER(source->data);
+  CHECK_POINTER(target->data);
+  CHECK_POINTER(weights_x);
+  CHECK_POINTER(weights_y);
+  CHECK_PARAM(source->type == p_U8 || source->type == p_S16 ||
+              source->type == p_F32);
+  CHECK_PARAM(target->type == p_U8 || target->type == p_S16 ||
+              target->type == p_F32);
+  CHECK_PARAM(source->width == target->width);
+  CHECK_PARAM(source->height == target->height);
+  CHECK_PARAM(border == c_CLAMP || border == c_REFLECT || border == c_ZERO);
+  CHECK_PARAM(threads > 0);
+
+  if (threads > source->height) {
+    threads = source->height;
+  }
+  strips.source = source;
+  strips.target = target;
+  strips.weights_x = weights_x;
+  strips.weights_y = weights_y;
+  strips.radius_x = radius_x;
+  strips.radius_y = radius_y;
+  strips.border = border;
+  strips.filter_x = convolution_get_row_function(2 * radius_x + 1);
+  strips.filter_y = convolution_get_row_function(2 * radius_y + 1);
+  /* the buffers are allocated here, so the threads do not allocate memory */
+  strips.rows_size = (source->width + 2 * radius_x) +
+      (2 * radius_y + 2) * source->width;
+  strips.pointers_size = 2 * ((radius_x > radius_y) ? radius_x : radius_y) + 1;
+  CHECK(memory_allocate((data_pointer *)&strips.rows,
+                        strips.rows_size * threads, sizeof(real32)));
+  CHECK(memory_allocate((data_pointer *)&strips.pointers,
+                        strips.pointers_size * threads,
+                        sizeof(const real32 *)));
+  CHECK(parallel_run(&convolution_strip, &strips, threads));
+
+  FINALLY(convolve_separable);
+  memory_deallocate((data_pointer *)&strips.pointers);
+  memory_deallocate((data_pointer *)&strips.rows);
   RETURN();
 }
 
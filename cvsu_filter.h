@@ -49,8 +49,26 @@ result threshold
   byte t
 );
 
+/**
+ * Thresholds an 8-bit grayscale image read row by row, in the same way as
+ * @see threshold. Each row is written as soon as it has been read, so only
+ * one row is kept in memory.
+ */
+result threshold_stream
+(
+  image_row_reader reader,
+  pointer reader_params,
+  image_row_writer writer,
+  pointer writer_params,
+  uint32 width,
+  uint32 height,
+  byte t
+);
+
 /**
  * Smoothes an 8-bit grayscale image by applying binomial filter multiple times.
+ * Allocates a buffer of rows on every call, @see smooth_binomial_with_buffer
+ * avoids this for images processed every frame.
  */
 result smooth_binomial
 (
@@ -59,6 +77,36 @@ result smooth_binomial
   uint32 passes
 );
 
+/**
+ * Smoothes like @see smooth_binomial, but keeps the rows in the data of an
+ * existing 8-bit buffer image with at least (4 * passes + 1) * width values,
+ * for example a single-channel image of the source width and 4 * passes + 1
+ * rows acquired from a scratch_pool, so that no memory is allocated.
+ */
+result smooth_binomial_with_buffer
+(
+  const pixel_image *source,
+  pixel_image *target,
+  uint32 passes,
+  pixel_image *buffer
+);
+
+/**
+ * Smoothes an 8-bit grayscale image read row by row, giving the same result as
+ * @see smooth_binomial. Each pass keeps four rows in memory, and a row is
+ * written as soon as the rows below it needed by all passes have been read.
+ */
+result smooth_binomial_stream
+(
+  image_row_reader reader,
+  pointer reader_params,
+  image_row_writer writer,
+  pointer writer_params,
+  uint32 width,
+  uint32 height,
+  uint32 passes
+);
+
 /**
  * Filters image with a 3x3 horizontal sobel operator.
  */
@@ -95,6 +143,24 @@ result abs_sobel_y
   pixel_image *target
 );
 
+/**
+ * Calculates the 3x3 sobel gradient of an 8-bit grayscale image in one pass,
+ * writing any of dx and dy (p_S16; the values are the same as from sobel_x and
+ * sobel_y, which write p_S32), the rounded magnitude (p_U16) and the
+ * orientation (p_U8). Outputs not needed are NULL.
+ * Orientation is quantized into eight 45 degree sectors counted from the
+ * positive x axis towards positive y: 0 for x, 2 for y, 4 for -x, 6 for -y.
+ * Border pixels of the outputs are set to 0.
+ */
+result sobel_gradient
+(
+  const pixel_image *source,
+  pixel_image *dx,
+  pixel_image *dy,
+  pixel_image *magnitude,
+  pixel_image *orientation
+);
+
 /**
  * Calculates the extremal values along horizontal scanlines
  */
@@ -104,6 +170,17 @@ result extrema_x
   pixel_image *target
 );
 
+/**
+ * Calculates the extremal values along horizontal scanlines using the given
+ * number of threads, each filtering a strip of rows. Target can be source.
+ */
+result extrema_x_parallel
+(
+  const pixel_image *source,
+  pixel_image *target,
+  uint32 threads
+);
+
 /**
  * Calculates the extremal values along vertical scanlines
  */
@@ -113,6 +190,154 @@ result extrema_y
   pixel_image *target
 );
 
+/**
+ * Calculates the extremal values along vertical scanlines using the given
+ * number of threads. The columns are followed a row at a time, so the image
+ * is read in memory order, and each thread filters a strip of rows. Target
+ * can be source. Memory is allocated only when more than one thread is used.
+ */
+result extrema_y_parallel
+(
+  const pixel_image *source,
+  pixel_image *target,
+  uint32 threads
+);
+
+/**
+ * Filters that can be chained in a @see filter_chain. The image type passed
+ * from a stage to the next must match.
+ */
+typedef enum filter_stage_type_t {
+  /** @see smooth_binomial from p_U8 to p_U8, param is the number of passes */
+  f_SMOOTH_BINOMIAL = 0,
+  /** @see sobel_x from p_U8 to p_S32 */
+  f_SOBEL_X,
+  /** @see abs_sobel_x from p_U8 to p_S32 */
+  f_ABS_SOBEL_X,
+  /** @see sobel_y from p_U8 to p_S32 */
+  f_SOBEL_Y,
+  /** @see abs_sobel_y from p_U8 to p_S32 */
+  f_ABS_SOBEL_Y,
+  /** @see extrema_x from p_S32 to p_S32, the first and last column are 0 */
+  f_EXTREMA_X,
+  /** @see threshold from p_U8 to p_U8, param is the threshold */
+  f_THRESHOLD
+} filter_stage_type;
+
+/**
+ * One stage of a filter_chain.
+ */
+typedef struct filter_stage_t {
+  /** The filter applied in this stage */
+  filter_stage_type type;
+  /** The parameter of the filter, if it has one */
+  uint32 param;
+} filter_stage;
+
+/**
+ * A sequence of filters applied to an image in horizontal bands. The
+ * intermediate images are kept only for the rows of one band, extended by
+ * the rows the following stages need above and below, so with bands that fit
+ * in cache the full frame goes through memory only when read and written.
+ * The rows shared by neighboring bands are calculated for both, so the bands
+ * can be filtered in parallel, and the result is the same as when applying
+ * the filters one by one to the whole image. @see extrema_y depends on whole
+ * columns and can not be chained.
+ */
+typedef struct filter_chain_t {
+  /** The stages in the order they are applied */
+  filter_stage *stages;
+  /** The number of stages allocated */
+  uint32 size;
+  /** The number of stages added */
+  uint32 count;
+  /** The number of rows in a band, or 0 for fitting a band in the L2 cache */
+  uint32 band_height;
+} filter_chain;
+
+/**
+ * Initializes the chain with room for the given number of stages. The chain
+ * grows when more stages are added.
+ * @see filter_chain_destroy
+ */
+result filter_chain_create
+(
+  filter_chain *target,
+  uint32 size
+);
+
+/**
+ * Deallocates the stages of the chain.
+ */
+result filter_chain_destroy
+(
+  filter_chain *target
+);
+
+/**
+ * Nullifies the contents of the chain. Does NOT deallocate memory.
+ */
+result filter_chain_nullify
+(
+  filter_chain *target
+);
+
+/**
+ * Adds a stage at the end of the chain.
+ */
+result filter_chain_add
+(
+  filter_chain *target,
+  filter_stage_type type,
+  uint32 param
+);
+
+/**
+ * Applies the chain to an 8-bit grayscale image of at least 3x3 pixels,
+ * filtering the bands with the given number of threads. The target must have
+ * the type produced by the last stage and the same size as the source, and
+ * both must have one channel.
+ */
+result filter_chain_run
+(
+  const filter_chain *chain,
+  const pixel_image *source,
+  pixel_image *target,
+  uint32 threads
+);
+
+/**
+ * Handling of the pixels outside the image in @see convolve_separable.
+ */
+typedef enum convolution_border_t {
+  /** the nearest edge pixel is used */
+  c_CLAMP = 0,
+  /** the image is mirrored around the edge pixel, which is not repeated */
+  c_REFLECT,
+  /** the pixels outside the image are 0 */
+  c_ZERO
+} convolution_border;
+
+/**
+ * Convolves an image with a separable kernel, given as the horizontal and
+ * vertical weights of 2 * radius + 1 values each, using the given number of
+ * threads. The source and target types can be p_U8, p_S16 or p_F32 in any
+ * combination; the sums are calculated as real32 values, which are rounded
+ * to nearest and saturated for integer targets. Kernels of radius 1 to 3
+ * have specialized implementations, and the others use a generic one.
+ */
+result convolve_separable
+(
+  const pixel_image *source,
+  pixel_image *target,
+  const real32 *weights_x,
+  uint32 radius_x,
+  const real32 *weights_y,
+  uint32 radius_y,
+  convolution_border border,
+  uint32 threads
+);
+
 #ifdef __cplusplus
 }
 #endif
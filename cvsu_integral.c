@@ -33,6 +33,8 @@
 #include "cvsu_macros.h"
 #include "cvsu_integral.h"
 #include "cvsu_memory.h"
+#include "cvsu_simd.h"
+#include "cvsu_parallel.h"
 
 #include <math.h>
 
@@ -62,6 +64,9 @@ double fmax(double __x, double __y);
 string integral_image_alloc_name = "integral_image_alloc";
 string integral_image_free_name = "integral_image_free";
 string integral_image_create_name = "integral_image_create";
+string integral_image_create_with_storage_name = "integral_image_create_with_storage";
+string integral_image_create_with_layout_name = "integral_image_create_with_layout";
+string integral_image_link_interleaved_name = "integral_image_link_interleaved";
 string integral_image_destroy_name = "integral_image_destroy";
 string integral_image_nullify_name = "integral_image_nullify";
 string integral_image_clone_name = "integral_image_clone";
@@ -69,18 +74,51 @@ string integral_image_copy_name = "integral_image_copy";
 string integral_image_update_name = "integral_image_update";
 string integral_image_threshold_sauvola_name = "integral_image_threshold_sauvola";
 string integral_image_threshold_feng_name = "integral_image_threshold_feng";
+string integral_image_threshold_sauvola_parallel_name = "integral_image_threshold_sauvola_parallel";
+string integral_image_threshold_feng_parallel_name = "integral_image_threshold_feng_parallel";
+string integral_image_prepare_buffer_name = "integral_image_prepare_buffer";
+string integral_box_batch_create_name = "integral_box_batch_create";
+string integral_box_batch_destroy_name = "integral_box_batch_destroy";
+string integral_box_batch_nullify_name = "integral_box_batch_nullify";
+string integral_image_calculate_batch_name = "integral_image_calculate_batch";
 string small_integral_image_create_name = "small_integral_image_create";
 string small_integral_image_update_name = "small_integral_image_update";
+string integral_image_update_parallel_name = "integral_image_update_parallel";
+string integral_image_update_rect_name = "integral_image_update_rect";
+string integral_image_update_from_reader_name = "integral_image_update_from_reader";
+string integral_image_update_from_yuv422_name = "integral_image_update_from_yuv422";
+string integral_image_clear_first_row_name = "integral_image_clear_first_row";
+string tiled_integral_image_update_name = "tiled_integral_image_update";
+string integral_image_update_higher_order_name =
+  "integral_image_update_higher_order";
+string integral_image_calculate_higher_statistics_name =
+  "integral_image_calculate_higher_statistics";
+string integral_image_enable_tilted_name = "integral_image_enable_tilted";
+string integral_image_update_tilted_name = "integral_image_update_tilted";
+string integral_image_calculate_tilted_statistics_name = "integral_image_calculate_tilted_statistics";
+string integral_stream_create_name = "integral_stream_create";
+string integral_stream_destroy_name = "integral_stream_destroy";
+string integral_stream_nullify_name = "integral_stream_nullify";
+string integral_stream_reset_name = "integral_stream_reset";
+string integral_stream_add_row_name = "integral_stream_add_row";
+string integral_stream_read_rows_name = "integral_stream_read_rows";
+string integral_stream_threshold_sauvola_name = "integral_stream_threshold_sauvola";
+string integral_stream_threshold_feng_name = "integral_stream_threshold_feng";
+
+/* with larger images the sum of 8-bit values may not fit in 32 bits */
+#define INTEGRAL_IMAGE_EXACT_MAX_SIZE 16843009UL
+
+/* the tiled integrals contain sums of at most 15x15 pixels, so the squared */
+/* sums stay below 2^24 and are exact in single precision                   */
+#define INTEGRAL_IMAGE_TILE_SIZE 16
 
 /******************************************************************************/
 /* constants for lookup tables                                                */
 
 truth_value tables_initialized = FALSE;
 integral_value pixel_squared[256];
-#ifdef INTEGRAL_IMAGE_HIGHER_ORDER_STATISTICS
 integral_value pixel_cubed[256];
 integral_value pixel_fourth[256];
-#endif
 SI_2_t small_pixel_squared[256];
 
 /******************************************************************************/
@@ -91,10 +129,8 @@ void init_tables()
     uint32 i;
     for (i = 0; i < 256; i++) {
       pixel_squared[i] = (integral_value)(i * i);
-#ifdef INTEGRAL_IMAGE_HIGHER_ORDER_STATISTICS
       pixel_cubed[i] = (integral_value)(i * i * i);
       pixel_fourth[i] = (integral_value)(i * i * i * i);
-#endif
       small_pixel_squared[i] = (SI_2_t)(i * i);
     }
     tables_initialized = TRUE;
@@ -143,32 +179,177 @@ result integral_image_create
 {
   TRY();
 
+  CHECK(integral_image_create_with_storage(target, source, i_REAL));
+
+  FINALLY(integral_image_create);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_image_create_with_storage
+(
+  integral_image *target,
+  pixel_image *source,
+  integral_storage storage
+)
+{
+  TRY();
+
+  CHECK(integral_image_create_with_layout(target, source, storage, l_SEPARATE));
+
+  FINALLY(integral_image_create_with_storage);
+  RETURN();
+}
+
+/******************************************************************************/
+/* with interleaved layout I_2 refers to the data of I_1 starting from the    */
+/* second value, and doesn't own the data                                     */
+
+result integral_image_link_interleaved
+(
+  integral_image *target
+)
+{
+  TRY();
+  pixel_image *I_1;
+
+  I_1 = &target->I_1;
+  /* the channel offset makes the rows point to the I_2 values */
+  CHECK(pixel_image_init(&target->I_2, I_1->data, I_1->type, I_1->format, 0, 0,
+                         I_1->width, I_1->height, 1, I_1->step, I_1->stride,
+                         I_1->size));
+  target->I_2.parent = I_1;
+  target->I_2.data = (pointer)(((integral_value *)I_1->data) + 1);
+  target->I_2.offset = 0;
+  target->I_2.size = I_1->size - 1;
+
+  FINALLY(integral_image_link_interleaved);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_image_create_with_layout
+(
+  integral_image *target,
+  pixel_image *source,
+  integral_storage storage,
+  integral_layout layout
+)
+{
+  TRY();
+  pixel_type type_1, type_2;
+  uint32 size_1, size_2, align;
+
   CHECK_POINTER(target);
   CHECK_POINTER(source);
   CHECK_POINTER(source->data);
   CHECK_PARAM(source->type == p_U8);
+  CHECK_PARAM(layout == l_SEPARATE || layout == l_INTERLEAVED);
+  /* interleaving requires the same value type for both integrals */
+  CHECK_PARAM(layout == l_SEPARATE || storage == i_REAL);
+
+  switch (storage) {
+  case i_REAL:
+    type_1 = p_I;
+    type_2 = p_I;
+    size_1 = sizeof(integral_value);
+    size_2 = sizeof(integral_value);
+    break;
+  case i_EXACT:
+    CHECK_PARAM(source->width * source->height <=
+                INTEGRAL_IMAGE_EXACT_MAX_SIZE);
+    type_1 = p_EI_1;
+    type_2 = p_EI_2;
+    size_1 = sizeof(EI_1_t);
+    size_2 = sizeof(EI_2_t);
+    break;
+  case i_SMALL:
+    type_1 = p_SI_1;
+    type_2 = p_SI_2;
+    size_1 = sizeof(SI_1_t);
+    size_2 = sizeof(SI_2_t);
+    break;
+  case i_TILED:
+    type_1 = p_TI;
+    type_2 = p_TI;
+    size_1 = sizeof(TI_t);
+    size_2 = sizeof(TI_t);
+    break;
+  default:
+    ERROR(BAD_PARAM);
+  }
 
   target->original = source;
   target->width = source->width;
   target->height = source->height;
-  target->step = source->step;
+  target->storage = storage;
+  target->layout = layout;
+  if (layout == l_INTERLEAVED) {
+    target->step = 2 * source->step;
+  }
+  else {
+    target->step = source->step;
+  }
 
   /* integral image requires one extra row and column at top and left side */
   target->stride = (target->width + 1) * target->step;
+  /* rows are padded so that each of them starts at an aligned address */
+  align = MEMORY_ALIGNMENT / ((size_1 < size_2) ? size_1 : size_2);
+  target->stride = ((target->stride + align - 1) / align) * align;
 
-  CHECK(pixel_image_create(&target->I_1, p_I, source->format,
-          target->width+1, target->height+1, target->step, target->stride));
-  CHECK(pixel_image_create(&target->I_2, p_I, source->format,
-          target->width+1, target->height+1, target->step, target->stride));
-#ifdef INTEGRAL_IMAGE_HIGHER_ORDER_STATISTICS
-  CHECK(pixel_image_create(&target->I_3, p_I, source->format,
-          target->width+1, target->height+1, target->step, target->stride));
-  CHECK(pixel_image_create(&target->I_4, p_I, source->format,
+  /* the padding is cleared, as it is never written by the updates */
+  CHECK(pixel_image_create(&target->I_1, type_1, source->format,
           target->width+1, target->height+1, target->step, target->stride));
-#endif
+  CHECK(memory_clear((data_pointer)target->I_1.data, target->I_1.size,
+                     size_1));
+  if (layout == l_INTERLEAVED) {
+    CHECK(integral_image_link_interleaved(target));
+  }
+  else {
+    CHECK(pixel_image_create(&target->I_2, type_2, source->format,
+            target->width+1, target->height+1, target->step, target->stride));
+    CHECK(memory_clear((data_pointer)target->I_2.data, target->I_2.size,
+                       size_2));
+  }
+  if (storage == i_TILED) {
+    /* one row of full integrals per tile row, one column per tile column */
+    CHECK(pixel_image_create(&target->tile_rows_1, p_I, source->format,
+            target->width + 1, target->height / INTEGRAL_IMAGE_TILE_SIZE + 1,
+            target->step, target->stride));
+    CHECK(pixel_image_create(&target->tile_rows_2, p_I, source->format,
+            target->width + 1, target->height / INTEGRAL_IMAGE_TILE_SIZE + 1,
+            target->step, target->stride));
+    CHECK(pixel_image_create(&target->tile_cols_1, p_I, source->format,
+            target->width / INTEGRAL_IMAGE_TILE_SIZE + 1, target->height + 1,
+            target->step,
+            (target->width / INTEGRAL_IMAGE_TILE_SIZE + 1) * target->step));
+    CHECK(pixel_image_create(&target->tile_cols_2, p_I, source->format,
+            target->width / INTEGRAL_IMAGE_TILE_SIZE + 1, target->height + 1,
+            target->step,
+            (target->width / INTEGRAL_IMAGE_TILE_SIZE + 1) * target->step));
+  }
+  else {
+    CHECK(pixel_image_nullify(&target->tile_rows_1));
+    CHECK(pixel_image_nullify(&target->tile_rows_2));
+    CHECK(pixel_image_nullify(&target->tile_cols_1));
+    CHECK(pixel_image_nullify(&target->tile_cols_2));
+  }
+  /* higher order and tilted integrals and threshold buffers are allocated */
+  /* when needed */
+  CHECK(pixel_image_nullify(&target->I_3));
+  CHECK(pixel_image_nullify(&target->I_4));
+  target->higher_order_updated = FALSE;
+  CHECK(pixel_image_nullify(&target->T_1));
+  CHECK(pixel_image_nullify(&target->T_2));
+  CHECK(pixel_image_nullify(&target->temp_tilted));
+  CHECK(pixel_image_nullify(&target->temp_mean));
+  CHECK(pixel_image_nullify(&target->temp_dev));
+  CHECK(pixel_image_nullify(&target->temp_rows));
   init_tables();
 
-  FINALLY(integral_image_create);
+  FINALLY(integral_image_create_with_layout);
   RETURN();
 }
 
@@ -185,10 +366,18 @@ result integral_image_destroy
 
   CHECK(pixel_image_destroy(&target->I_1));
   CHECK(pixel_image_destroy(&target->I_2));
-#ifdef INTEGRAL_IMAGE_HIGHER_ORDER_STATISTICS
+  CHECK(pixel_image_destroy(&target->tile_rows_1));
+  CHECK(pixel_image_destroy(&target->tile_rows_2));
+  CHECK(pixel_image_destroy(&target->tile_cols_1));
+  CHECK(pixel_image_destroy(&target->tile_cols_2));
   CHECK(pixel_image_destroy(&target->I_3));
   CHECK(pixel_image_destroy(&target->I_4));
-#endif
+  CHECK(pixel_image_destroy(&target->T_1));
+  CHECK(pixel_image_destroy(&target->T_2));
+  CHECK(pixel_image_destroy(&target->temp_tilted));
+  CHECK(pixel_image_destroy(&target->temp_mean));
+  CHECK(pixel_image_destroy(&target->temp_dev));
+  CHECK(pixel_image_destroy(&target->temp_rows));
   FINALLY(integral_image_destroy);
   RETURN();
 }
@@ -206,14 +395,25 @@ result integral_image_nullify
   target->original = NULL;
   CHECK(pixel_image_nullify(&target->I_1));
   CHECK(pixel_image_nullify(&target->I_2));
-#ifdef INTEGRAL_IMAGE_HIGHER_ORDER_STATISTICS
+  CHECK(pixel_image_nullify(&target->tile_rows_1));
+  CHECK(pixel_image_nullify(&target->tile_rows_2));
+  CHECK(pixel_image_nullify(&target->tile_cols_1));
+  CHECK(pixel_image_nullify(&target->tile_cols_2));
   CHECK(pixel_image_nullify(&target->I_3));
   CHECK(pixel_image_nullify(&target->I_4));
-#endif
+  target->higher_order_updated = FALSE;
+  CHECK(pixel_image_nullify(&target->T_1));
+  CHECK(pixel_image_nullify(&target->T_2));
+  CHECK(pixel_image_nullify(&target->temp_tilted));
+  CHECK(pixel_image_nullify(&target->temp_mean));
+  CHECK(pixel_image_nullify(&target->temp_dev));
+  CHECK(pixel_image_nullify(&target->temp_rows));
   target->width = 0;
   target->height = 0;
   target->step = 0;
   target->stride = 0;
+  target->storage = i_REAL;
+  target->layout = l_SEPARATE;
 
   FINALLY(integral_image_nullify);
   RETURN();
@@ -256,13 +456,51 @@ result integral_image_clone
   target->height = source->height;
   target->step = source->step;
   target->stride = source->stride;
+  target->storage = source->storage;
+  target->layout = source->layout;
 
   CHECK(pixel_image_clone(&target->I_1, &source->I_1));
-  CHECK(pixel_image_clone(&target->I_2, &source->I_2));
-#ifdef INTEGRAL_IMAGE_HIGHER_ORDER_STATISTICS
-  CHECK(pixel_image_clone(&target->I_3, &source->I_3));
-  CHECK(pixel_image_clone(&target->I_4, &source->I_4));
-#endif
+  if (source->layout == l_INTERLEAVED) {
+    CHECK(integral_image_link_interleaved(target));
+  }
+  else {
+    CHECK(pixel_image_clone(&target->I_2, &source->I_2));
+  }
+  if (source->storage == i_TILED) {
+    CHECK(pixel_image_clone(&target->tile_rows_1, &source->tile_rows_1));
+    CHECK(pixel_image_clone(&target->tile_rows_2, &source->tile_rows_2));
+    CHECK(pixel_image_clone(&target->tile_cols_1, &source->tile_cols_1));
+    CHECK(pixel_image_clone(&target->tile_cols_2, &source->tile_cols_2));
+  }
+  else {
+    CHECK(pixel_image_nullify(&target->tile_rows_1));
+    CHECK(pixel_image_nullify(&target->tile_rows_2));
+    CHECK(pixel_image_nullify(&target->tile_cols_1));
+    CHECK(pixel_image_nullify(&target->tile_cols_2));
+  }
+  if (source->I_3.data != NULL) {
+    CHECK(pixel_image_clone(&target->I_3, &source->I_3));
+    CHECK(pixel_image_clone(&target->I_4, &source->I_4));
+    target->higher_order_updated = source->higher_order_updated;
+  }
+  else {
+    CHECK(pixel_image_nullify(&target->I_3));
+    CHECK(pixel_image_nullify(&target->I_4));
+    target->higher_order_updated = FALSE;
+  }
+  if (source->T_1.data != NULL) {
+    CHECK(pixel_image_clone(&target->T_1, &source->T_1));
+    CHECK(pixel_image_clone(&target->T_2, &source->T_2));
+    CHECK(pixel_image_clone(&target->temp_tilted, &source->temp_tilted));
+  }
+  else {
+    CHECK(pixel_image_nullify(&target->T_1));
+    CHECK(pixel_image_nullify(&target->T_2));
+    CHECK(pixel_image_nullify(&target->temp_tilted));
+  }
+  CHECK(pixel_image_nullify(&target->temp_mean));
+  CHECK(pixel_image_nullify(&target->temp_dev));
+  CHECK(pixel_image_nullify(&target->temp_rows));
 
   FINALLY(integral_image_clone);
   RETURN();
@@ -285,16 +523,36 @@ result integral_image_copy
   CHECK_PARAM(source->height == target->height);
   CHECK_PARAM(source->step == target->step);
   CHECK_PARAM(source->stride == target->stride);
+  CHECK_PARAM(source->storage == target->storage);
+  CHECK_PARAM(source->layout == target->layout);
 
   if (target->original != source->original) {
       CHECK(pixel_image_copy(target->original, source->original));
   }
   CHECK(pixel_image_copy(&target->I_1, &source->I_1));
-  CHECK(pixel_image_copy(&target->I_2, &source->I_2));
-#ifdef INTEGRAL_IMAGE_HIGHER_ORDER_STATISTICS
-  CHECK(pixel_image_copy(&target->I_3, &source->I_3));
-  CHECK(pixel_image_copy(&target->I_4, &source->I_4));
-#endif
+  /* interleaved I_2 was copied with I_1 */
+  if (source->layout == l_SEPARATE) {
+    CHECK(pixel_image_copy(&target->I_2, &source->I_2));
+  }
+  if (source->storage == i_TILED) {
+    CHECK(pixel_image_copy(&target->tile_rows_1, &source->tile_rows_1));
+    CHECK(pixel_image_copy(&target->tile_rows_2, &source->tile_rows_2));
+    CHECK(pixel_image_copy(&target->tile_cols_1, &source->tile_cols_1));
+    CHECK(pixel_image_copy(&target->tile_cols_2, &source->tile_cols_2));
+  }
+  if (source->I_3.data != NULL && target->I_3.data != NULL) {
+    CHECK(pixel_image_copy(&target->I_3, &source->I_3));
+    CHECK(pixel_image_copy(&target->I_4, &source->I_4));
+    target->higher_order_updated = source->higher_order_updated;
+  }
+  else {
+    /* built again from the copied original when needed */
+    target->higher_order_updated = FALSE;
+  }
+  if (source->T_1.data != NULL && target->T_1.data != NULL) {
+    CHECK(pixel_image_copy(&target->T_1, &source->T_1));
+    CHECK(pixel_image_copy(&target->T_2, &source->T_2));
+  }
 
   FINALLY(integral_image_copy);
   RETURN();
@@ -322,560 +580,3049 @@ result integral_image_copy
 #define I_2_SET_VALUE(value) *I_2_pos = (value)
 #define I_2_GET_VALUE_WITH_OFFSET(offset) (*(I_2_pos - (offset)))
 
-
 /******************************************************************************/
+/* private functions for calculating the integrals one row at a time          */
+/* the row is first summed into a running row sum, which is then added to the */
+/* previous integral row; as all intermediate values are integers that fit in */
+/* the mantissa of a double, the results are identical to the scalar version  */
 
-result integral_image_update
+typedef void (*integral_image_row_function)
 (
-  integral_image *target
+  const byte *source,
+  uint32 source_step,
+  const integral_value *I_1_prev,
+  integral_value *I_1_row,
+  const integral_value *I_2_prev,
+  integral_value *I_2_row,
+  uint32 step,
+  uint32 width
+);
+
+void integral_image_update_row_scalar
+(
+  const byte *source,
+  uint32 source_step,
+  const integral_value *I_1_prev,
+  integral_value *I_1_row,
+  const integral_value *I_2_prev,
+  integral_value *I_2_row,
+  uint32 step,
+  uint32 width
 )
 {
-  TRY();
-  pixel_image *source;
-
-  CHECK_POINTER(target);
-  CHECK_POINTER(target->original);
-  CHECK_POINTER(target->I_1.data);
-  CHECK_POINTER(target->I_2.data);
-
-  source = target->original;
-  /* TODO: handle multiple channels, and higher powers */
-  {
-    INTEGRAL_IMAGE_UPDATE_DEFINE_VARIABLES(integral_value, integral_value);
-    uint32 width, height, x, y, h, v, d;
-    byte intensity;
-    SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(source, byte);
+  integral_value sum_1, sum_2;
+  uint32 x;
+  byte value;
+
+  sum_1 = 0;
+  sum_2 = 0;
+  for (x = width; x--; source += source_step, I_1_prev += step, I_1_row += step,
+       I_2_prev += step, I_2_row += step) {
+    value = *source;
+    sum_1 += (integral_value)value;
+    sum_2 += pixel_squared[value];
+    *I_1_row = *I_1_prev + sum_1;
+    *I_2_row = *I_2_prev + sum_2;
+  }
+}
 
-    /* set the image content to 0's */
-    /* the first row and column must contain only 0's */
-    /* otherwise the algorithm doesn't work correctly */
-    CHECK(pixel_image_clear(&target->I_1));
-    CHECK(pixel_image_clear(&target->I_2));
+/* multi-channel rows are calculated from the previous column of the same    */
+/* channel instead of running row sums, so all channels are handled in one    */
+/* traversal of the source row                                                */
 
-    width = target->width;
-    height = target->height;
-    I_1_data = (integral_value*)target->I_1.data;
-    I_2_data = (integral_value*)target->I_2.data;
-    
-    /* horizontal offset for integral images */
-    h = target->step;
-    /* vertical offset for integral images */
-    v = target->stride;
-    /* diagonal offset for integral images */
-    d = target->stride + target->step;
-    
-    /* initialize rest of integral images */
-    /* add value of this pixel and integrals from top and left */
-    /* subtract integral from top left diagonal */
-    {
-      INTEGRAL_IMAGE_SET_POS(d);
-      for (y = 0; y < height; y++) {
-        for (x = width, source_pos = source_rows[y]; x--; source_pos += source_step) {
-          intensity = PIXEL_VALUE(source);
-          I_1_SET_VALUE((I_1_GET_VALUE_WITH_OFFSET(v) -
-                         I_1_GET_VALUE_WITH_OFFSET(d)) +
-                         I_1_GET_VALUE_WITH_OFFSET(h) +
-                         ((integral_value)intensity));
-          I_2_SET_VALUE((I_2_GET_VALUE_WITH_OFFSET(v) -
-                         I_2_GET_VALUE_WITH_OFFSET(d)) +
-                         I_2_GET_VALUE_WITH_OFFSET(h) +
-                         pixel_squared[intensity]);
-          INTEGRAL_IMAGE_ADVANCE_POS(h);
-        }
-        /* skip one col to reach the beginning of next row */
-        INTEGRAL_IMAGE_ADVANCE_POS(h);
-      }
+void integral_image_update_row_channels
+(
+  const byte *source,
+  uint32 source_step,
+  const integral_value *I_1_prev,
+  integral_value *I_1_row,
+  const integral_value *I_2_prev,
+  integral_value *I_2_row,
+  uint32 step,
+  uint32 width
+)
+{
+  const integral_value *I_1_diag, *I_2_diag, *I_1_left, *I_2_left;
+  uint32 x, c, pos, channel_step;
+  byte value;
+
+  /* with interleaved layout the channels are two values apart */
+  channel_step = step / source_step;
+  I_1_diag = I_1_prev - step;
+  I_2_diag = I_2_prev - step;
+  I_1_left = I_1_row - step;
+  I_2_left = I_2_row - step;
+  for (x = width; x--; source += source_step,
+       I_1_prev += step, I_1_row += step, I_1_diag += step, I_1_left += step,
+       I_2_prev += step, I_2_row += step, I_2_diag += step, I_2_left += step) {
+    for (c = 0, pos = 0; c < source_step; c++, pos += channel_step) {
+      value = source[c];
+      I_1_row[pos] = (I_1_prev[pos] - I_1_diag[pos]) + I_1_left[pos] +
+                     (integral_value)value;
+      I_2_row[pos] = (I_2_prev[pos] - I_2_diag[pos]) + I_2_left[pos] +
+                     pixel_squared[value];
     }
   }
-
-  FINALLY(integral_image_update);
-  RETURN();
 }
 
-/******************************************************************************/
-
-/*
-Notes:
--x and y are signed to allow creating regions around any pixel (cx - r, cy - r)
--top left corner of rectangle is in reality one pixel right and up from the
-coordinates of the top left corner of the image region; but since an empty
-row and column is added to top and left, the coordinates are handled
-automatically correctly, and the real width and height of the rectangle can be
-used for dx and dy, there is no need to subtract 1
--this takes into account multi-channel images
-*/
-
-image_rect integral_image_create_rect
+#if defined(HAVE_X86_SIMD) && (INTEGRAL_IMAGE_DATA_TYPE == INTEGRAL_IMAGE_USING_DOUBLE)
+
+#define INTEGRAL_IMAGE_SIMD_ROWS
+
+/* calculates the inclusive prefix sum of four 32-bit lanes */
+#define SIMD_PREFIX_SUM_EPI32(v)\
+  v = _mm_add_epi32(v, _mm_slli_si128(v, 4));\
+  v = _mm_add_epi32(v, _mm_slli_si128(v, 8))
+
+/* calculates the inclusive prefix sum of eight 16-bit lanes */
+#define SIMD_PREFIX_SUM_EPI16(v)\
+  v = _mm_add_epi16(v, _mm_slli_si128(v, 2));\
+  v = _mm_add_epi16(v, _mm_slli_si128(v, 4));\
+  v = _mm_add_epi16(v, _mm_slli_si128(v, 8))
+
+/* calculates the prefix sums of 8 pixels and their squares in 32-bit lanes */
+#define SIMD_ROW_PREFIX_SUMS_8(source)\
+  v16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(source)), zero);\
+  s16 = _mm_mullo_epi16(v16, v16);\
+  SIMD_PREFIX_SUM_EPI16(v16);\
+  v_lo = _mm_unpacklo_epi16(v16, zero);\
+  v_hi = _mm_unpackhi_epi16(v16, zero);\
+  s_lo = _mm_unpacklo_epi16(s16, zero);\
+  s_hi = _mm_unpackhi_epi16(s16, zero);\
+  SIMD_PREFIX_SUM_EPI32(s_lo);\
+  SIMD_PREFIX_SUM_EPI32(s_hi);\
+  s_hi = _mm_add_epi32(s_hi, _mm_shuffle_epi32(s_lo, 0xFF))
+
+/* adds four prefix sums, the carry from previous pixels and previous row */
+#define SIMD_STORE_4_SSE2(prev, row, carry, p)\
+  _mm_storeu_pd((row), _mm_add_pd(_mm_loadu_pd(prev),\
+                _mm_add_pd(carry, _mm_cvtepi32_pd(p))));\
+  _mm_storeu_pd((row) + 2, _mm_add_pd(_mm_loadu_pd((prev) + 2),\
+                _mm_add_pd(carry, _mm_cvtepi32_pd(_mm_srli_si128(p, 8)))))
+
+#define SIMD_STORE_4_AVX2(prev, row, carry, p)\
+  _mm256_storeu_pd((row), _mm256_add_pd(_mm256_loadu_pd(prev),\
+                   _mm256_add_pd(carry, _mm256_cvtepi32_pd(p))))
+
+SIMD_TARGET_SSE2
+void integral_image_update_row_sse2
 (
-  integral_image *target,
-  sint32 x,
-  sint32 y,
-  sint32 dx,
-  sint32 dy,
-  uint32 offset
+  const byte *source,
+  uint32 source_step,
+  const real64 *I_1_prev,
+  real64 *I_1_row,
+  const real64 *I_2_prev,
+  real64 *I_2_row,
+  uint32 step,
+  uint32 width
 )
 {
-  image_rect irect;
-  register uint32 width, height, step, stride;
-
-  width = target->width;
-  height = target->height;
+  __m128i zero, v16, s16, v_lo, v_hi, s_lo, s_hi;
+  __m128d carry_1, carry_2;
+  real64 sum_1, sum_2;
+  uint32 x;
+  byte value;
+
+  /* only contiguous single-channel rows are handled */
+  (void)source_step;
+  (void)step;
+  zero = _mm_setzero_si128();
+  carry_1 = _mm_setzero_pd();
+  carry_2 = _mm_setzero_pd();
+  for (x = 0; x + 8 <= width; x += 8) {
+    SIMD_ROW_PREFIX_SUMS_8(source + x);
+    SIMD_STORE_4_SSE2(I_1_prev + x, I_1_row + x, carry_1, v_lo);
+    SIMD_STORE_4_SSE2(I_1_prev + x + 4, I_1_row + x + 4, carry_1, v_hi);
+    SIMD_STORE_4_SSE2(I_2_prev + x, I_2_row + x, carry_2, s_lo);
+    SIMD_STORE_4_SSE2(I_2_prev + x + 4, I_2_row + x + 4, carry_2, s_hi);
+    carry_1 = _mm_add_pd(carry_1, _mm_cvtepi32_pd(_mm_shuffle_epi32(v_hi, 0xFF)));
+    carry_2 = _mm_add_pd(carry_2, _mm_cvtepi32_pd(_mm_shuffle_epi32(s_hi, 0xFF)));
+  }
+  sum_1 = _mm_cvtsd_f64(carry_1);
+  sum_2 = _mm_cvtsd_f64(carry_2);
+  for (; x < width; x++) {
+    value = source[x];
+    sum_1 += (real64)value;
+    sum_2 += pixel_squared[value];
+    I_1_row[x] = I_1_prev[x] + sum_1;
+    I_2_row[x] = I_2_prev[x] + sum_2;
+  }
+}
 
-  irect.valid = 0;
-  if (x < 0) {
-    dx = dx + x;
-    x = 0;
+SIMD_TARGET_AVX2
+void integral_image_update_row_avx2
+(
+  const byte *source,
+  uint32 source_step,
+  const real64 *I_1_prev,
+  real64 *I_1_row,
+  const real64 *I_2_prev,
+  real64 *I_2_row,
+  uint32 step,
+  uint32 width
+)
+{
+  __m128i zero, v16, s16, v_lo, v_hi, s_lo, s_hi;
+  __m256d carry_1, carry_2;
+  real64 sum_1, sum_2;
+  uint32 x;
+  byte value;
+
+  (void)source_step;
+  (void)step;
+  zero = _mm_setzero_si128();
+  carry_1 = _mm256_setzero_pd();
+  carry_2 = _mm256_setzero_pd();
+  for (x = 0; x + 8 <= width; x += 8) {
+    SIMD_ROW_PREFIX_SUMS_8(source + x);
+    SIMD_STORE_4_AVX2(I_1_prev + x, I_1_row + x, carry_1, v_lo);
+    SIMD_STORE_4_AVX2(I_1_prev + x + 4, I_1_row + x + 4, carry_1, v_hi);
+    SIMD_STORE_4_AVX2(I_2_prev + x, I_2_row + x, carry_2, s_lo);
+    SIMD_STORE_4_AVX2(I_2_prev + x + 4, I_2_row + x + 4, carry_2, s_hi);
+    carry_1 = _mm256_add_pd(carry_1, _mm256_cvtepi32_pd(_mm_shuffle_epi32(v_hi, 0xFF)));
+    carry_2 = _mm256_add_pd(carry_2, _mm256_cvtepi32_pd(_mm_shuffle_epi32(s_hi, 0xFF)));
   }
-  if (y < 0) {
-    dy = dy + y;
-    y = 0;
+  sum_1 = _mm256_cvtsd_f64(carry_1);
+  sum_2 = _mm256_cvtsd_f64(carry_2);
+  for (; x < width; x++) {
+    value = source[x];
+    sum_1 += (real64)value;
+    sum_2 += pixel_squared[value];
+    I_1_row[x] = I_1_prev[x] + sum_1;
+    I_2_row[x] = I_2_prev[x] + sum_2;
   }
-  if ((unsigned)x < width && (unsigned)y < height) {
-    if (dx > 0 && dy > 0) {
-      if (((unsigned)(x + dx)) > width) dx = ((signed)width) - x;
-      if (((unsigned)(y + dy)) > height) dy = ((signed)height) - y;
+}
+
+#endif /* HAVE_X86_SIMD && INTEGRAL_IMAGE_USING_DOUBLE */
+
+/******************************************************************************/
 
-      step = target->step;
-      stride = target->stride;
-      irect.valid = 1;
-      irect.offset = ((unsigned)y) * stride + ((unsigned)x) * step + offset;
-      irect.hstep = ((unsigned)dx) * step;
-      irect.vstep = ((unsigned)dy) * stride;
-      irect.N = ((unsigned)dx) * ((unsigned)dy);
+integral_image_row_function integral_image_get_row_function
+(
+  uint32 source_step,
+  uint32 step
+)
+{
+  if (source_step > 1) {
+    return &integral_image_update_row_channels;
+  }
+#ifdef INTEGRAL_IMAGE_SIMD_ROWS
+  /* vectorized kernels handle single-channel images with contiguous rows */
+  /* and separate integrals */
+  if (step == 1) {
+    switch (simd_get_level()) {
+    case s_AVX2:
+      return &integral_image_update_row_avx2;
+    case s_SSE2:
+      return &integral_image_update_row_sse2;
+    default:
+      break;
     }
   }
-
-  return irect;
+#else
+  (void)step;
+#endif
+  return &integral_image_update_row_scalar;
 }
 
 /******************************************************************************/
+/* calculates the integral rows for the source rows first..last-1; the        */
+/* integral row above the first row is treated as if it contained only 0's,   */
+/* so that image strips can be calculated independently                       */
 
-integral_value integral_image_calculate_mean
+/******************************************************************************/
+/* private function for calculating the tilted integral row for source row y */
+/* from the finished regular integral rows; the row sums R(x) are the         */
+/* differences of consecutive integral rows. The tilted integral is the       */
+/* difference of two accumulations, A(x,y) = A(x+1,y-1) + R(x,y) and          */
+/* B(x,y) = B(x-1,y-1) + R(x-1,y), where R(x) is the row total for x >= width */
+/* and 0 for x < 0. The state contains the A and B rows for both powers, each */
+/* with width+1 values, kept in temp_tilted and cleared before the first row. */
+
+void integral_image_update_tilted_row
 (
   integral_image *target,
-  sint32 x,
-  sint32 y,
-  sint32 dx,
-  sint32 dy,
-  uint32 offset
+  uint32 y,
+  integral_value *state
 )
 {
-  image_rect irect;
-  integral_value *iA, sum;
+  integral_value *I_1_row, *I_1_prev, *I_2_row, *I_2_prev, *T_1_row, *T_2_row;
+  integral_value *A_1, *B_1, *A_2, *B_2, r_1, r_2, prev_r_1, prev_r_2;
+  integral_value carry_1, carry_2, old;
+  uint32 x, width, last;
 
-  irect = integral_image_create_rect(target, x, y, dx, dy, offset);
-  if (irect.valid == 0) {
-    return 0;
+  width = target->width;
+  T_1_row = (integral_value *)target->T_1.data + (y + 1) * target->T_1.stride;
+  T_2_row = (integral_value *)target->T_2.data + (y + 1) * target->T_2.stride;
+  /* an image without columns has only the empty columns x = -1 and x = 0 */
+  if (width == 0) {
+    T_1_row[0] = T_1_row[1] = 0;
+    T_2_row[0] = T_2_row[1] = 0;
+    return;
   }
-  else {
-    iA = ((integral_value *)target->I_1.data) + irect.offset;
-    sum = *(iA + irect.vstep + irect.hstep) + *iA - *(iA + irect.hstep) - *(iA + irect.vstep);
-    return sum / ((integral_value)irect.N);
+  last = width - 1;
+  I_1_row = (integral_value *)target->I_1.data + (y + 1) * target->stride + 1;
+  I_2_row = (integral_value *)target->I_2.data + (y + 1) * target->stride + 1;
+  I_1_prev = I_1_row - target->stride;
+  I_2_prev = I_2_row - target->stride;
+  A_1 = state;
+  B_1 = A_1 + width + 1;
+  A_2 = B_1 + width + 1;
+  B_2 = A_2 + width + 1;
+
+  /* column x = -1 contains A(0,y-1) */
+  T_1_row[0] = A_1[0];
+  T_2_row[0] = A_2[0];
+  carry_1 = 0;
+  carry_2 = 0;
+  prev_r_1 = 0;
+  prev_r_2 = 0;
+  for (x = 0; x <= width; x++) {
+    r_1 = I_1_row[(x < last) ? x : last] - I_1_prev[(x < last) ? x : last];
+    r_2 = I_2_row[(x < last) ? x : last] - I_2_prev[(x < last) ? x : last];
+    /* A is updated in ascending order, so A(x+1,y-1) is still available */
+    A_1[x] = A_1[(x < width) ? x + 1 : width] + r_1;
+    A_2[x] = A_2[(x < width) ? x + 1 : width] + r_2;
+    /* B(x-1,y-1) has been overwritten, so it is carried */
+    old = B_1[x];
+    B_1[x] = carry_1 + prev_r_1;
+    carry_1 = old;
+    old = B_2[x];
+    B_2[x] = carry_2 + prev_r_2;
+    carry_2 = old;
+    prev_r_1 = r_1;
+    prev_r_2 = r_2;
+    T_1_row[x + 1] = A_1[x] - B_1[x];
+    T_2_row[x + 1] = A_2[x] - B_2[x];
   }
 }
 
 /******************************************************************************/
 
-integral_value integral_image_calculate_variance
+void integral_image_update_rows
 (
   integral_image *target,
-  sint32 x,
-  sint32 y,
-  sint32 dx,
-  sint32 dy,
-  uint32 offset
+  integral_image_row_function update_row,
+  uint32 first,
+  uint32 last,
+  integral_value *tilted_state
 )
 {
-  image_rect irect;
-  integral_value *iA, *i2A, mean, sum2, var;
-
-  irect = integral_image_create_rect(target, x, y, dx, dy, offset);
-  if (irect.valid == 0) {
-    return 0;
-  }
-  else {
-    iA = ((integral_value *)target->I_1.data) + irect.offset;
-    i2A = ((integral_value *)target->I_2.data) + irect.offset;
-    mean = (*(iA + irect.vstep + irect.hstep) + *iA - *(iA + irect.hstep) - *(iA + irect.vstep)) / ((integral_value)irect.N);
-    sum2 = *(i2A + irect.vstep + irect.hstep) + *i2A - *(i2A + irect.hstep) - *(i2A + irect.vstep);
-    var = (sum2 / ((integral_value)irect.N)) - mean*mean;
-    if (var < 0) var = 0;
-    return var;
+  integral_value *I_1_data, *I_2_data, *I_1_row, *I_2_row, *I_1_prev, *I_2_prev;
+  uint32 y, source_step, step, stride, c;
+  byte **source_rows;
+
+  I_1_data = (integral_value *)target->I_1.data;
+  I_2_data = (integral_value *)target->I_2.data;
+  source_rows = (byte **)target->original->rows;
+  source_step = target->original->step;
+  step = target->step;
+  stride = target->stride;
+
+  for (y = first; y < last; y++) {
+    I_1_row = I_1_data + (y + 1) * stride;
+    I_2_row = I_2_data + (y + 1) * stride;
+    /* the first row of the integral is always 0 */
+    I_1_prev = (y == first) ? I_1_data : I_1_row - stride;
+    I_2_prev = (y == first) ? I_2_data : I_2_row - stride;
+    for (c = 0; c < step; c++) {
+      I_1_row[c] = 0;
+      I_2_row[c] = 0;
+    }
+    update_row(source_rows[y], source_step, I_1_prev + step, I_1_row + step,
+               I_2_prev + step, I_2_row + step, step, target->width);
+    /* tilted rows are calculated while the integral rows are in cache */
+    if (tilted_state != NULL) {
+      integral_image_update_tilted_row(target, y, tilted_state);
+    }
   }
 }
 
 /******************************************************************************/
+/* private macro for generating the functions calculating the integer         */
+/* integral rows for the source rows first..last-1 for all channels; the      */
+/* integral row above the first row is treated as if it contained only 0's    */
+
+#define INTEGER_INTEGRAL_IMAGE_UPDATE_ROWS(I_1_type, I_2_type)\
+  I_1_type *I_1_data, *I_1_row, *I_1_prev, sum_1;\
+  I_2_type *I_2_data, *I_2_row, *I_2_prev, sum_2;\
+  uint32 x, y, c, pos, step, stride, width;\
+  byte **source_rows, *source_row, value;\
+  \
+  I_1_data = (I_1_type *)target->I_1.data;\
+  I_2_data = (I_2_type *)target->I_2.data;\
+  source_rows = (byte **)target->original->rows;\
+  width = target->width;\
+  step = target->step;\
+  stride = target->stride;\
+  \
+  for (y = first; y < last; y++) {\
+    source_row = source_rows[y];\
+    I_1_row = I_1_data + (y + 1) * stride;\
+    I_2_row = I_2_data + (y + 1) * stride;\
+    I_1_prev = (y == first) ? I_1_data : I_1_row - stride;\
+    I_2_prev = (y == first) ? I_2_data : I_2_row - stride;\
+    for (c = 0; c < step; c++) {\
+      I_1_row[c] = 0;\
+      I_2_row[c] = 0;\
+      sum_1 = 0;\
+      sum_2 = 0;\
+      for (x = 0, pos = c; x < width; x++, pos += step) {\
+        value = source_row[pos];\
+        sum_1 += value;\
+        sum_2 += small_pixel_squared[value];\
+        I_1_row[pos + step] = I_1_prev[pos + step] + sum_1;\
+        I_2_row[pos + step] = I_2_prev[pos + step] + sum_2;\
+      }\
+    }\
+  }
 
-void integral_image_calculate_statistics
+void small_integral_image_update_rows
 (
   integral_image *target,
-  statistics *stat,
-  sint32 x,
-  sint32 y,
-  sint32 dx,
-  sint32 dy,
-  uint32 offset
+  uint32 first,
+  uint32 last
 )
 {
-  image_rect irect;
-  integral_value *iA, *i2A, N, sum, sum2, mean, var;
+  INTEGER_INTEGRAL_IMAGE_UPDATE_ROWS(SI_1_t, SI_2_t);
+}
 
-  statistics_init(stat);
-  irect = integral_image_create_rect(target, x, y, dx, dy, offset);
-  if (irect.valid == 0) {
-    return;
-  }
-  else {
-    iA = ((integral_value *)target->I_1.data) + irect.offset;
-    i2A = ((integral_value *)target->I_2.data) + irect.offset;
-    N = ((integral_value)irect.N);
-    sum = *(iA + irect.vstep + irect.hstep) + *iA - *(iA + irect.hstep) - *(iA + irect.vstep);
-    sum2 = *(i2A + irect.vstep + irect.hstep) + *i2A - *(i2A + irect.hstep) - *(i2A + irect.vstep);
-    mean = sum / N;
-    var = (sum2 / N) - mean*mean;
-    if (var < 0) var = 0;
-    stat->N = N;
-    stat->sum = sum;
-    stat->sum2 = sum2;
-    stat->mean = mean;
-    stat->variance = var;
-    stat->deviation = sqrt(var);
-    return;
-  }
+void exact_integral_image_update_rows
+(
+  integral_image *target,
+  uint32 first,
+  uint32 last
+)
+{
+  INTEGER_INTEGRAL_IMAGE_UPDATE_ROWS(EI_1_t, EI_2_t);
 }
 
 /******************************************************************************/
+/* makes sure that the buffer has room for the given number of rows, and      */
+/* allocates it again only if it is too small                                 */
 
-result integral_image_threshold_sauvola
+result integral_image_prepare_buffer
 (
-  integral_image *source,
-  pixel_image *target,
-  truth_value invert,
-  sint32 radius,
-  integral_value k,
-  truth_value calculate_max,
-  integral_value max,
-  truth_value use_mean
+  pixel_image *buffer,
+  uint32 width,
+  uint32 height
 )
 {
   TRY();
-  pixel_image temp_mean, temp_dev;
-  byte *source_data, *target_data, source_value, t, value1, value2;
-  integral_value *mean_data, *dev_data, mean, dev, R, dev_max, dev_sum;
-  sint32 x, y, width, height, step, stride, size, pos;
-  uint32 offset;
-  statistics stat;
 
-  CHECK_POINTER(source);
-  CHECK_POINTER(target);
-  CHECK_PARAM(source->original->type == p_U8);
+  CHECK_POINTER(buffer);
 
-  CHECK(pixel_image_clone(target, source->original));
+  if (buffer->data == NULL || buffer->width != width ||
+      buffer->height < height) {
+    CHECK(pixel_image_destroy(buffer));
+    CHECK(pixel_image_create(buffer, p_I, GREY, width, height, 1, width));
+  }
 
-  width = ((signed)target->width);
-  height = ((signed)target->height);
-  step = ((signed)target->step);
-  stride = ((signed)target->stride);
-  offset = target->offset;
+  FINALLY(integral_image_prepare_buffer);
+  RETURN();
+}
 
-  if (IS_TRUE(invert)) {
-    value1 = 0;
-    value2 = 255;
-  }
-  else {
-    value1 = 255;
-    value2 = 0;
-  }
+/******************************************************************************/
+/* private function for calculating the tiled integrals; the full integral   */
+/* rows are accumulated in double precision, and only the parts relative to  */
+/* the tile borders are stored in the tiles                                  */
 
-  CHECK(pixel_image_create(&temp_mean, p_I, target->format, ((unsigned)width),
-                           ((unsigned)height), ((unsigned)step),
-                           ((unsigned)stride)));
-  CHECK(pixel_image_create(&temp_dev, p_I, target->format, ((unsigned)width),
-                           ((unsigned)height), ((unsigned)step),
-                           ((unsigned)stride)));
+result tiled_integral_image_update
+(
+  integral_image *target
+)
+{
+  TRY();
+  integral_value *full_1, *full_2, *R_1, *R_2, *C_1, *C_2, sum_1, sum_2;
+  integral_value border_1, border_2;
+  TI_t *L_1, *L_2;
+  uint32 x, y, c, pos, end, step, stride, width, tile_stride, tile_x, corner;
+  byte *source_row, value;
 
-  source_data = (byte *)source->original->data;
-  target_data = (byte *)target->data;
-  mean_data = (integral_value *)temp_mean.data;
-  dev_data = (integral_value *)temp_dev.data;
-  size = 2 * radius + 1;
+  CHECK_POINTER(target);
+  CHECK_PARAM(target->storage == i_TILED);
 
-  if (IS_FALSE(calculate_max)) {
-    R = max;
-    for (y = 0; y < height; y++) {
-      pos = y * stride;
-      for (x = 0; x < width; x++, pos += step) {
-        source_value = source_data[pos];
-        integral_image_calculate_statistics(source, &stat, x-radius, y-radius,
-                                            size, size, offset);
-        t = (byte)floor(stat.mean * (1.0 + k * ((stat.deviation / R) - 1.0)));
-        if (source_value > t) {
-          target_data[pos] = value1;
-        }
-        else {
-          target_data[pos] = value2;
+  step = target->step;
+  stride = target->stride;
+  width = target->width;
+  tile_stride = target->tile_cols_1.stride;
+  /* the rows are kept in the integral, so later frames do not allocate */
+  CHECK(integral_image_prepare_buffer(&target->temp_rows, stride, 2));
+  full_1 = (integral_value *)target->temp_rows.data;
+  CHECK(memory_clear((data_pointer)full_1, 2 * stride,
+                     sizeof(integral_value)));
+  full_2 = full_1 + stride;
+
+  for (y = 0; y <= target->height; y++) {
+    /* accumulate the full integral row for source row y-1 */
+    if (y > 0) {
+      source_row = (byte *)target->original->rows[y - 1];
+      for (c = 0; c < step; c++) {
+        sum_1 = 0;
+        sum_2 = 0;
+        for (x = 0, pos = c; x < width; x++, pos += step) {
+          value = source_row[pos];
+          sum_1 += value;
+          sum_2 += pixel_squared[value];
+          full_1[pos + step] += sum_1;
+          full_2[pos + step] += sum_2;
         }
       }
     }
-  }
-  else {
-    if (IS_FALSE(use_mean)) {
-      dev_max = 0;
-      for (y = 0; y < height; y++) {
-        pos = y * stride;
-        for (x = 0; x < width; x++, pos += step) {
-          integral_image_calculate_statistics(source, &stat, x-radius, y-radius,
-                                              size, size, offset);
-          mean_data[pos] = stat.mean;
-          dev = stat.deviation;
-          dev_data[pos] = dev;
-          if (dev > dev_max) dev_max = dev;
-        }
+    R_1 = (integral_value *)target->tile_rows_1.data +
+        (y / INTEGRAL_IMAGE_TILE_SIZE) * stride;
+    R_2 = (integral_value *)target->tile_rows_2.data +
+        (y / INTEGRAL_IMAGE_TILE_SIZE) * stride;
+    if (y % INTEGRAL_IMAGE_TILE_SIZE == 0) {
+      for (pos = 0; pos < stride; pos++) {
+        R_1[pos] = full_1[pos];
+        R_2[pos] = full_2[pos];
       }
-      R = dev_max;
     }
-    else {
-      dev_sum = 0;
-      for (y = 0; y < height; y++) {
-        pos = y * stride;
-        for (x = 0; x < width; x++, pos += step) {
-          integral_image_calculate_statistics(source, &stat, x-radius, y-radius,
-                                              size, size, offset);
-          mean_data[pos] = stat.mean;
-          dev_sum += dev_data[pos] = stat.deviation;
-        }
+    C_1 = (integral_value *)target->tile_cols_1.data + y * tile_stride;
+    C_2 = (integral_value *)target->tile_cols_2.data + y * tile_stride;
+    for (x = 0, tile_x = 0; x <= width;
+         x += INTEGRAL_IMAGE_TILE_SIZE, tile_x += step) {
+      for (c = 0; c < step; c++) {
+        C_1[tile_x + c] = full_1[x * step + c];
+        C_2[tile_x + c] = full_2[x * step + c];
       }
-      R = dev_sum / ((integral_value)(width*height));
-    }
-    for (y = 0; y < height; y++) {
-      pos = y * stride;
-      for (x = 0; x < width; x++, pos += step) {
-        source_value = source_data[pos];
-        mean = mean_data[pos];
-        dev = dev_data[pos];
-        t = (byte)floor(mean * (1.0 + k * ((dev / R) - 1.0)));
-        if (source_value > t) {
-          target_data[pos] = value1;
-        }
-        else {
-          target_data[pos] = value2;
+    }
+    /* the values relative to the tile borders are small enough for TI_t */
+    L_1 = (TI_t *)target->I_1.data + y * stride;
+    L_2 = (TI_t *)target->I_2.data + y * stride;
+    for (x = 0, tile_x = 0; x <= width;
+         x += INTEGRAL_IMAGE_TILE_SIZE, tile_x += step) {
+      corner = x * step;
+      end = (x + INTEGRAL_IMAGE_TILE_SIZE <= width + 1) ?
+          (x + INTEGRAL_IMAGE_TILE_SIZE) * step : (width + 1) * step;
+      for (c = 0; c < step; c++) {
+        border_1 = R_1[corner + c] - C_1[tile_x + c];
+        border_2 = R_2[corner + c] - C_2[tile_x + c];
+        for (pos = corner + c; pos < end; pos += step) {
+          L_1[pos] = (TI_t)(full_1[pos] - R_1[pos] + border_1);
+          L_2[pos] = (TI_t)(full_2[pos] - R_2[pos] + border_2);
         }
       }
     }
   }
 
+  FINALLY(tiled_integral_image_update);
+  RETURN();
+}
 
-  FINALLY(integral_image_threshold_sauvola);
-  pixel_image_destroy(&temp_mean);
-  pixel_image_destroy(&temp_dev);
+/******************************************************************************/
+/* the first row of the integrals must contain only 0's                       */
+
+result integral_image_clear_first_row
+(
+  integral_image *target
+)
+{
+  TRY();
+
+  switch (target->storage) {
+  case i_REAL:
+    CHECK(memory_clear((data_pointer)target->I_1.data, target->stride,
+                       sizeof(integral_value)));
+    CHECK(memory_clear((data_pointer)target->I_2.data, target->stride,
+                       sizeof(integral_value)));
+    if (target->T_1.data != NULL) {
+      CHECK(memory_clear((data_pointer)target->T_1.data, target->T_1.stride,
+                         sizeof(integral_value)));
+      CHECK(memory_clear((data_pointer)target->T_2.data, target->T_2.stride,
+                         sizeof(integral_value)));
+    }
+    break;
+  case i_EXACT:
+    CHECK(memory_clear((data_pointer)target->I_1.data, target->stride,
+                       sizeof(EI_1_t)));
+    CHECK(memory_clear((data_pointer)target->I_2.data, target->stride,
+                       sizeof(EI_2_t)));
+    break;
+  case i_SMALL:
+    CHECK(memory_clear((data_pointer)target->I_1.data, target->stride,
+                       sizeof(SI_1_t)));
+    CHECK(memory_clear((data_pointer)target->I_2.data, target->stride,
+                       sizeof(SI_2_t)));
+    break;
+  case i_TILED:
+    CHECK(memory_clear((data_pointer)target->I_1.data, target->stride,
+                       sizeof(TI_t)));
+    CHECK(memory_clear((data_pointer)target->I_2.data, target->stride,
+                       sizeof(TI_t)));
+    break;
+  default:
+    ERROR(BAD_TYPE);
+  }
+
+  FINALLY(integral_image_clear_first_row);
   RETURN();
 }
 
 /******************************************************************************/
 
-result integral_image_threshold_feng
+result integral_image_update
 (
-  integral_image *source,
-  pixel_image *target,
-  truth_value invert,
-  sint32 radius1,
-  integral_value multiplier,
-  truth_value estimate_min,
-  integral_value alpha
+  integral_image *target
 )
 {
   TRY();
-  byte *source_data, *target_data, source_value, t, value1, value2;
-  integral_value min, mean, dev1, dev2, as, a1, a2, a3, k1, k2, g, asg;
-  sint32 x, y, width, height, step, stride, radius2, size1, size2, pos;
-  uint32 offset;
-  statistics stat;
+  integral_value *tilted_state;
 
-  CHECK_POINTER(source);
+  tilted_state = NULL;
   CHECK_POINTER(target);
-  CHECK_PARAM(source->original->type == p_U8);
+  CHECK_POINTER(target->original);
+  CHECK_POINTER(target->I_1.data);
+  CHECK_POINTER(target->I_2.data);
 
-  CHECK(pixel_image_clone(target, source->original));
+  /* only the first row has to be cleared, the rest is overwritten */
+  CHECK(integral_image_clear_first_row(target));
+  target->higher_order_updated = FALSE;
+  switch (target->storage) {
+  case i_EXACT:
+    exact_integral_image_update_rows(target, 0, target->height);
+    break;
+  case i_SMALL:
+    small_integral_image_update_rows(target, 0, target->height);
+    break;
+  case i_TILED:
+    CHECK(tiled_integral_image_update(target));
+    break;
+  default:
+    if (target->T_1.data != NULL) {
+      CHECK(pixel_image_clear(&target->temp_tilted));
+      tilted_state = (integral_value *)target->temp_tilted.data;
+    }
+    integral_image_update_rows(target,
+        integral_image_get_row_function(target->original->step, target->step),
+        0, target->height, tilted_state);
+  }
 
-  width = ((signed)target->width);
-  height = ((signed)target->height);
-  step = ((signed)target->step);
-  stride = ((signed)target->stride);
-  offset = target->offset;
+  FINALLY(integral_image_update);
+  RETURN();
+}
 
-  g = 2;
-  a1 = 0.12;
-  k1 = 0.25;
-  k2 = 0.04;
+/******************************************************************************/
 
-  if (IS_TRUE(invert)) {
-    value1 = 0;
-    value2 = 255;
-  }
-  else {
-    value1 = 255;
-    value2 = 0;
-  }
+result integral_image_update_from_reader
+(
+  integral_image *target,
+  image_row_reader reader,
+  pointer reader_params
+)
+{
+  TRY();
+  pixel_image *grey;
+  integral_image_row_function update_row;
+  integral_value *tilted_state, *I_1_row, *I_2_row, *I_1_prev, *I_2_prev;
+  uint32 y, c, step, stride;
 
-  source_data = (byte *)source->original->data;
-  target_data = (byte *)target->data;
-  size1 = 2 * ((signed)radius1) + 1;
-  radius2 = (sint32)(multiplier * ((integral_value)radius1));
-  size2 = 2 * radius2 + 1;
+  tilted_state = NULL;
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->original);
+  CHECK_POINTER(target->I_1.data);
+  CHECK_POINTER(target->I_2.data);
+  CHECK_POINTER(reader);
+  grey = target->original;
+  CHECK_PARAM(grey->type == p_U8);
+  CHECK_PARAM(grey->step == 1);
+  CHECK_PARAM(grey->offset == 0);
+
+  if (target->storage != i_REAL) {
+    for (y = 0; y < grey->height; y++) {
+      CHECK(reader(reader_params, y, (byte *)grey->rows[y]));
+    }
+    CHECK(integral_image_update(target));
+    TERMINATE(SUCCESS);
+  }
 
-  for (y = 0; y < height; y++) {
-    pos = y * stride;
-    for (x = 0; x < width; x++, pos += step) {
-      source_value = source_data[pos];
-      integral_image_calculate_statistics(source, &stat, x-radius1,y-radius1,
-                                          size1, size1, offset);
-      mean = stat.mean;
-      dev1 = stat.deviation;
-      if (IS_TRUE(estimate_min)) {
-        min = fmax(0, mean - alpha * dev1);
-      }
-      else {
-        min = pixel_image_find_min_byte(source->original, x-radius1, y-radius1,
-                                        size1, size1, offset);
-      }
-      dev2 = sqrt(integral_image_calculate_variance(source, x-radius2, y-radius2,
-                                                    size2, size2, offset));
-      as = dev1 / fmax(1,dev2);
-      asg = pow(as, g);
-      a2 = k1 * asg;
-      a3 = k2 * asg;
-      t = (byte)floor((1 - a1) * mean + a2 * as * (mean - min) + a3 * min);
-      if (source_value > t) {
-        target_data[pos] = value1;
-      }
-      else {
-        target_data[pos] = value2;
-      }
+  CHECK(integral_image_clear_first_row(target));
+  target->higher_order_updated = FALSE;
+  if (target->T_1.data != NULL) {
+    CHECK(pixel_image_clear(&target->temp_tilted));
+    tilted_state = (integral_value *)target->temp_tilted.data;
+  }
+  update_row = integral_image_get_row_function(1, target->step);
+  step = target->step;
+  stride = target->stride;
+  for (y = 0; y < target->height; y++) {
+    CHECK(reader(reader_params, y, (byte *)grey->rows[y]));
+    I_1_row = (integral_value *)target->I_1.data + (y + 1) * stride;
+    I_2_row = (integral_value *)target->I_2.data + (y + 1) * stride;
+    I_1_prev = I_1_row - stride;
+    I_2_prev = I_2_row - stride;
+    for (c = 0; c < step; c++) {
+      I_1_row[c] = 0;
+      I_2_row[c] = 0;
+    }
+    update_row((byte *)grey->rows[y], 1, I_1_prev + step, I_1_row + step,
+               I_2_prev + step, I_2_row + step, step, target->width);
+    if (tilted_state != NULL) {
+      integral_image_update_tilted_row(target, y, tilted_state);
     }
   }
 
-  FINALLY(integral_image_threshold_feng);
+  FINALLY(integral_image_update_from_reader);
   RETURN();
 }
 
 /******************************************************************************/
+/* private row reader converting the rows of a yuv422 image to greyscale      */
 
-result small_integral_image_create
+typedef struct yuv422_row_params_t {
+  const pixel_image *source;
+  uint32 y_channel;
+} yuv422_row_params;
+
+result yuv422_row_reader
+(
+  pointer params,
+  uint32 row,
+  byte *target
+)
+{
+  yuv422_row_params *yuv;
+
+  yuv = (yuv422_row_params *)params;
+  convert_yuv422_row_to_grey8((const byte *)yuv->source->rows[row], target,
+                              yuv->source->width, yuv->y_channel);
+  return SUCCESS;
+}
+
+/******************************************************************************/
+
+result integral_image_update_from_yuv422
 (
   integral_image *target,
-  pixel_image *source
+  const pixel_image *source,
+  uint32 y_channel
 )
 {
   TRY();
+  pixel_image *grey;
+  yuv422_row_params params;
 
   CHECK_POINTER(target);
+  CHECK_POINTER(target->original);
   CHECK_POINTER(source);
   CHECK_POINTER(source->data);
   CHECK_PARAM(source->type == p_U8);
+  CHECK_PARAM(source->step == 2);
+  CHECK_PARAM(source->format == UYVY);
+  CHECK_PARAM(source->offset == 0);
+  CHECK_PARAM(y_channel < 2);
+  grey = target->original;
+  CHECK_PARAM(grey->format == GREY);
+  CHECK_PARAM(source->width == grey->width);
+  CHECK_PARAM(source->height == grey->height);
+
+  params.source = source;
+  params.y_channel = y_channel;
+  CHECK(integral_image_update_from_reader(target, &yuv422_row_reader,
+                                          &params));
+
+  FINALLY(integral_image_update_from_yuv422);
+  RETURN();
+}
 
-  target->original = source;
-  target->width = source->width;
-  target->height = source->height;
-  target->step = source->step;
-  target->I_1.data = NULL;
-  target->I_2.data = NULL;
-
-  /* integral image requires one extra row and column at top and left side */
-  target->stride = (target->width + 1) * target->step;
+/******************************************************************************/
+/* calculates the tilted integrals from the finished regular integrals, used  */
+/* after updating the regular integrals in parallel strips                    */
 
-  CHECK(pixel_image_create(&target->I_1, p_SI_1, source->format,
-        target->width+1, target->height+1, target->step, target->stride));
+result integral_image_update_tilted
+(
+  integral_image *target
+)
+{
+  TRY();
+  integral_value *tilted_state;
+  uint32 y;
 
-  CHECK(pixel_image_create(&target->I_2, p_SI_2, source->format,
-        target->width+1, target->height+1, target->step, target->stride));
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->T_1.data);
+  CHECK_POINTER(target->temp_tilted.data);
 
-  init_tables();
+  CHECK(pixel_image_clear(&target->temp_tilted));
+  tilted_state = (integral_value *)target->temp_tilted.data;
+  for (y = 0; y < target->height; y++) {
+    integral_image_update_tilted_row(target, y, tilted_state);
+  }
 
-  FINALLY(integral_image_create);
+  FINALLY(integral_image_update_tilted);
   RETURN();
 }
 
 /******************************************************************************/
 
-void small_integral_image_update_channel
+result integral_image_enable_tilted
 (
-  integral_image *target,
-  uint32 channel
+  integral_image *target
 )
 {
-  pixel_image *source;
+  TRY();
 
-  source = target->original;
-  {
-    INTEGRAL_IMAGE_UPDATE_DEFINE_VARIABLES(SI_1_t, SI_2_t);
-    uint32 intensity, width, height, x, y, h, v, d;
-    SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(source, byte);
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->original);
+  CHECK_PARAM(target->storage == i_REAL);
+  CHECK_PARAM(target->layout == l_SEPARATE);
+  CHECK_PARAM(target->original->step == 1);
+
+  if (target->T_1.data == NULL) {
+    CHECK(pixel_image_create(&target->T_1, p_I, GREY, target->width + 2,
+                             target->height + 1, 1, target->width + 2));
+    CHECK(pixel_image_create(&target->T_2, p_I, GREY, target->width + 2,
+                             target->height + 1, 1, target->width + 2));
+    /* the rows of the tilted update state, allocated once for all updates */
+    CHECK(pixel_image_create(&target->temp_tilted, p_I, GREY,
+                             target->width + 1, 4, 1, target->width + 1));
+  }
 
-    width = target->width;
-    height = target->height;
-    I_1_data = (SI_1_t *)target->I_1.data;
-    I_2_data = (SI_2_t *)target->I_2.data;
+  FINALLY(integral_image_enable_tilted);
+  RETURN();
+}
 
-    /* horizontal offset for integral images */
-    h = target->step;
-    /* vertical offset for integral images */
-    v = target->stride;
-    /* diagonal offset for integral images */
-    d = target->stride + target->step;
+/******************************************************************************/
 
-    /* initialize rest of integral images */
-    /* add value of this pixel and integrals from top and left */
-    /* subtract integral from top left diagonal */
-    {
-      INTEGRAL_IMAGE_SET_POS(d + channel);
-      for (y = 0; y < height; y++) {
-        for (x = width, source_pos = source_rows[y] + channel; x--; source_pos += source_step) {
-          intensity = PIXEL_VALUE(source);
-          I_1_SET_VALUE((I_1_GET_VALUE_WITH_OFFSET(v) -
-                         I_1_GET_VALUE_WITH_OFFSET(d)) +
-                         I_1_GET_VALUE_WITH_OFFSET(h) +
-                         intensity);
-          I_2_SET_VALUE((I_2_GET_VALUE_WITH_OFFSET(v) -
-                         I_2_GET_VALUE_WITH_OFFSET(d)) +
-                         I_2_GET_VALUE_WITH_OFFSET(h) +
-                         small_pixel_squared[intensity]);
-          INTEGRAL_IMAGE_ADVANCE_POS(h);
-        }
-        /* skip one col from the beginning of next row */
-        INTEGRAL_IMAGE_ADVANCE_POS(h);
-      }
+/*
+Notes:
+-x and y are signed to allow creating regions around any pixel (cx - r, cy - r)
+-top left corner of rectangle is in reality one pixel right and up from the
+coordinates of the top left corner of the image region; but since an empty
+row and column is added to top and left, the coordinates are handled
+automatically correctly, and the real width and height of the rectangle can be
+used for dx and dy, there is no need to subtract 1
+-this takes into account multi-channel images
+*/
+
+/* reduces the rectangle to fit in the image, returns FALSE if it is outside */
+
+truth_value integral_image_clip_rect
+(
+  uint32 width,
+  uint32 height,
+  sint32 *x,
+  sint32 *y,
+  sint32 *dx,
+  sint32 *dy
+)
+{
+  if (*x < 0) {
+    *dx = *dx + *x;
+    *x = 0;
+  }
+  if (*y < 0) {
+    *dy = *dy + *y;
+    *y = 0;
+  }
+  if ((unsigned)*x < width && (unsigned)*y < height) {
+    if (*dx > 0 && *dy > 0) {
+      if (((unsigned)(*x + *dx)) > width) *dx = ((signed)width) - *x;
+      if (((unsigned)(*y + *dy)) > height) *dy = ((signed)height) - *y;
+      return TRUE;
     }
   }
+  return FALSE;
 }
 
 /******************************************************************************/
 
-result small_integral_image_update
+image_rect integral_image_create_rect
 (
-  integral_image *target
+  integral_image *target,
+  sint32 x,
+  sint32 y,
+  sint32 dx,
+  sint32 dy,
+  uint32 offset
 )
 {
-  TRY();
-  uint32 i;
+  image_rect irect;
+  register uint32 step, stride;
 
-  CHECK_POINTER(target);
-  CHECK_POINTER(target->original);
-  CHECK_POINTER(target->I_1.data);
-  CHECK_POINTER(target->I_2.data);
-  CHECK_PARAM(target->I_1.type == p_SI_1);
-  CHECK_PARAM(target->I_2.type == p_SI_2);
+  irect.valid = 0;
+  if (IS_TRUE(integral_image_clip_rect(target->width, target->height,
+                                       &x, &y, &dx, &dy))) {
+    step = target->step;
+    stride = target->stride;
+    /* with interleaved layout each channel takes two values */
+    if (target->layout == l_INTERLEAVED) {
+      offset = 2 * offset;
+    }
+    irect.valid = 1;
+    irect.offset = ((unsigned)y) * stride + ((unsigned)x) * step + offset;
+    irect.hstep = ((unsigned)dx) * step;
+    irect.vstep = ((unsigned)dy) * stride;
+    irect.N = ((unsigned)dx) * ((unsigned)dy);
+  }
 
-  /* set the image content to 0's */
-  /* the first row and column must contain only 0's */
-  /* otherwise the algorithm doesn't work correctly */
-  CHECK(pixel_image_clear(&target->I_1));
-  CHECK(pixel_image_clear(&target->I_2));
+  return irect;
+}
 
-  for (i = 0; i < target->original->step; i++) {
-    small_integral_image_update_channel(target, i);
+/******************************************************************************/
+/* private macro for calculating the sum within a valid rectangle from an     */
+/* integral with the given value type; integer sums are calculated in the     */
+/* integer type, as wrapping around in the subtractions cancels out exactly   */
+
+#define INTEGRAL_IMAGE_RECT_SUM(type, I, irect)\
+  ((integral_value)(*(((type *)(I).data) + (irect).offset + (irect).vstep +\
+                      (irect).hstep) +\
+                    *(((type *)(I).data) + (irect).offset) -\
+                    *(((type *)(I).data) + (irect).offset + (irect).hstep) -\
+                    *(((type *)(I).data) + (irect).offset + (irect).vstep)))
+
+/******************************************************************************/
+/* private functions for reading tiled integrals; the full integral is the    */
+/* sum of the tile-relative value, the full integrals at the top of the tile  */
+/* and at the left of the tile, minus their common corner                     */
+
+integral_value tiled_integral_image_value
+(
+  integral_image *target,
+  pixel_image *L,
+  pixel_image *R,
+  pixel_image *C,
+  uint32 pos
+)
+{
+  uint32 y, row_pos, x, c, tile_y, tile_x;
+
+  y = pos / target->stride;
+  row_pos = pos - y * target->stride;
+  x = row_pos / target->step;
+  c = row_pos - x * target->step;
+  tile_y = (y / INTEGRAL_IMAGE_TILE_SIZE) * target->stride;
+  tile_x = (x / INTEGRAL_IMAGE_TILE_SIZE) * target->step;
+  return (integral_value)((TI_t *)L->data)[pos] +
+         ((integral_value *)R->data)[tile_y + row_pos] +
+         ((integral_value *)C->data)[y * C->stride + tile_x + c] -
+         ((integral_value *)R->data)[tile_y + tile_x *
+                                     INTEGRAL_IMAGE_TILE_SIZE + c];
+}
+
+integral_value tiled_integral_image_rect_sum
+(
+  integral_image *target,
+  pixel_image *L,
+  pixel_image *R,
+  pixel_image *C,
+  image_rect *irect
+)
+{
+  TI_t *L_data;
+  uint32 x1, y1, x2, y2;
+
+  y1 = irect->offset / target->stride;
+  x1 = (irect->offset - y1 * target->stride) / target->step;
+  y2 = y1 + irect->vstep / target->stride;
+  x2 = x1 + irect->hstep / target->step;
+  /* within one tile the border terms cancel out */
+  if (x1 / INTEGRAL_IMAGE_TILE_SIZE == x2 / INTEGRAL_IMAGE_TILE_SIZE &&
+      y1 / INTEGRAL_IMAGE_TILE_SIZE == y2 / INTEGRAL_IMAGE_TILE_SIZE) {
+    L_data = (TI_t *)L->data + irect->offset;
+    return (integral_value)L_data[irect->vstep + irect->hstep] +
+           (integral_value)L_data[0] -
+           (integral_value)L_data[irect->hstep] -
+           (integral_value)L_data[irect->vstep];
   }
+  return tiled_integral_image_value(target, L, R, C, irect->offset +
+                                    irect->vstep + irect->hstep) +
+         tiled_integral_image_value(target, L, R, C, irect->offset) -
+         tiled_integral_image_value(target, L, R, C, irect->offset +
+                                    irect->hstep) -
+         tiled_integral_image_value(target, L, R, C, irect->offset +
+                                    irect->vstep);
+}
 
-  FINALLY(small_integral_image_update);
+/******************************************************************************/
+
+integral_value integral_image_get_value_1
+(
+  integral_image *target,
+  uint32 pos
+)
+{
+  if (target->storage == i_TILED) {
+    return tiled_integral_image_value(target, &target->I_1,
+                                      &target->tile_rows_1,
+                                      &target->tile_cols_1, pos);
+  }
+  return cast_pixel_value(target->I_1.data, target->I_1.type, pos);
+}
+
+integral_value integral_image_get_value_2
+(
+  integral_image *target,
+  uint32 pos
+)
+{
+  if (target->storage == i_TILED) {
+    return tiled_integral_image_value(target, &target->I_2,
+                                      &target->tile_rows_2,
+                                      &target->tile_cols_2, pos);
+  }
+  return cast_pixel_value(target->I_2.data, target->I_2.type, pos);
+}
+
+/******************************************************************************/
+
+integral_value integral_image_calculate_sum_1
+(
+  integral_image *target,
+  image_rect *irect
+)
+{
+  switch (target->storage) {
+  case i_EXACT:
+    return INTEGRAL_IMAGE_RECT_SUM(EI_1_t, target->I_1, *irect);
+  case i_SMALL:
+    return INTEGRAL_IMAGE_RECT_SUM(SI_1_t, target->I_1, *irect);
+  case i_TILED:
+    return tiled_integral_image_rect_sum(target, &target->I_1,
+                                         &target->tile_rows_1,
+                                         &target->tile_cols_1, irect);
+  default:
+    return INTEGRAL_IMAGE_RECT_SUM(integral_value, target->I_1, *irect);
+  }
+}
+
+integral_value integral_image_calculate_sum_2
+(
+  integral_image *target,
+  image_rect *irect
+)
+{
+  switch (target->storage) {
+  case i_EXACT:
+    return INTEGRAL_IMAGE_RECT_SUM(EI_2_t, target->I_2, *irect);
+  case i_SMALL:
+    return INTEGRAL_IMAGE_RECT_SUM(SI_2_t, target->I_2, *irect);
+  case i_TILED:
+    return tiled_integral_image_rect_sum(target, &target->I_2,
+                                         &target->tile_rows_2,
+                                         &target->tile_cols_2, irect);
+  default:
+    return INTEGRAL_IMAGE_RECT_SUM(integral_value, target->I_2, *irect);
+  }
+}
+
+/******************************************************************************/
+
+integral_value integral_image_calculate_mean
+(
+  integral_image *target,
+  sint32 x,
+  sint32 y,
+  sint32 dx,
+  sint32 dy,
+  uint32 offset
+)
+{
+  image_rect irect;
+  integral_value sum;
+
+  irect = integral_image_create_rect(target, x, y, dx, dy, offset);
+  if (irect.valid == 0) {
+    return 0;
+  }
+  else {
+    sum = integral_image_calculate_sum_1(target, &irect);
+    return sum / ((integral_value)irect.N);
+  }
+}
+
+/******************************************************************************/
+
+integral_value integral_image_calculate_variance
+(
+  integral_image *target,
+  sint32 x,
+  sint32 y,
+  sint32 dx,
+  sint32 dy,
+  uint32 offset
+)
+{
+  image_rect irect;
+  integral_value mean, sum2, var;
+
+  irect = integral_image_create_rect(target, x, y, dx, dy, offset);
+  if (irect.valid == 0) {
+    return 0;
+  }
+  else {
+    mean = integral_image_calculate_sum_1(target, &irect) / ((integral_value)irect.N);
+    sum2 = integral_image_calculate_sum_2(target, &irect);
+    var = (sum2 / ((integral_value)irect.N)) - mean*mean;
+    if (var < 0) var = 0;
+    return var;
+  }
+}
+
+/******************************************************************************/
+
+void integral_image_calculate_statistics
+(
+  integral_image *target,
+  statistics *stat,
+  sint32 x,
+  sint32 y,
+  sint32 dx,
+  sint32 dy,
+  uint32 offset
+)
+{
+  image_rect irect;
+  integral_value N, sum, sum2, mean, var;
+
+  statistics_init(stat);
+  irect = integral_image_create_rect(target, x, y, dx, dy, offset);
+  if (irect.valid == 0) {
+    return;
+  }
+  else {
+    N = ((integral_value)irect.N);
+    sum = integral_image_calculate_sum_1(target, &irect);
+    sum2 = integral_image_calculate_sum_2(target, &irect);
+    mean = sum / N;
+    var = (sum2 / N) - mean*mean;
+    if (var < 0) var = 0;
+    stat->N = N;
+    stat->sum = sum;
+    stat->sum2 = sum2;
+    stat->mean = mean;
+    stat->variance = var;
+    stat->deviation = sqrt(var);
+    return;
+  }
+}
+
+/******************************************************************************/
+
+result integral_image_update_higher_order
+(
+  integral_image *target
+)
+{
+  TRY();
+  pixel_image *source;
+  integral_value *I_3_row, *I_4_row, sum3, sum4;
+  byte *source_row;
+  uint32 x, y, c, channels, step, stride, pos;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->original);
+
+  /* the integrals are packed, without the padding or the interleaving of */
+  /* I_1, so they only take the memory they need                          */
+  source = target->original;
+  channels = source->step;
+  if (target->I_3.data == NULL) {
+    CHECK(pixel_image_create(&target->I_3, p_I, source->format,
+            target->width+1, target->height+1, channels,
+            channels * (target->width+1)));
+    CHECK(pixel_image_create(&target->I_4, p_I, source->format,
+            target->width+1, target->height+1, channels,
+            channels * (target->width+1)));
+  }
+
+  step = target->I_3.step;
+  stride = target->I_3.stride;
+  CHECK(memory_clear((data_pointer)target->I_3.data, stride,
+                     sizeof(integral_value)));
+  CHECK(memory_clear((data_pointer)target->I_4.data, stride,
+                     sizeof(integral_value)));
+  for (y = 0; y < target->height; y++) {
+    source_row = (byte *)source->rows[y];
+    I_3_row = (integral_value *)target->I_3.data + (y + 1) * stride;
+    I_4_row = (integral_value *)target->I_4.data + (y + 1) * stride;
+    for (c = 0; c < channels; c++) {
+      pos = c;
+      I_3_row[pos] = 0;
+      I_4_row[pos] = 0;
+      sum3 = 0;
+      sum4 = 0;
+      for (x = 0; x < target->width; x++) {
+        sum3 += pixel_cubed[source_row[x * channels + c]];
+        sum4 += pixel_fourth[source_row[x * channels + c]];
+        pos += step;
+        I_3_row[pos] = I_3_row[pos - stride] + sum3;
+        I_4_row[pos] = I_4_row[pos - stride] + sum4;
+      }
+    }
+  }
+  target->higher_order_updated = TRUE;
+
+  FINALLY(integral_image_update_higher_order);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_image_calculate_higher_statistics
+(
+  integral_image *target,
+  statistics *stat,
+  integral_value *skewness,
+  integral_value *kurtosis,
+  sint32 x,
+  sint32 y,
+  sint32 width,
+  sint32 height,
+  uint32 offset
+)
+{
+  TRY();
+  image_rect irect;
+  integral_value N, mean, var, sum3, sum4, m3, m4;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(stat);
+  CHECK_POINTER(skewness);
+  CHECK_POINTER(kurtosis);
+
+  if (IS_FALSE(target->higher_order_updated)) {
+    CHECK(integral_image_update_higher_order(target));
+  }
+
+  *skewness = 0;
+  *kurtosis = 0;
+  integral_image_calculate_statistics(target, stat, x, y, width, height,
+                                      offset);
+  irect = integral_image_create_rect(target, x, y, width, height, offset);
+  if (irect.valid != 0) {
+    N = stat->N;
+    mean = stat->mean;
+    var = stat->variance;
+    /* the higher order integrals are packed, so the rect is converted */
+    irect.offset = (irect.offset / target->stride) * target->I_3.stride +
+        ((irect.offset % target->stride) / target->step) * target->I_3.step +
+        offset;
+    irect.hstep = (irect.hstep / target->step) * target->I_3.step;
+    irect.vstep = (irect.vstep / target->stride) * target->I_3.stride;
+    sum3 = INTEGRAL_IMAGE_RECT_SUM(integral_value, target->I_3, irect);
+    sum4 = INTEGRAL_IMAGE_RECT_SUM(integral_value, target->I_4, irect);
+    /* central moments from the raw moments */
+    m3 = sum3 / N - 3 * mean * (stat->sum2 / N) + 2 * mean * mean * mean;
+    m4 = sum4 / N - 4 * mean * (sum3 / N) + 6 * mean * mean * (stat->sum2 / N)
+       - 3 * mean * mean * mean * mean;
+    if (var > 0) {
+      *skewness = m3 / (var * stat->deviation);
+      *kurtosis = m4 / (var * var);
+    }
+#ifdef INTEGRAL_IMAGE_HIGHER_ORDER_STATISTICS
+    stat->sum3 = sum3;
+    stat->sum4 = sum4;
+    stat->skewness = *skewness;
+    stat->kurtosis = *kurtosis;
+#endif
+  }
+
+  FINALLY(integral_image_calculate_higher_statistics);
+  RETURN();
+}
+
+/******************************************************************************/
+/* value of the tilted integral at (x,y), where x may be -1..width and y may */
+/* be -1..height-1                                                            */
+
+#define TILTED_VALUE(T, x, y) \
+  ((integral_value *)(T).data)[((y) + 1) * (sint32)(T).stride + (x) + 1]
+
+result integral_image_calculate_tilted_statistics
+(
+  integral_image *target,
+  statistics *stat,
+  sint32 x,
+  sint32 y,
+  sint32 w,
+  sint32 h
+)
+{
+  TRY();
+  integral_value N, sum, sum2, mean, var;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(stat);
+
+  statistics_init(stat);
+  stat->N = 0;
+  stat->sum = 0;
+  stat->sum2 = 0;
+  CHECK_POINTER(target->T_1.data);
+  CHECK_POINTER(target->T_2.data);
+
+  if (w >= 1 && h >= 1 && x - h + 1 >= 0 &&
+      x + w <= (sint32)target->width && y >= 0 &&
+      y + w + h <= (sint32)target->height) {
+    /* the rectangle is the difference of four triangles */
+    N = (integral_value)(2 * w * h);
+    sum = TILTED_VALUE(target->T_1, x - h + w, y + w + h - 1)
+        + TILTED_VALUE(target->T_1, x, y - 1)
+        - TILTED_VALUE(target->T_1, x - h, y + h - 1)
+        - TILTED_VALUE(target->T_1, x + w, y + w - 1);
+    sum2 = TILTED_VALUE(target->T_2, x - h + w, y + w + h - 1)
+         + TILTED_VALUE(target->T_2, x, y - 1)
+         - TILTED_VALUE(target->T_2, x - h, y + h - 1)
+         - TILTED_VALUE(target->T_2, x + w, y + w - 1);
+    mean = sum / N;
+    var = (sum2 / N) - mean*mean;
+    if (var < 0) var = 0;
+    stat->N = N;
+    stat->sum = sum;
+    stat->sum2 = sum2;
+    stat->mean = mean;
+    stat->variance = var;
+    stat->deviation = sqrt(var);
+  }
+
+  FINALLY(integral_image_calculate_tilted_statistics);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_box_batch_create
+(
+  integral_box_batch *target,
+  uint32 capacity
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+  CHECK_PARAM(capacity > 0);
+
+  CHECK(integral_box_batch_nullify(target));
+  /* the arrays of each type are allocated as one block */
+  CHECK(memory_allocate((data_pointer *)&target->x, 4 * capacity,
+                        sizeof(sint32)));
+  CHECK(memory_allocate((data_pointer *)&target->N, 6 * capacity,
+                        sizeof(integral_value)));
+  target->y = target->x + capacity;
+  target->dx = target->y + capacity;
+  target->dy = target->dx + capacity;
+  target->sum = target->N + capacity;
+  target->sum2 = target->sum + capacity;
+  target->mean = target->sum2 + capacity;
+  target->variance = target->mean + capacity;
+  target->deviation = target->variance + capacity;
+  target->capacity = capacity;
+
+  FINALLY(integral_box_batch_create);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_box_batch_destroy
+(
+  integral_box_batch *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  CHECK(memory_deallocate((data_pointer *)&target->x));
+  CHECK(memory_deallocate((data_pointer *)&target->N));
+  CHECK(integral_box_batch_nullify(target));
+
+  FINALLY(integral_box_batch_destroy);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_box_batch_nullify
+(
+  integral_box_batch *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  target->count = 0;
+  target->capacity = 0;
+  target->x = NULL;
+  target->y = NULL;
+  target->dx = NULL;
+  target->dy = NULL;
+  target->N = NULL;
+  target->sum = NULL;
+  target->sum2 = NULL;
+  target->mean = NULL;
+  target->variance = NULL;
+  target->deviation = NULL;
+
+  FINALLY(integral_box_batch_nullify);
+  RETURN();
+}
+
+/******************************************************************************/
+/* private functions for calculating the mean, variance and deviation from    */
+/* the sums of a batch; invalid rectangles with N = 0 get 0 for all values    */
+
+typedef void (*integral_image_batch_function)
+(
+  const integral_value *N,
+  const integral_value *sum,
+  const integral_value *sum2,
+  integral_value *mean,
+  integral_value *variance,
+  integral_value *deviation,
+  uint32 count
+);
+
+void integral_image_batch_scalar
+(
+  const integral_value *N,
+  const integral_value *sum,
+  const integral_value *sum2,
+  integral_value *mean,
+  integral_value *variance,
+  integral_value *deviation,
+  uint32 count
+)
+{
+  integral_value m, var;
+  uint32 i;
+
+  for (i = 0; i < count; i++) {
+    if (N[i] > 0) {
+      m = sum[i] / N[i];
+      var = (sum2[i] / N[i]) - m*m;
+      if (var < 0) var = 0;
+      mean[i] = m;
+      variance[i] = var;
+      deviation[i] = sqrt(var);
+    }
+    else {
+      mean[i] = 0;
+      variance[i] = 0;
+      deviation[i] = 0;
+    }
+  }
+}
+
+#ifdef INTEGRAL_IMAGE_SIMD_ROWS
+
+/* invalid rectangles are divided by 1 and masked to 0 afterwards */
+
+SIMD_TARGET_SSE2
+void integral_image_batch_sse2
+(
+  const real64 *N,
+  const real64 *sum,
+  const real64 *sum2,
+  real64 *mean,
+  real64 *variance,
+  real64 *deviation,
+  uint32 count
+)
+{
+  __m128d one, zero, n, valid, m, var;
+  uint32 i;
+
+  one = _mm_set1_pd(1.0);
+  zero = _mm_setzero_pd();
+  for (i = 0; i + 2 <= count; i += 2) {
+    n = _mm_loadu_pd(N + i);
+    valid = _mm_cmpgt_pd(n, zero);
+    n = _mm_max_pd(n, one);
+    m = _mm_div_pd(_mm_loadu_pd(sum + i), n);
+    var = _mm_sub_pd(_mm_div_pd(_mm_loadu_pd(sum2 + i), n), _mm_mul_pd(m, m));
+    var = _mm_and_pd(_mm_max_pd(var, zero), valid);
+    _mm_storeu_pd(mean + i, _mm_and_pd(m, valid));
+    _mm_storeu_pd(variance + i, var);
+    _mm_storeu_pd(deviation + i, _mm_sqrt_pd(var));
+  }
+  integral_image_batch_scalar(N + i, sum + i, sum2 + i, mean + i,
+                              variance + i, deviation + i, count - i);
+}
+
+SIMD_TARGET_AVX2
+void integral_image_batch_avx2
+(
+  const real64 *N,
+  const real64 *sum,
+  const real64 *sum2,
+  real64 *mean,
+  real64 *variance,
+  real64 *deviation,
+  uint32 count
+)
+{
+  __m256d one, zero, n, valid, m, var;
+  uint32 i;
+
+  one = _mm256_set1_pd(1.0);
+  zero = _mm256_setzero_pd();
+  for (i = 0; i + 4 <= count; i += 4) {
+    n = _mm256_loadu_pd(N + i);
+    valid = _mm256_cmp_pd(n, zero, _CMP_GT_OQ);
+    n = _mm256_max_pd(n, one);
+    m = _mm256_div_pd(_mm256_loadu_pd(sum + i), n);
+    var = _mm256_sub_pd(_mm256_div_pd(_mm256_loadu_pd(sum2 + i), n),
+                        _mm256_mul_pd(m, m));
+    var = _mm256_and_pd(_mm256_max_pd(var, zero), valid);
+    _mm256_storeu_pd(mean + i, _mm256_and_pd(m, valid));
+    _mm256_storeu_pd(variance + i, var);
+    _mm256_storeu_pd(deviation + i, _mm256_sqrt_pd(var));
+  }
+  integral_image_batch_scalar(N + i, sum + i, sum2 + i, mean + i,
+                              variance + i, deviation + i, count - i);
+}
+
+#endif /* INTEGRAL_IMAGE_SIMD_ROWS */
+
+integral_image_batch_function integral_image_get_batch_function()
+{
+#ifdef INTEGRAL_IMAGE_SIMD_ROWS
+  switch (simd_get_level()) {
+  case s_AVX2:
+    return &integral_image_batch_avx2;
+  case s_SSE2:
+    return &integral_image_batch_sse2;
+  default:
+    break;
+  }
+#endif
+  return &integral_image_batch_scalar;
+}
+
+/******************************************************************************/
+
+result integral_image_calculate_batch
+(
+  integral_image *source,
+  integral_box_batch *batch,
+  uint32 offset
+)
+{
+  TRY();
+  integral_value *I_1_data, *I_2_data, *iA, *i2A;
+  image_rect irect;
+  sint32 x, y, dx, dy, width, height;
+  uint32 i, step, stride, hstep, vstep, dstep;
+
+  CHECK_POINTER(source);
+  CHECK_POINTER(batch);
+  CHECK_PARAM(batch->count == 0 || batch->x != NULL);
+
+  width = (signed)source->width;
+  height = (signed)source->height;
+  step = source->step;
+  stride = source->stride;
+  I_1_data = (integral_value *)source->I_1.data;
+  I_2_data = (integral_value *)source->I_2.data;
+  /* with interleaved layout each channel takes two values */
+  if (source->layout == l_INTERLEAVED) {
+    I_1_data += 2 * offset;
+    I_2_data += 2 * offset;
+  }
+  else {
+    I_1_data += offset;
+    I_2_data += offset;
+  }
+
+  /* first calculate the sums; rectangles within the image don't need to be */
+  /* clipped, and with real storage the values are read directly */
+  for (i = 0; i < batch->count; i++) {
+    x = batch->x[i];
+    y = batch->y[i];
+    dx = batch->dx[i];
+    dy = batch->dy[i];
+    if (source->storage == i_REAL && x >= 0 && y >= 0 && dx > 0 && dy > 0 &&
+        x + dx <= width && y + dy <= height) {
+      hstep = ((unsigned)dx) * step;
+      vstep = ((unsigned)dy) * stride;
+      dstep = hstep + vstep;
+      iA = I_1_data + ((unsigned)y) * stride + ((unsigned)x) * step;
+      i2A = I_2_data + ((unsigned)y) * stride + ((unsigned)x) * step;
+      batch->N[i] = (integral_value)(((unsigned)dx) * ((unsigned)dy));
+      batch->sum[i] = *(iA + dstep) + *iA - *(iA + hstep) - *(iA + vstep);
+      batch->sum2[i] = *(i2A + dstep) + *i2A - *(i2A + hstep) - *(i2A + vstep);
+    }
+    else {
+      irect = integral_image_create_rect(source, x, y, dx, dy, offset);
+      if (irect.valid != 0) {
+        batch->N[i] = (integral_value)irect.N;
+        batch->sum[i] = integral_image_calculate_sum_1(source, &irect);
+        batch->sum2[i] = integral_image_calculate_sum_2(source, &irect);
+      }
+      else {
+        batch->N[i] = 0;
+        batch->sum[i] = 0;
+        batch->sum2[i] = 0;
+      }
+    }
+  }
+
+  /* then the rest of the statistics for the whole batch */
+  integral_image_get_batch_function()(batch->N, batch->sum, batch->sum2,
+                                      batch->mean, batch->variance,
+                                      batch->deviation, batch->count);
+
+  FINALLY(integral_image_calculate_batch);
+  RETURN();
+}
+
+/******************************************************************************/
+/* private functions for calculating the statistics of all windows of a row;  */
+/* in the columns where the window is not clipped horizontally, it just       */
+/* slides one step at a time, so the four corner pointers are advanced        */
+/* instead of creating a clipped rectangle for every pixel                    */
+
+typedef void (*integral_image_box_function)
+(
+  const integral_value *I_1_top,
+  const integral_value *I_1_bottom,
+  const integral_value *I_2_top,
+  const integral_value *I_2_bottom,
+  uint32 step,
+  uint32 hstep,
+  integral_value N,
+  integral_value *mean,
+  integral_value *dev,
+  uint32 count
+);
+
+void integral_image_box_scalar
+(
+  const integral_value *I_1_top,
+  const integral_value *I_1_bottom,
+  const integral_value *I_2_top,
+  const integral_value *I_2_bottom,
+  uint32 step,
+  uint32 hstep,
+  integral_value N,
+  integral_value *mean,
+  integral_value *dev,
+  uint32 count
+)
+{
+  integral_value sum, sum2, m, var;
+  uint32 i;
+
+  /* same order of operations as in integral_image_calculate_statistics */
+  for (i = 0; i < count; i++) {
+    sum = *(I_1_bottom + hstep) + *I_1_top - *(I_1_top + hstep) - *I_1_bottom;
+    sum2 = *(I_2_bottom + hstep) + *I_2_top - *(I_2_top + hstep) - *I_2_bottom;
+    m = sum / N;
+    var = (sum2 / N) - m*m;
+    if (var < 0) var = 0;
+    mean[i] = m;
+    dev[i] = sqrt(var);
+    I_1_top += step;
+    I_1_bottom += step;
+    I_2_top += step;
+    I_2_bottom += step;
+  }
+}
+
+#ifdef INTEGRAL_IMAGE_SIMD_ROWS
+
+/* division and square root are correctly rounded in both scalar and vector */
+/* instructions, so the vectorized kernels give identical results */
+
+SIMD_TARGET_SSE2
+void integral_image_box_sse2
+(
+  const real64 *I_1_top,
+  const real64 *I_1_bottom,
+  const real64 *I_2_top,
+  const real64 *I_2_bottom,
+  uint32 step,
+  uint32 hstep,
+  real64 N,
+  real64 *mean,
+  real64 *dev,
+  uint32 count
+)
+{
+  __m128d n, zero, sum, sum2, m, var;
+  uint32 i;
+
+  /* only separate integrals of single-channel images are handled */
+  (void)step;
+  n = _mm_set1_pd(N);
+  zero = _mm_setzero_pd();
+  for (i = 0; i + 2 <= count; i += 2) {
+    sum = _mm_sub_pd(_mm_sub_pd(_mm_add_pd(_mm_loadu_pd(I_1_bottom + hstep + i),
+                                           _mm_loadu_pd(I_1_top + i)),
+                                _mm_loadu_pd(I_1_top + hstep + i)),
+                     _mm_loadu_pd(I_1_bottom + i));
+    sum2 = _mm_sub_pd(_mm_sub_pd(_mm_add_pd(_mm_loadu_pd(I_2_bottom + hstep + i),
+                                            _mm_loadu_pd(I_2_top + i)),
+                                 _mm_loadu_pd(I_2_top + hstep + i)),
+                      _mm_loadu_pd(I_2_bottom + i));
+    m = _mm_div_pd(sum, n);
+    var = _mm_sub_pd(_mm_div_pd(sum2, n), _mm_mul_pd(m, m));
+    var = _mm_max_pd(var, zero);
+    _mm_storeu_pd(mean + i, m);
+    _mm_storeu_pd(dev + i, _mm_sqrt_pd(var));
+  }
+  integral_image_box_scalar(I_1_top + i, I_1_bottom + i, I_2_top + i,
+                            I_2_bottom + i, 1, hstep, N, mean + i, dev + i,
+                            count - i);
+}
+
+SIMD_TARGET_AVX2
+void integral_image_box_avx2
+(
+  const real64 *I_1_top,
+  const real64 *I_1_bottom,
+  const real64 *I_2_top,
+  const real64 *I_2_bottom,
+  uint32 step,
+  uint32 hstep,
+  real64 N,
+  real64 *mean,
+  real64 *dev,
+  uint32 count
+)
+{
+  __m256d n, zero, sum, sum2, m, var;
+  uint32 i;
+
+  (void)step;
+  n = _mm256_set1_pd(N);
+  zero = _mm256_setzero_pd();
+  for (i = 0; i + 4 <= count; i += 4) {
+    sum = _mm256_sub_pd(_mm256_sub_pd(_mm256_add_pd(
+                          _mm256_loadu_pd(I_1_bottom + hstep + i),
+                          _mm256_loadu_pd(I_1_top + i)),
+                        _mm256_loadu_pd(I_1_top + hstep + i)),
+                        _mm256_loadu_pd(I_1_bottom + i));
+    sum2 = _mm256_sub_pd(_mm256_sub_pd(_mm256_add_pd(
+                           _mm256_loadu_pd(I_2_bottom + hstep + i),
+                           _mm256_loadu_pd(I_2_top + i)),
+                         _mm256_loadu_pd(I_2_top + hstep + i)),
+                         _mm256_loadu_pd(I_2_bottom + i));
+    m = _mm256_div_pd(sum, n);
+    var = _mm256_sub_pd(_mm256_div_pd(sum2, n), _mm256_mul_pd(m, m));
+    var = _mm256_max_pd(var, zero);
+    _mm256_storeu_pd(mean + i, m);
+    _mm256_storeu_pd(dev + i, _mm256_sqrt_pd(var));
+  }
+  integral_image_box_scalar(I_1_top + i, I_1_bottom + i, I_2_top + i,
+                            I_2_bottom + i, 1, hstep, N, mean + i, dev + i,
+                            count - i);
+}
+
+#endif /* INTEGRAL_IMAGE_SIMD_ROWS */
+
+integral_image_box_function integral_image_get_box_function
+(
+  uint32 step
+)
+{
+#ifdef INTEGRAL_IMAGE_SIMD_ROWS
+  if (step == 1) {
+    switch (simd_get_level()) {
+    case s_AVX2:
+      return &integral_image_box_avx2;
+    case s_SSE2:
+      return &integral_image_box_sse2;
+    default:
+      break;
+    }
+  }
+#else
+  (void)step;
+#endif
+  return &integral_image_box_scalar;
+}
+
+/******************************************************************************/
+/* calculates the mean and deviation of the windows of size 2*radius+1        */
+/* centered at each pixel of row y; clipped windows at the left and right     */
+/* border and integer storages use the general box query                      */
+
+void integral_image_calculate_row_statistics
+(
+  integral_image *source,
+  integral_image_box_function box,
+  sint32 y,
+  sint32 radius,
+  uint32 offset,
+  integral_value *mean,
+  integral_value *dev
+)
+{
+  image_rect irect;
+  statistics stat;
+  integral_value *I_1_top, *I_2_top;
+  sint32 x, width, size, first, last;
+
+  width = (signed)source->width;
+  size = 2 * radius + 1;
+  first = 0;
+  last = 0;
+  if (source->storage == i_REAL && radius >= 0 && width > 2 * radius) {
+    /* the window is clipped only vertically between first and last */
+    irect = integral_image_create_rect(source, 0, y - radius, size, size,
+                                       offset);
+    if (irect.valid != 0) {
+      first = radius;
+      last = width - radius;
+      I_1_top = (integral_value *)source->I_1.data + irect.offset;
+      I_2_top = (integral_value *)source->I_2.data + irect.offset;
+      box(I_1_top, I_1_top + irect.vstep, I_2_top, I_2_top + irect.vstep,
+          source->step, irect.hstep, (integral_value)irect.N, mean + first,
+          dev + first, (unsigned)(last - first));
+    }
+  }
+  for (x = 0; x < width; x++) {
+    if (x == first && first < last) {
+      x = last;
+      if (x >= width) break;
+    }
+    integral_image_calculate_statistics(source, &stat, x - radius, y - radius,
+                                        size, size, offset);
+    mean[x] = stat.mean;
+    dev[x] = stat.deviation;
+  }
+}
+
+/******************************************************************************/
+/* private functions for calculating the thresholds, shared by the in-memory  */
+/* and streaming versions so that both give identical results                 */
+
+byte integral_image_sauvola_threshold
+(
+  integral_value mean,
+  integral_value dev,
+  integral_value k,
+  integral_value R
+)
+{
+  return (byte)floor(mean * (1.0 + k * ((dev / R) - 1.0)));
+}
+
+byte integral_image_feng_threshold
+(
+  integral_value mean,
+  integral_value min,
+  integral_value dev1,
+  integral_value dev2
+)
+{
+  integral_value as, a1, a2, a3, k1, k2, g, asg;
+
+  g = 2;
+  a1 = 0.12;
+  k1 = 0.25;
+  k2 = 0.04;
+
+  as = dev1 / fmax(1,dev2);
+  asg = pow(as, g);
+  a2 = k1 * asg;
+  a3 = k2 * asg;
+  return (byte)floor((1 - a1) * mean + a2 * as * (mean - min) + a3 * min);
+}
+
+/******************************************************************************/
+
+/* the first source row of a strip, strip count may not exceed height */
+#define INTEGRAL_IMAGE_STRIP_FIRST(target, index, count)\
+  (((target)->height * (index)) / (count))
+
+/* parameters shared by the threshold strips; each strip writes only its own */
+/* rows of the target and its own rows of the buffers, so that the strips    */
+/* can be processed in parallel */
+typedef struct integral_image_threshold_t {
+  integral_image *source;
+  pixel_image *target;
+  integral_image_box_function box;
+  byte value1;
+  byte value2;
+  sint32 radius1;
+  sint32 radius2;
+  integral_value k;
+  integral_value R;
+  integral_value alpha;
+  truth_value calculate_max;
+  truth_value estimate_min;
+  /* maximum deviation found by each strip */
+  integral_value *dev_max;
+} integral_image_threshold;
+
+/* calculates the window statistics of all rows of the strip for finding */
+/* the maximum deviation; buffers contain the statistics of all rows */
+void integral_image_statistics_strip
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+)
+{
+  integral_image_threshold *threshold;
+  integral_image *source;
+  integral_value *mean_data, *dev_data, dev_max;
+  sint32 x, y, width, first, last;
+
+  threshold = (integral_image_threshold *)params;
+  source = threshold->source;
+  width = (signed)source->width;
+  first = (signed)INTEGRAL_IMAGE_STRIP_FIRST(source, index, count);
+  last = (signed)INTEGRAL_IMAGE_STRIP_FIRST(source, index + 1, count);
+
+  dev_max = 0;
+  for (y = first; y < last; y++) {
+    mean_data = (integral_value *)source->temp_mean.data + y * width;
+    dev_data = (integral_value *)source->temp_dev.data + y * width;
+    integral_image_calculate_row_statistics(source, threshold->box, y,
+                                            threshold->radius1,
+                                            threshold->target->offset,
+                                            mean_data, dev_data);
+    for (x = 0; x < width; x++) {
+      if (dev_data[x] > dev_max) dev_max = dev_data[x];
+    }
+  }
+  threshold->dev_max[index] = dev_max;
+}
+
+void integral_image_sauvola_strip
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+)
+{
+  integral_image_threshold *threshold;
+  integral_image *source;
+  byte *source_data, *target_data, t;
+  integral_value *mean_data, *dev_data;
+  sint32 x, y, width, step, stride, first, last, row, pos;
+
+  threshold = (integral_image_threshold *)params;
+  source = threshold->source;
+  width = (signed)source->width;
+  step = (signed)threshold->target->step;
+  stride = (signed)threshold->target->stride;
+  first = (signed)INTEGRAL_IMAGE_STRIP_FIRST(source, index, count);
+  last = (signed)INTEGRAL_IMAGE_STRIP_FIRST(source, index + 1, count);
+  source_data = (byte *)source->original->data;
+  target_data = (byte *)threshold->target->data;
+
+  for (y = first; y < last; y++) {
+    /* without the maximum each strip calculates one row at a time */
+    row = IS_TRUE(threshold->calculate_max) ? y * width :
+                                              ((signed)index) * width;
+    mean_data = (integral_value *)source->temp_mean.data + row;
+    dev_data = (integral_value *)source->temp_dev.data + row;
+    if (IS_FALSE(threshold->calculate_max)) {
+      integral_image_calculate_row_statistics(source, threshold->box, y,
+                                              threshold->radius1,
+                                              threshold->target->offset,
+                                              mean_data, dev_data);
+    }
+    pos = y * stride;
+    for (x = 0; x < width; x++, pos += step) {
+      t = integral_image_sauvola_threshold(mean_data[x], dev_data[x],
+                                           threshold->k, threshold->R);
+      if (source_data[pos] > t) {
+        target_data[pos] = threshold->value1;
+      }
+      else {
+        target_data[pos] = threshold->value2;
+      }
+    }
+  }
+}
+
+void integral_image_feng_strip
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+)
+{
+  integral_image_threshold *threshold;
+  integral_image *source;
+  byte *source_data, *target_data, t;
+  integral_value *mean_1, *dev_1, *mean_2, *dev_2, min, mean;
+  sint32 x, y, width, step, stride, first, last, radius1, size1, pos;
+  uint32 offset;
+
+  threshold = (integral_image_threshold *)params;
+  source = threshold->source;
+  width = (signed)source->width;
+  step = (signed)threshold->target->step;
+  stride = (signed)threshold->target->stride;
+  offset = threshold->target->offset;
+  first = (signed)INTEGRAL_IMAGE_STRIP_FIRST(source, index, count);
+  last = (signed)INTEGRAL_IMAGE_STRIP_FIRST(source, index + 1, count);
+  source_data = (byte *)source->original->data;
+  target_data = (byte *)threshold->target->data;
+  radius1 = threshold->radius1;
+  size1 = 2 * radius1 + 1;
+
+  /* each strip has two buffer rows, for the smaller and larger window */
+  mean_1 = (integral_value *)source->temp_mean.data +
+           2 * index * source->width;
+  dev_1 = (integral_value *)source->temp_dev.data + 2 * index * source->width;
+  mean_2 = mean_1 + source->width;
+  dev_2 = dev_1 + source->width;
+
+  for (y = first; y < last; y++) {
+    integral_image_calculate_row_statistics(source, threshold->box, y, radius1,
+                                            offset, mean_1, dev_1);
+    integral_image_calculate_row_statistics(source, threshold->box, y,
+                                            threshold->radius2, offset,
+                                            mean_2, dev_2);
+    pos = y * stride;
+    for (x = 0; x < width; x++, pos += step) {
+      mean = mean_1[x];
+      if (IS_TRUE(threshold->estimate_min)) {
+        min = fmax(0, mean - threshold->alpha * dev_1[x]);
+      }
+      else {
+        min = pixel_image_find_min_byte(source->original, x-radius1, y-radius1,
+                                        size1, size1, offset);
+      }
+      t = integral_image_feng_threshold(mean, min, dev_1[x], dev_2[x]);
+      if (source_data[pos] > t) {
+        target_data[pos] = threshold->value1;
+      }
+      else {
+        target_data[pos] = threshold->value2;
+      }
+    }
+  }
+}
+
+/******************************************************************************/
+
+result integral_image_threshold_sauvola
+(
+  integral_image *source,
+  pixel_image *target,
+  truth_value invert,
+  sint32 radius,
+  integral_value k,
+  truth_value calculate_max,
+  integral_value max,
+  truth_value use_mean
+)
+{
+  TRY();
+
+  CHECK(integral_image_threshold_sauvola_parallel(source, target, invert,
+                                                  radius, k, calculate_max,
+                                                  max, use_mean, 1));
+
+  FINALLY(integral_image_threshold_sauvola);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_image_threshold_feng
+(
+  integral_image *source,
+  pixel_image *target,
+  truth_value invert,
+  sint32 radius1,
+  integral_value multiplier,
+  truth_value estimate_min,
+  integral_value alpha
+)
+{
+  TRY();
+
+  CHECK(integral_image_threshold_feng_parallel(source, target, invert,
+                                               radius1, multiplier,
+                                               estimate_min, alpha, 1));
+
+  FINALLY(integral_image_threshold_feng);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_image_threshold_sauvola_parallel
+(
+  integral_image *source,
+  pixel_image *target,
+  truth_value invert,
+  sint32 radius,
+  integral_value k,
+  truth_value calculate_max,
+  integral_value max,
+  truth_value use_mean,
+  uint32 threads
+)
+{
+  TRY();
+  integral_image_threshold threshold;
+  integral_value *dev_data, dev_sum;
+  uint32 i, size;
+
+  threshold.dev_max = NULL;
+  CHECK_POINTER(source);
+  CHECK_POINTER(target);
+  CHECK_PARAM(source->original->type == p_U8);
+  CHECK_PARAM(threads > 0);
+
+  CHECK(pixel_image_clone(target, source->original));
+
+  /* each strip must contain at least one row */
+  if (threads > source->height) {
+    threads = source->height;
+  }
+
+  threshold.source = source;
+  threshold.target = target;
+  threshold.box = integral_image_get_box_function(source->step);
+  threshold.radius1 = radius;
+  threshold.k = k;
+  threshold.R = max;
+  threshold.calculate_max = calculate_max;
+  if (IS_TRUE(invert)) {
+    threshold.value1 = 0;
+    threshold.value2 = 255;
+  }
+  else {
+    threshold.value1 = 255;
+    threshold.value2 = 0;
+  }
+
+  /* the statistics of all rows are needed only for finding the maximum, */
+  /* otherwise each strip needs one row */
+  CHECK(integral_image_prepare_buffer(&source->temp_mean, source->width,
+                                      IS_TRUE(calculate_max) ? source->height :
+                                                               threads));
+  CHECK(integral_image_prepare_buffer(&source->temp_dev, source->width,
+                                      IS_TRUE(calculate_max) ? source->height :
+                                                               threads));
+
+  if (IS_TRUE(calculate_max)) {
+    CHECK(memory_allocate((data_pointer *)&threshold.dev_max, threads,
+                          sizeof(integral_value)));
+    CHECK(parallel_run(&integral_image_statistics_strip, &threshold, threads));
+    /* the maximum does not depend on the order, but the sum is calculated */
+    /* in row order so that the result is the same with any thread count */
+    if (IS_TRUE(use_mean)) {
+      dev_data = (integral_value *)source->temp_dev.data;
+      size = source->width * source->height;
+      dev_sum = 0;
+      for (i = 0; i < size; i++) {
+        dev_sum += dev_data[i];
+      }
+      threshold.R = dev_sum / ((integral_value)size);
+    }
+    else {
+      threshold.R = 0;
+      for (i = 0; i < threads; i++) {
+        if (threshold.dev_max[i] > threshold.R) {
+          threshold.R = threshold.dev_max[i];
+        }
+      }
+    }
+  }
+
+  CHECK(parallel_run(&integral_image_sauvola_strip, &threshold, threads));
+
+  FINALLY(integral_image_threshold_sauvola_parallel);
+  memory_deallocate((data_pointer *)&threshold.dev_max);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_image_threshold_feng_parallel
+(
+  integral_image *source,
+  pixel_image *target,
+  truth_value invert,
+  sint32 radius1,
+  integral_value multiplier,
+  truth_value estimate_min,
+  integral_value alpha,
+  uint32 threads
+)
+{
+  TRY();
+  integral_image_threshold threshold;
+
+  CHECK_POINTER(source);
+  CHECK_POINTER(target);
+  CHECK_PARAM(source->original->type == p_U8);
+  CHECK_PARAM(threads > 0);
+
+  CHECK(pixel_image_clone(target, source->original));
+
+  /* each strip must contain at least one row */
+  if (threads > source->height) {
+    threads = source->height;
+  }
+
+  threshold.source = source;
+  threshold.target = target;
+  threshold.box = integral_image_get_box_function(source->step);
+  threshold.radius1 = radius1;
+  threshold.radius2 = (sint32)(multiplier * ((integral_value)radius1));
+  threshold.estimate_min = estimate_min;
+  threshold.alpha = alpha;
+  threshold.dev_max = NULL;
+  if (IS_TRUE(invert)) {
+    threshold.value1 = 0;
+    threshold.value2 = 255;
+  }
+  else {
+    threshold.value1 = 255;
+    threshold.value2 = 0;
+  }
+
+  CHECK(integral_image_prepare_buffer(&source->temp_mean, source->width,
+                                      2 * threads));
+  CHECK(integral_image_prepare_buffer(&source->temp_dev, source->width,
+                                      2 * threads));
+
+  CHECK(parallel_run(&integral_image_feng_strip, &threshold, threads));
+
+  FINALLY(integral_image_threshold_feng_parallel);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result small_integral_image_create
+(
+  integral_image *target,
+  pixel_image *source
+)
+{
+  TRY();
+
+  CHECK(integral_image_create_with_storage(target, source, i_SMALL));
+
+  FINALLY(small_integral_image_create);
+  RETURN();
+}
+
+/******************************************************************************/
+
+void small_integral_image_update_channel
+(
+  integral_image *target,
+  uint32 channel
+)
+{
+  pixel_image *source;
+
+  source = target->original;
+  {
+    INTEGRAL_IMAGE_UPDATE_DEFINE_VARIABLES(SI_1_t, SI_2_t);
+    uint32 intensity, width, height, x, y, h, v, d;
+    SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(source, byte);
+
+    width = target->width;
+    height = target->height;
+    I_1_data = (SI_1_t *)target->I_1.data;
+    I_2_data = (SI_2_t *)target->I_2.data;
+
+    /* horizontal offset for integral images */
+    h = target->step;
+    /* vertical offset for integral images */
+    v = target->stride;
+    /* diagonal offset for integral images */
+    d = target->stride + target->step;
+
+    /* initialize rest of integral images */
+    /* add value of this pixel and integrals from top and left */
+    /* subtract integral from top left diagonal */
+    {
+      for (y = 0; y < height; y++) {
+        /* rows start after the first col, the stride may contain padding */
+        INTEGRAL_IMAGE_SET_POS(y * v + d + channel);
+        for (x = width, source_pos = source_rows[y] + channel; x--; source_pos += source_step) {
+          intensity = PIXEL_VALUE(source);
+          I_1_SET_VALUE((I_1_GET_VALUE_WITH_OFFSET(v) -
+                         I_1_GET_VALUE_WITH_OFFSET(d)) +
+                         I_1_GET_VALUE_WITH_OFFSET(h) +
+                         intensity);
+          I_2_SET_VALUE((I_2_GET_VALUE_WITH_OFFSET(v) -
+                         I_2_GET_VALUE_WITH_OFFSET(d)) +
+                         I_2_GET_VALUE_WITH_OFFSET(h) +
+                         small_pixel_squared[intensity]);
+          INTEGRAL_IMAGE_ADVANCE_POS(h);
+        }
+      }
+    }
+  }
+}
+
+/******************************************************************************/
+
+result small_integral_image_update
+(
+  integral_image *target
+)
+{
+  TRY();
+  uint32 i;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->original);
+  CHECK_POINTER(target->I_1.data);
+  CHECK_POINTER(target->I_2.data);
+  CHECK_PARAM(target->I_1.type == p_SI_1);
+  CHECK_PARAM(target->I_2.type == p_SI_2);
+
+  /* set the image content to 0's */
+  /* the first row and column must contain only 0's */
+  /* otherwise the algorithm doesn't work correctly */
+  CHECK(pixel_image_clear(&target->I_1));
+  CHECK(pixel_image_clear(&target->I_2));
+  target->higher_order_updated = FALSE;
+
+  for (i = 0; i < target->original->step; i++) {
+    small_integral_image_update_channel(target, i);
+  }
+
+  FINALLY(small_integral_image_update);
+  RETURN();
+}
+
+/******************************************************************************/
+/* private functions for calculating the integrals in horizontal strips       */
+
+typedef struct integral_image_strips_t {
+  integral_image *target;
+  integral_image_row_function update_row;
+} integral_image_strips;
+
+/* adds the carry row to the given integral row, rows are given as integral */
+/* row indices, so the first row of the integral is row 0                   */
+#define INTEGRAL_IMAGE_ADD_ROW(I_1_type, I_2_type)\
+  {\
+    I_1_type *I_1_row, *I_1_carry;\
+    I_2_type *I_2_row, *I_2_carry;\
+    I_1_row = ((I_1_type *)target->I_1.data) + row * target->stride;\
+    I_2_row = ((I_2_type *)target->I_2.data) + row * target->stride;\
+    I_1_carry = ((I_1_type *)target->I_1.data) + carry_row * target->stride;\
+    I_2_carry = ((I_2_type *)target->I_2.data) + carry_row * target->stride;\
+    for (x = target->step, x_end = target->stride; x < x_end; x++) {\
+      I_1_row[x] += I_1_carry[x];\
+      I_2_row[x] += I_2_carry[x];\
+    }\
+  }
+
+void integral_image_add_row
+(
+  integral_image *target,
+  uint32 row,
+  uint32 carry_row
+)
+{
+  uint32 x, x_end;
+
+  /* interleaved I_2 values are within the I_1 rows */
+  if (target->layout == l_INTERLEAVED) {
+    integral_value *I_row, *I_carry;
+    I_row = ((integral_value *)target->I_1.data) + row * target->stride;
+    I_carry = ((integral_value *)target->I_1.data) + carry_row * target->stride;
+    for (x = target->step, x_end = target->stride; x < x_end; x++) {
+      I_row[x] += I_carry[x];
+    }
+    return;
+  }
+
+  switch (target->storage) {
+  case i_EXACT:
+    INTEGRAL_IMAGE_ADD_ROW(EI_1_t, EI_2_t);
+    break;
+  case i_SMALL:
+    INTEGRAL_IMAGE_ADD_ROW(SI_1_t, SI_2_t);
+    break;
+  default:
+    INTEGRAL_IMAGE_ADD_ROW(integral_value, integral_value);
+  }
+}
+
+void integral_image_update_strip
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+)
+{
+  integral_image_strips *strips;
+  integral_image *target;
+  uint32 first, last;
+
+  strips = (integral_image_strips *)params;
+  target = strips->target;
+  first = INTEGRAL_IMAGE_STRIP_FIRST(target, index, count);
+  last = INTEGRAL_IMAGE_STRIP_FIRST(target, index + 1, count);
+
+  switch (target->storage) {
+  case i_EXACT:
+    exact_integral_image_update_rows(target, first, last);
+    break;
+  case i_SMALL:
+    small_integral_image_update_rows(target, first, last);
+    break;
+  default:
+    integral_image_update_rows(target, strips->update_row, first, last, NULL);
+  }
+}
+
+void integral_image_carry_strip
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+)
+{
+  integral_image *target;
+  uint32 first, last, row;
+
+  /* the first strip doesn't need a carry */
+  if (index == 0) {
+    return;
+  }
+  target = ((integral_image_strips *)params)->target;
+  first = INTEGRAL_IMAGE_STRIP_FIRST(target, index, count);
+  last = INTEGRAL_IMAGE_STRIP_FIRST(target, index + 1, count);
+
+  /* the last row of the strip has already been fixed, and the carry row */
+  /* is the last row of the previous strip, with integral row index first */
+  for (row = first + 1; row < last; row++) {
+    integral_image_add_row(target, row, first);
+  }
+}
+
+/******************************************************************************/
+
+result integral_image_update_parallel
+(
+  integral_image *target,
+  uint32 threads
+)
+{
+  TRY();
+  integral_image_strips strips;
+  uint32 i;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->original);
+  CHECK_POINTER(target->I_1.data);
+  CHECK_POINTER(target->I_2.data);
+  CHECK_PARAM(threads > 0);
+
+  /* each strip must contain at least one row */
+  if (threads > target->height) {
+    threads = target->height;
+  }
+  /* the tiled integrals are relative to full integral rows of all strips */
+  if (threads <= 1 || target->storage == i_TILED) {
+    CHECK(integral_image_update(target));
+    TERMINATE(SUCCESS);
+  }
+
+  /* only the first row has to be cleared, the rest is overwritten */
+  CHECK(integral_image_clear_first_row(target));
+  target->higher_order_updated = FALSE;
+
+  strips.target = target;
+  strips.update_row = integral_image_get_row_function(target->original->step,
+                                                      target->step);
+
+  /* first calculate the local integrals of each strip in parallel */
+  CHECK(parallel_run(&integral_image_update_strip, &strips, threads));
+  /* then propagate the totals through the last rows of the strips */
+  for (i = 1; i < threads; i++) {
+    integral_image_add_row(target,
+                           INTEGRAL_IMAGE_STRIP_FIRST(target, i + 1, threads),
+                           INTEGRAL_IMAGE_STRIP_FIRST(target, i, threads));
+  }
+  /* finally add the carried row to the rest of the rows in parallel */
+  CHECK(parallel_run(&integral_image_carry_strip, &strips, threads));
+  /* the tilted integrals depend on all previous rows and are done serially */
+  if (target->T_1.data != NULL) {
+    CHECK(integral_image_update_tilted(target));
+  }
+
+  FINALLY(integral_image_update_parallel);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_image_update_rect
+(
+  integral_image *target,
+  sint32 x,
+  sint32 y,
+  sint32 dx,
+  sint32 dy
+)
+{
+  TRY();
+  integral_value *delta, *planes[2], *row, *plane_delta;
+  integral_value *I_1_row, *I_1_prev, *I_2_row, *I_2_prev, sum_1, sum_2;
+  byte *source_row, value;
+  uint32 i, count, channels, channel_step, c, px, pos, start, iy, y_end;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->original);
+  CHECK_POINTER(target->I_1.data);
+  CHECK_POINTER(target->I_2.data);
+
+  if (target->storage != i_REAL) {
+    CHECK(integral_image_update(target));
+    TERMINATE(SUCCESS);
+  }
+  if (IS_FALSE(integral_image_clip_rect(target->width, target->height,
+                                        &x, &y, &dx, &dy))) {
+    TERMINATE(SUCCESS);
+  }
+  target->higher_order_updated = FALSE;
+
+  /* with interleaved layout, both integrals are in the I_1 plane */
+  planes[0] = (integral_value *)target->I_1.data;
+  planes[1] = (integral_value *)target->I_2.data;
+  count = (target->layout == l_INTERLEAVED) ? 1 : 2;
+  channels = target->original->step;
+  channel_step = target->step / channels;
+  /* only the integral columns right of the changed pixels are affected */
+  start = ((unsigned)x + 1) * target->step;
+  y_end = (unsigned)(y + dy);
+  /* the changes of the last row are kept in the reused row buffer */
+  CHECK(integral_image_prepare_buffer(&target->temp_rows, target->stride, 2));
+  delta = (integral_value *)target->temp_rows.data;
+
+  for (iy = (unsigned)y + 1; iy <= y_end; iy++) {
+    /* store the old totals of the last changed row */
+    if (iy == y_end) {
+      for (i = 0; i < count; i++) {
+        row = planes[i] + iy * target->stride;
+        plane_delta = delta + i * target->stride;
+        for (pos = start; pos < target->stride; pos++) {
+          plane_delta[pos] = row[pos];
+        }
+      }
+    }
+    source_row = (byte *)target->original->rows[iy - 1];
+    I_1_row = planes[0] + iy * target->stride;
+    I_2_row = (integral_value *)target->I_2.data + iy * target->stride;
+    I_1_prev = I_1_row - target->stride;
+    I_2_prev = I_2_row - target->stride;
+    for (c = 0; c < channels; c++) {
+      /* the row sum up to the rectangle is the difference of unchanged values */
+      pos = (unsigned)x * target->step + c * channel_step;
+      sum_1 = I_1_row[pos] - I_1_prev[pos];
+      sum_2 = I_2_row[pos] - I_2_prev[pos];
+      for (px = (unsigned)x; px < target->width; px++) {
+        value = source_row[px * channels + c];
+        sum_1 += value;
+        sum_2 += pixel_squared[value];
+        pos += target->step;
+        I_1_row[pos] = I_1_prev[pos] + sum_1;
+        I_2_row[pos] = I_2_prev[pos] + sum_2;
+      }
+    }
+    if (iy == y_end) {
+      for (i = 0; i < count; i++) {
+        row = planes[i] + iy * target->stride;
+        plane_delta = delta + i * target->stride;
+        for (pos = start; pos < target->stride; pos++) {
+          plane_delta[pos] = row[pos] - plane_delta[pos];
+        }
+      }
+    }
+  }
+
+  /* the rows below change by the same amounts as the last changed row */
+  for (iy = y_end + 1; iy <= target->height; iy++) {
+    for (i = 0; i < count; i++) {
+      row = planes[i] + iy * target->stride;
+      plane_delta = delta + i * target->stride;
+      for (pos = start; pos < target->stride; pos++) {
+        row[pos] += plane_delta[pos];
+      }
+    }
+  }
+  if (target->T_1.data != NULL) {
+    CHECK(integral_image_update_tilted(target));
+  }
+
+  FINALLY(integral_image_update_rect);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_stream_create
+(
+  integral_stream *target,
+  uint32 width,
+  uint32 height,
+  uint32 radius
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+  CHECK_PARAM(width > 0 && height > 0);
+
+  target->width = width;
+  target->height = height;
+  target->stride = width + 1;
+  target->radius = radius;
+  /* queries around a row need the integral rows from row - radius to */
+  /* row + radius + 1, and the source rows from row - radius to row + radius */
+  target->capacity = 2 * radius + 2;
+  if (target->capacity > height + 1) {
+    target->capacity = height + 1;
+  }
+  target->source_capacity = 2 * radius + 1;
+  if (target->source_capacity > height) {
+    target->source_capacity = height;
+  }
+  target->I_1 = NULL;
+  target->I_2 = NULL;
+  target->source = NULL;
+
+  CHECK(memory_allocate((data_pointer *)&target->I_1,
+                        target->capacity * target->stride,
+                        sizeof(integral_value)));
+  CHECK(memory_allocate((data_pointer *)&target->I_2,
+                        target->capacity * target->stride,
+                        sizeof(integral_value)));
+  CHECK(memory_allocate((data_pointer *)&target->source,
+                        target->source_capacity * width, sizeof(byte)));
+  CHECK(integral_stream_reset(target));
+
+  FINALLY(integral_stream_create);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_stream_destroy
+(
+  integral_stream *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  CHECK(memory_deallocate((data_pointer *)&target->I_1));
+  CHECK(memory_deallocate((data_pointer *)&target->I_2));
+  CHECK(memory_deallocate((data_pointer *)&target->source));
+  CHECK(integral_stream_nullify(target));
+
+  FINALLY(integral_stream_destroy);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_stream_nullify
+(
+  integral_stream *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  target->width = 0;
+  target->height = 0;
+  target->stride = 0;
+  target->radius = 0;
+  target->capacity = 0;
+  target->source_capacity = 0;
+  target->rows = 0;
+  target->I_1 = NULL;
+  target->I_2 = NULL;
+  target->source = NULL;
+
+  FINALLY(integral_stream_nullify);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_stream_reset
+(
+  integral_stream *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->I_1);
+  CHECK_POINTER(target->I_2);
+
+  /* the first row of the integral must contain only 0's */
+  CHECK(memory_clear((data_pointer)target->I_1, target->stride,
+                     sizeof(integral_value)));
+  CHECK(memory_clear((data_pointer)target->I_2, target->stride,
+                     sizeof(integral_value)));
+  target->rows = 0;
+
+  FINALLY(integral_stream_reset);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_stream_add_row
+(
+  integral_stream *target,
+  const byte *row
+)
+{
+  TRY();
+  integral_value *I_1_prev, *I_1_row, *I_2_prev, *I_2_row;
+  integral_image_row_function update_row;
+  byte *source_row;
+  uint32 col;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(row);
+  CHECK_PARAM(target->rows < target->height);
+
+  /* integral row n is stored at position n modulo capacity */
+  I_1_prev = target->I_1 + (target->rows % target->capacity) * target->stride;
+  I_2_prev = target->I_2 + (target->rows % target->capacity) * target->stride;
+  I_1_row = target->I_1 + ((target->rows + 1) % target->capacity) * target->stride;
+  I_2_row = target->I_2 + ((target->rows + 1) % target->capacity) * target->stride;
+
+  I_1_row[0] = 0;
+  I_2_row[0] = 0;
+  update_row = integral_image_get_row_function(1, 1);
+  update_row(row, 1, I_1_prev + 1, I_1_row + 1, I_2_prev + 1, I_2_row + 1, 1,
+             target->width);
+
+  source_row = target->source + (target->rows % target->source_capacity) *
+               target->width;
+  for (col = 0; col < target->width; col++) {
+    source_row[col] = row[col];
+  }
+  target->rows++;
+
+  FINALLY(integral_stream_add_row);
+  RETURN();
+}
+
+/******************************************************************************/
+
+byte *integral_stream_get_row
+(
+  integral_stream *target,
+  uint32 row
+)
+{
+  if (target == NULL || row >= target->rows ||
+      row + target->source_capacity < target->rows) {
+    return NULL;
+  }
+  return target->source + (row % target->source_capacity) * target->width;
+}
+
+/******************************************************************************/
+
+void integral_stream_calculate_statistics
+(
+  integral_stream *target,
+  statistics *stat,
+  sint32 x,
+  sint32 y,
+  sint32 dx,
+  sint32 dy
+)
+{
+  integral_value *iA, *iD, *i2A, *i2D, N, sum, sum2, mean, var;
+  uint32 top, bottom;
+
+  statistics_init(stat);
+  if (IS_FALSE(integral_image_clip_rect(target->width, target->height,
+                                        &x, &y, &dx, &dy))) {
+    return;
+  }
+  top = (unsigned)y;
+  bottom = (unsigned)(y + dy);
+  /* the integral rows must still be in memory */
+  if (bottom > target->rows || top + target->capacity < target->rows + 1) {
+    return;
+  }
+  iA = target->I_1 + (top % target->capacity) * target->stride + x;
+  iD = target->I_1 + (bottom % target->capacity) * target->stride + x;
+  i2A = target->I_2 + (top % target->capacity) * target->stride + x;
+  i2D = target->I_2 + (bottom % target->capacity) * target->stride + x;
+
+  /* same order of operations as with the full integral_image */
+  N = ((integral_value)(((unsigned)dx) * ((unsigned)dy)));
+  sum = *(iD + dx) + *iA - *(iA + dx) - *iD;
+  sum2 = *(i2D + dx) + *i2A - *(i2A + dx) - *i2D;
+  mean = sum / N;
+  var = (sum2 / N) - mean*mean;
+  if (var < 0) var = 0;
+  stat->N = N;
+  stat->sum = sum;
+  stat->sum2 = sum2;
+  stat->mean = mean;
+  stat->variance = var;
+  stat->deviation = sqrt(var);
+}
+
+/******************************************************************************/
+/* finds the minimum source value within the region, in the same way as       */
+/* pixel_image_find_min_byte                                                  */
+
+integral_value integral_stream_find_min
+(
+  integral_stream *target,
+  sint32 x,
+  sint32 y,
+  sint32 dx,
+  sint32 dy
+)
+{
+  integral_value min, value;
+  byte *row;
+  uint32 col, end;
+
+  if (IS_FALSE(integral_image_clip_rect(target->width, target->height,
+                                        &x, &y, &dx, &dy))) {
+    return 0;
+  }
+  min = 255;
+  end = (unsigned)(x + dx);
+  for (; dy > 0; dy--, y++) {
+    row = integral_stream_get_row(target, (unsigned)y);
+    if (row == NULL) {
+      return 0;
+    }
+    for (col = (unsigned)x; col < end; col++) {
+      value = (integral_value)row[col];
+      if (value < min) min = value;
+    }
+  }
+  return min;
+}
+
+/******************************************************************************/
+/* reads source rows until the rows needed by the queries around the given    */
+/* row are in memory                                                          */
+
+result integral_stream_read_rows
+(
+  integral_stream *target,
+  image_row_reader reader,
+  pointer params,
+  byte *buffer,
+  uint32 row
+)
+{
+  TRY();
+  uint32 last;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(reader);
+
+  last = row + target->radius + 1;
+  if (last > target->height) {
+    last = target->height;
+  }
+  while (target->rows < last) {
+    CHECK(reader(params, target->rows, buffer));
+    CHECK(integral_stream_add_row(target, buffer));
+  }
+
+  FINALLY(integral_stream_read_rows);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_stream_threshold_sauvola
+(
+  image_row_reader reader,
+  pointer reader_params,
+  image_row_writer writer,
+  pointer writer_params,
+  uint32 width,
+  uint32 height,
+  truth_value invert,
+  sint32 radius,
+  integral_value k,
+  truth_value calculate_max,
+  integral_value max,
+  truth_value use_mean
+)
+{
+  TRY();
+  integral_stream stream;
+  byte *buffer, *source_row, t, value1, value2;
+  integral_value dev, R, dev_max, dev_sum;
+  sint32 x, y, size;
+  statistics stat;
+
+  buffer = NULL;
+  CHECK(integral_stream_nullify(&stream));
+  CHECK_POINTER(reader);
+  CHECK_POINTER(writer);
+  CHECK_PARAM(radius >= 0);
+
+  CHECK(integral_stream_create(&stream, width, height, (unsigned)radius));
+  CHECK(memory_allocate(&buffer, width, sizeof(byte)));
+
+  if (IS_TRUE(invert)) {
+    value1 = 0;
+    value2 = 255;
+  }
+  else {
+    value1 = 255;
+    value2 = 0;
+  }
+  size = 2 * radius + 1;
+
+  /* the first pass finds the maximum or mean deviation */
+  R = max;
+  if (IS_TRUE(calculate_max)) {
+    dev_max = 0;
+    dev_sum = 0;
+    for (y = 0; y < (signed)height; y++) {
+      CHECK(integral_stream_read_rows(&stream, reader, reader_params, buffer,
+                                      (unsigned)y));
+      for (x = 0; x < (signed)width; x++) {
+        integral_stream_calculate_statistics(&stream, &stat, x-radius,
+                                             y-radius, size, size);
+        dev = stat.deviation;
+        if (IS_TRUE(use_mean)) {
+          dev_sum += dev;
+        }
+        else {
+          if (dev > dev_max) dev_max = dev;
+        }
+      }
+    }
+    if (IS_TRUE(use_mean)) {
+      R = dev_sum / ((integral_value)(((signed)width)*((signed)height)));
+    }
+    else {
+      R = dev_max;
+    }
+    CHECK(integral_stream_reset(&stream));
+  }
+
+  for (y = 0; y < (signed)height; y++) {
+    CHECK(integral_stream_read_rows(&stream, reader, reader_params, buffer,
+                                    (unsigned)y));
+    source_row = integral_stream_get_row(&stream, (unsigned)y);
+    for (x = 0; x < (signed)width; x++) {
+      integral_stream_calculate_statistics(&stream, &stat, x-radius, y-radius,
+                                           size, size);
+      t = integral_image_sauvola_threshold(stat.mean, stat.deviation, k, R);
+      if (source_row[x] > t) {
+        buffer[x] = value1;
+      }
+      else {
+        buffer[x] = value2;
+      }
+    }
+    CHECK(writer(writer_params, (unsigned)y, buffer));
+  }
+
+  FINALLY(integral_stream_threshold_sauvola);
+  memory_deallocate(&buffer);
+  integral_stream_destroy(&stream);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result integral_stream_threshold_feng
+(
+  image_row_reader reader,
+  pointer reader_params,
+  image_row_writer writer,
+  pointer writer_params,
+  uint32 width,
+  uint32 height,
+  truth_value invert,
+  sint32 radius1,
+  integral_value multiplier,
+  truth_value estimate_min,
+  integral_value alpha
+)
+{
+  TRY();
+  integral_stream stream;
+  byte *buffer, *source_row, t, value1, value2;
+  integral_value min, mean, dev1, dev2;
+  sint32 x, y, radius2, size1, size2;
+  statistics stat;
+
+  buffer = NULL;
+  CHECK(integral_stream_nullify(&stream));
+  CHECK_POINTER(reader);
+  CHECK_POINTER(writer);
+  CHECK_PARAM(radius1 >= 0);
+
+  size1 = 2 * radius1 + 1;
+  radius2 = (sint32)(multiplier * ((integral_value)radius1));
+  size2 = 2 * radius2 + 1;
+  CHECK_PARAM(radius2 >= 0);
+
+  CHECK(integral_stream_create(&stream, width, height,
+                               (unsigned)((radius1 > radius2) ? radius1 :
+                                                                radius2)));
+  CHECK(memory_allocate(&buffer, width, sizeof(byte)));
+
+  if (IS_TRUE(invert)) {
+    value1 = 0;
+    value2 = 255;
+  }
+  else {
+    value1 = 255;
+    value2 = 0;
+  }
+
+  for (y = 0; y < (signed)height; y++) {
+    CHECK(integral_stream_read_rows(&stream, reader, reader_params, buffer,
+                                    (unsigned)y));
+    source_row = integral_stream_get_row(&stream, (unsigned)y);
+    for (x = 0; x < (signed)width; x++) {
+      integral_stream_calculate_statistics(&stream, &stat, x-radius1,
+                                           y-radius1, size1, size1);
+      mean = stat.mean;
+      dev1 = stat.deviation;
+      if (IS_TRUE(estimate_min)) {
+        min = fmax(0, mean - alpha * dev1);
+      }
+      else {
+        min = integral_stream_find_min(&stream, x-radius1, y-radius1, size1,
+                                       size1);
+      }
+      integral_stream_calculate_statistics(&stream, &stat, x-radius2,
+                                           y-radius2, size2, size2);
+      dev2 = sqrt(stat.variance);
+      t = integral_image_feng_threshold(mean, min, dev1, dev2);
+      if (source_row[x] > t) {
+        buffer[x] = value1;
+      }
+      else {
+        buffer[x] = value2;
+      }
+    }
+    CHECK(writer(writer_params, (unsigned)y, buffer));
+  }
+
+  FINALLY(integral_stream_threshold_feng);
+  memory_deallocate(&buffer);
+  integral_stream_destroy(&stream);
   RETURN();
 }
 
@@ -40,11 +40,41 @@ extern "C" {
 #include "cvsu_types.h"
 #include "cvsu_pixel_image.h"
 
+/**
+ * Different ways of storing the integral values.
+ */
+typedef enum integral_storage_t {
+  /** integral_value (p_I) for both integrals */
+  i_REAL = 0,
+  /** exact integers, EI_1_t and EI_2_t; for images up to 16843009 pixels */
+  i_EXACT,
+  /** exact integers, SI_1_t and SI_2_t; for images smaller than 256x256 */
+  i_SMALL,
+  /**
+   * TI_t sums relative to the origin of each 16x16 tile, with the full
+   * integrals along the tile borders in tile_rows and tile_cols; exact for
+   * the same image sizes as i_REAL, in about 60% of the memory
+   */
+  i_TILED
+} integral_storage;
+
+/**
+ * Different ways of arranging the integral values in memory.
+ */
+typedef enum integral_layout_t {
+  /** I_1 and I_2 are stored in separate images */
+  l_SEPARATE = 0,
+  /** I_1 and I_2 values of each pixel are stored next to each other */
+  l_INTERLEAVED
+} integral_layout;
+
 /**
  * Stores an integral and squared integral representation of a pixel image.
  * Refers to the original image but does not own it.
  * @note Integral images have one extra row and column, so they have larger
  * stride than the original, even though the width and height are the same.
+ * The stride is also padded so that every row starts at a multiple of
+ * MEMORY_ALIGNMENT bytes.
  */
 typedef struct integral_image_t {
   /** The original pixel_image from which the integrals are calculated */
@@ -53,22 +83,97 @@ typedef struct integral_image_t {
   pixel_image I_1;
   /** The pixel_image containing the integral of power two */
   pixel_image I_2;
-#ifdef INTEGRAL_IMAGE_HIGHER_ORDER_STATISTICS
-  /** The pixel_image containing the integral of power three */
+  /**
+   * The pixel_image containing the integral of power three; null until higher
+   * order statistics are first requested, then packed with one value per
+   * channel and no row padding
+   */
   pixel_image I_3;
   /** The pixel_image containing the integral of power four */
   pixel_image I_4;
-#endif
+  /** Whether I_3 and I_4 are up to date with the latest update */
+  truth_value higher_order_updated;
   /** The width of the integral_image; same as the width of pixel_image */
   uint32 width;
   /** The height of the integral_image; same as the height of pixel_image */
   uint32 height;
-  /** The column step of the integral_image; same as the step of pixel_image */
+  /** The column step of the integral_image; doubled with interleaved layout */
   uint32 step;
   /** The row stride of the integral_image; LARGER than in pixel_image */
   uint32 stride;
+  /** The type of values stored in the integrals */
+  integral_storage storage;
+  /** The arrangement of the integrals in memory */
+  integral_layout layout;
+  /**
+   * With i_TILED storage, the full integral of power one along the top row
+   * of each tile row; null with other storages
+   */
+  pixel_image tile_rows_1;
+  /** With i_TILED storage, the same for the integral of power two */
+  pixel_image tile_rows_2;
+  /**
+   * With i_TILED storage, the full integral of power one along the left
+   * column of each tile column; null with other storages
+   */
+  pixel_image tile_cols_1;
+  /** With i_TILED storage, the same for the integral of power two */
+  pixel_image tile_cols_2;
+  /**
+   * The tilted integral of power one, containing at (x,y) the sum of the
+   * pixels above (x,y) within a 45 degree triangle; null unless enabled with
+   * @see integral_image_enable_tilted. Has columns for x = -1..width.
+   */
+  pixel_image T_1;
+  /** The tilted integral of power two */
+  pixel_image T_2;
+  /** Buffer for the state of the tilted update, allocated with T_1 and T_2 */
+  pixel_image temp_tilted;
+  /** Buffer for window means used by thresholding, reused between calls */
+  pixel_image temp_mean;
+  /** Buffer for window deviations used by thresholding, reused between calls */
+  pixel_image temp_dev;
+  /**
+   * Buffer of two integral rows, used for the full rows of the i_TILED update
+   * and for the row changes of @see integral_image_update_rect
+   */
+  pixel_image temp_rows;
 } integral_image;
 
+/**
+ * Stores a batch of rectangles for box queries and the resulting statistics
+ * as a structure of arrays, so that the statistics can be calculated for all
+ * rectangles in one call. The arrays may be allocated with
+ * @see integral_box_batch_create, or set to point to arrays owned by the
+ * caller.
+ */
+typedef struct integral_box_batch_t {
+  /** Number of rectangles in the batch */
+  uint32 count;
+  /** Number of rectangles that fit in the allocated arrays */
+  uint32 capacity;
+  /** Left coordinates of the rectangles, can be negative */
+  sint32 *x;
+  /** Top coordinates of the rectangles, can be negative */
+  sint32 *y;
+  /** Widths of the rectangles */
+  sint32 *dx;
+  /** Heights of the rectangles */
+  sint32 *dy;
+  /** Number of pixels within the clipped rectangles, 0 if invalid */
+  integral_value *N;
+  /** Sums of pixel values */
+  integral_value *sum;
+  /** Sums of squared pixel values */
+  integral_value *sum2;
+  /** Means of pixel values */
+  integral_value *mean;
+  /** Variances of pixel values */
+  integral_value *variance;
+  /** Standard deviations of pixel values */
+  integral_value *deviation;
+} integral_box_batch;
+
 /**
  * Allocates an integral_image structure.
  * @see integral_image_free
@@ -95,6 +200,38 @@ result integral_image_create
   pixel_image *source
 );
 
+/**
+ * Initializes the structure for an integral image using the given storage
+ * and allocates the memory. Exact storage uses integer values that don't lose
+ * precision with large images, and tiled storage uses single precision values
+ * relative to small tiles; all box queries work with every storage, but the
+ * macros accessing the integrals directly require i_REAL storage.
+ * @see integral_image_create
+ */
+result integral_image_create_with_storage
+(
+  integral_image *target,
+  pixel_image *source,
+  integral_storage storage
+);
+
+/**
+ * Initializes the structure for an integral image using the given storage and
+ * layout and allocates the memory. With interleaved layout a box query reads
+ * both integrals of a corner from the same cache line. The step and stride
+ * of the integral_image describe the layout, so the box macros and the
+ * rectangles created with @see integral_image_create_rect work with both
+ * layouts. Interleaved layout requires i_REAL storage.
+ * @see integral_image_create_with_storage
+ */
+result integral_image_create_with_layout
+(
+  integral_image *target,
+  pixel_image *source,
+  integral_storage storage,
+  integral_layout layout
+);
+
 /**
  * Deallocates the memory allocated within the integral_image structure.
  * Does not free the structure pointer itself.
@@ -146,17 +283,82 @@ result integral_image_copy
 
 /**
  * Updates the integral_image by calculating the integral and squared integral
- * of the source pixel_image.
+ * of the source pixel_image. All channels of multi-channel images are
+ * calculated in one traversal; the channel offset given to the box queries
+ * selects the channel.
  */
 result integral_image_update
 (
   integral_image *target
 );
 
+/**
+ * Reads the rows of the original image from a row source and updates the
+ * integrals of each row as soon as it has been read, so reading the next rows
+ * can overlap with the summing. The original image must be a single-channel
+ * byte image, and it receives the rows that were read. Storages other than
+ * i_REAL read the whole image before the update.
+ */
+result integral_image_update_from_reader
+(
+  integral_image *target,
+  image_row_reader reader,
+  pointer reader_params
+);
+
+/**
+ * Converts a two-channel uyvy or yuyv frame into the greyscale original image
+ * of the integral_image and updates the integrals in the same pass. Each
+ * greyscale row is summed right after it is converted, while it is still in
+ * cache, so the converted frame is not read back from memory. The result is
+ * the same as converting the frame and calling @see integral_image_update.
+ * Storages other than i_REAL convert the whole frame before the update.
+ */
+result integral_image_update_from_yuv422
+(
+  integral_image *target,
+  /** Two-channel frame with the same size as the original image */
+  const pixel_image *source,
+  /** Channel containing the y values; 1 for uyvy and 0 for yuyv */
+  uint32 y_channel
+);
+
+/**
+ * Updates the integral_image after the pixels of the original image have
+ * changed only within the given rectangle. The rows within the rectangle are
+ * recalculated from its left side onwards, and the change of the totals is
+ * added to the rows below it. The result is the same as with
+ * @see integral_image_update. Storages other than i_REAL are updated fully.
+ * @see pixel_image_copy_changes
+ */
+result integral_image_update_rect
+(
+  integral_image *target,
+  sint32 x,
+  sint32 y,
+  sint32 dx,
+  sint32 dy
+);
+
+/**
+ * Updates the integral_image using the given number of threads. The source
+ * image is divided into horizontal strips, the integrals of the strips are
+ * calculated in parallel, and then the totals of the strips above are carried
+ * to each strip. Works for both regular and small integral images, and gives
+ * the same result as @see integral_image_update and
+ * @see small_integral_image_update.
+ */
+result integral_image_update_parallel
+(
+  integral_image *target,
+  uint32 threads
+);
+
 /**
  * Produces a valid rectangle for the given integral_image. Takes into account
  * image dimensions and reduces the size of the region at the border. May
- * cause edge effects in some applications.
+ * cause edge effects in some applications. The channel offset is given in
+ * channels and is converted according to the layout.
  */
 image_rect integral_image_create_rect
 (
@@ -174,6 +376,27 @@ image_rect integral_image_create_rect
   uint32 offset
 );
 
+/**
+ * Returns the value of the integral of power one at the given position of the
+ * I_1 image, for any storage.
+ */
+integral_value integral_image_get_value_1
+(
+  integral_image *target,
+  uint32 pos
+);
+
+/**
+ * Returns the value of the integral of power two at the given position of the
+ * I_1 image, for any storage. With interleaved layout, the position is the
+ * same as for the corresponding value of power one.
+ */
+integral_value integral_image_get_value_2
+(
+  integral_image *target,
+  uint32 pos
+);
+
 /**
  * Uses the integral_image to calculate intensity mean within the given region.
  */
@@ -222,6 +445,107 @@ void integral_image_calculate_statistics
   uint32 offset
 );
 
+/**
+ * Calculates the integrals of powers three and four, allocating them if
+ * needed. Called automatically by
+ * @see integral_image_calculate_higher_statistics when the integrals are not
+ * up to date, so that they are only built for the frames that need them.
+ */
+result integral_image_update_higher_order
+(
+  integral_image *target
+);
+
+/**
+ * Calculates the same statistics as @see integral_image_calculate_statistics,
+ * and the skewness and kurtosis (not excess kurtosis) within the region. The
+ * integrals of powers three and four are built on the first call after each
+ * update. If the region is empty or has no variance, skewness and kurtosis
+ * are 0.
+ */
+result integral_image_calculate_higher_statistics
+(
+  integral_image *target,
+  statistics *stat,
+  integral_value *skewness,
+  integral_value *kurtosis,
+  sint32 x,
+  sint32 y,
+  sint32 width,
+  sint32 height,
+  uint32 offset
+);
+
+/**
+ * Allocates the tilted integrals of the integral_image, so that
+ * @see integral_image_update calculates them in the same pass with the
+ * regular integrals. Requires a single-channel image with i_REAL storage and
+ * l_SEPARATE layout.
+ */
+result integral_image_enable_tilted
+(
+  integral_image *target
+);
+
+/**
+ * Uses the tilted integrals to calculate intensity statistics within a
+ * rectangle rotated by 45 degrees. The top corner of the rectangle is at
+ * (x,y); it extends w steps down and right, and h steps down and left, and
+ * contains 2*w*h pixels. The rectangle must be fully inside the image,
+ * otherwise N is set to 0 and the statistics to 0. Fails if the tilted
+ * integrals have not been enabled.
+ * @see integral_image_enable_tilted
+ */
+result integral_image_calculate_tilted_statistics
+(
+  integral_image *target,
+  statistics *stat,
+  sint32 x,
+  sint32 y,
+  sint32 w,
+  sint32 h
+);
+
+/**
+ * Allocates the arrays of an integral_box_batch for the given number of
+ * rectangles. The count is set to 0.
+ * @see integral_box_batch_destroy
+ */
+result integral_box_batch_create
+(
+  integral_box_batch *target,
+  uint32 capacity
+);
+
+/**
+ * Deallocates the arrays allocated with @see integral_box_batch_create.
+ */
+result integral_box_batch_destroy
+(
+  integral_box_batch *target
+);
+
+/**
+ * Initializes the integral_box_batch structure with null values.
+ */
+result integral_box_batch_nullify
+(
+  integral_box_batch *target
+);
+
+/**
+ * Calculates the statistics of all rectangles in the batch, with the same
+ * clipping and the same results as @see integral_image_calculate_statistics.
+ * Invalid rectangles get 0 for all statistics. The divisions and square roots
+ * are evaluated for the whole batch with vector instructions when available.
+ */
+result integral_image_calculate_batch
+(
+  integral_image *source,
+  integral_box_batch *batch,
+  uint32 offset
+);
+
 /**
  * Uses the integral_image to threshold the underlying pixel_image using the
  * Sauvola method.
@@ -253,6 +577,43 @@ result integral_image_threshold_feng
   integral_value alpha
 );
 
+/**
+ * Thresholds using the Sauvola method with the given number of threads. The
+ * image is divided into horizontal strips that are thresholded in parallel.
+ * When the maximum is calculated, the deviations of all windows are found
+ * first and combined in a fixed order, so the result is identical to
+ * @see integral_image_threshold_sauvola with any number of threads.
+ */
+result integral_image_threshold_sauvola_parallel
+(
+  integral_image *source,
+  pixel_image *target,
+  truth_value invert,
+  sint32 radius,
+  integral_value k,
+  truth_value calculate_max,
+  integral_value max,
+  truth_value use_mean,
+  uint32 threads
+);
+
+/**
+ * Thresholds using the Feng method with the given number of threads. The
+ * image is divided into horizontal strips that are thresholded in parallel,
+ * and the result is identical to @see integral_image_threshold_feng.
+ */
+result integral_image_threshold_feng_parallel
+(
+  integral_image *source,
+  pixel_image *target,
+  truth_value invert,
+  sint32 radius1,
+  integral_value multiplier,
+  truth_value estimate_min,
+  integral_value alpha,
+  uint32 threads
+);
+
 /**
  * Creates a small integral image with dimensions less than 256. This allows
  * using unsigned long values for both images.
@@ -271,6 +632,148 @@ result small_integral_image_update
   integral_image *target
 );
 
+/**
+ * Stores the integral of a single-channel image only for the rows needed by
+ * box queries within the given radius from the current row. The rows are added
+ * one at a time, and the memory used is proportional to width * radius. The
+ * integral values are the same as in the full integral_image, so the queries
+ * give identical results.
+ */
+typedef struct integral_stream_t {
+  /** The width of the source image */
+  uint32 width;
+  /** The height of the source image, used for limiting the queries */
+  uint32 height;
+  /** The row stride of the integral rows; one larger than the width */
+  uint32 stride;
+  /** The maximum radius of the queries */
+  uint32 radius;
+  /** The number of integral rows kept in memory */
+  uint32 capacity;
+  /** The number of source rows kept in memory */
+  uint32 source_capacity;
+  /** The number of source rows added so far */
+  uint32 rows;
+  /** The integral rows, used as a ring buffer */
+  integral_value *I_1;
+  /** The squared integral rows, used as a ring buffer */
+  integral_value *I_2;
+  /** The source rows, used as a ring buffer */
+  byte *source;
+} integral_stream;
+
+/**
+ * Initializes the integral_stream and allocates the memory for the rows
+ * needed by queries within the given radius.
+ * @see integral_stream_destroy
+ */
+result integral_stream_create
+(
+  integral_stream *target,
+  uint32 width,
+  uint32 height,
+  uint32 radius
+);
+
+/**
+ * Deallocates the memory allocated within the integral_stream structure.
+ */
+result integral_stream_destroy
+(
+  integral_stream *target
+);
+
+/**
+ * Nullifies the contents of the integral_stream. Does NOT deallocate memory.
+ */
+result integral_stream_nullify
+(
+  integral_stream *target
+);
+
+/**
+ * Starts the stream from the beginning for a new pass over the image.
+ */
+result integral_stream_reset
+(
+  integral_stream *target
+);
+
+/**
+ * Adds the next source row to the stream and calculates its integral row.
+ */
+result integral_stream_add_row
+(
+  integral_stream *target,
+  const byte *row
+);
+
+/**
+ * Returns the given source row, or NULL if it is no longer in memory.
+ */
+byte *integral_stream_get_row
+(
+  integral_stream *target,
+  uint32 row
+);
+
+/**
+ * Uses the integral_stream to calculate intensity statistics within the given
+ * region, in the same way as @see integral_image_calculate_statistics. The
+ * rows of the region must still be in memory.
+ */
+void integral_stream_calculate_statistics
+(
+  integral_stream *target,
+  statistics *stat,
+  sint32 x,
+  sint32 y,
+  sint32 dx,
+  sint32 dy
+);
+
+/**
+ * Thresholds an image read row by row using the Sauvola method. Gives the
+ * same result as @see integral_image_threshold_sauvola but only keeps the
+ * rows within the radius in memory. Calculating the maximum deviation
+ * requires reading the image twice.
+ */
+result integral_stream_threshold_sauvola
+(
+  image_row_reader reader,
+  pointer reader_params,
+  image_row_writer writer,
+  pointer writer_params,
+  uint32 width,
+  uint32 height,
+  truth_value invert,
+  sint32 radius,
+  integral_value k,
+  truth_value calculate_max,
+  integral_value max,
+  truth_value use_mean
+);
+
+/**
+ * Thresholds an image read row by row using the Feng method. Gives the same
+ * result as @see integral_image_threshold_feng but only keeps the rows within
+ * the larger radius in memory.
+ */
+result integral_stream_threshold_feng
+(
+  image_row_reader reader,
+  pointer reader_params,
+  image_row_writer writer,
+  pointer writer_params,
+  uint32 width,
+  uint32 height,
+  truth_value invert,
+  sint32 radius1,
+  integral_value multiplier,
+  truth_value estimate_min,
+  integral_value alpha
+);
+
 #ifdef __cplusplus
 }
 #endif
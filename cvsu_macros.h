@@ -113,7 +113,7 @@ finally:
   uint32 image##_step, image##_stride;\
   image##_data = (type *)image->data;\
   image##_step = image->step;\
-  image##_stride = image->stride - (rect.hstep * image->step) + 1;\
+  image##_stride = image->stride - (rect.hstep * image->step);\
   image##_pos = image##_data + rect.offset
 
 #define SINGLE_CONTINUOUS_IMAGE_VARIABLES(image, type)\
@@ -290,6 +290,8 @@ finally:
 
 /******************************************************************************/
 /* macros for integral image handling                                         */
+/* the offsets are calculated from the step and stride of the integral_image, */
+/* so the macros work with both separate and interleaved integral layouts     */
 
 #define INTEGRAL_IMAGE_1BOX_VARIABLES()\
   const I_1_t *I_1_data, *iA;\
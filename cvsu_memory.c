@@ -50,9 +50,17 @@
 
 string memory_allocate_name = "memory_allocate";
 string memory_deallocate_name = "memory_deallocate";
+string memory_allocate_aligned_name = "memory_allocate_aligned";
+string memory_deallocate_aligned_name = "memory_deallocate_aligned";
 string memory_clear_name = "memory_clear";
 string memory_copy_name = "memory_copy";
 
+/******************************************************************************/
+/* number of allocations, not protected against concurrent updates because   */
+/* it is only used for observing that allocations stop in steady state        */
+
+uint32 memory_allocation_count = 0;
+
 /******************************************************************************/
 
 result memory_allocate
@@ -76,6 +84,7 @@ result memory_allocate
   if (*target == NULL) {
     ERROR(BAD_POINTER);
   }
+  memory_allocation_count++;
 
   FINALLY(memory_allocate);
   RETURN();
@@ -83,6 +92,13 @@ result memory_allocate
 
 /******************************************************************************/
 
+uint32 memory_get_allocation_count()
+{
+  return memory_allocation_count;
+}
+
+/******************************************************************************/
+
 result memory_deallocate
 (
   data_pointer *target
@@ -105,6 +121,58 @@ result memory_deallocate
   RETURN();
 }
 
+/******************************************************************************/
+/* the aligned array is allocated with extra space in front of it, and the   */
+/* pointer to the whole allocation is stored just before the aligned array   */
+
+result memory_allocate_aligned
+(
+  data_pointer *target,
+  uint32 target_size,
+  uint32 element_size
+)
+{
+  TRY();
+  data_pointer block;
+  size_t address;
+
+  CHECK_POINTER(target);
+
+  block = NULL;
+  CHECK(memory_allocate(&block, target_size * element_size +
+                        MEMORY_ALIGNMENT + sizeof(data_pointer), 1));
+  address = (size_t)(block + sizeof(data_pointer));
+  address = (address + MEMORY_ALIGNMENT - 1) &
+            ~((size_t)MEMORY_ALIGNMENT - 1);
+  *target = block + (address - (size_t)block);
+  ((data_pointer *)*target)[-1] = block;
+
+  FINALLY(memory_allocate_aligned);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result memory_deallocate_aligned
+(
+  data_pointer *target
+)
+{
+  TRY();
+  data_pointer block;
+
+  CHECK_POINTER(target);
+
+  if (*target != NULL) {
+    block = ((data_pointer *)*target)[-1];
+    CHECK(memory_deallocate(&block));
+    *target = NULL;
+  }
+
+  FINALLY(memory_deallocate_aligned);
+  RETURN();
+}
+
 /******************************************************************************/
 
 result memory_clear
@@ -38,6 +38,12 @@ extern "C" {
 
 #include "cvsu_types.h"
 
+/**
+ * Alignment of the arrays allocated with @see memory_allocate_aligned, in
+ * bytes; enough for the widest vector loads and a full cache line.
+ */
+#define MEMORY_ALIGNMENT 64
+
 /**
  * A generic function for allocating an array of bytes.
  */
@@ -48,6 +54,34 @@ result memory_allocate
   uint32 element_size
 );
 
+/**
+ * Returns the number of successful allocations made with the memory functions
+ * since the start of the program. Comparing the counts before and after
+ * processing a frame shows whether the processing allocates memory. The count
+ * is not updated atomically, so it is exact only when threads are not
+ * allocating at the same time.
+ */
+uint32 memory_get_allocation_count();
+
+/**
+ * Allocates an array of bytes starting at a multiple of MEMORY_ALIGNMENT.
+ * The array must be deallocated with @see memory_deallocate_aligned.
+ */
+result memory_allocate_aligned
+(
+  data_pointer *target,
+  uint32 target_size,
+  uint32 element_size
+);
+
+/**
+ * Deallocates an array allocated with @see memory_allocate_aligned.
+ */
+result memory_deallocate_aligned
+(
+  data_pointer *target
+);
+
 /**
  * A generic function for deallocating an array of bytes.
  */
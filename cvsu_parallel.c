@@ -0,0 +1,140 @@
+/**
+ * @file cvsu_parallel.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Simple parallel task execution for cvsu.
+ *
+ * Copyright (c) 2011-2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_parallel.h"
+
+#if (THREADS_METHOD == THREADS_WITH_PTHREAD)
+#include <pthread.h>
+#elif (THREADS_METHOD != THREADS_DISABLED)
+#error "Threading method not defined"
+#endif
+
+/******************************************************************************/
+/* constants for reporting function names in error messages                   */
+
+string parallel_run_name = "parallel_run";
+
+/******************************************************************************/
+/* private structure for passing the task parameters to threads               */
+
+typedef struct parallel_task_t {
+  parallel_function function;
+  pointer params;
+  uint32 index;
+  uint32 count;
+#if (THREADS_METHOD == THREADS_WITH_PTHREAD)
+  pthread_t thread;
+  truth_value started;
+#endif
+} parallel_task;
+
+/******************************************************************************/
+
+void *parallel_task_run
+(
+  void *task_pointer
+)
+{
+  parallel_task *task;
+
+  task = (parallel_task *)task_pointer;
+  task->function(task->params, task->index, task->count);
+  return NULL;
+}
+
+/******************************************************************************/
+
+result parallel_run
+(
+  parallel_function function,
+  pointer params,
+  uint32 count
+)
+{
+  TRY();
+  parallel_task tasks[PARALLEL_MAX_THREADS];
+  uint32 first, batch, i;
+
+  CHECK_POINTER(function);
+  CHECK_PARAM(count > 0);
+
+  if (count == 1) {
+    function(params, 0, 1);
+    TERMINATE(SUCCESS);
+  }
+
+  for (first = 0; first < count; first += batch) {
+    batch = count - first;
+    if (batch > PARALLEL_MAX_THREADS) {
+      batch = PARALLEL_MAX_THREADS;
+    }
+    for (i = 0; i < batch; i++) {
+      tasks[i].function = function;
+      tasks[i].params = params;
+      tasks[i].index = first + i;
+      tasks[i].count = count;
+    }
+
+#if (THREADS_METHOD == THREADS_WITH_PTHREAD)
+    /* if a thread can't be created, its task is run in this thread instead */
+    for (i = 1; i < batch; i++) {
+      if (pthread_create(&tasks[i].thread, NULL, &parallel_task_run,
+                         &tasks[i]) == 0) {
+        tasks[i].started = TRUE;
+      }
+      else {
+        tasks[i].started = FALSE;
+      }
+    }
+    parallel_task_run(&tasks[0]);
+    for (i = 1; i < batch; i++) {
+      if (IS_TRUE(tasks[i].started)) {
+        pthread_join(tasks[i].thread, NULL);
+      }
+      else {
+        parallel_task_run(&tasks[i]);
+      }
+    }
+#else
+    for (i = 0; i < batch; i++) {
+      parallel_task_run(&tasks[i]);
+    }
+#endif
+  }
+
+  FINALLY(parallel_run);
+  RETURN();
+}
+
+/* end of file                                                                */
+/******************************************************************************/
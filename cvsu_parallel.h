@@ -0,0 +1,73 @@
+/**
+ * @file cvsu_parallel.h
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Simple parallel task execution for cvsu.
+ *
+ * Copyright (c) 2011-2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CVSU_PARALLEL_H
+#   define CVSU_PARALLEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "cvsu_config.h"
+#include "cvsu_types.h"
+
+/**
+ * Function type for tasks executed in parallel. Each task receives the same
+ * parameter pointer, its own index, and the total number of tasks, and should
+ * use them to decide which part of the work to do. Tasks must not write to
+ * memory that other tasks read or write.
+ */
+typedef void (*parallel_function)
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+);
+
+/**
+ * Runs the given number of tasks in parallel, each in its own thread, and
+ * waits until all tasks have finished. The first task runs in the calling
+ * thread. If threads are not available, the tasks are run sequentially. At most
+ * PARALLEL_MAX_THREADS tasks run at the same time, the rest are run in further
+ * batches. No memory is allocated.
+ */
+result parallel_run
+(
+  parallel_function function,
+  pointer params,
+  uint32 count
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CVSU_PARALLEL_H */
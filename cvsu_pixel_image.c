@@ -30,14 +30,33 @@
  */
 
 #include "cvsu_config.h"
+
+#if (FILE_MAPPING_METHOD == FILE_MAPPING_WITH_MMAP)
+/* the posix file functions are not declared in strict ansi mode */
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include "cvsu_macros.h"
 #include "cvsu_memory.h"
 #include "cvsu_pixel_image.h"
+#include "cvsu_simd.h"
+#include "cvsu_parallel.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <limits.h>
 
+#if (FILE_MAPPING_METHOD == FILE_MAPPING_WITH_MMAP)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#elif (FILE_MAPPING_METHOD != FILE_MAPPING_DISABLED)
+#error "File mapping method not defined"
+#endif
+
 /******************************************************************************/
 /* constants for reporting unction names in error messages                    */
 
@@ -46,15 +65,37 @@ string pixel_image_alloc_name = "pixel_image_alloc";
 string pixel_image_free_name = "pixel_image_free";
 string pixel_image_create_name = "pixel_image_create";
 string pixel_image_create_from_data_name = "pixel_image_create_from_data";
+string pixel_image_create_aligned_name = "pixel_image_create_aligned";
+string pixel_image_replicate_border_name = "pixel_image_replicate_border";
 string pixel_image_destroy_name = "pixel_image_destroy";
 string pixel_image_nullify_name = "pixel_image_nullify";
 string pixel_image_convert_name = "pixel_image_convert";
 string pixel_image_create_roi_name = "pixel_image_create_roi";
 string pixel_image_clone_name = "pixel_image_clone";
 string pixel_image_copy_name = "pixel_image_copy";
+string pixel_image_copy_changes_name = "pixel_image_copy_changes";
 string pixel_image_clear_name = "pixel_image_clear";
 string pixel_image_read_name = "pixel_image_read";
+string pixel_image_read_mapped_name = "pixel_image_read_mapped";
+string pixel_image_create_mapped_name = "pixel_image_create_mapped";
+string pixel_image_write_mapped_name = "pixel_image_write_mapped";
+string pixel_image_unmap_name = "pixel_image_unmap";
 string pixel_image_write_name = "pixel_image_write";
+string pixel_image_calculate_statistics_byte_name =
+  "pixel_image_calculate_statistics_byte";
+string pixel_image_calculate_statistics_byte_parallel_name =
+  "pixel_image_calculate_statistics_byte_parallel";
+string pixel_image_read_row_name = "pixel_image_read_row";
+string pixel_image_write_row_name = "pixel_image_write_row";
+string pnm_row_source_open_name = "pnm_row_source_open";
+string pnm_row_source_close_name = "pnm_row_source_close";
+string pnm_row_source_nullify_name = "pnm_row_source_nullify";
+string pnm_row_source_read_name = "pnm_row_source_read";
+string yuv_row_source_open_name = "yuv_row_source_open";
+string yuv_row_source_set_frame_name = "yuv_row_source_set_frame";
+string yuv_row_source_close_name = "yuv_row_source_close";
+string yuv_row_source_nullify_name = "yuv_row_source_nullify";
+string yuv_row_source_read_name = "yuv_row_source_read";
 string normalize_name = "normalize";
 string normalize_byte_name = "normalize_byte";
 string normalize_char_name = "normalize_char";
@@ -75,6 +116,42 @@ string convert_uyvy16_to_yuv24_name = "convert_uyvy16_to_yuv24";
 string convert_yuyv16_to_grey8_name = "convert_yuyv16_to_grey8";
 string pick_1_channel_from_3_channels_name = "pick_1_channel_from_3_channels";
 
+/******************************************************************************/
+/* private function for getting the size of one pixel value in bytes         */
+
+uint32 pixel_type_size
+(
+  pixel_type type
+)
+{
+  switch (type) {
+  case p_U8:
+    return sizeof(uint8);
+  case p_S8:
+    return sizeof(sint8);
+  case p_U16:
+    return sizeof(uint16);
+  case p_S16:
+    return sizeof(sint16);
+  case p_U32:
+    return sizeof(uint32);
+  case p_S32:
+    return sizeof(sint32);
+  case p_U64:
+    return sizeof(uint64);
+  case p_S64:
+    return sizeof(sint64);
+  case p_F32:
+    return sizeof(real32);
+  case p_F64:
+    return sizeof(real64);
+  case p_U32I:
+    return sizeof(uint32i);
+  default:
+    return 0;
+  }
+}
+
 /******************************************************************************/
 /* private function for initializing the pixel_image structure                */
 
@@ -120,36 +197,15 @@ result pixel_image_init
   target->step = step;
   target->stride = stride;
   target->size = size;
+  target->border = 0;
+  target->mapping = NULL;
+  target->mapping_size = 0;
 
-  CHECK(memory_allocate((data_pointer *)&target->rows, height, sizeof(data_pointer *)));
-  switch (type) {
-  case p_U8:
-      pixel_size = sizeof(uint8);
-      break;
-  case p_S8:
-      pixel_size = sizeof(sint8);
-      break;
-  case p_U16:
-      pixel_size = sizeof(uint16);
-      break;
-  case p_S16:
-      pixel_size = sizeof(sint16);
-      break;
-  case p_U32:
-      pixel_size = sizeof(uint32);
-      break;
-  case p_S32:
-      pixel_size = sizeof(sint32);
-      break;
-  case p_F32:
-      pixel_size = sizeof(real32);
-      break;
-  case p_F64:
-      pixel_size = sizeof(real64);
-      break;
-  default:
-      ERROR(BAD_TYPE);
+  pixel_size = pixel_type_size(type);
+  if (pixel_size == 0) {
+    ERROR(BAD_TYPE);
   }
+  CHECK(memory_allocate((data_pointer *)&target->rows, height, sizeof(data_pointer *)));
 
   for (i = 0, row = (data_pointer *)target->rows; i < target->height; i++, row++) {
       *row = (data_pointer)target->data + ((target->dy + i) * target->stride + target->dx * target->step + target->offset) * pixel_size;
@@ -206,39 +262,16 @@ result pixel_image_create
 {
   TRY();
   data_pointer data;
-  uint32 size;
+  uint32 size, pixel_size;
 
   CHECK_POINTER(target);
 
   size = height * stride;
-  switch (type) {
-  case p_U8:
-    CHECK(memory_allocate(&data, size, sizeof(uint8)));
-    break;
-  case p_S8:
-    CHECK(memory_allocate(&data, size, sizeof(sint8)));
-    break;
-  case p_U16:
-    CHECK(memory_allocate(&data, size, sizeof(uint16)));
-    break;
-  case p_S16:
-    CHECK(memory_allocate(&data, size, sizeof(sint16)));
-    break;
-  case p_U32:
-    CHECK(memory_allocate(&data, size, sizeof(uint32)));
-    break;
-  case p_S32:
-    CHECK(memory_allocate(&data, size, sizeof(sint32)));
-    break;
-  case p_F32:
-    CHECK(memory_allocate(&data, size, sizeof(real32)));
-    break;
-  case p_F64:
-    CHECK(memory_allocate(&data, size, sizeof(real64)));
-    break;
-  default:
+  pixel_size = pixel_type_size(type);
+  if (pixel_size == 0) {
     ERROR(BAD_TYPE);
   }
+  CHECK(memory_allocate_aligned(&data, size, pixel_size));
 
   CHECK(pixel_image_init(target, data, type, format, 0, 0, width, height, 0, step, stride, size));
 
@@ -248,6 +281,99 @@ result pixel_image_create
 
 /******************************************************************************/
 
+result pixel_image_create_aligned
+(
+  pixel_image *target,
+  pixel_type type,
+  pixel_format format,
+  uint32 width,
+  uint32 height,
+  uint32 step,
+  uint32 border
+)
+{
+  TRY();
+  data_pointer data;
+  uint32 value_size, pixel_bytes, unit, left, row_bytes, stride, size;
+
+  CHECK_POINTER(target);
+  CHECK_PARAM(step > 0);
+
+  value_size = pixel_type_size(type);
+  if (value_size == 0) {
+    ERROR(BAD_TYPE);
+  }
+  pixel_bytes = step * value_size;
+  /* the left border is widened so that the first pixel of each row is */
+  /* aligned; unit is the smallest number of pixels with aligned size   */
+  for (unit = MEMORY_ALIGNMENT; unit > 1 && (unit / 2) * pixel_bytes %
+       MEMORY_ALIGNMENT == 0; unit /= 2);
+  left = ((border + unit - 1) / unit) * unit;
+  row_bytes = (left + width + border) * pixel_bytes + MEMORY_ALIGNMENT;
+  row_bytes = ((row_bytes + MEMORY_ALIGNMENT - 1) / MEMORY_ALIGNMENT) *
+              MEMORY_ALIGNMENT;
+  stride = row_bytes / value_size;
+  size = (height + 2 * border) * stride;
+
+  CHECK(memory_allocate_aligned(&data, size, value_size));
+  /* the padding is cleared so that reading it gives defined values */
+  CHECK(memory_clear(data, size, value_size));
+  CHECK(pixel_image_init(target, data, type, format, left, border, width,
+                         height, 0, step, stride, size));
+  target->border = border;
+
+  FINALLY(pixel_image_create_aligned);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result pixel_image_replicate_border
+(
+  pixel_image *target
+)
+{
+  TRY();
+  data_pointer row, edge;
+  uint32 value_size, pixel_bytes, row_bytes, border, i, y;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->data);
+  CHECK_PARAM(target->parent == NULL);
+
+  border = target->border;
+  if (border == 0 || target->width == 0 || target->height == 0) {
+    TERMINATE(SUCCESS);
+  }
+  value_size = pixel_type_size(target->type);
+  pixel_bytes = target->step * value_size;
+  row_bytes = (target->width + 2 * border) * pixel_bytes;
+
+  /* first extend the image rows to the left and right */
+  for (y = 0; y < target->height; y++) {
+    row = target->rows[y];
+    for (i = 1; i <= border; i++) {
+      memcpy(row - i * pixel_bytes, row, pixel_bytes);
+      memcpy(row + (target->width - 1 + i) * pixel_bytes,
+             row + (target->width - 1) * pixel_bytes, pixel_bytes);
+    }
+  }
+  /* then copy the extended first and last rows up and down */
+  for (i = 1; i <= border; i++) {
+    edge = target->rows[0] - border * pixel_bytes;
+    row = edge - i * target->stride * value_size;
+    memcpy(row, edge, row_bytes);
+    edge = target->rows[target->height - 1] - border * pixel_bytes;
+    row = edge + i * target->stride * value_size;
+    memcpy(row, edge, row_bytes);
+  }
+
+  FINALLY(pixel_image_replicate_border);
+  RETURN();
+}
+
+/******************************************************************************/
+
 result pixel_image_create_from_data
 (
   pixel_image *target,
@@ -269,43 +395,40 @@ result pixel_image_create_from_data
   size = height * stride;
 
   CHECK(pixel_image_create(target, type, format, width, height, step, stride));
-  {
-    size_t pixel_size;
-    switch (type) {
-    case p_U8:
-      pixel_size = sizeof(uint8);
-      break;
-    case p_S8:
-      pixel_size = sizeof(sint8);
-      break;
-    case p_U16:
-      pixel_size = sizeof(uint16);
-      break;
-    case p_S16:
-      pixel_size = sizeof(sint16);
-      break;
-    case p_U32:
-      pixel_size = sizeof(uint32);
-      break;
-    case p_S32:
-      pixel_size = sizeof(sint32);
-      break;
-    case p_F32:
-      pixel_size = sizeof(real32);
-      break;
-    case p_F64:
-      pixel_size = sizeof(real64);
-      break;
-    default:
-      ERROR(BAD_TYPE);
-    }
-    memory_copy(target->data, data, size, pixel_size);
-  }
+  memory_copy(target->data, data, size, pixel_type_size(type));
 
   FINALLY(pixel_image_create_from_data);
   RETURN();
 }
 
+/******************************************************************************/
+/* private function for releasing the mapped file of an image                 */
+
+result pixel_image_unmap
+(
+  pixel_image *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->mapping);
+
+#if (FILE_MAPPING_METHOD == FILE_MAPPING_WITH_MMAP)
+  if (munmap(target->mapping, target->mapping_size) != 0) {
+    ERROR(INPUT_ERROR);
+  }
+#else
+  ERROR(NOT_IMPLEMENTED);
+#endif
+  target->mapping = NULL;
+  target->mapping_size = 0;
+  target->data = NULL;
+
+  FINALLY(pixel_image_unmap);
+  RETURN();
+}
+
 /******************************************************************************/
 
 result pixel_image_destroy
@@ -319,7 +442,12 @@ result pixel_image_destroy
 
   /* don't delete if target has a parent, that's parent's responsibility */
   if (target->parent == NULL) {
-    CHECK(memory_deallocate((data_pointer*)&target->data));
+    if (target->mapping != NULL) {
+      CHECK(pixel_image_unmap(target));
+    }
+    else {
+      CHECK(memory_deallocate_aligned((data_pointer*)&target->data));
+    }
   }
   CHECK(memory_deallocate((data_pointer*)&target->rows));
   CHECK(pixel_image_nullify(target));
@@ -352,6 +480,9 @@ result pixel_image_nullify
   target->step = 0;
   target->stride = 0;
   target->size = 0;
+  target->border = 0;
+  target->mapping = NULL;
+  target->mapping_size = 0;
 
   FINALLY(pixel_image_nullify);
   RETURN();
@@ -380,11 +511,8 @@ result pixel_image_convert
   pixel_image *target
 )
 {
-  pixel_image *temp;
   TRY();
 
-  temp = NULL;
-
   CHECK_POINTER(source);
   CHECK_POINTER(target);
 
@@ -443,9 +571,6 @@ result pixel_image_convert
   }
 
   FINALLY(pixel_image_convert);
-  if (temp != NULL) {
-      pixel_image_free(temp);
-  }
   RETURN();
 }
 
@@ -489,8 +614,16 @@ result pixel_image_clone
   TRY();
   CHECK_POINTER(source);
 
-  CHECK(pixel_image_create(target, source->type, source->format, source->width,
-                           source->height, source->step, source->stride));
+  if (source->border > 0) {
+    CHECK(pixel_image_create_aligned(target, source->type, source->format,
+                                     source->width, source->height,
+                                     source->step, source->border));
+  }
+  else {
+    CHECK(pixel_image_create(target, source->type, source->format,
+                             source->width, source->height, source->step,
+                             source->stride));
+  }
 
   FINALLY(pixel_image_clone);
   RETURN();
@@ -505,6 +638,7 @@ result pixel_image_copy
 )
 {
   TRY();
+  uint32 y, pixel_size;
 
   CHECK_POINTER(source);
   CHECK_POINTER(target);
@@ -516,115 +650,17 @@ result pixel_image_copy
   CHECK_PARAM(source->height == target->height);
   CHECK_PARAM(source->step == target->step);
 
+  pixel_size = pixel_type_size(source->type);
+  if (pixel_size == 0) {
+    ERROR(BAD_TYPE);
+  }
   if (pixel_image_is_continuous(source) && pixel_image_is_continuous(target)) {
-    size_t pixel_size;
-    switch (source->type) {
-    case p_U8:
-      pixel_size = sizeof(uint8);
-      break;
-    case p_S8:
-      pixel_size = sizeof(sint8);
-      break;
-    case p_U16:
-      pixel_size = sizeof(uint16);
-      break;
-    case p_S16:
-      pixel_size = sizeof(sint16);
-      break;
-    case p_U32:
-      pixel_size = sizeof(uint32);
-      break;
-    case p_S32:
-      pixel_size = sizeof(sint32);
-      break;
-    case p_F32:
-      pixel_size = sizeof(real32);
-      break;
-    case p_F64:
-      pixel_size = sizeof(real64);
-      break;
-    default:
-      ERROR(BAD_TYPE);
-    }
     memory_copy(target->data, source->data, source->size, pixel_size);
   }
   else {
-    uint32 x, y;
-    switch (source->type) {
-    case p_U8:
-      {
-        DISCONTINUOUS_IMAGE_VARIABLES(byte, byte);
-        FOR_2_DISCONTINUOUS_IMAGE_ROWS()
-            memory_copy((data_pointer)POINTER_TO_PIXEL(target),
-                        (data_pointer)POINTER_TO_PIXEL(source),
-                        source->width * source_step, sizeof(byte));
-      }
-      break;
-    case p_S8:
-      {
-        DISCONTINUOUS_IMAGE_VARIABLES(sint8, sint8);
-        FOR_2_DISCONTINUOUS_IMAGE_ROWS()
-            memory_copy((data_pointer)POINTER_TO_PIXEL(target),
-                        (data_pointer)POINTER_TO_PIXEL(source),
-                        source->width * source_step, sizeof(sint8));
-      }
-      break;
-    case p_U16:
-      {
-        DISCONTINUOUS_IMAGE_VARIABLES(word, word);
-        FOR_2_DISCONTINUOUS_IMAGE_ROWS()
-            memory_copy((data_pointer)POINTER_TO_PIXEL(target),
-                        (data_pointer)POINTER_TO_PIXEL(source),
-                        source->width * source_step, sizeof(word));
-      }
-      break;
-    case p_S16:
-      {
-        DISCONTINUOUS_IMAGE_VARIABLES(sint16, sint16);
-        FOR_2_DISCONTINUOUS_IMAGE_ROWS()
-            memory_copy((data_pointer)POINTER_TO_PIXEL(target),
-                        (data_pointer)POINTER_TO_PIXEL(source),
-                        source->width * source_step, sizeof(sint16));
-      }
-      break;
-    case p_U32:
-      {
-        DISCONTINUOUS_IMAGE_VARIABLES(dword, dword);
-        FOR_2_DISCONTINUOUS_IMAGE_ROWS()
-            memory_copy((data_pointer)POINTER_TO_PIXEL(target),
-                        (data_pointer)POINTER_TO_PIXEL(source),
-                        source->width * source_step, sizeof(dword));
-      }
-      break;
-    case p_S32:
-      {
-        DISCONTINUOUS_IMAGE_VARIABLES(sint32, sint32);
-        FOR_2_DISCONTINUOUS_IMAGE_ROWS()
-            memory_copy((data_pointer)POINTER_TO_PIXEL(target),
-                        (data_pointer)POINTER_TO_PIXEL(source),
-                        source->width * source_step, sizeof(sint32));
-      }
-      break;
-    case p_F32:
-      {
-        DISCONTINUOUS_IMAGE_VARIABLES(real32, real32);
-        FOR_2_DISCONTINUOUS_IMAGE_ROWS()
-            memory_copy((data_pointer)POINTER_TO_PIXEL(target),
-                        (data_pointer)POINTER_TO_PIXEL(source),
-                        source->width * source_step, sizeof(real32));
-      }
-      break;
-    case p_F64:
-      {
-        DISCONTINUOUS_IMAGE_VARIABLES(real64, real64);
-        FOR_2_DISCONTINUOUS_IMAGE_ROWS()
-            memory_copy((data_pointer)POINTER_TO_PIXEL(target),
-                        (data_pointer)POINTER_TO_PIXEL(source),
-                      source->width * source_step, sizeof(real64));
-      }
-      break;
-    default:
-      ERROR(BAD_TYPE);
+    for (y = 0; y < source->height; y++) {
+      memory_copy((data_pointer)target->rows[y], (data_pointer)source->rows[y],
+                  source->width * source->step, pixel_size);
     }
   }
 
@@ -634,117 +670,98 @@ result pixel_image_copy
 
 /******************************************************************************/
 
+result pixel_image_copy_changes
+(
+  pixel_image *target,
+  const pixel_image *source,
+  sint32 *x,
+  sint32 *y,
+  sint32 *dx,
+  sint32 *dy
+)
+{
+  TRY();
+  byte *target_row, *source_row;
+  uint32 row, first, last, left, right, row_size, i;
+
+  CHECK_POINTER(source);
+  CHECK_POINTER(target);
+  CHECK_POINTER(source->data);
+  CHECK_POINTER(target->data);
+  CHECK_POINTER(x);
+  CHECK_POINTER(y);
+  CHECK_POINTER(dx);
+  CHECK_POINTER(dy);
+  CHECK_PARAM(source->type == p_U8);
+  CHECK_PARAM(target->type == p_U8);
+  CHECK_PARAM(source->width == target->width);
+  CHECK_PARAM(source->height == target->height);
+  CHECK_PARAM(source->step == target->step);
+
+  row_size = source->width * source->step;
+  /* left and right are the element range of the changes, first and last */
+  /* are the row range; empty ranges have the start after the end */
+  first = source->height;
+  last = 0;
+  left = row_size;
+  right = 0;
+  for (row = 0; row < source->height; row++) {
+    source_row = (byte *)source->rows[row];
+    target_row = (byte *)target->rows[row];
+    if (memcmp(source_row, target_row, row_size) != 0) {
+      if (row < first) first = row;
+      last = row + 1;
+      /* only the parts outside the current range need to be compared */
+      for (i = 0; i < left && source_row[i] == target_row[i]; i++);
+      left = i;
+      for (i = row_size; i > right && source_row[i - 1] == target_row[i - 1];
+           i--);
+      right = i;
+      memcpy(target_row, source_row, row_size);
+    }
+  }
+
+  if (first < last) {
+    *x = (sint32)(left / source->step);
+    *y = (sint32)first;
+    *dx = (sint32)((right + source->step - 1) / source->step) - *x;
+    *dy = (sint32)(last - first);
+  }
+  else {
+    *x = 0;
+    *y = 0;
+    *dx = 0;
+    *dy = 0;
+  }
+
+  FINALLY(pixel_image_copy_changes);
+  RETURN();
+}
+
+/******************************************************************************/
+
 result pixel_image_clear
 (
   pixel_image *target
 )
 {
   TRY();
+  uint32 y, pixel_size;
 
   CHECK_POINTER(target);
   CHECK_POINTER(target->data);
 
+  pixel_size = pixel_type_size(target->type);
+  if (pixel_size == 0) {
+    ERROR(BAD_TYPE);
+  }
   if (pixel_image_is_continuous(target)) {
-    size_t pixel_size;
-    switch (target->type) {
-    case p_U8:
-      pixel_size = sizeof(uint8);
-      break;
-    case p_S8:
-      pixel_size = sizeof(sint8);
-      break;
-    case p_U16:
-      pixel_size = sizeof(uint16);
-      break;
-    case p_S16:
-      pixel_size = sizeof(sint16);
-      break;
-    case p_U32:
-      pixel_size = sizeof(uint32);
-      break;
-    case p_S32:
-      pixel_size = sizeof(sint32);
-      break;
-    case p_F32:
-      pixel_size = sizeof(real32);
-      break;
-    case p_F64:
-      pixel_size = sizeof(real64);
-      break;
-    default:
-      ERROR(BAD_TYPE);
-    }
     memory_clear((data_pointer)target->data, target->size, pixel_size);
   }
   else {
-    uint32 x, y;
-    switch (target->type) {
-    case p_U8:
-      {
-        SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(target, byte);
-        FOR_DISCONTINUOUS_IMAGE_ROW(target)
-            memory_clear((data_pointer)POINTER_TO_PIXEL(target),
-                         target->width * target_step, sizeof(byte));
-      }
-      break;
-    case p_S8:
-      {
-        SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(target, char);
-        FOR_DISCONTINUOUS_IMAGE_ROW(target)
-            memory_clear((data_pointer)POINTER_TO_PIXEL(target),
-                         target->width * target_step, sizeof(char));
-      }
-      break;
-    case p_U16:
-      {
-        SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(target, word);
-        FOR_DISCONTINUOUS_IMAGE_ROW(target)
-            memory_clear((data_pointer)POINTER_TO_PIXEL(target),
-                         target->width * target_step, sizeof(word));
-      }
-      break;
-    case p_S16:
-      {
-        SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(target, sint16);
-        FOR_DISCONTINUOUS_IMAGE_ROW(target)
-            memory_clear((data_pointer)POINTER_TO_PIXEL(target),
-                         target->width * target_step, sizeof(sint16));
-      }
-      break;
-    case p_U32:
-      {
-        SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(target, dword);
-        FOR_DISCONTINUOUS_IMAGE_ROW(target)
-            memory_clear((data_pointer)POINTER_TO_PIXEL(target),
-                         target->width * target_step, sizeof(dword));
-      }
-      break;
-    case p_S32:
-      {
-        SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(target, sint32);
-        FOR_DISCONTINUOUS_IMAGE_ROW(target)
-            memory_clear((data_pointer)POINTER_TO_PIXEL(target),
-                         target->width * target_step, sizeof(sint32));
-      }
-      break;
-    case p_F32:
-      {
-        SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(target, real32);
-        FOR_DISCONTINUOUS_IMAGE_ROW(target)
-            memory_clear((data_pointer)POINTER_TO_PIXEL(target),
-                         target->width * target_step, sizeof(real32));
-      }
-      break;
-    case p_F64:
-      {
-        SINGLE_DISCONTINUOUS_IMAGE_VARIABLES(target, real64);
-        FOR_DISCONTINUOUS_IMAGE_ROW(target)
-            memory_clear((data_pointer)POINTER_TO_PIXEL(target),
-                         target->width * target_step, sizeof(real64));
-      }
-      break;
-    default:
-      ERROR(BAD_TYPE);
+    for (y = 0; y < target->height; y++) {
+      memory_clear((data_pointer)target->rows[y],
+                   target->width * target->step, pixel_size);
     }
   }
 
@@ -1131,33 +1148,294 @@ result pixel_image_write
 }
 
 /******************************************************************************/
+/* private function for parsing the header of a binary pnm file in memory;    */
+/* returns the offset of the pixel data, or 0 if the header is not valid;     */
+/* the fields must be between 1 and PNM_MAX_HEADER_VALUE                      */
 
-truth_value pixel_image_is_continuous
+#define PNM_MAX_HEADER_VALUE 2147483647UL
+
+uint32 parse_pnm_header
 (
-  const pixel_image *image
+  const byte *data,
+  uint32 size,
+  uint32 *number,
+  uint32 *width,
+  uint32 *height,
+  uint32 *maxval
 )
 {
-  if (image == NULL) {
-    return FALSE;
+  uint32 pos, field, value, digit;
+  uint32 *fields[3];
+
+  /* P1 and P4 have no maxval, so only the formats with three fields */
+  if (size < 3 || data[0] != 'P' || data[1] < '2' || data[1] > '6' ||
+      data[1] == '4') {
+    return 0;
   }
-  if (image->width * image->step != image->stride) {
-    return FALSE;
+  *number = (uint32)(data[1] - '0');
+  fields[0] = width;
+  fields[1] = height;
+  fields[2] = maxval;
+  pos = 2;
+  for (field = 0; field < 3; field++) {
+    /* whitespace and comments are allowed between the header fields */
+    while (pos < size && (data[pos] == ' ' || data[pos] == '\t' ||
+           data[pos] == '\n' || data[pos] == '\r' || data[pos] == '#')) {
+      if (data[pos] == '#') {
+        while (pos < size && data[pos] != '\n' && data[pos] != '\r') {
+          pos++;
+        }
+      }
+      else {
+        pos++;
+      }
+    }
+    if (pos >= size || data[pos] < '0' || data[pos] > '9') {
+      return 0;
+    }
+    for (value = 0; pos < size && data[pos] >= '0' && data[pos] <= '9';
+         pos++) {
+      digit = (uint32)(data[pos] - '0');
+      if (value > (PNM_MAX_HEADER_VALUE - digit) / 10) {
+        return 0;
+      }
+      value = 10 * value + digit;
+    }
+    if (value == 0) {
+      return 0;
+    }
+    *fields[field] = value;
   }
-  if (image->dx > 0 || image->dy > 0) {
-    return FALSE;
+  /* allowing only one whitespace after header and no comment */
+  if (pos >= size) {
+    return 0;
   }
-  return TRUE;
+  return pos + 1;
 }
 
 /******************************************************************************/
+/* private function for calculating the size of the pixel data of a pnm file; */
+/* returns FALSE if the size does not fit in uint32                           */
 
-result normalize
+truth_value pnm_data_size
 (
-  pixel_image *source,
-  pixel_image *target
+  uint32 width,
+  uint32 height,
+  uint32 step,
+  uint32 *size
 )
 {
-  TRY();
+  uint32 max;
+
+  max = ~(uint32)0;
+  if (width == 0 || height == 0 || width > max / step ||
+      height > max / (width * step)) {
+    return FALSE;
+  }
+  *size = width * step * height;
+  return TRUE;
+}
+
+/******************************************************************************/
+
+result pixel_image_read_mapped
+(
+  pixel_image *target,
+  string source
+)
+{
+  TRY();
+  byte *mapping;
+  uint32 mapping_size, offset, number, width, height, maxval, step, size;
+#if (FILE_MAPPING_METHOD == FILE_MAPPING_WITH_MMAP)
+  int file;
+  struct stat file_stat;
+#endif
+
+  mapping = NULL;
+  mapping_size = 0;
+  CHECK_POINTER(target);
+  CHECK_POINTER(source);
+
+#if (FILE_MAPPING_METHOD == FILE_MAPPING_WITH_MMAP)
+  file = open(source, O_RDONLY);
+  if (file < 0) {
+    ERROR(INPUT_ERROR);
+  }
+  if (fstat(file, &file_stat) != 0 || file_stat.st_size <= 0 ||
+      (off_t)(uint32)file_stat.st_size != file_stat.st_size) {
+    close(file);
+    ERROR(INPUT_ERROR);
+  }
+  mapping_size = (uint32)file_stat.st_size;
+  /* a private mapping allows modifying the pixels without changing the file */
+  mapping = (byte *)mmap(NULL, mapping_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, file, 0);
+  close(file);
+  if (mapping == (byte *)MAP_FAILED) {
+    mapping = NULL;
+    ERROR(INPUT_ERROR);
+  }
+#else
+  ERROR(NOT_IMPLEMENTED);
+#endif
+
+  offset = parse_pnm_header(mapping, mapping_size, &number, &width, &height,
+                            &maxval);
+  if (offset == 0) {
+    ERROR(INPUT_ERROR);
+  }
+  /* only binary 8-bit greyscale and rgb images are used without copying */
+  if ((number != 5 && number != 6) || maxval > 255) {
+    ERROR(NOT_IMPLEMENTED);
+  }
+  step = (number == 6) ? 3 : 1;
+  /* the size is checked for overflow, as the header comes from the file */
+  if (IS_FALSE(pnm_data_size(width, height, step, &size)) ||
+      mapping_size - offset < size) {
+    ERROR(INPUT_ERROR);
+  }
+
+  CHECK(pixel_image_init(target, mapping + offset, p_U8,
+                         (number == 6) ? RGB : GREY, 0, 0, width, height, 0,
+                         step, step * width, size));
+  target->mapping = mapping;
+  target->mapping_size = mapping_size;
+
+  FINALLY(pixel_image_read_mapped);
+#if (FILE_MAPPING_METHOD == FILE_MAPPING_WITH_MMAP)
+  if (r != SUCCESS && mapping != NULL) {
+    munmap(mapping, mapping_size);
+  }
+#endif
+  RETURN();
+}
+
+/******************************************************************************/
+
+result pixel_image_create_mapped
+(
+  pixel_image *target,
+  string source,
+  pixel_format format,
+  uint32 width,
+  uint32 height
+)
+{
+  TRY();
+  byte *mapping;
+  char header[80];
+  uint32 mapping_size, offset, step, size;
+#if (FILE_MAPPING_METHOD == FILE_MAPPING_WITH_MMAP)
+  int file;
+#endif
+
+  mapping = NULL;
+  mapping_size = 0;
+  CHECK_POINTER(target);
+  CHECK_POINTER(source);
+  CHECK_PARAM(format == GREY || format == RGB);
+  /* the file must be readable with the same limits as when reading */
+  CHECK_PARAM(width <= PNM_MAX_HEADER_VALUE && height <= PNM_MAX_HEADER_VALUE);
+
+  step = (format == RGB) ? 3 : 1;
+  offset = (uint32)sprintf(header, "P%d\n# Created by cvsu\n%lu %lu %d\n",
+                           (format == RGB) ? 6 : 5, width, height, 255);
+  if (IS_FALSE(pnm_data_size(width, height, step, &size)) ||
+      size > ~(uint32)0 - offset) {
+    ERROR(BAD_PARAM);
+  }
+  mapping_size = offset + size;
+
+#if (FILE_MAPPING_METHOD == FILE_MAPPING_WITH_MMAP)
+  file = open(source, O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (file < 0) {
+    ERROR(INPUT_ERROR);
+  }
+  /* the file is sized before mapping, the pages are written by the kernel */
+  if (ftruncate(file, (off_t)mapping_size) != 0) {
+    close(file);
+    ERROR(INPUT_ERROR);
+  }
+  mapping = (byte *)mmap(NULL, mapping_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, file, 0);
+  close(file);
+  if (mapping == (byte *)MAP_FAILED) {
+    mapping = NULL;
+    ERROR(INPUT_ERROR);
+  }
+#else
+  ERROR(NOT_IMPLEMENTED);
+#endif
+
+  memcpy(mapping, header, offset);
+  CHECK(pixel_image_init(target, mapping + offset, p_U8, format, 0, 0, width,
+                         height, 0, step, step * width, size));
+  target->mapping = mapping;
+  target->mapping_size = mapping_size;
+
+  FINALLY(pixel_image_create_mapped);
+#if (FILE_MAPPING_METHOD == FILE_MAPPING_WITH_MMAP)
+  if (r != SUCCESS && mapping != NULL) {
+    munmap(mapping, mapping_size);
+  }
+#endif
+  RETURN();
+}
+
+/******************************************************************************/
+
+result pixel_image_write_mapped
+(
+  pixel_image *source,
+  string target
+)
+{
+  TRY();
+  pixel_image mapped;
+
+  CHECK(pixel_image_nullify(&mapped));
+  CHECK_POINTER(source);
+  CHECK_POINTER(target);
+  CHECK_PARAM(source->type == p_U8);
+
+  CHECK(pixel_image_create_mapped(&mapped, target, source->format,
+                                  source->width, source->height));
+  CHECK(pixel_image_copy(&mapped, source));
+
+  FINALLY(pixel_image_write_mapped);
+  pixel_image_destroy(&mapped);
+  RETURN();
+}
+
+/******************************************************************************/
+
+truth_value pixel_image_is_continuous
+(
+  const pixel_image *image
+)
+{
+  if (image == NULL) {
+    return FALSE;
+  }
+  if (image->width * image->step != image->stride) {
+    return FALSE;
+  }
+  if (image->dx > 0 || image->dy > 0) {
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/******************************************************************************/
+
+result normalize
+(
+  pixel_image *source,
+  pixel_image *target
+)
+{
+  TRY();
   CHECK_POINTER(source);
   CHECK_POINTER(target);
   CHECK_PARAM(source->width == target->width);
@@ -1206,7 +1484,6 @@ result normalize_##type\
   type mean\
 )\
 {\
-  type value;\
   double factor;\
   uint32 i;\
   int temp;
@@ -1215,12 +1492,11 @@ result normalize_##type\
 
 #define CHECK_MINMAX()\
   {\
-    value = *source_pos;\
-    if (value < min) {\
-        min = value;\
+    if (*source_pos < min) {\
+        min = *source_pos;\
     }\
-    else if (value > max) {\
-        max = value;\
+    else if (*source_pos > max) {\
+        max = *source_pos;\
     }\
   }
 
@@ -1235,6 +1511,7 @@ result normalize_##type\
 
 NORMALIZE_FUNCTION_BEGIN(byte)
   TRY();
+  image_statistics stat;
 
   CHECK_POINTER(source);
   CHECK_POINTER(target);
@@ -1246,11 +1523,9 @@ NORMALIZE_FUNCTION_BEGIN(byte)
     CONTINUOUS_IMAGE_VARIABLES(byte, byte);
     for (i = 0; i < source->step; i++) {
       if (min == 0 && max == 0) {
-        min = PIXEL_VALUE(source);
-        max = min;
-
-        FOR_CONTINUOUS_IMAGE_WITH_OFFSET(source, i)
-          CHECK_MINMAX()
+        CHECK(pixel_image_calculate_statistics_byte(source, i, &stat));
+        min = stat.min;
+        max = stat.max;
       }
       factor = 256.0 / (double)(max - min);
 
@@ -1263,11 +1538,9 @@ NORMALIZE_FUNCTION_BEGIN(byte)
     DISCONTINUOUS_IMAGE_VARIABLES(byte, byte);
     for (i = 0; i < source->step; i++) {
       if (min == 0 && max == 0) {
-        min = PIXEL_VALUE(source);
-        max = min;
-
-        FOR_DISCONTINUOUS_IMAGE_WITH_OFFSET(source, i)
-          CHECK_MINMAX()
+        CHECK(pixel_image_calculate_statistics_byte(source, i, &stat));
+        min = stat.min;
+        max = stat.max;
       }
       factor = 256.0 / (double)(max - min);
 
@@ -1524,6 +1797,476 @@ NORMALIZE_FUNCTION_BEGIN(double)
   RETURN();
 NORMALIZE_FUNCTION_END()
 
+/******************************************************************************/
+/* private row functions for the vectorized color conversions; each function */
+/* converts one row of pixels, and converts the pixels that don't fill a     */
+/* whole vector with scalar code, so the results equal those of the scalar   */
+/* conversions                                                                */
+
+typedef void (*convert_row_function)
+(
+  const byte *source,
+  byte *target,
+  uint32 width
+);
+
+/* the conversions of single pixels, shared by the scalar conversions and */
+/* the vector tails                                                        */
+
+#define CONVERT_RGB_TO_GREY(target, Rb, Gb, Bb)\
+  {\
+    sint32 grey;\
+    grey = (int)(0.30 * (Rb) + 0.59 * (Gb) + 0.11 * (Bb));\
+    grey = TRUNC(grey, 0, 255);\
+    (target) = (byte)grey;\
+  }
+
+#define CONVERT_RGB_TO_YUV(target, Rb, Gb, Bb)\
+  {\
+    double r_value, g_value, b_value, y_value, u_value, v_value;\
+    r_value = (double)(Rb) / 255.0;\
+    g_value = (double)(Gb) / 255.0;\
+    b_value = (double)(Bb) / 255.0;\
+    y_value = ( 0.29900 * r_value) + ( 0.58700 * g_value) +\
+              ( 0.11400 * b_value);\
+    u_value = (-0.14713 * r_value) + (-0.28886 * g_value) +\
+              ( 0.43600 * b_value);\
+    v_value = ( 0.61500 * r_value) + (-0.51499 * g_value) +\
+              (-0.10001 * b_value);\
+    (target)[0] = (byte)(y_value * 255);\
+    (target)[1] = (byte)(((u_value + 0.436) / (2 * 0.436)) * 255);\
+    (target)[2] = (byte)(((v_value + 0.615) / (2 * 0.615)) * 255);\
+  }
+
+#define CONVERT_YUV_TO_RGB(target, Yb, Ub, Vb)\
+  {\
+    double y_value, u_value, v_value, r_value, g_value, b_value;\
+    y_value = ((double)(Yb) / 255.0);\
+    u_value = (((double)(Ub) / 255.0) * 2.0 * 0.436) - 0.436;\
+    v_value = (((double)(Vb) / 255.0) * 2.0 * 0.615) - 0.615;\
+    r_value = ( y_value + 0.00000 * u_value + 1.13983 * v_value);\
+    g_value = ( y_value - 0.39465 * u_value - 0.58060 * v_value);\
+    b_value = ( y_value + 2.03211 * u_value + 0.00000 * v_value);\
+    (target)[0] = (byte)(r_value * 255);\
+    (target)[1] = (byte)(g_value * 255);\
+    (target)[2] = (byte)(b_value * 255);\
+  }
+
+#ifdef HAVE_X86_SIMD
+
+#define CONVERT_ROW_KERNEL(function) (&function)
+
+/* creates a mask for picking one byte out of every three into 32-bit lanes */
+#define SIMD_MASK_3_CHANNELS_TO_EPI32(c)\
+  _mm_setr_epi8((c), -1, -1, -1, (c) + 3, -1, -1, -1,\
+                (c) + 6, -1, -1, -1, (c) + 9, -1, -1, -1)
+
+/* loads one channel of four three-channel pixels as doubles */
+#define SIMD_LOAD_CHANNEL_PD(v, mask)\
+  _mm256_cvtepi32_pd(_mm_shuffle_epi8(v, mask))
+
+/* stores the low bytes of three vectors of four 32-bit lanes as four        */
+/* three-channel pixels, without touching the bytes after the last pixel     */
+#define SIMD_STORE_3_CHANNELS_4(target, c0, c1, c2)\
+  {\
+    __m128i packed;\
+    int last;\
+    packed = _mm_or_si128(_mm_or_si128(_mm_and_si128(c0, low),\
+             _mm_slli_epi32(_mm_and_si128(c1, low), 8)),\
+             _mm_slli_epi32(_mm_and_si128(c2, low), 16));\
+    packed = _mm_shuffle_epi8(packed, compress);\
+    _mm_storel_epi64((__m128i *)(target), packed);\
+    last = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));\
+    memcpy((target) + 8, &last, 4);\
+  }
+
+#define SIMD_DEFINE_STORE_3_CHANNELS()\
+  low = _mm_set1_epi32(0xFF);\
+  compress = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,\
+                           -1, -1, -1, -1)
+
+SIMD_TARGET_AVX2
+void convert_grey8_to_grey24_row_avx2
+(
+  const byte *source,
+  byte *target,
+  uint32 width
+)
+{
+  __m128i v, m0, m1, m2;
+  uint32 x;
+
+  m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+  m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+  m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15,
+                     15, 15);
+  for (x = 0; x + 16 <= width; x += 16) {
+    v = _mm_loadu_si128((const __m128i *)(source + x));
+    _mm_storeu_si128((__m128i *)(target + 3 * x), _mm_shuffle_epi8(v, m0));
+    _mm_storeu_si128((__m128i *)(target + 3 * x + 16), _mm_shuffle_epi8(v, m1));
+    _mm_storeu_si128((__m128i *)(target + 3 * x + 32), _mm_shuffle_epi8(v, m2));
+  }
+  for (; x < width; x++) {
+    target[3 * x] = target[3 * x + 1] = target[3 * x + 2] = source[x];
+  }
+}
+
+SIMD_TARGET_AVX2
+void convert_grey8_to_yuv24_row_avx2
+(
+  const byte *source,
+  byte *target,
+  uint32 width
+)
+{
+  __m128i v, m0, m1, m2, k0, k1, k2, zero, chroma;
+  uint32 x;
+
+  /* the chroma bytes are left empty by the masks and filled with 128 */
+  m0 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+  m1 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10,
+                     -1);
+  m2 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15,
+                     -1, -1);
+  zero = _mm_setzero_si128();
+  chroma = _mm_set1_epi8(-128);
+  k0 = _mm_and_si128(_mm_cmplt_epi8(m0, zero), chroma);
+  k1 = _mm_and_si128(_mm_cmplt_epi8(m1, zero), chroma);
+  k2 = _mm_and_si128(_mm_cmplt_epi8(m2, zero), chroma);
+  for (x = 0; x + 16 <= width; x += 16) {
+    v = _mm_loadu_si128((const __m128i *)(source + x));
+    _mm_storeu_si128((__m128i *)(target + 3 * x),
+                     _mm_or_si128(_mm_shuffle_epi8(v, m0), k0));
+    _mm_storeu_si128((__m128i *)(target + 3 * x + 16),
+                     _mm_or_si128(_mm_shuffle_epi8(v, m1), k1));
+    _mm_storeu_si128((__m128i *)(target + 3 * x + 32),
+                     _mm_or_si128(_mm_shuffle_epi8(v, m2), k2));
+  }
+  for (; x < width; x++) {
+    target[3 * x] = source[x];
+    target[3 * x + 1] = 128;
+    target[3 * x + 2] = 128;
+  }
+}
+
+SIMD_TARGET_AVX2
+void convert_rgb24_to_grey8_row_avx2
+(
+  const byte *source,
+  byte *target,
+  uint32 width
+)
+{
+  __m128i v, mr, mg, mb, value;
+  __m256d R, G, B, cr, cg, cb;
+  uint32 x;
+  int packed;
+
+  mr = SIMD_MASK_3_CHANNELS_TO_EPI32(0);
+  mg = SIMD_MASK_3_CHANNELS_TO_EPI32(1);
+  mb = SIMD_MASK_3_CHANNELS_TO_EPI32(2);
+  cr = _mm256_set1_pd(0.30);
+  cg = _mm256_set1_pd(0.59);
+  cb = _mm256_set1_pd(0.11);
+  /* four pixels are converted, but 16 bytes are loaded */
+  for (x = 0; x + 6 <= width; x += 4) {
+    v = _mm_loadu_si128((const __m128i *)(source + 3 * x));
+    R = SIMD_LOAD_CHANNEL_PD(v, mr);
+    G = SIMD_LOAD_CHANNEL_PD(v, mg);
+    B = SIMD_LOAD_CHANNEL_PD(v, mb);
+    value = _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_add_pd(
+            _mm256_mul_pd(cr, R), _mm256_mul_pd(cg, G)), _mm256_mul_pd(cb, B)));
+    /* saturating packs truncate the values to 0..255 */
+    value = _mm_packus_epi16(_mm_packs_epi32(value, value), value);
+    packed = _mm_cvtsi128_si32(value);
+    memcpy(target + x, &packed, 4);
+  }
+  for (; x < width; x++) {
+    CONVERT_RGB_TO_GREY(target[x], source[3 * x], source[3 * x + 1],
+                        source[3 * x + 2]);
+  }
+}
+
+SIMD_TARGET_AVX2
+void convert_rgb24_to_yuv24_row_avx2
+(
+  const byte *source,
+  byte *target,
+  uint32 width
+)
+{
+  __m128i v, mr, mg, mb, low, compress, Yi, Ui, Vi;
+  __m256d R, G, B, Y, U, V, k255, k255i, ku, kv, su, sv;
+  uint32 x;
+
+  mr = SIMD_MASK_3_CHANNELS_TO_EPI32(0);
+  mg = SIMD_MASK_3_CHANNELS_TO_EPI32(1);
+  mb = SIMD_MASK_3_CHANNELS_TO_EPI32(2);
+  SIMD_DEFINE_STORE_3_CHANNELS();
+  k255 = _mm256_set1_pd(255.0);
+  k255i = _mm256_set1_pd(255);
+  ku = _mm256_set1_pd(0.436);
+  kv = _mm256_set1_pd(0.615);
+  su = _mm256_set1_pd(2 * 0.436);
+  sv = _mm256_set1_pd(2 * 0.615);
+  for (x = 0; x + 6 <= width; x += 4) {
+    v = _mm_loadu_si128((const __m128i *)(source + 3 * x));
+    R = _mm256_div_pd(SIMD_LOAD_CHANNEL_PD(v, mr), k255);
+    G = _mm256_div_pd(SIMD_LOAD_CHANNEL_PD(v, mg), k255);
+    B = _mm256_div_pd(SIMD_LOAD_CHANNEL_PD(v, mb), k255);
+    Y = _mm256_add_pd(_mm256_add_pd(
+          _mm256_mul_pd(_mm256_set1_pd(0.29900), R),
+          _mm256_mul_pd(_mm256_set1_pd(0.58700), G)),
+          _mm256_mul_pd(_mm256_set1_pd(0.11400), B));
+    U = _mm256_add_pd(_mm256_add_pd(
+          _mm256_mul_pd(_mm256_set1_pd(-0.14713), R),
+          _mm256_mul_pd(_mm256_set1_pd(-0.28886), G)),
+          _mm256_mul_pd(_mm256_set1_pd(0.43600), B));
+    V = _mm256_add_pd(_mm256_add_pd(
+          _mm256_mul_pd(_mm256_set1_pd(0.61500), R),
+          _mm256_mul_pd(_mm256_set1_pd(-0.51499), G)),
+          _mm256_mul_pd(_mm256_set1_pd(-0.10001), B));
+    Yi = _mm256_cvttpd_epi32(_mm256_mul_pd(Y, k255i));
+    Ui = _mm256_cvttpd_epi32(_mm256_mul_pd(
+           _mm256_div_pd(_mm256_add_pd(U, ku), su), k255i));
+    Vi = _mm256_cvttpd_epi32(_mm256_mul_pd(
+           _mm256_div_pd(_mm256_add_pd(V, kv), sv), k255i));
+    SIMD_STORE_3_CHANNELS_4(target + 3 * x, Yi, Ui, Vi);
+  }
+  for (; x < width; x++) {
+    CONVERT_RGB_TO_YUV(target + 3 * x, source[3 * x], source[3 * x + 1],
+                       source[3 * x + 2]);
+  }
+}
+
+SIMD_TARGET_AVX2
+void convert_yuv24_to_rgb24_row_avx2
+(
+  const byte *source,
+  byte *target,
+  uint32 width
+)
+{
+  __m128i v, my, mu, mv, low, compress, Ri, Gi, Bi;
+  __m256d R, G, B, Y, U, V, k255, k255i, k2, ku, kv;
+  uint32 x;
+
+  my = SIMD_MASK_3_CHANNELS_TO_EPI32(0);
+  mu = SIMD_MASK_3_CHANNELS_TO_EPI32(1);
+  mv = SIMD_MASK_3_CHANNELS_TO_EPI32(2);
+  SIMD_DEFINE_STORE_3_CHANNELS();
+  k255 = _mm256_set1_pd(255.0);
+  k255i = _mm256_set1_pd(255);
+  k2 = _mm256_set1_pd(2.0);
+  ku = _mm256_set1_pd(0.436);
+  kv = _mm256_set1_pd(0.615);
+  for (x = 0; x + 6 <= width; x += 4) {
+    v = _mm_loadu_si128((const __m128i *)(source + 3 * x));
+    Y = _mm256_div_pd(SIMD_LOAD_CHANNEL_PD(v, my), k255);
+    U = _mm256_sub_pd(_mm256_mul_pd(_mm256_mul_pd(
+          _mm256_div_pd(SIMD_LOAD_CHANNEL_PD(v, mu), k255), k2), ku), ku);
+    V = _mm256_sub_pd(_mm256_mul_pd(_mm256_mul_pd(
+          _mm256_div_pd(SIMD_LOAD_CHANNEL_PD(v, mv), k255), k2), kv), kv);
+    /* the terms multiplied by zero don't change the results */
+    R = _mm256_add_pd(Y, _mm256_mul_pd(_mm256_set1_pd(1.13983), V));
+    G = _mm256_sub_pd(_mm256_sub_pd(Y,
+          _mm256_mul_pd(_mm256_set1_pd(0.39465), U)),
+          _mm256_mul_pd(_mm256_set1_pd(0.58060), V));
+    B = _mm256_add_pd(Y, _mm256_mul_pd(_mm256_set1_pd(2.03211), U));
+    /* like the scalar conversion, keeps the low byte of the integer value */
+    Ri = _mm256_cvttpd_epi32(_mm256_mul_pd(R, k255i));
+    Gi = _mm256_cvttpd_epi32(_mm256_mul_pd(G, k255i));
+    Bi = _mm256_cvttpd_epi32(_mm256_mul_pd(B, k255i));
+    SIMD_STORE_3_CHANNELS_4(target + 3 * x, Ri, Gi, Bi);
+  }
+  for (; x < width; x++) {
+    CONVERT_YUV_TO_RGB(target + 3 * x, source[3 * x], source[3 * x + 1],
+                       source[3 * x + 2]);
+  }
+}
+
+SIMD_TARGET_AVX2
+void convert_yuv24_to_grey8_row_avx2
+(
+  const byte *source,
+  byte *target,
+  uint32 width
+)
+{
+  __m128i m0, m1, m2;
+  uint32 x;
+
+  m0 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                     -1);
+  m1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1,
+                     -1);
+  m2 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10,
+                     13);
+  for (x = 0; x + 16 <= width; x += 16) {
+    _mm_storeu_si128((__m128i *)(target + x), _mm_or_si128(_mm_or_si128(
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(source + 3 * x)), m0),
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(source + 3 * x + 16)),
+                       m1)),
+      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(source + 3 * x + 32)),
+                       m2)));
+  }
+  for (; x < width; x++) {
+    target[x] = source[3 * x];
+  }
+}
+
+/* picks the y values of 16 two-channel pixels, y_shift is 8 for uyvy and 0 */
+/* for yuyv */
+#define SIMD_PICK_Y_16(source, y_shift)\
+  _mm_packus_epi16(\
+    _mm_and_si128(_mm_srli_epi16(_mm_loadu_si128(\
+      (const __m128i *)(source)), y_shift), low),\
+    _mm_and_si128(_mm_srli_epi16(_mm_loadu_si128(\
+      (const __m128i *)((source) + 16)), y_shift), low))
+
+SIMD_TARGET_SSE2
+void convert_uyvy16_to_grey8_row_sse2
+(
+  const byte *source,
+  byte *target,
+  uint32 width
+)
+{
+  __m128i low;
+  uint32 x;
+
+  low = _mm_set1_epi16(0xFF);
+  for (x = 0; x + 16 <= width; x += 16) {
+    _mm_storeu_si128((__m128i *)(target + x), SIMD_PICK_Y_16(source + 2 * x, 8));
+  }
+  for (; x < width; x++) {
+    target[x] = source[2 * x + 1];
+  }
+}
+
+SIMD_TARGET_SSE2
+void convert_yuyv16_to_grey8_row_sse2
+(
+  const byte *source,
+  byte *target,
+  uint32 width
+)
+{
+  __m128i low;
+  uint32 x;
+
+  low = _mm_set1_epi16(0xFF);
+  for (x = 0; x + 16 <= width; x += 16) {
+    _mm_storeu_si128((__m128i *)(target + x), SIMD_PICK_Y_16(source + 2 * x, 0));
+  }
+  for (; x < width; x++) {
+    target[x] = source[2 * x];
+  }
+}
+
+/* each pair of pixels u y1 v y2 becomes y1 u v y2 u v; requires even width */
+SIMD_TARGET_AVX2
+void convert_uyvy16_to_yuv24_row_avx2
+(
+  const byte *source,
+  byte *target,
+  uint32 width
+)
+{
+  __m128i v, m0, m1;
+  uint32 x;
+
+  m0 = _mm_setr_epi8(1, 0, 2, 3, 0, 2, 5, 4, 6, 7, 4, 6, 9, 8, 10, 11);
+  m1 = _mm_setr_epi8(8, 10, 13, 12, 14, 15, 12, 14, -1, -1, -1, -1, -1, -1,
+                     -1, -1);
+  for (x = 0; x + 8 <= width; x += 8) {
+    v = _mm_loadu_si128((const __m128i *)(source + 2 * x));
+    _mm_storeu_si128((__m128i *)(target + 3 * x), _mm_shuffle_epi8(v, m0));
+    _mm_storel_epi64((__m128i *)(target + 3 * x + 16), _mm_shuffle_epi8(v, m1));
+  }
+  for (; x + 2 <= width; x += 2) {
+    target[3 * x]     = source[2 * x + 1];
+    target[3 * x + 1] = source[2 * x];
+    target[3 * x + 2] = source[2 * x + 2];
+    target[3 * x + 3] = source[2 * x + 3];
+    target[3 * x + 4] = source[2 * x];
+    target[3 * x + 5] = source[2 * x + 2];
+  }
+}
+
+#else
+
+#define CONVERT_ROW_KERNEL(function) NULL
+
+#endif /* HAVE_X86_SIMD */
+
+/* selects the row function for the current simd level; the row functions */
+/* are used only when the rows start at the first channel of the pixels    */
+
+convert_row_function convert_get_row_function
+(
+  const pixel_image *source,
+  const pixel_image *target,
+  convert_row_function sse2,
+  convert_row_function avx2
+)
+{
+  if (source->offset != 0 || target->offset != 0) {
+    return NULL;
+  }
+  switch (simd_get_level()) {
+  case s_AVX2:
+    return (avx2 != NULL) ? avx2 : sse2;
+  case s_SSE2:
+    return sse2;
+  default:
+    return NULL;
+  }
+}
+
+void convert_rows
+(
+  const pixel_image *source,
+  pixel_image *target,
+  convert_row_function convert_row
+)
+{
+  uint32 y;
+
+  for (y = 0; y < source->height; y++) {
+    convert_row((const byte *)source->rows[y], (byte *)target->rows[y],
+                source->width);
+  }
+}
+
+/******************************************************************************/
+
+void convert_yuv422_row_to_grey8
+(
+  const byte *source,
+  byte *target,
+  uint32 width,
+  uint32 y_channel
+)
+{
+  uint32 x;
+
+#ifdef HAVE_X86_SIMD
+  if (simd_get_level() >= s_SSE2) {
+    if (y_channel == 1) {
+      convert_uyvy16_to_grey8_row_sse2(source, target, width);
+    }
+    else {
+      convert_yuyv16_to_grey8_row_sse2(source, target, width);
+    }
+    return;
+  }
+#endif
+  for (x = 0, source += y_channel; x < width; x++, source += 2) {
+    target[x] = *source;
+  }
+}
+
 /******************************************************************************/
 
 result convert_grey8_to_grey24
@@ -1533,6 +2276,7 @@ result convert_grey8_to_grey24
 )
 {
   TRY();
+  convert_row_function convert_row;
 
   CHECK_POINTER(source);
   CHECK_POINTER(target);
@@ -1547,6 +2291,12 @@ result convert_grey8_to_grey24
   CHECK_PARAM(source->width == target->width);
   CHECK_PARAM(source->height == target->height);
 
+  convert_row = convert_get_row_function(source, target,
+      NULL, CONVERT_ROW_KERNEL(convert_grey8_to_grey24_row_avx2));
+  if (convert_row != NULL) {
+    convert_rows(source, target, convert_row);
+  }
+  else
   if (pixel_image_is_continuous(source) && pixel_image_is_continuous(target)) {
     CONTINUOUS_IMAGE_VARIABLES(byte, byte);
     FOR_2_CONTINUOUS_IMAGES()
@@ -1582,6 +2332,7 @@ result convert_grey8_to_yuv24
 )
 {
   TRY();
+  convert_row_function convert_row;
 
   CHECK_POINTER(source);
   CHECK_POINTER(target);
@@ -1596,6 +2347,12 @@ result convert_grey8_to_yuv24
   CHECK_PARAM(source->width == target->width);
   CHECK_PARAM(source->height == target->height);
 
+  convert_row = convert_get_row_function(source, target,
+      NULL, CONVERT_ROW_KERNEL(convert_grey8_to_yuv24_row_avx2));
+  if (convert_row != NULL) {
+    convert_rows(source, target, convert_row);
+  }
+  else
   if (pixel_image_is_continuous(source) && pixel_image_is_continuous(target)) {
     CONTINUOUS_IMAGE_VARIABLES(byte, byte);
     FOR_2_CONTINUOUS_IMAGES()
@@ -1629,7 +2386,7 @@ result convert_rgb24_to_grey8
 )
 {
   TRY();
-  sint32 value;
+  convert_row_function convert_row;
 
   CHECK_POINTER(source);
   CHECK_POINTER(target);
@@ -1644,15 +2401,19 @@ result convert_rgb24_to_grey8
   CHECK_PARAM(source->width == target->width);
   CHECK_PARAM(source->height == target->height);
 
+  convert_row = convert_get_row_function(source, target,
+      NULL, CONVERT_ROW_KERNEL(convert_rgb24_to_grey8_row_avx2));
+  if (convert_row != NULL) {
+    convert_rows(source, target, convert_row);
+  }
+  else
   if (pixel_image_is_continuous(source) && pixel_image_is_continuous(target)) {
     CONTINUOUS_IMAGE_VARIABLES(byte, byte);
     FOR_2_CONTINUOUS_IMAGES()
     {
-      value = (int)(0.30 * PIXEL_VALUE(source) +
-                    0.59 * PIXEL_VALUE_PLUS(source, 1) +
-                    0.11 * PIXEL_VALUE_PLUS(source, 2));
-      value = TRUNC(value, 0, 255);
-      PIXEL_VALUE(target) = (byte)value;
+      CONVERT_RGB_TO_GREY(PIXEL_VALUE(target), PIXEL_VALUE(source),
+                          PIXEL_VALUE_PLUS(source, 1),
+                          PIXEL_VALUE_PLUS(source, 2));
     }
   }
   else {
@@ -1660,11 +2421,9 @@ result convert_rgb24_to_grey8
     DISCONTINUOUS_IMAGE_VARIABLES(byte, byte);
     FOR_2_DISCONTINUOUS_IMAGES()
     {
-      value = (int)(0.30 * PIXEL_VALUE(source) +
-                    0.59 * PIXEL_VALUE_PLUS(source, 1) +
-                    0.11 * PIXEL_VALUE_PLUS(source, 2));
-      value = TRUNC(value, 0, 255);
-      PIXEL_VALUE(target) = (byte)value;
+      CONVERT_RGB_TO_GREY(PIXEL_VALUE(target), PIXEL_VALUE(source),
+                          PIXEL_VALUE_PLUS(source, 1),
+                          PIXEL_VALUE_PLUS(source, 2));
     }
   }
 
@@ -1681,9 +2440,7 @@ result convert_rgb24_to_yuv24
 )
 {
   TRY();
-  byte R, G, B;
-  /*sint32 Y, U, V;*/
-  double  Y, U, V;
+  convert_row_function convert_row;
 
   CHECK_POINTER(source);
   CHECK_POINTER(target);
@@ -1698,27 +2455,19 @@ result convert_rgb24_to_yuv24
   CHECK_PARAM(source->width == target->width);
   CHECK_PARAM(source->height == target->height);
 
+  convert_row = convert_get_row_function(source, target,
+      NULL, CONVERT_ROW_KERNEL(convert_rgb24_to_yuv24_row_avx2));
+  if (convert_row != NULL) {
+    convert_rows(source, target, convert_row);
+  }
+  else
   if (pixel_image_is_continuous(source) && pixel_image_is_continuous(target)) {
     CONTINUOUS_IMAGE_VARIABLES(byte, byte);
     FOR_2_CONTINUOUS_IMAGES()
     {
-      R = PIXEL_VALUE(source);
-      G = PIXEL_VALUE_PLUS(source, 1);
-      B = PIXEL_VALUE_PLUS(source, 2);
-      Y = ( 0.29900 * ((double)R / 255.0)) + ( 0.58700 * ((double)G / 255.0)) + ( 0.11400 * ((double)B / 255.0));
-      U = (-0.14713 * ((double)R / 255.0)) + (-0.28886 * ((double)G / 255.0)) + ( 0.43600 * ((double)B / 255.0));
-      V = ( 0.61500 * ((double)R / 255.0)) + (-0.51499 * ((double)G / 255.0)) + (-0.10001 * ((double)B / 255.0));
-      /*
-      Y = ( 77 * R) + (150 * G) + ( 29 * B) + 128;
-      U = (-38 * R) + (-74 * G) + (112 * B) + 128;
-      V = (112 * R) + (-94 * G) + (-18 * B) + 128;
-      Y >>= 8;
-      U >>= 8;
-      V >>= 8;
-      */
-      PIXEL_VALUE(target)         = (byte)(Y * 255);
-      PIXEL_VALUE_PLUS(target, 1) = (byte)(((U + 0.436) / (2 * 0.436)) * 255);
-      PIXEL_VALUE_PLUS(target, 2) = (byte)(((V + 0.615) / (2 * 0.615)) * 255);
+      CONVERT_RGB_TO_YUV(target_pos, PIXEL_VALUE(source),
+                         PIXEL_VALUE_PLUS(source, 1),
+                         PIXEL_VALUE_PLUS(source, 2));
     }
   }
   else {
@@ -1726,23 +2475,9 @@ result convert_rgb24_to_yuv24
     DISCONTINUOUS_IMAGE_VARIABLES(byte, byte);
     FOR_2_DISCONTINUOUS_IMAGES()
     {
-      R = PIXEL_VALUE(source);
-      G = PIXEL_VALUE_PLUS(source, 1);
-      B = PIXEL_VALUE_PLUS(source, 2);
-      Y = ( 0.29900 * ((double)R / 255.0)) + ( 0.58700 * ((double)G / 255.0)) + ( 0.11400 * ((double)B / 255.0));
-      U = (-0.14713 * ((double)R / 255.0)) + (-0.28886 * ((double)G / 255.0)) + ( 0.43600 * ((double)B / 255.0));
-      V = ( 0.61500 * ((double)R / 255.0)) + (-0.51499 * ((double)G / 255.0)) + (-0.10001 * ((double)B / 255.0));
-      /*
-      Y = ( 77 * R) + (150 * G) + ( 29 * B) + 128;
-      U = (-38 * R) + (-74 * G) + (112 * B) + 128;
-      V = (112 * R) + (-94 * G) + (-18 * B) + 128;
-      Y >>= 8;
-      U >>= 8;
-      V >>= 8;
-      */
-      PIXEL_VALUE(target)         = (byte)(Y * 255);
-      PIXEL_VALUE_PLUS(target, 1) = (byte)(((U + 0.436) / (2 * 0.436)) * 255);
-      PIXEL_VALUE_PLUS(target, 2) = (byte)(((V + 0.615) / (2 * 0.615)) * 255);
+      CONVERT_RGB_TO_YUV(target_pos, PIXEL_VALUE(source),
+                         PIXEL_VALUE_PLUS(source, 1),
+                         PIXEL_VALUE_PLUS(source, 2));
     }
   }
 
@@ -1759,9 +2494,7 @@ result convert_yuv24_to_rgb24
 )
 {
   TRY();
-  byte Yb, Ub, Vb;
-  /*sint32 Y, U, V;*/
-  double Y, U, V, R, G, B;
+  convert_row_function convert_row;
 
   CHECK_POINTER(source);
   CHECK_POINTER(target);
@@ -1776,30 +2509,19 @@ result convert_yuv24_to_rgb24
   CHECK_PARAM(source->width == target->width);
   CHECK_PARAM(source->height == target->height);
 
+  convert_row = convert_get_row_function(source, target,
+      NULL, CONVERT_ROW_KERNEL(convert_yuv24_to_rgb24_row_avx2));
+  if (convert_row != NULL) {
+    convert_rows(source, target, convert_row);
+  }
+  else
   if (pixel_image_is_continuous(source) && pixel_image_is_continuous(target)) {
     CONTINUOUS_IMAGE_VARIABLES(byte, byte);
     FOR_2_CONTINUOUS_IMAGES()
     {
-      Yb = PIXEL_VALUE(source);
-      Ub = PIXEL_VALUE_PLUS(source, 1);
-      Vb = PIXEL_VALUE_PLUS(source, 2);
-      Y = ((double)Yb / 255.0);
-      U = (((double)Ub / 255.0) * 2.0 * 0.436) - 0.436;
-      V = (((double)Vb / 255.0) * 2.0 * 0.615) - 0.615;
-      R = ( Y + 0.00000 * U + 1.13983 * V);
-      G = ( Y - 0.39465 * U - 0.58060 * V);
-      B = ( Y + 2.03211 * U + 0.00000 * V);
-      /*
-      Y = ( 77 * R) + (150 * G) + ( 29 * B) + 128;
-      U = (-38 * R) + (-74 * G) + (112 * B) + 128;
-      V = (112 * R) + (-94 * G) + (-18 * B) + 128;
-      Y >>= 8;
-      U >>= 8;
-      V >>= 8;
-      */
-      PIXEL_VALUE(target)         = (byte)(R * 255);
-      PIXEL_VALUE_PLUS(target, 1) = (byte)(G * 255);
-      PIXEL_VALUE_PLUS(target, 2) = (byte)(B * 255);
+      CONVERT_YUV_TO_RGB(target_pos, PIXEL_VALUE(source),
+                         PIXEL_VALUE_PLUS(source, 1),
+                         PIXEL_VALUE_PLUS(source, 2));
     }
   }
   else {
@@ -1807,26 +2529,9 @@ result convert_yuv24_to_rgb24
     DISCONTINUOUS_IMAGE_VARIABLES(byte, byte);
     FOR_2_DISCONTINUOUS_IMAGES()
     {
-      Yb = PIXEL_VALUE(source);
-      Ub = PIXEL_VALUE_PLUS(source, 1);
-      Vb = PIXEL_VALUE_PLUS(source, 2);
-      Y = ((double)Yb / 255.0);
-      U = (((double)Ub / 255.0) * 2.0 * 0.436) - 0.436;
-      V = (((double)Vb / 255.0) * 2.0 * 0.615) - 0.615;
-      R = ( Y + 0.00000 * U + 1.13983 * V);
-      G = ( Y - 0.39465 * U - 0.58060 * V);
-      B = ( Y + 2.03211 * U + 0.00000 * V);
-      /*
-      Y = ( 77 * R) + (150 * G) + ( 29 * B) + 128;
-      U = (-38 * R) + (-74 * G) + (112 * B) + 128;
-      V = (112 * R) + (-94 * G) + (-18 * B) + 128;
-      Y >>= 8;
-      U >>= 8;
-      V >>= 8;
-      */
-      PIXEL_VALUE(target)         = (byte)(R * 255);
-      PIXEL_VALUE_PLUS(target, 1) = (byte)(G * 255);
-      PIXEL_VALUE_PLUS(target, 2) = (byte)(B * 255);
+      CONVERT_YUV_TO_RGB(target_pos, PIXEL_VALUE(source),
+                         PIXEL_VALUE_PLUS(source, 1),
+                         PIXEL_VALUE_PLUS(source, 2));
     }
   }
 
@@ -1843,6 +2548,7 @@ result convert_yuv24_to_grey8
 )
 {
   TRY();
+  convert_row_function convert_row;
   byte Y;
 
   CHECK_POINTER(source);
@@ -1858,6 +2564,12 @@ result convert_yuv24_to_grey8
   CHECK_PARAM(source->width == target->width);
   CHECK_PARAM(source->height == target->height);
 
+  convert_row = convert_get_row_function(source, target,
+      NULL, CONVERT_ROW_KERNEL(convert_yuv24_to_grey8_row_avx2));
+  if (convert_row != NULL) {
+    convert_rows(source, target, convert_row);
+  }
+  else
   if (pixel_image_is_continuous(source) && pixel_image_is_continuous(target)) {
     CONTINUOUS_IMAGE_VARIABLES(byte, byte);
     FOR_2_CONTINUOUS_IMAGES()
@@ -1889,6 +2601,7 @@ result convert_uyvy16_to_grey8
 )
 {
   TRY();
+  convert_row_function convert_row;
 
   CHECK_POINTER(source);
   CHECK_POINTER(target);
@@ -1904,6 +2617,12 @@ result convert_uyvy16_to_grey8
   CHECK_PARAM(source->height == target->height);
 
   /* simply copy y values from uyvy image to greyscale image */
+  convert_row = convert_get_row_function(source, target,
+      CONVERT_ROW_KERNEL(convert_uyvy16_to_grey8_row_sse2), NULL);
+  if (convert_row != NULL) {
+    convert_rows(source, target, convert_row);
+  }
+  else
   if (pixel_image_is_continuous(source) && pixel_image_is_continuous(target)) {
     CONTINUOUS_IMAGE_VARIABLES(byte, byte);
     /* y values are in second channel, so must apply offset 1 to source */
@@ -1938,6 +2657,7 @@ result convert_uyvy16_to_yuv24
 {
   byte y1,y2,u,v;
   TRY();
+  convert_row_function convert_row;
 
   CHECK_POINTER(source);
   CHECK_POINTER(target);
@@ -1955,6 +2675,12 @@ result convert_uyvy16_to_yuv24
   /* simply copy y value from second channel */
   /* u and v values are stored only once for two columnes */
   /* therefore, must read two columns at once */
+  convert_row = convert_get_row_function(source, target,
+      NULL, CONVERT_ROW_KERNEL(convert_uyvy16_to_yuv24_row_avx2));
+  if (convert_row != NULL && source->width % 2 == 0) {
+    convert_rows(source, target, convert_row);
+  }
+  else
   if (pixel_image_is_continuous(source) && pixel_image_is_continuous(target)) {
     CONTINUOUS_IMAGE_VARIABLES(byte, byte);
     FOR_2_CONTINUOUS_IMAGES()
@@ -2008,6 +2734,7 @@ result convert_yuyv16_to_grey8
 )
 {
   TRY();
+  convert_row_function convert_row;
 
   CHECK_POINTER(source);
   CHECK_POINTER(target);
@@ -2023,6 +2750,12 @@ result convert_yuyv16_to_grey8
   CHECK_PARAM(source->height == target->height);
 
   /* simply copy y values from uyvy image to greyscale image */
+  convert_row = convert_get_row_function(source, target,
+      CONVERT_ROW_KERNEL(convert_yuyv16_to_grey8_row_sse2), NULL);
+  if (convert_row != NULL) {
+    convert_rows(source, target, convert_row);
+  }
+  else
   if (pixel_image_is_continuous(source) && pixel_image_is_continuous(target)) {
     CONTINUOUS_IMAGE_VARIABLES(byte, byte);
     /* y values are in first channel, so must apply offset 0 to source */
@@ -2093,6 +2826,53 @@ result pick_1_channel_from_3_channels
 
 /******************************************************************************/
 
+/* private function for averaging the 2x2 blocks of two single-channel rows */
+/* into width target pixels; the source rows must have 2 * width pixels     */
+
+#ifdef HAVE_X86_SIMD
+
+SIMD_TARGET_SSE2
+void scale_down_row_sse2
+(
+  const byte *row_1,
+  const byte *row_2,
+  byte *target,
+  uint32 width
+)
+{
+  __m128i low, two, a, b, sum_lo, sum_hi;
+  uint32 x;
+
+  low = _mm_set1_epi16(0xFF);
+  two = _mm_set1_epi16(2);
+  for (x = 0; x + 16 <= width; x += 16) {
+    /* the horizontal pairs are added as 16-bit values */
+    a = _mm_loadu_si128((const __m128i *)(row_1 + 2 * x));
+    b = _mm_loadu_si128((const __m128i *)(row_2 + 2 * x));
+    sum_lo = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, low),
+                                         _mm_srli_epi16(a, 8)),
+                           _mm_add_epi16(_mm_and_si128(b, low),
+                                         _mm_srli_epi16(b, 8)));
+    a = _mm_loadu_si128((const __m128i *)(row_1 + 2 * x + 16));
+    b = _mm_loadu_si128((const __m128i *)(row_2 + 2 * x + 16));
+    sum_hi = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, low),
+                                         _mm_srli_epi16(a, 8)),
+                           _mm_add_epi16(_mm_and_si128(b, low),
+                                         _mm_srli_epi16(b, 8)));
+    sum_lo = _mm_srli_epi16(_mm_add_epi16(sum_lo, two), 2);
+    sum_hi = _mm_srli_epi16(_mm_add_epi16(sum_hi, two), 2);
+    _mm_storeu_si128((__m128i *)(target + x), _mm_packus_epi16(sum_lo, sum_hi));
+  }
+  for (; x < width; x++) {
+    target[x] = (byte)((row_1[2 * x] + row_1[2 * x + 1] +
+                        row_2[2 * x] + row_2[2 * x + 1] + 2) >> 2);
+  }
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/******************************************************************************/
+
 result scale_down
 (
   const pixel_image *source,
@@ -2100,6 +2880,8 @@ result scale_down
 )
 {
   TRY();
+  uint32 x, y, c, width, height, step, last, x_1, x_2;
+  byte *row_1, *row_2, *target_row;
 
   CHECK_POINTER(source);
   CHECK_POINTER(target);
@@ -2107,15 +2889,37 @@ result scale_down
   CHECK_POINTER(target->data);
   CHECK_PARAM(source->type == p_U8);
   CHECK_PARAM(target->type == p_U8);
+  CHECK_PARAM(source->step == target->step);
   CHECK_PARAM(2 * target->width >= source->width);
   CHECK_PARAM(2 * target->height >= source->height);
 
-  {
-    uint32 x, y;
-    IMAGE_WITH_STEP_VARIABLES(byte, byte);
-    FOR_2_IMAGES_WITH_STEP(2, 2, 1, 1)
-    {
-      PIXEL_VALUE(target) = PIXEL_VALUE(source);
+  /* odd last rows and cols are averaged with themselves */
+  width = (source->width + 1) / 2;
+  height = (source->height + 1) / 2;
+  step = source->step;
+  last = source->width - 1;
+  /* rows are processed from the top, so that the same image can be used as */
+  /* source and target; target values are never written before reading them */
+  for (y = 0; y < height; y++) {
+    row_1 = (byte *)source->rows[2 * y];
+    row_2 = (byte *)source->rows[(2 * y + 1 < source->height) ? 2 * y + 1 :
+                                                                2 * y];
+    target_row = (byte *)target->rows[y];
+    x = 0;
+#ifdef HAVE_X86_SIMD
+    if (step == 1 && simd_get_level() >= s_SSE2) {
+      x = source->width / 2;
+      scale_down_row_sse2(row_1, row_2, target_row, x);
+    }
+#endif
+    for (; x < width; x++) {
+      x_1 = 2 * x * step;
+      x_2 = ((2 * x + 1 < source->width) ? 2 * x + 1 : last) * step;
+      for (c = 0; c < step; c++) {
+        target_row[x * step + c] = (byte)((row_1[x_1 + c] + row_1[x_2 + c] +
+                                          row_2[x_1 + c] + row_2[x_2 + c] +
+                                          2) >> 2);
+      }
     }
   }
 
@@ -2336,5 +3140,576 @@ integral_value pixel_image_calculate_variance_byte
   }
 }
 
+/******************************************************************************/
+/* private structure and functions for gathering the histogram of a channel  */
+/* in strips; each pixel updates one of four histograms in turn, so that     */
+/* consecutive equal values do not wait for each other's counter updates     */
+
+typedef struct histogram_strips_t {
+  const pixel_image *source;
+  uint32 offset;
+  /* one histogram of 256 bins for each strip */
+  uint32 *histograms;
+} histogram_strips;
+
+void pixel_image_histogram_strip
+(
+  pointer params,
+  uint32 index,
+  uint32 count
+)
+{
+  histogram_strips *strips;
+  const pixel_image *source;
+  const byte *pos;
+  uint32 partial[4][256];
+  uint32 *histogram;
+  uint32 i, x, y, first, last, width, step;
+
+  strips = (histogram_strips *)params;
+  source = strips->source;
+  width = source->width;
+  step = source->step;
+  first = (source->height * index) / count;
+  last = (source->height * (index + 1)) / count;
+  memset(partial, 0, sizeof(partial));
+
+  for (y = first; y < last; y++) {
+    pos = (const byte *)source->rows[y] + strips->offset;
+    x = 0;
+    if (step == 1) {
+      for (; x + 4 <= width; x += 4, pos += 4) {
+        partial[0][pos[0]]++;
+        partial[1][pos[1]]++;
+        partial[2][pos[2]]++;
+        partial[3][pos[3]]++;
+      }
+    }
+    for (; x < width; x++, pos += step) {
+      partial[x & 3][*pos]++;
+    }
+  }
+
+  histogram = strips->histograms + 256 * index;
+  for (i = 0; i < 256; i++) {
+    histogram[i] = partial[0][i] + partial[1][i] + partial[2][i] +
+                   partial[3][i];
+  }
+}
+
+/******************************************************************************/
+
+result pixel_image_calculate_statistics_byte
+(
+  const pixel_image *source,
+  uint32 offset,
+  image_statistics *target
+)
+{
+  TRY();
+
+  CHECK(pixel_image_calculate_statistics_byte_parallel(source, offset, target,
+                                                       1));
+
+  FINALLY(pixel_image_calculate_statistics_byte);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result pixel_image_calculate_statistics_byte_parallel
+(
+  const pixel_image *source,
+  uint32 offset,
+  image_statistics *target,
+  uint32 threads
+)
+{
+  TRY();
+  histogram_strips strips;
+  integral_value N, sum, sum2, count, value, mean, var;
+  uint32 i, j;
+
+  strips.histograms = NULL;
+  CHECK_POINTER(source);
+  CHECK_POINTER(source->rows);
+  CHECK_POINTER(target);
+  CHECK_PARAM(source->type == p_U8);
+  CHECK_PARAM(offset < source->step);
+  CHECK_PARAM(threads > 0);
+
+  if (threads > source->height) {
+    threads = (source->height > 0) ? source->height : 1;
+  }
+  strips.source = source;
+  strips.offset = offset;
+  if (threads == 1) {
+    strips.histograms = target->histogram;
+    pixel_image_histogram_strip(&strips, 0, 1);
+  }
+  else {
+    CHECK(memory_allocate((data_pointer *)&strips.histograms, 256 * threads,
+                          sizeof(uint32)));
+    CHECK(parallel_run(&pixel_image_histogram_strip, &strips, threads));
+    for (i = 0; i < 256; i++) {
+      target->histogram[i] = 0;
+      for (j = 0; j < threads; j++) {
+        target->histogram[i] += strips.histograms[256 * j + i];
+      }
+    }
+  }
+
+  /* the sums are exact, as they are sums of integers well below 2^53 */
+  statistics_init(&target->stat);
+  target->min = 0;
+  target->max = 0;
+  N = 0;
+  sum = 0;
+  sum2 = 0;
+  for (i = 0; i < 256; i++) {
+    if (target->histogram[i] > 0) {
+      if (N == 0) {
+        target->min = (byte)i;
+      }
+      target->max = (byte)i;
+      count = (integral_value)target->histogram[i];
+      value = (integral_value)i;
+      N += count;
+      sum += count * value;
+      sum2 += count * value * value;
+    }
+  }
+  if (N > 0) {
+    mean = sum / N;
+    var = (sum2 / N) - mean*mean;
+    if (var < 0) var = 0;
+    target->stat.N = N;
+    target->stat.sum = sum;
+    target->stat.sum2 = sum2;
+    target->stat.mean = mean;
+    target->stat.variance = var;
+    target->stat.deviation = sqrt(var);
+  }
+
+  FINALLY(pixel_image_calculate_statistics_byte_parallel);
+  if (threads > 1) {
+    memory_deallocate((data_pointer *)&strips.histograms);
+  }
+  RETURN();
+}
+
+/******************************************************************************/
+/* row sources for processing images one row at a time                        */
+
+/* size of the stdio buffer used for reading rows sequentially from files     */
+#define ROW_SOURCE_FILE_BUFFER_SIZE 262144
+
+result pixel_image_read_row
+(
+  pointer params,
+  uint32 row,
+  byte *target
+)
+{
+  TRY();
+  pixel_image *source;
+  const byte *source_pos;
+  uint32 x, step;
+
+  CHECK_POINTER(params);
+  CHECK_POINTER(target);
+  source = (pixel_image *)params;
+  CHECK_POINTER(source->rows);
+  CHECK_PARAM(source->type == p_U8);
+  CHECK_PARAM(row < source->height);
+
+  step = source->step;
+  source_pos = (const byte *)source->rows[row];
+  if (step == 1) {
+    memcpy(target, source_pos, source->width);
+  }
+  else {
+    for (x = 0; x < source->width; x++, source_pos += step) {
+      target[x] = *source_pos;
+    }
+  }
+
+  FINALLY(pixel_image_read_row);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result pixel_image_write_row
+(
+  pointer params,
+  uint32 row,
+  const byte *source
+)
+{
+  TRY();
+  pixel_image *target;
+  byte *target_pos;
+  uint32 x, step;
+
+  CHECK_POINTER(params);
+  CHECK_POINTER(source);
+  target = (pixel_image *)params;
+  CHECK_POINTER(target->rows);
+  CHECK_PARAM(target->type == p_U8);
+  CHECK_PARAM(row < target->height);
+
+  step = target->step;
+  target_pos = (byte *)target->rows[row];
+  if (step == 1) {
+    memcpy(target_pos, source, target->width);
+  }
+  else {
+    for (x = 0; x < target->width; x++, target_pos += step) {
+      *target_pos = source[x];
+    }
+  }
+
+  FINALLY(pixel_image_write_row);
+  RETURN();
+}
+
+/******************************************************************************/
+/* private function for preparing a file for reading rows sequentially        */
+
+void row_source_prepare_file
+(
+  FILE *file
+)
+{
+  setvbuf(file, NULL, _IOFBF, ROW_SOURCE_FILE_BUFFER_SIZE);
+#if (FILE_MAPPING_METHOD == FILE_MAPPING_WITH_MMAP)
+  /* let the system read ahead while the previous rows are being processed */
+  posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+/******************************************************************************/
+
+result pnm_row_source_open
+(
+  pnm_row_source *target,
+  string source
+)
+{
+  TRY();
+  byte header[1024];
+  uint32 size, offset, number, width, height, maxval, step;
+  long file_size;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(source);
+  CHECK(pnm_row_source_nullify(target));
+
+  target->file = fopen(source, "rb");
+  if (target->file == NULL) {
+    ERROR(NOT_FOUND);
+  }
+  /* the buffering must be set before any other operation on the file */
+  row_source_prepare_file(target->file);
+  size = (uint32)fread(header, sizeof(byte), sizeof(header), target->file);
+  offset = parse_pnm_header(header, size, &number, &width, &height, &maxval);
+  if (offset == 0 || (number != 5 && number != 6) || maxval > 255) {
+    ERROR(INPUT_ERROR);
+  }
+  step = (number == 6) ? 3 : 1;
+  /* the rows are located with fseek, so the data must fit in a long */
+  if (IS_FALSE(pnm_data_size(width, height, step, &size)) ||
+      size > (uint32)LONG_MAX - offset) {
+    ERROR(INPUT_ERROR);
+  }
+  if (fseek(target->file, 0, SEEK_END) != 0) {
+    ERROR(INPUT_ERROR);
+  }
+  file_size = ftell(target->file);
+  if (file_size < (long)(offset + size)) {
+    ERROR(INPUT_ERROR);
+  }
+
+  target->width = width;
+  target->height = height;
+  target->step = step;
+  target->data_offset = (long)offset;
+  if (target->step > 1) {
+    CHECK(memory_allocate((data_pointer *)&target->buffer,
+                          target->step * width, sizeof(byte)));
+  }
+  if (fseek(target->file, target->data_offset, SEEK_SET) != 0) {
+    ERROR(INPUT_ERROR);
+  }
+
+  FINALLY(pnm_row_source_open);
+  if (r != SUCCESS) {
+    pnm_row_source_close(target);
+  }
+  RETURN();
+}
+
+/******************************************************************************/
+
+result pnm_row_source_close
+(
+  pnm_row_source *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  if (target->file != NULL) {
+    fclose(target->file);
+  }
+  CHECK(memory_deallocate((data_pointer *)&target->buffer));
+  CHECK(pnm_row_source_nullify(target));
+
+  FINALLY(pnm_row_source_close);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result pnm_row_source_nullify
+(
+  pnm_row_source *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  target->file = NULL;
+  target->width = 0;
+  target->height = 0;
+  target->step = 0;
+  target->data_offset = 0;
+  target->next_row = 0;
+  target->buffer = NULL;
+
+  FINALLY(pnm_row_source_nullify);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result pnm_row_source_read
+(
+  pointer params,
+  uint32 row,
+  byte *target
+)
+{
+  TRY();
+  pnm_row_source *source;
+  byte *source_pos;
+  uint32 x, row_size;
+
+  CHECK_POINTER(params);
+  CHECK_POINTER(target);
+  source = (pnm_row_source *)params;
+  CHECK_POINTER(source->file);
+  CHECK_PARAM(row < source->height);
+
+  row_size = source->step * source->width;
+  if (row != source->next_row) {
+    if (fseek(source->file, source->data_offset + (long)row * (long)row_size,
+              SEEK_SET) != 0) {
+      ERROR(INPUT_ERROR);
+    }
+  }
+  source_pos = (source->step == 1) ? target : source->buffer;
+  if (fread(source_pos, sizeof(byte), row_size, source->file) != row_size) {
+    ERROR(INPUT_ERROR);
+  }
+  source->next_row = row + 1;
+
+  if (source->step == 3) {
+    for (x = 0; x < source->width; x++, source_pos += 3) {
+      CONVERT_RGB_TO_GREY(target[x], source_pos[0], source_pos[1],
+                          source_pos[2]);
+    }
+  }
+
+  FINALLY(pnm_row_source_read);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result yuv_row_source_open
+(
+  yuv_row_source *target,
+  string source,
+  yuv_file_layout layout,
+  uint32 width,
+  uint32 height,
+  uint32 frame
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(source);
+  CHECK_PARAM(width > 0 && height > 0);
+  CHECK(yuv_row_source_nullify(target));
+
+  target->layout = layout;
+  target->width = width;
+  target->height = height;
+  switch (layout) {
+  case YUV_PACKED_UYVY:
+  case YUV_PACKED_YUYV:
+    CHECK_PARAM((width & 1) == 0);
+    target->row_size = 2 * width;
+    CHECK(memory_allocate((data_pointer *)&target->buffer, target->row_size,
+                          sizeof(byte)));
+    break;
+  case YUV_PLANAR_420:
+    target->row_size = width;
+    break;
+  default:
+    ERROR(BAD_PARAM);
+  }
+
+  target->file = fopen(source, "rb");
+  if (target->file == NULL) {
+    ERROR(NOT_FOUND);
+  }
+  row_source_prepare_file(target->file);
+  CHECK(yuv_row_source_set_frame(target, frame));
+
+  FINALLY(yuv_row_source_open);
+  if (r != SUCCESS) {
+    yuv_row_source_close(target);
+  }
+  RETURN();
+}
+
+/******************************************************************************/
+
+result yuv_row_source_set_frame
+(
+  yuv_row_source *target,
+  uint32 frame
+)
+{
+  TRY();
+  long frame_size;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->file);
+
+  if (target->layout == YUV_PLANAR_420) {
+    /* the chroma planes are subsampled by two in both directions */
+    frame_size = (long)(target->width * target->height) +
+        2 * (long)(((target->width + 1) / 2) * ((target->height + 1) / 2));
+  }
+  else {
+    frame_size = (long)(target->row_size * target->height);
+  }
+  target->frame_offset = (long)frame * frame_size;
+  if (fseek(target->file, target->frame_offset, SEEK_SET) != 0) {
+    ERROR(INPUT_ERROR);
+  }
+  target->next_row = 0;
+
+  FINALLY(yuv_row_source_set_frame);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result yuv_row_source_close
+(
+  yuv_row_source *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  if (target->file != NULL) {
+    fclose(target->file);
+  }
+  CHECK(memory_deallocate((data_pointer *)&target->buffer));
+  CHECK(yuv_row_source_nullify(target));
+
+  FINALLY(yuv_row_source_close);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result yuv_row_source_nullify
+(
+  yuv_row_source *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  target->file = NULL;
+  target->layout = YUV_PACKED_UYVY;
+  target->width = 0;
+  target->height = 0;
+  target->row_size = 0;
+  target->frame_offset = 0;
+  target->next_row = 0;
+  target->buffer = NULL;
+
+  FINALLY(yuv_row_source_nullify);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result yuv_row_source_read
+(
+  pointer params,
+  uint32 row,
+  byte *target
+)
+{
+  TRY();
+  yuv_row_source *source;
+  byte *source_pos;
+  uint32 row_size;
+
+  CHECK_POINTER(params);
+  CHECK_POINTER(target);
+  source = (yuv_row_source *)params;
+  CHECK_POINTER(source->file);
+  CHECK_PARAM(row < source->height);
+
+  row_size = source->row_size;
+  if (row != source->next_row) {
+    if (fseek(source->file, source->frame_offset + (long)row * (long)row_size,
+              SEEK_SET) != 0) {
+      ERROR(INPUT_ERROR);
+    }
+  }
+  source_pos = (source->layout == YUV_PLANAR_420) ? target : source->buffer;
+  if (fread(source_pos, sizeof(byte), row_size, source->file) != row_size) {
+    ERROR(INPUT_ERROR);
+  }
+  source->next_row = row + 1;
+
+  if (source->layout == YUV_PACKED_UYVY) {
+    convert_yuv422_row_to_grey8(source_pos, target, source->width, 1);
+  }
+  else
+  if (source->layout == YUV_PACKED_YUYV) {
+    convert_yuv422_row_to_grey8(source_pos, target, source->width, 0);
+  }
+
+  FINALLY(yuv_row_source_read);
+  RETURN();
+}
+
 /* end of file                                                                */
 /******************************************************************************/
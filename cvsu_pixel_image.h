@@ -39,6 +39,8 @@ extern "C" {
 #include "cvsu_config.h"
 #include "cvsu_types.h"
 
+#include <stdio.h>
+
 /**
  * Stores an image and its format description as an array of pixels.
  * Can be used also for referring to a region of interest (ROI) of an image.
@@ -70,6 +72,15 @@ typedef struct pixel_image_t {
   uint32 stride;
   /** Total number of elements in the @see data array */
   uint32 size;
+  /**
+   * Number of pixels allocated around the image on each side, that can be
+   * filled with @see pixel_image_replicate_border; 0 for regular images
+   */
+  uint32 border;
+  /** Start of the mapped file containing the data, NULL if not mapped */
+  pointer mapping;
+  /** Size of the mapped file in bytes */
+  uint32 mapping_size;
 } pixel_image;
 
 /* TODO: Consider:
@@ -94,7 +105,42 @@ void pixel_image_free
 );
 
 /**
- * Allocates data for a pixel image.
+ * Initializes a pixel image structure using existing data without copying it.
+ * The caller remains responsible for the data; set the parent if the image
+ * must not deallocate it.
+ * @see pixel_image_destroy
+ */
+result pixel_image_init
+(
+  /** Pointer to target struct where image is stored */
+  pixel_image *target,
+  /** Pointer to existing image data */
+  pointer data,
+  /** Data type used for storing the pixel values */
+  pixel_type type,
+  /** Pixel format for multi-channel images or GREY for greyscale */
+  pixel_format format,
+  /** Horizontal offset of the image within the data in pixels */
+  uint32 dx,
+  /** Vertical offset of the image within the data in pixels */
+  uint32 dy,
+  /** Width of image in pixels */
+  uint32 width,
+  /** Height of image in pixels */
+  uint32 height,
+  /** Offset of the first value, such as the channel of multi-channel data */
+  uint32 offset,
+  /** Step between columns of pixels (amount of channels per pixel) */
+  uint32 step,
+  /** Stride between rows of pixels (distance to same column on next row) */
+  uint32 stride,
+  /** Size of the data in values */
+  uint32 size
+);
+
+/**
+ * Allocates data for a pixel image. The data starts at a multiple of
+ * MEMORY_ALIGNMENT bytes.
  * @see pixel_image_destroy
  */
 result pixel_image_create
@@ -115,6 +161,43 @@ result pixel_image_create
   uint32 stride
 );
 
+/**
+ * Allocates data for a pixel image with SIMD-friendly rows. Each row starts
+ * at a multiple of MEMORY_ALIGNMENT bytes, and has at least MEMORY_ALIGNMENT
+ * bytes of readable padding after the last pixel, so that kernels can use
+ * aligned full-width vector loads without handling the row tails separately.
+ * The given number of border pixels is allocated around the image, and can be
+ * filled with @see pixel_image_replicate_border. The stride is chosen by the
+ * function.
+ * @see pixel_image_destroy
+ */
+result pixel_image_create_aligned
+(
+  /** Pointer to the target struct where the image is stored */
+  pixel_image *target,
+  /** Data type used for storing the pixel values */
+  pixel_type type,
+  /** Pixel format for multi-channel images or GREY for greyscale */
+  pixel_format format,
+  /** Width of image in pixels */
+  uint32 width,
+  /** Height of image in pixels */
+  uint32 height,
+  /** Step between columns of pixels (amount of channels per pixel) */
+  uint32 step,
+  /** Number of pixels allocated around the image on each side */
+  uint32 border
+);
+
+/**
+ * Fills the border pixels of an image created with
+ * @see pixel_image_create_aligned by replicating the nearest image pixels.
+ */
+result pixel_image_replicate_border
+(
+  pixel_image *target
+);
+
 /**
  * Creates a pixel image from existing data.
  * Make sure the data is of correct type, as defined in parameters.
@@ -208,6 +291,29 @@ result pixel_image_copy
   const pixel_image *source
 );
 
+/**
+ * Copies the contents of a byte image into the target image like
+ * @see pixel_image_copy, but writes only the rows that differ, and reports
+ * the bounding rectangle of the changed pixels. If nothing changed, the
+ * width and height of the rectangle are 0. Useful for updating only the
+ * changed part of the structures calculated from the target image.
+ */
+result pixel_image_copy_changes
+(
+  /** The target image, containing the previous contents. */
+  pixel_image *target,
+  /** The source image, containing the new contents. */
+  const pixel_image *source,
+  /** Left coordinate of the changed rectangle. */
+  sint32 *x,
+  /** Top coordinate of the changed rectangle. */
+  sint32 *y,
+  /** Width of the changed rectangle. */
+  sint32 *dx,
+  /** Height of the changed rectangle. */
+  sint32 *dy
+);
+
 /**
  * Resets the image contents to 0.
  */
@@ -235,6 +341,240 @@ result pixel_image_write
   truth_value use_ascii
 );
 
+/**
+ * Maps a binary 8-bit pgm or ppm file (P5 or P6) to memory and uses the pixel
+ * data in the mapping as the image data without copying it. Changes to the
+ * pixels are not written back to the file. The mapping is released by
+ * @see pixel_image_destroy.
+ */
+result pixel_image_read_mapped
+(
+  pixel_image *target,
+  string source
+);
+
+/**
+ * Creates a binary 8-bit pgm or ppm file with the size of the image, maps it
+ * to memory, and uses the pixel data in the mapping as the image data. The
+ * pixels written to the image end up in the file, which is completed when the
+ * image is destroyed with @see pixel_image_destroy.
+ */
+result pixel_image_create_mapped
+(
+  pixel_image *target,
+  /** Name of the file to create */
+  string source,
+  /** Pixel format, GREY or RGB */
+  pixel_format format,
+  uint32 width,
+  uint32 height
+);
+
+/**
+ * Writes the pixel image to a binary 8-bit pgm or ppm file through a memory
+ * mapping of the file, with a single copy of the pixel data.
+ * @see pixel_image_create_mapped
+ */
+result pixel_image_write_mapped
+(
+  pixel_image *source,
+  string target
+);
+
+/**
+ * Reads the given row of a single-channel source image into the buffer. Rows
+ * are requested in order; functions that need two passes over the image
+ * request the rows again starting from row 0.
+ */
+typedef result (*image_row_reader)
+(
+  pointer params,
+  uint32 row,
+  byte *target
+);
+
+/**
+ * Writes the given row of a single-channel result image. Rows are written in
+ * order.
+ */
+typedef result (*image_row_writer)
+(
+  pointer params,
+  uint32 row,
+  const byte *source
+);
+
+/**
+ * Reads rows from a pixel image in memory; the params is the pixel_image. For
+ * images with several channels, the channel at the image offset is read.
+ */
+result pixel_image_read_row
+(
+  pointer params,
+  uint32 row,
+  byte *target
+);
+
+/**
+ * Writes rows to a pixel image in memory; the params is the pixel_image. For
+ * images with several channels, the channel at the image offset is written.
+ */
+result pixel_image_write_row
+(
+  pointer params,
+  uint32 row,
+  const byte *source
+);
+
+/**
+ * Reads the rows of a binary 8-bit pgm or ppm file (P5 or P6) one at a time,
+ * so that only one row needs to be kept in memory. Color images are turned
+ * into greyscale while reading. Sequential reads use a large file buffer, and
+ * rows requested out of order cause a seek within the file.
+ */
+typedef struct pnm_row_source_t {
+  /** The file opened for reading */
+  FILE *file;
+  /** The width of the image */
+  uint32 width;
+  /** The height of the image */
+  uint32 height;
+  /** The number of channels in the file, 1 for pgm and 3 for ppm */
+  uint32 step;
+  /** The position of the pixel data in the file */
+  long data_offset;
+  /** The row that the file is positioned at */
+  uint32 next_row;
+  /** Buffer for one row of color values */
+  byte *buffer;
+} pnm_row_source;
+
+/**
+ * Opens a binary 8-bit pnm file for reading rows, and reads the image size
+ * from the header.
+ * @see pnm_row_source_close
+ */
+result pnm_row_source_open
+(
+  pnm_row_source *target,
+  string source
+);
+
+/**
+ * Closes the file and deallocates the row buffer.
+ */
+result pnm_row_source_close
+(
+  pnm_row_source *target
+);
+
+/**
+ * Nullifies the contents of the pnm_row_source. Does NOT close the file.
+ */
+result pnm_row_source_nullify
+(
+  pnm_row_source *target
+);
+
+/**
+ * Reads one row of the file; the params is the pnm_row_source.
+ */
+result pnm_row_source_read
+(
+  pointer params,
+  uint32 row,
+  byte *target
+);
+
+/**
+ * Pixel layouts of raw yuv video files without headers.
+ */
+typedef enum yuv_file_layout_t {
+  /** Packed 4:2:2 with bytes in order u y v y */
+  YUV_PACKED_UYVY = 0,
+  /** Packed 4:2:2 with bytes in order y u y v */
+  YUV_PACKED_YUYV,
+  /** Planar 4:2:0 (I420 or YV12), the y plane followed by the chroma planes */
+  YUV_PLANAR_420
+} yuv_file_layout;
+
+/**
+ * Reads the y values of one frame in a raw yuv video file one row at a time.
+ * The packed layouts are converted with @see convert_yuv422_row_to_grey8,
+ * and the y plane of the planar layout is read directly.
+ */
+typedef struct yuv_row_source_t {
+  /** The file opened for reading */
+  FILE *file;
+  /** The pixel layout of the file */
+  yuv_file_layout layout;
+  /** The width of the frames */
+  uint32 width;
+  /** The height of the frames */
+  uint32 height;
+  /** The number of bytes in one row of the file */
+  uint32 row_size;
+  /** The position of the selected frame in the file */
+  long frame_offset;
+  /** The row that the file is positioned at */
+  uint32 next_row;
+  /** Buffer for one row of packed values */
+  byte *buffer;
+} yuv_row_source;
+
+/**
+ * Opens a raw yuv file for reading the rows of the given frame.
+ * @see yuv_row_source_close
+ */
+result yuv_row_source_open
+(
+  yuv_row_source *target,
+  /** Name of the file to open */
+  string source,
+  /** Pixel layout of the file */
+  yuv_file_layout layout,
+  uint32 width,
+  uint32 height,
+  /** Index of the frame to read, starting from 0 */
+  uint32 frame
+);
+
+/**
+ * Selects another frame of the same file for reading.
+ */
+result yuv_row_source_set_frame
+(
+  yuv_row_source *target,
+  uint32 frame
+);
+
+/**
+ * Closes the file and deallocates the row buffer.
+ */
+result yuv_row_source_close
+(
+  yuv_row_source *target
+);
+
+/**
+ * Nullifies the contents of the yuv_row_source. Does NOT close the file.
+ */
+result yuv_row_source_nullify
+(
+  yuv_row_source *target
+);
+
+/**
+ * Reads the y values of one row of the frame; the params is the
+ * yuv_row_source.
+ */
+result yuv_row_source_read
+(
+  pointer params,
+  uint32 row,
+  byte *target
+);
+
 /**
  * Checks if the image is stored in a continuous block of memory, meaning
  * all pixels are stored one after another in memory. This information can be
@@ -259,6 +599,12 @@ result normalize
   pixel_image *target
 );
 
+/**
+ * Normalizes a byte image using the given range. If min and max are both 0,
+ * the range of each channel is found with
+ * @see pixel_image_calculate_statistics_byte; when the statistics are already
+ * known, passing their min and max avoids scanning the image again.
+ */
 result normalize_byte
 (
   pixel_image *source,
@@ -409,6 +755,23 @@ result convert_yuyv16_to_grey8(
     pixel_image *target
 );
 
+/**
+ * Converts one row of a two-channel uyvy or yuyv image into greyscale values
+ * by taking the values of the y channel. Allows combining the conversion with
+ * other processing of the same row while it is in cache.
+ */
+void convert_yuv422_row_to_grey8
+(
+  /** Pointer to the first pixel of the source row */
+  const byte *source,
+  /** Pointer to the first pixel of the target row */
+  byte *target,
+  /** Number of pixels in the row */
+  uint32 width,
+  /** Channel containing the y values; 1 for uyvy and 0 for yuyv */
+  uint32 y_channel
+);
+
 /**
  * Takes a 3-channel image and makes a 1-channel image selecting one channel.
  */
@@ -423,8 +786,9 @@ result pick_1_channel_from_3_channels
 );
 
 /**
- * Scales the image down by factor of two without smoothing.
- * Takes every other pixel on every other row.
+ * Scales the image down by factor of two by averaging each 2x2 block of
+ * pixels, so that small details don't cause aliasing. The last col and row
+ * of images with odd size are averaged with themselves.
  * Supports using the same image for both source and target.
  * This way, the function can be used for successive scale_downs and scale_ups.
  */
@@ -549,6 +913,50 @@ integral_value pixel_image_calculate_variance_byte
   uint32 offset
 );
 
+/**
+ * Stores the statistics of one channel of a byte image gathered in a single
+ * pass: the minimum and maximum values, the histogram, and the sums, mean and
+ * variance in a statistics structure.
+ */
+typedef struct image_statistics_t {
+  /** Number of pixels, sums, mean, variance and deviation */
+  statistics stat;
+  /** The smallest value in the channel */
+  byte min;
+  /** The largest value in the channel */
+  byte max;
+  /** Number of pixels with each value */
+  uint32 histogram[256];
+} image_statistics;
+
+/**
+ * Calculates the statistics of one channel of a byte image in a single pass.
+ * Only the histogram is gathered from the pixels, and the other values are
+ * derived from it, so the sums are exact and the mean and variance are the
+ * same as given by @see pixel_image_calculate_mean_byte and
+ * @see pixel_image_calculate_variance_byte for the whole image. The result
+ * can be given to @see normalize_byte to avoid scanning the image again.
+ */
+result pixel_image_calculate_statistics_byte
+(
+  const pixel_image *source,
+  /** channel offset for multi-channel images */
+  uint32 offset,
+  image_statistics *target
+);
+
+/**
+ * Calculates the statistics like @see pixel_image_calculate_statistics_byte,
+ * dividing the rows between the given number of threads.
+ */
+result pixel_image_calculate_statistics_byte_parallel
+(
+  const pixel_image *source,
+  uint32 offset,
+  image_statistics *target,
+  uint32 threads
+);
+
 #ifdef __cplusplus
 }
 #endif
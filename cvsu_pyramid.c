@@ -0,0 +1,184 @@
+/**
+ * @file cvsu_pyramid.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Image pyramids for cvsu.
+ *
+ * Copyright (c) 2011-2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_memory.h"
+#include "cvsu_pyramid.h"
+
+/******************************************************************************/
+/* constants for reporting function names in error messages                   */
+
+string pixel_image_pyramid_create_name = "pixel_image_pyramid_create";
+string pixel_image_pyramid_destroy_name = "pixel_image_pyramid_destroy";
+string pixel_image_pyramid_nullify_name = "pixel_image_pyramid_nullify";
+string pixel_image_pyramid_update_name = "pixel_image_pyramid_update";
+
+/******************************************************************************/
+
+result pixel_image_pyramid_create
+(
+  pixel_image_pyramid *target,
+  const pixel_image *source,
+  uint32 level_count,
+  truth_value use_integrals
+)
+{
+  TRY();
+  uint32 i, width, height;
+
+  CHECK_POINTER(target);
+  /* nullified first, so that a failed create can always be destroyed */
+  CHECK(pixel_image_pyramid_nullify(target));
+  CHECK_POINTER(source);
+  CHECK_PARAM(source->type == p_U8);
+  CHECK_PARAM(level_count > 0);
+  /* the coarsest level must have at least one pixel */
+  CHECK_PARAM(level_count <= 32);
+  CHECK_PARAM((source->width >> (level_count - 1)) > 0);
+  CHECK_PARAM((source->height >> (level_count - 1)) > 0);
+
+  CHECK(memory_allocate((data_pointer *)&target->levels, level_count,
+                        sizeof(pixel_image)));
+  for (i = 0; i < level_count; i++) {
+    CHECK(pixel_image_nullify(&target->levels[i]));
+  }
+  target->level_count = level_count;
+  width = source->width;
+  height = source->height;
+  for (i = 0; i < level_count; i++) {
+    CHECK(pixel_image_create_aligned(&target->levels[i], source->type,
+                                     source->format, width, height,
+                                     source->step, 0));
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+  }
+
+  if (IS_TRUE(use_integrals)) {
+    CHECK(memory_allocate((data_pointer *)&target->integrals, level_count,
+                          sizeof(integral_image)));
+    for (i = 0; i < level_count; i++) {
+      CHECK(integral_image_nullify(&target->integrals[i]));
+    }
+    for (i = 0; i < level_count; i++) {
+      CHECK(integral_image_create(&target->integrals[i], &target->levels[i]));
+    }
+  }
+
+  FINALLY(pixel_image_pyramid_create);
+  if (r != SUCCESS && target != NULL) {
+    pixel_image_pyramid_destroy(target);
+  }
+  RETURN();
+}
+
+/******************************************************************************/
+
+result pixel_image_pyramid_destroy
+(
+  pixel_image_pyramid *target
+)
+{
+  TRY();
+  uint32 i;
+
+  CHECK_POINTER(target);
+
+  if (target->integrals != NULL) {
+    for (i = 0; i < target->level_count; i++) {
+      CHECK(integral_image_destroy(&target->integrals[i]));
+    }
+    CHECK(memory_deallocate((data_pointer *)&target->integrals));
+  }
+  if (target->levels != NULL) {
+    for (i = 0; i < target->level_count; i++) {
+      CHECK(pixel_image_destroy(&target->levels[i]));
+    }
+    CHECK(memory_deallocate((data_pointer *)&target->levels));
+  }
+  CHECK(pixel_image_pyramid_nullify(target));
+
+  FINALLY(pixel_image_pyramid_destroy);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result pixel_image_pyramid_nullify
+(
+  pixel_image_pyramid *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  target->level_count = 0;
+  target->levels = NULL;
+  target->integrals = NULL;
+
+  FINALLY(pixel_image_pyramid_nullify);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result pixel_image_pyramid_update
+(
+  pixel_image_pyramid *target,
+  const pixel_image *source
+)
+{
+  TRY();
+  uint32 i;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->levels);
+  CHECK_POINTER(source);
+
+  if (source != &target->levels[0]) {
+    CHECK(pixel_image_copy(&target->levels[0], source));
+  }
+  for (i = 1; i < target->level_count; i++) {
+    CHECK(scale_down(&target->levels[i - 1], &target->levels[i]));
+  }
+  if (target->integrals != NULL) {
+    for (i = 0; i < target->level_count; i++) {
+      CHECK(integral_image_update(&target->integrals[i]));
+    }
+  }
+
+  FINALLY(pixel_image_pyramid_update);
+  RETURN();
+}
+
+/* end of file                                                                */
+/******************************************************************************/
@@ -0,0 +1,108 @@
+/**
+ * @file cvsu_pyramid.h
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Image pyramids for cvsu.
+ *
+ * Copyright (c) 2011-2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CVSU_PYRAMID_H
+#   define CVSU_PYRAMID_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "cvsu_types.h"
+#include "cvsu_pixel_image.h"
+#include "cvsu_integral.h"
+
+/**
+ * Stores the levels of an image pyramid. Level 0 has the resolution of the
+ * original image, and each level above it is scaled down by factor of two
+ * by averaging 2x2 blocks. All levels are allocated once, so the same
+ * pyramid can be updated with every frame of a video.
+ */
+typedef struct pixel_image_pyramid_t {
+  /** Number of levels in the pyramid */
+  uint32 level_count;
+  /** The images of the levels, from the finest to the coarsest */
+  pixel_image *levels;
+  /** Integral images of the levels, NULL if integrals are not used */
+  integral_image *integrals;
+} pixel_image_pyramid;
+
+/**
+ * Allocates the levels of a pyramid for images with the same type, format and
+ * size as the given image. Optionally allocates an integral image for each
+ * level, that is updated together with the levels.
+ * @see pixel_image_pyramid_update
+ * @see pixel_image_pyramid_destroy
+ */
+result pixel_image_pyramid_create
+(
+  pixel_image_pyramid *target,
+  /** Image used as a model for level 0, must have type p_U8 */
+  const pixel_image *source,
+  /** Number of levels including level 0 */
+  uint32 level_count,
+  /** Whether to keep an integral image for each level */
+  truth_value use_integrals
+);
+
+/**
+ * Deallocates the levels and integrals of the pyramid.
+ * Does not free the structure pointer itself.
+ */
+result pixel_image_pyramid_destroy
+(
+  pixel_image_pyramid *target
+);
+
+/**
+ * Nullifies the contents of the pyramid. Does NOT deallocate memory.
+ */
+result pixel_image_pyramid_nullify
+(
+  pixel_image_pyramid *target
+);
+
+/**
+ * Copies the source image to level 0 and calculates the other levels, and
+ * the integrals if they are used. The source can also be level 0 itself, if
+ * the frame has already been converted there.
+ */
+result pixel_image_pyramid_update
+(
+  pixel_image_pyramid *target,
+  const pixel_image *source
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CVSU_PYRAMID_H */
@@ -87,6 +87,7 @@ string quad_forest_refresh_segments_name = "quad_forest_refresh_segments";
 string quad_forest_destroy_name = "quad_forest_destroy";
 string quad_forest_nullify_name = "quad_forest_nullify";
 string quad_forest_update_name = "quad_forest_update";
+string quad_forest_update_frame_name = "quad_forest_update_frame";
 string quad_forest_segment_with_deviation_name = "quad_forest_segment_with_deviation";
 string quad_forest_segment_with_overlap_name = "quad_forest_segment_with_overlap";
 string quad_forest_get_segments_name = "quad_forest_get_regions";
@@ -99,6 +100,7 @@ string quad_forest_get_path_sniffers_name = "quad_forest_get_path_sniffers";
 string quad_forest_draw_trees_name =  "quad_forest_draw_trees";
 string quad_forest_highlight_segments_name = "quad_forest_highlight_segments";
 string quad_forest_draw_image_name = "quad_forest_draw_image";
+string quad_forest_draw_to_image_name = "quad_forest_draw_to_image";
 string quad_forest_find_edges_name = "quad_forest_find_edges";
 string quad_forest_find_boundaries_name = "quad_forest_find_boundaries";
 string quad_forest_find_boundaries_with_hysteresis_name = "quad_forest_find_boundaries_with_hysteresis";
@@ -550,108 +552,48 @@ result quad_tree_get_child_statistics
       target[2].y = y;
     }
     else {
-      uint32 hstep, vstep, dstep;
-      integral_image *I;
-      integral_value *iA, *i2A, N, sum1, sum2, mean, var;
-
-      I = &forest->integral;
-      N = (integral_value)(size * size);
-      step = I->step;
-      stride = I->stride;
-      hstep = size * step;
-      vstep = size * stride;
-      dstep = hstep + vstep;
+      integral_box_batch batch;
+      sint32 bx[4], by[4], bdx[4], bdy[4];
+      integral_value bN[4], bsum[4], bsum2[4], bmean[4], bvar[4], bdev[4];
+      uint32 i;
+
+      /* the four children are queried as one batch in the target order */
+      batch.count = 4;
+      batch.capacity = 4;
+      batch.x = bx;
+      batch.y = by;
+      batch.dx = bdx;
+      batch.dy = bdy;
+      batch.N = bN;
+      batch.sum = bsum;
+      batch.sum2 = bsum2;
+      batch.mean = bmean;
+      batch.variance = bvar;
+      batch.deviation = bdev;
 
-      /* nw child block */
       x = source->x;
       y = source->y;
-      offset = y * stride + x * step;
-
-      iA = ((integral_value *)I->I_1.data) + offset;
-      i2A = ((integral_value *)I->I_2.data) + offset;
-
-      sum1 = *(iA + dstep) + *iA - *(iA + hstep) - *(iA + vstep);
-      sum2 = *(i2A + dstep) + *i2A - *(i2A + hstep) - *(i2A + vstep);
-      mean = sum1 / N;
-      var = sum2 / N - mean*mean;
-      if (var < 0) var = 0;
-
-      stat = &target[0].stat;
-      stat->N = N;
-      stat->sum = sum1;
-      stat->sum2 = sum2;
-      stat->mean = mean;
-      stat->variance = var;
-      stat->deviation = sqrt(var);
-
-      target[0].x = x;
-      target[0].y = y;
-
-      /* ne child block */
-      x = x + size;
-      iA = iA + hstep;
-      i2A = i2A + hstep;
-
-      sum1 = *(iA + dstep) + *iA - *(iA + hstep) - *(iA + vstep);
-      sum2 = *(i2A + dstep) + *i2A - *(i2A + hstep) - *(i2A + vstep);
-      mean = sum1 / N;
-      var = sum2 / N - mean*mean;
-      if (var < 0) var = 0;
-
-      stat = &target[1].stat;
-      stat->N = N;
-      stat->sum = sum1;
-      stat->sum2 = sum2;
-      stat->mean = mean;
-      stat->variance = var;
-      stat->deviation = sqrt(var);
-
-      target[1].x = x;
-      target[1].y = y;
-
-      /* se child block */
-      y = y + size;
-      iA = iA + vstep;
-      i2A = i2A + vstep;
-
-      sum1 = *(iA + dstep) + *iA - *(iA + hstep) - *(iA + vstep);
-      sum2 = *(i2A + dstep) + *i2A - *(i2A + hstep) - *(i2A + vstep);
-      mean = sum1 / N;
-      var = sum2 / N - mean*mean;
-      if (var < 0) var = 0;
-
-      stat = &target[3].stat;
-      stat->N = N;
-      stat->sum = sum1;
-      stat->sum2 = sum2;
-      stat->mean = mean;
-      stat->variance = var;
-      stat->deviation = sqrt(var);
-
-      target[3].x = x;
-      target[3].y = y;
-
-      /* sw child block */
-      x = x - size;
-      iA = iA - hstep;
-      i2A = i2A - hstep;
-
-      sum1 = *(iA + dstep) + *iA - *(iA + hstep) - *(iA + vstep);
-      sum2 = *(i2A + dstep) + *i2A - *(i2A + hstep) - *(i2A + vstep);
-      mean = sum1 / N;
-      var = sum2 / N - mean*mean;
-      if (var < 0) var = 0;
+      bx[0] = bx[2] = (signed)x;
+      bx[1] = bx[3] = (signed)(x + size);
+      by[0] = by[1] = (signed)y;
+      by[2] = by[3] = (signed)(y + size);
+      for (i = 0; i < 4; i++) {
+        bdx[i] = bdy[i] = (signed)size;
+      }
+      CHECK(integral_image_calculate_batch(&forest->integral, &batch, 0));
 
-      stat = &target[2].stat;
-      stat->N = N;
-      stat->sum = sum1;
-      stat->sum2 = sum2;
-      stat->mean = mean;
-      stat->variance = var;
-      stat->deviation = sqrt(var);
+      for (i = 0; i < 4; i++) {
+        stat = &target[i].stat;
+        stat->N = bN[i];
+        stat->sum = bsum[i];
+        stat->sum2 = bsum2[i];
+        stat->mean = bmean[i];
+        stat->variance = bvar[i];
+        stat->deviation = bdev[i];
 
-      target[2].x = x;
-      target[2].y = y;
+        target[i].x = (unsigned)bx[i];
+        target[i].y = (unsigned)by[i];
+      }
     }
   }
 
@@ -883,7 +825,48 @@ result quad_tree_get_edge_response
     /*printf("dy %.3f ", vsum);*/
   }
 
-  tree->edge.mag = sqrt(hsum*hsum + vsum*vsum);
+  /* calculate diagonal gradients from rotated box pairs, if available */
+  tree->edge.d45 = 0;
+  tree->edge.d135 = 0;
+  if (forest->integral.T_1.data != NULL) {
+    statistics stat1, stat2;
+    sint32 cx, cy, across, along;
+
+    cx = ((signed)tree->x) + ((signed)box_width) / 2;
+    cy = ((signed)tree->y) + ((signed)box_width) / 2;
+    /* the boxes are stacked along the gradient direction */
+    across = (signed)getmax(((integral_value)box_width) / 2.0, 1.0);
+    along = (signed)box_length / 2;
+    /* 45 degrees: boxes extend 'along' steps down and right */
+    scol = cx - (2 * along - across) / 2;
+    srow = cy - (2 * along + across) / 2;
+    CHECK(integral_image_calculate_tilted_statistics(&forest->integral, &stat1,
+        scol, srow, along, across));
+    CHECK(integral_image_calculate_tilted_statistics(&forest->integral, &stat2,
+        scol + along, srow + along, along, across));
+    if (stat1.N > 0 && stat2.N > 0) {
+      tree->edge.d45 = edgel_fisher_signed(stat1.N, stat1.sum, stat2.sum,
+                                           stat1.sum2, stat2.sum2);
+    }
+    /* 135 degrees: boxes extend 'along' steps down and left */
+    scol = cx - (across - 2 * along) / 2;
+    srow = cy - (across + 2 * along) / 2;
+    CHECK(integral_image_calculate_tilted_statistics(&forest->integral, &stat1,
+        scol, srow, across, along));
+    CHECK(integral_image_calculate_tilted_statistics(&forest->integral, &stat2,
+        scol - along, srow + along, across, along));
+    if (stat1.N > 0 && stat2.N > 0) {
+      tree->edge.d135 = edgel_fisher_signed(stat1.N, stat1.sum, stat2.sum,
+                                            stat1.sum2, stat2.sum2);
+    }
+    /* four directions, scaled to the range of the two-direction magnitude */
+    tree->edge.mag = sqrt((hsum*hsum + vsum*vsum +
+                           tree->edge.d45*tree->edge.d45 +
+                           tree->edge.d135*tree->edge.d135) / 2);
+  }
+  else {
+    tree->edge.mag = sqrt(hsum*hsum + vsum*vsum);
+  }
   ang = atan2(hsum, vsum);
   if (ang < 0) ang = ang + 2 * M_PI;
   tree->edge.ang = ang;
@@ -1579,6 +1562,10 @@ result quad_forest_init
       CHECK(memory_deallocate((data_pointer*)&target->roots));
     }
     CHECK(memory_allocate((data_pointer *)&target->roots, size, sizeof(quad_tree*)));
+    if (target->batch.x != NULL) {
+      CHECK(integral_box_batch_destroy(&target->batch));
+    }
+    CHECK(integral_box_batch_create(&target->batch, size));
 
     if (!list_is_null(&target->trees)) {
       CHECK(list_destroy(&target->trees));
@@ -1626,8 +1613,13 @@ result quad_forest_init
       CHECK(list_append_return_pointer(&target->trees, (pointer)&new_tree, (pointer*)&tree));
       CHECK(list_create(&tree->links, 8, sizeof(quad_tree_link_head*), 1));
       target->roots[pos] = tree;
+      target->batch.x[pos] = (signed)new_tree.x;
+      target->batch.y[pos] = (signed)new_tree.y;
+      target->batch.dx[pos] = (signed)tree_max_size;
+      target->batch.dy[pos] = (signed)tree_max_size;
     }
   }
+  target->batch.count = size;
   target->last_root_tree = target->trees.last.prev;
 
   new_link.a.angle = 0;
@@ -1706,6 +1698,8 @@ result quad_forest_init
       }
     }
   }
+  /* the root trees were recreated, so they don't have statistics yet */
+  target->updated = FALSE;
 
   FINALLY(quad_forest_init);
   RETURN();
@@ -1872,6 +1866,7 @@ result quad_forest_destroy
   CHECK(list_destroy(&target->links));
   CHECK(list_destroy(&target->edges));
   CHECK(memory_deallocate((data_pointer*)&target->roots));
+  CHECK(integral_box_batch_destroy(&target->batch));
   CHECK(integral_image_destroy(&target->integral));
   if (target->source != NULL) {
     pixel_image_free(target->source);
@@ -1908,6 +1903,12 @@ result quad_forest_nullify
   CHECK(list_nullify(&target->links));
   target->last_root_tree = NULL;
   target->roots = NULL;
+  CHECK(integral_box_batch_nullify(&target->batch));
+  target->updated = FALSE;
+  target->changed.left = 0;
+  target->changed.right = 0;
+  target->changed.top = 0;
+  target->changed.bottom = 0;
 
   FINALLY(quad_forest_nullify);
   RETURN();
@@ -1936,20 +1937,12 @@ result quad_forest_update
 )
 {
   TRY();
-  uint32 row, col, rows, cols, pos, size, step, stride, hstep, vstep, dstep, offset;
+  uint32 pos, size;
   quad_tree *tree;
-  integral_image *I;
+  integral_box_batch *batch;
   statistics *stat;
-  integral_value *iA, *i2A, N, sum1, sum2, mean, var;
 
-  size = target->tree_max_size;
-  I = &target->integral;
-  N = (integral_value)(size * size);
-  step = I->step;
-  stride = I->stride;
-  hstep = size * step;
-  vstep = size * stride;
-  dstep = hstep + vstep;
+  CHECK_POINTER(target);
 
   /* create a fresh copy of the source image in case it has changed */
   /* TODO: need to remove original and force giving the source images as param? */
@@ -1959,45 +1952,147 @@ result quad_forest_update
 
   CHECK(list_remove_rest(&target->trees, target->last_root_tree));
 
-  rows = target->rows;
-  cols = target->cols;
+  /* the rectangles of the root trees were set in init */
+  batch = &target->batch;
+  CHECK(integral_image_calculate_batch(&target->integral, batch, 0));
 
-  pos = 0;
-  for (row = 0; row < rows; row++) {
+  size = target->rows * target->cols;
+  for (pos = 0; pos < size; pos++) {
     tree = target->roots[pos];
-    /* TODO: calculate offset for first row only, then add vstep */
-    offset = (tree->y * stride) + (tree->x * step);
-    for (col = 0; col < cols; col++, pos++, offset += hstep) {
+    stat = &tree->stat;
+
+    stat->N = batch->N[pos];
+    stat->sum = batch->sum[pos];
+    stat->sum2 = batch->sum2[pos];
+    stat->mean = batch->mean[pos];
+    stat->variance = batch->variance[pos];
+    stat->deviation = batch->deviation[pos];
+
+    /* TODO: decide where the segments are created */
+    /*quad_tree_segment_create(tree);*/
+    tree->nw = NULL;
+    tree->ne = NULL;
+    tree->sw = NULL;
+    tree->se = NULL;
+  }
+  target->updated = TRUE;
+  target->changed.left = 0;
+  target->changed.right = (coord)target->cols;
+  target->changed.top = 0;
+  target->changed.bottom = (coord)target->rows;
 
-      iA = ((integral_value *)I->I_1.data) + offset;
-      i2A = ((integral_value *)I->I_2.data) + offset;
+  FINALLY(quad_forest_update);
+  RETURN();
+}
 
-      sum1 = *(iA + dstep) + *iA - *(iA + hstep) - *(iA + vstep);
-      sum2 = *(i2A + dstep) + *i2A - *(i2A + hstep) - *(i2A + vstep);
-      mean = sum1 / N;
-      var = sum2 / N - mean*mean;
-      if (var < 0) var = 0;
+/******************************************************************************/
+/* private function for finding the range of root trees along one axis that  */
+/* overlap the range of changed pixels                                        */
 
-      tree = target->roots[pos];
-      stat = &tree->stat;
+void quad_forest_changed_range
+(
+  sint32 start,
+  sint32 length,
+  uint32 offset,
+  uint32 size,
+  uint32 count,
+  coord *first,
+  coord *last
+)
+{
+  sint32 begin, end;
 
-      stat->N = N;
-      stat->sum = sum1;
-      stat->sum2 = sum2;
-      stat->mean = mean;
-      stat->variance = var;
-      stat->deviation = sqrt(var);
+  begin = start - (sint32)offset;
+  end = begin + length;
+  if (begin < 0) begin = 0;
+  if (end > (sint32)(size * count)) end = (sint32)(size * count);
+  if (end <= begin) {
+    *first = 0;
+    *last = 0;
+  }
+  else {
+    *first = begin / (sint32)size;
+    *last = (end + (sint32)size - 1) / (sint32)size;
+  }
+}
 
-      /* TODO: decide where the segments are created */
-      /*quad_tree_segment_create(tree);*/
-      tree->nw = NULL;
-      tree->ne = NULL;
-      tree->sw = NULL;
-      tree->se = NULL;
-    }
+/******************************************************************************/
+
+result quad_forest_update_frame
+(
+  quad_forest *target,
+  pixel_image *frame
+)
+{
+  TRY();
+  uint32 pos, size;
+  sint32 x, y, dx, dy;
+  coord row, col;
+  quad_tree *tree;
+  integral_box_batch *batch, changed;
+  statistics *stat;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(frame);
+
+  if (IS_FALSE(target->updated)) {
+    CHECK(pixel_image_copy(target->source, frame));
+    CHECK(quad_forest_update(target));
+    TERMINATE(SUCCESS);
   }
 
-  FINALLY(quad_forest_update);
+  CHECK(pixel_image_copy_changes(target->source, frame, &x, &y, &dx, &dy));
+  CHECK(integral_image_update_rect(&target->integral, x, y, dx, dy));
+  /* if there are existing child nodes and blocks, remove them */
+  CHECK(list_remove_rest(&target->trees, target->last_root_tree));
+
+  size = target->rows * target->cols;
+  for (pos = 0; pos < size; pos++) {
+    tree = target->roots[pos];
+    tree->nw = NULL;
+    tree->ne = NULL;
+    tree->sw = NULL;
+    tree->se = NULL;
+  }
+
+  /* the sums of unchanged trees are exactly the same as before */
+  quad_forest_changed_range(x, dx, target->dx, target->tree_max_size,
+                            target->cols, &target->changed.left,
+                            &target->changed.right);
+  quad_forest_changed_range(y, dy, target->dy, target->tree_max_size,
+                            target->rows, &target->changed.top,
+                            &target->changed.bottom);
+  /* the changed roots of each row are a contiguous part of the root batch, */
+  /* so they are calculated the same way as in quad_forest_update            */
+  batch = &target->batch;
+  for (row = target->changed.top; row < target->changed.bottom; row++) {
+    pos = (uint32)row * target->cols + (uint32)target->changed.left;
+    changed.count = (uint32)(target->changed.right - target->changed.left);
+    changed.capacity = changed.count;
+    changed.x = batch->x + pos;
+    changed.y = batch->y + pos;
+    changed.dx = batch->dx + pos;
+    changed.dy = batch->dy + pos;
+    changed.N = batch->N + pos;
+    changed.sum = batch->sum + pos;
+    changed.sum2 = batch->sum2 + pos;
+    changed.mean = batch->mean + pos;
+    changed.variance = batch->variance + pos;
+    changed.deviation = batch->deviation + pos;
+    CHECK(integral_image_calculate_batch(&target->integral, &changed, 0));
+    for (col = target->changed.left; col < target->changed.right;
+         col++, pos++) {
+      stat = &target->roots[pos]->stat;
+      stat->N = batch->N[pos];
+      stat->sum = batch->sum[pos];
+      stat->sum2 = batch->sum2[pos];
+      stat->mean = batch->mean[pos];
+      stat->variance = batch->variance[pos];
+      stat->deviation = batch->deviation[pos];
+    }
+  }
+
+  FINALLY(quad_forest_update_frame);
   RETURN();
 }
 
@@ -3595,7 +3690,7 @@ result quad_forest_highlight_segments
 
 /******************************************************************************/
 
-result quad_forest_draw_image
+result quad_forest_draw_to_image
 (
   quad_forest *forest,
   pixel_image *target,
@@ -3613,15 +3708,16 @@ result quad_forest_draw_image
   CHECK_POINTER(forest);
   CHECK_POINTER(forest->source);
   CHECK_POINTER(target);
+  CHECK_POINTER(target->rows);
+  CHECK_PARAM(target->type == p_U8);
+  CHECK_PARAM(target->step == 3);
+  CHECK_PARAM(target->width == forest->source->width);
+  CHECK_PARAM(target->height == forest->source->height);
 
-  width = forest->source->width;
-  height = forest->source->height;
-
-  CHECK(pixel_image_create(target, p_U8, RGB, width, height, 3, 3 * width));
   CHECK(pixel_image_clear(target));
 
   stride = target->stride;
-  target_data = (byte*)target->data;
+  target_data = (byte*)target->rows[0];
 
   /* draw using tree mean value */
   if (IS_FALSE(use_segments)) {
@@ -3714,6 +3810,33 @@ result quad_forest_draw_image
     }
   }
 
+  FINALLY(quad_forest_draw_to_image);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result quad_forest_draw_image
+(
+  quad_forest *forest,
+  pixel_image *target,
+  truth_value use_segments,
+  truth_value use_colors
+)
+{
+  TRY();
+  uint32 width, height;
+
+  CHECK_POINTER(forest);
+  CHECK_POINTER(forest->source);
+  CHECK_POINTER(target);
+
+  width = forest->source->width;
+  height = forest->source->height;
+
+  CHECK(pixel_image_create(target, p_U8, RGB, width, height, 3, 3 * width));
+  CHECK(quad_forest_draw_to_image(forest, target, use_segments, use_colors));
+
   FINALLY(quad_forest_draw_image);
   RETURN();
 }
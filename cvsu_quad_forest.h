@@ -105,6 +105,13 @@ typedef struct quad_forest_edge_t
   integral_value dx;
   /** Vertical edge response value averaged from the tree region */
   integral_value dy;
+  /**
+   * Diagonal edge response across the 45 degree direction (down and right),
+   * calculated only if the tilted integrals of the forest are enabled
+   */
+  integral_value d45;
+  /** Diagonal edge response across the 135 degree direction (down and left) */
+  integral_value d135;
   /** Magnitude of the edge response average from the tree region */
   integral_value mag;
   /** The estimated dominant edge direction as averaged from the tree region */
@@ -370,6 +377,15 @@ typedef struct quad_forest_t {
   list_item *last_root_tree;
   /** Pointer array containing the root trees in the tree grid */
   quad_tree **roots;
+  /** Box queries of the root trees, for updating their statistics at once */
+  integral_box_batch batch;
+  /** Whether the integral image and root statistics match the source */
+  truth_value updated;
+  /**
+   * The range of root tree cols (left..right-1) and rows (top..bottom-1) that
+   * had their statistics refreshed in the latest update
+   */
+  rect changed;
 } quad_forest;
 
 /**
@@ -653,6 +669,23 @@ result quad_forest_update
   quad_forest *target
 );
 
+/**
+ * Updates a quad_forest structure with a new frame of the same size. Only the
+ * pixels that differ from the current source are copied, the integral_image
+ * is updated only from the changed rectangle onwards, and only the statistics
+ * of the root trees overlapping the changed rectangle are refreshed; these are
+ * reported in the changed field of the forest. The first update of the forest
+ * after initialization is a full update. Cleans the data structure like
+ * @see quad_forest_update.
+ */
+result quad_forest_update_frame
+(
+  /** The quad_forest structure to be updated. */
+  quad_forest *target,
+  /** The new frame, must have the same format as the source of the forest. */
+  pixel_image *frame
+);
+
 /**
  * Segments the quad_forest structure using a deviation threshold as
  * consistency and similarity criteria. Divides all trees that have deviation
@@ -818,6 +851,24 @@ result quad_forest_draw_image
   truth_value use_colors
 );
 
+/**
+ * Draws the quad_forest like @see quad_forest_draw_image into an existing
+ * 3-channel byte image with the size of the forest source image, for example
+ * one acquired from a scratch_pool, so that drawing every frame does not
+ * allocate a new image.
+ */
+result quad_forest_draw_to_image
+(
+  /** The quad_forest to be drawn into an image. */
+  quad_forest *forest,
+  /** The pixel_image to draw into, must have the size of the forest. */
+  pixel_image *target,
+  /** Should we use segment statistics or individual tree statistics? */
+  truth_value use_segments,
+  /** For segments, should we use mean or colors? No effect for trees. */
+  truth_value use_colors
+);
+
 /**
  * Uses edge responses and graph propagation to find trees containing strong
  * magnitude edges.
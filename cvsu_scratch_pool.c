@@ -0,0 +1,273 @@
+/**
+ * @file cvsu_scratch_pool.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Reusable scratch images for cvsu.
+ *
+ * Copyright (c) 2011-2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_memory.h"
+#include "cvsu_scratch_pool.h"
+
+/******************************************************************************/
+/* constants for reporting function names in error messages                   */
+
+string scratch_pool_create_name = "scratch_pool_create";
+string scratch_pool_destroy_name = "scratch_pool_destroy";
+string scratch_pool_nullify_name = "scratch_pool_nullify";
+string scratch_pool_begin_name = "scratch_pool_begin";
+string scratch_pool_end_name = "scratch_pool_end";
+string scratch_pool_acquire_name = "scratch_pool_acquire";
+string scratch_pool_release_name = "scratch_pool_release";
+string scratch_pool_add_image_name = "scratch_pool_add_image";
+
+/******************************************************************************/
+
+result scratch_pool_create
+(
+  scratch_pool *target,
+  uint32 size
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+  CHECK_PARAM(size > 0);
+
+  CHECK(scratch_pool_nullify(target));
+  CHECK(memory_allocate((data_pointer *)&target->images, size,
+                        sizeof(scratch_image *)));
+  target->size = size;
+
+  FINALLY(scratch_pool_create);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result scratch_pool_destroy
+(
+  scratch_pool *target
+)
+{
+  TRY();
+  uint32 i;
+
+  CHECK_POINTER(target);
+
+  if (target->images != NULL) {
+    for (i = 0; i < target->count; i++) {
+      CHECK(pixel_image_destroy(&target->images[i]->image));
+      CHECK(memory_deallocate((data_pointer *)&target->images[i]));
+    }
+    CHECK(memory_deallocate((data_pointer *)&target->images));
+  }
+  CHECK(scratch_pool_nullify(target));
+
+  FINALLY(scratch_pool_destroy);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result scratch_pool_nullify
+(
+  scratch_pool *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  target->images = NULL;
+  target->size = 0;
+  target->count = 0;
+  target->scope = 0;
+
+  FINALLY(scratch_pool_nullify);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result scratch_pool_begin
+(
+  scratch_pool *target
+)
+{
+  TRY();
+
+  CHECK_POINTER(target);
+
+  target->scope++;
+
+  FINALLY(scratch_pool_begin);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result scratch_pool_end
+(
+  scratch_pool *target
+)
+{
+  TRY();
+  uint32 i;
+
+  CHECK_POINTER(target);
+  CHECK_PARAM(target->scope > 0);
+
+  for (i = 0; i < target->count; i++) {
+    if (target->images[i]->scope >= target->scope) {
+      target->images[i]->scope = 0;
+    }
+  }
+  target->scope--;
+
+  FINALLY(scratch_pool_end);
+  RETURN();
+}
+
+/******************************************************************************/
+/* private function for creating a new image in the pool, growing the array  */
+/* of images when it is full                                                  */
+
+result scratch_pool_add_image
+(
+  scratch_pool *target,
+  pixel_type type,
+  pixel_format format,
+  uint32 width,
+  uint32 height,
+  uint32 step
+)
+{
+  TRY();
+  scratch_image **images, *new_image;
+
+  images = NULL;
+  new_image = NULL;
+  CHECK_POINTER(target);
+
+  if (target->count == target->size) {
+    CHECK(memory_allocate((data_pointer *)&images, 2 * target->size,
+                          sizeof(scratch_image *)));
+    CHECK(memory_copy((data_pointer)images, (data_pointer)target->images,
+                      target->count, sizeof(scratch_image *)));
+    CHECK(memory_deallocate((data_pointer *)&target->images));
+    target->images = images;
+    target->size = 2 * target->size;
+    images = NULL;
+  }
+
+  CHECK(memory_allocate((data_pointer *)&new_image, 1, sizeof(scratch_image)));
+  CHECK(pixel_image_nullify(&new_image->image));
+  CHECK(pixel_image_create(&new_image->image, type, format, width, height,
+                           step, width * step));
+  new_image->scope = 0;
+  target->images[target->count] = new_image;
+  target->count++;
+  new_image = NULL;
+
+  FINALLY(scratch_pool_add_image);
+  memory_deallocate((data_pointer *)&images);
+  memory_deallocate((data_pointer *)&new_image);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result scratch_pool_acquire
+(
+  scratch_pool *target,
+  pixel_image **image,
+  pixel_type type,
+  pixel_format format,
+  uint32 width,
+  uint32 height,
+  uint32 step
+)
+{
+  TRY();
+  uint32 i;
+  scratch_image *current;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(target->images);
+  CHECK_POINTER(image);
+  CHECK_PARAM(target->scope > 0);
+
+  *image = NULL;
+  for (i = 0; i < target->count; i++) {
+    current = target->images[i];
+    if (current->scope == 0 && current->image.type == type &&
+        current->image.format == format && current->image.width == width &&
+        current->image.height == height && current->image.step == step) {
+      break;
+    }
+  }
+  if (i == target->count) {
+    CHECK(scratch_pool_add_image(target, type, format, width, height, step));
+  }
+  current = target->images[i];
+  current->scope = target->scope;
+  *image = &current->image;
+
+  FINALLY(scratch_pool_acquire);
+  RETURN();
+}
+
+/******************************************************************************/
+
+result scratch_pool_release
+(
+  scratch_pool *target,
+  pixel_image *image
+)
+{
+  TRY();
+  uint32 i;
+
+  CHECK_POINTER(target);
+  CHECK_POINTER(image);
+
+  for (i = 0; i < target->count; i++) {
+    if (&target->images[i]->image == image) {
+      target->images[i]->scope = 0;
+      TERMINATE(SUCCESS);
+    }
+  }
+  ERROR(NOT_FOUND);
+
+  FINALLY(scratch_pool_release);
+  RETURN();
+}
+
+/* end of file                                                                */
+/******************************************************************************/
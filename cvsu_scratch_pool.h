@@ -0,0 +1,147 @@
+/**
+ * @file cvsu_scratch_pool.h
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Reusable scratch images for cvsu.
+ *
+ * Copyright (c) 2011-2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CVSU_SCRATCH_POOL_H
+#   define CVSU_SCRATCH_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "cvsu_types.h"
+#include "cvsu_pixel_image.h"
+
+/**
+ * Stores one image of a scratch_pool and the scope that is using it.
+ */
+typedef struct scratch_image_t {
+  /** The image handed out by the pool */
+  pixel_image image;
+  /** The scope that acquired the image, or 0 if the image is free */
+  uint32 scope;
+} scratch_image;
+
+/**
+ * Hands out temporary pixel images and recycles them, so that functions
+ * called for every frame do not need to allocate and deallocate the same
+ * images over and over. An image is reused when a free image with the same
+ * type, format, size and step exists in the pool. The images are acquired
+ * within scopes, and ending a scope releases all images acquired in it. Once
+ * every image needed by a frame has been created, processing the following
+ * frames does not allocate memory; the count of images in the pool and
+ * @see memory_get_allocation_count can be used for checking this.
+ */
+typedef struct scratch_pool_t {
+  /** The images of the pool; each one allocated separately so that the */
+  /** pointers handed out stay valid when the pool grows */
+  scratch_image **images;
+  /** The number of image slots allocated */
+  uint32 size;
+  /** The number of images created */
+  uint32 count;
+  /** The depth of the current scope, 0 outside all scopes */
+  uint32 scope;
+} scratch_pool;
+
+/**
+ * Initializes the pool with room for the given number of images. The pool
+ * grows when more images are needed.
+ * @see scratch_pool_destroy
+ */
+result scratch_pool_create
+(
+  scratch_pool *target,
+  uint32 size
+);
+
+/**
+ * Destroys all images of the pool and deallocates the memory.
+ */
+result scratch_pool_destroy
+(
+  scratch_pool *target
+);
+
+/**
+ * Nullifies the contents of the pool. Does NOT deallocate memory.
+ */
+result scratch_pool_nullify
+(
+  scratch_pool *target
+);
+
+/**
+ * Begins a new scope. Scopes can be nested.
+ */
+result scratch_pool_begin
+(
+  scratch_pool *target
+);
+
+/**
+ * Ends the current scope and returns the images acquired in it to the pool.
+ */
+result scratch_pool_end
+(
+  scratch_pool *target
+);
+
+/**
+ * Hands out an image with the given properties, reusing a free image if
+ * possible. The contents of a reused image are left as they were, so the
+ * image must be cleared if the caller depends on the initial values. The
+ * image belongs to the pool and must not be destroyed by the caller.
+ */
+result scratch_pool_acquire
+(
+  scratch_pool *target,
+  pixel_image **image,
+  pixel_type type,
+  pixel_format format,
+  uint32 width,
+  uint32 height,
+  uint32 step
+);
+
+/**
+ * Returns an image to the pool before the end of its scope.
+ */
+result scratch_pool_release
+(
+  scratch_pool *target,
+  pixel_image *image
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CVSU_SCRATCH_POOL_H */
@@ -0,0 +1,99 @@
+/**
+ * @file cvsu_simd.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Runtime SIMD support detection for cvsu.
+ *
+ * Copyright (c) 2011-2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_simd.h"
+
+/******************************************************************************/
+/* cached results of cpu feature detection                                    */
+
+truth_value simd_level_detected = FALSE;
+simd_level simd_cpu_level = s_NONE;
+simd_level simd_max_level = s_AVX2;
+
+/******************************************************************************/
+
+void simd_detect()
+{
+  if (IS_FALSE(simd_level_detected)) {
+    simd_cpu_level = s_NONE;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      simd_cpu_level = s_AVX2;
+    }
+    else
+    if (__builtin_cpu_supports("sse2")) {
+      simd_cpu_level = s_SSE2;
+    }
+#endif
+    simd_level_detected = TRUE;
+  }
+}
+
+/******************************************************************************/
+
+simd_level simd_get_level()
+{
+  simd_detect();
+  return (simd_cpu_level < simd_max_level) ? simd_cpu_level : simd_max_level;
+}
+
+/******************************************************************************/
+
+void simd_set_max_level
+(
+  simd_level level
+)
+{
+  simd_max_level = level;
+}
+
+/******************************************************************************/
+
+string simd_level_name
+(
+  simd_level level
+)
+{
+  switch (level) {
+  case s_SSE2:
+    return "sse2";
+  case s_AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+/* end of file                                                                */
+/******************************************************************************/
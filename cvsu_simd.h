@@ -0,0 +1,91 @@
+/**
+ * @file cvsu_simd.h
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Runtime SIMD support detection for cvsu.
+ *
+ * Copyright (c) 2011-2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CVSU_SIMD_H
+#   define CVSU_SIMD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "cvsu_config.h"
+#include "cvsu_types.h"
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+/* kernels are compiled for their target instruction set with attributes, */
+/* so that the rest of the library does not require special compiler flags */
+#define SIMD_TARGET_SSE2 __attribute__((__target__("sse2")))
+#define SIMD_TARGET_AVX2 __attribute__((__target__("avx2")))
+#endif
+
+/**
+ * Enumerates the SIMD instruction set levels that kernels may be compiled for.
+ * Higher levels include the lower ones.
+ */
+typedef enum simd_level_t {
+  /** Plain scalar code */
+  s_NONE = 0,
+  /** x86 SSE2 instructions (128-bit vectors) */
+  s_SSE2,
+  /** x86 AVX2 instructions (256-bit vectors) */
+  s_AVX2
+} simd_level;
+
+/**
+ * Returns the SIMD level that kernels should use. The cpu is queried on the
+ * first call, and the result is limited by @see simd_set_max_level.
+ */
+simd_level simd_get_level();
+
+/**
+ * Limits the SIMD level used by kernels. Useful for comparing the results and
+ * speed of different code paths. Giving a level higher than what the cpu
+ * supports has no effect.
+ */
+void simd_set_max_level
+(
+  simd_level level
+);
+
+/**
+ * Returns a string describing the SIMD level, useful for output.
+ */
+string simd_level_name
+(
+  simd_level level
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CVSU_SIMD_H */
@@ -229,8 +229,8 @@ result temporal_forest_update
   if (target->current >= target->count) {
     target->current = 0;
   }
-  CHECK(pixel_image_copy(target->forests[target->current].source, source));
-  CHECK(quad_forest_update(&target->forests[target->current]));
+  /* only the part that changed since the forest was last used is updated */
+  CHECK(quad_forest_update_frame(&target->forests[target->current], source));
   target->frames++;
   if (target->frames > 1) {
     if (target->current == 0) {
@@ -132,19 +132,27 @@ integral_value cast_s32
 }
 
 /******************************************************************************/
-/*
-integral_value cast_u64(void *data, uint32 offset)
+
+integral_value cast_u64
+(
+  void *data,
+  uint32 offset
+)
 {
   return (integral_value)*(((uint64 *)data) + offset);
 }
-*/
+
 /******************************************************************************/
-/*
-integral_value cast_s64(void *data, uint32 offset)
+
+integral_value cast_s64
+(
+  void *data,
+  uint32 offset
+)
 {
   return (integral_value)*(((sint64 *)data) + offset);
 }
-*/
+
 /******************************************************************************/
 
 integral_value cast_f32
@@ -169,6 +177,17 @@ integral_value cast_f64
 
 /******************************************************************************/
 
+integral_value cast_u32i
+(
+  void *data,
+  uint32 offset
+)
+{
+  return (integral_value)*(((uint32i *)data) + offset);
+}
+
+/******************************************************************************/
+
 pixel_casting_function casts[] = {
   &cast_none,
   &cast_u8,
@@ -177,12 +196,11 @@ pixel_casting_function casts[] = {
   &cast_s16,
   &cast_u32,
   &cast_s32,
-  /*
+  &cast_f32,
+  &cast_f64,
   &cast_u64,
   &cast_s64,
-  */
-  &cast_f32,
-  &cast_f64
+  &cast_u32i
 };
 
 /******************************************************************************/
@@ -59,6 +59,19 @@ typedef signed short   sint16;
 typedef unsigned short uint16;
 typedef signed long    sint32;
 typedef unsigned long  uint32;
+/* unsigned 32-bit integers also where long is 64 bits; int is 32 bits on */
+/* all supported platforms, both ILP32 and LP64                           */
+typedef unsigned int   uint32i;
+#if defined(__GNUC__)
+__extension__ typedef signed long long   sint64;
+__extension__ typedef unsigned long long uint64;
+#elif defined(_MSC_VER)
+typedef signed __int64   sint64;
+typedef unsigned __int64 uint64;
+#else
+typedef signed long long   sint64;
+typedef unsigned long long uint64;
+#endif
 typedef float          real32;
 typedef double         real64;
 
@@ -248,14 +261,16 @@ typedef enum pixel_type_t {
   p_U32,
   /** signed 32-bit integer (long) values */
   p_S32,
-  /** unsigned 64-bit integer (long long) values */
-  /*p_U64,*/
-  /** signed 64-bit integer (long long) values */
-  /*p_S64,*/
   /** 32-bit floating point (float) values */
   p_F32,
   /** 64-bit floating point values (double) */
-  p_F64
+  p_F64,
+  /** unsigned 64-bit integer (long long) values */
+  p_U64,
+  /** signed 64-bit integer (long long) values */
+  p_S64,
+  /** unsigned 32-bit integer (int) values, 32 bits also on LP64 */
+  p_U32I
 } pixel_type;
 
 #define BYTE_IMAGE p_U8
@@ -299,6 +314,16 @@ typedef uint32 SI_2_t;
 #define p_SI_1 p_U32
 #define p_SI_2 p_U32
 
+/* exact integral images use 64-bit squared integrals for larger images */
+typedef uint32i EI_1_t;
+typedef uint64 EI_2_t;
+#define p_EI_1 p_U32I
+#define p_EI_2 p_U64
+
+/* tiled integral images store single precision sums relative to each tile */
+typedef real32 TI_t;
+#define p_TI p_F32
+
 typedef sint8 edge_strength;
 
 /**
@@ -0,0 +1,97 @@
+/**
+ * @file cvsu_connected_components_t.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Testing code for cvsu_connected_components.c
+ *
+ * Copyright (c) 2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_memory.h"
+#include "cvsu_pixel_image.h"
+#include "cvsu_filter.h"
+#include "cvsu_connected_components.h"
+#include "cvsu_test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* connected components collected while the thresholded rows arrive are the */
+/* same as the components of the thresholded image                          */
+void test_connected_components_stream(pixel_image *source)
+{
+  pixel_image binary, drawn, drawn_reference;
+  connected_components cc, cc_reference;
+  uint32 errors;
+
+  pixel_image_clone(&binary, source);
+  threshold(source, &binary, 128);
+  connected_components_create(&cc_reference, &binary);
+  connected_components_update(&cc_reference);
+  connected_components_create_stream(&cc, source->width, source->height);
+  threshold_stream(&pixel_image_read_row, source, &connected_components_add_row,
+                   &cc, source->width, source->height, 128);
+  connected_components_update(&cc);
+  /* the colors are assigned in pixel order, so equal regions draw equally */
+  connected_components_draw_image(&cc, &drawn);
+  connected_components_draw_image(&cc_reference, &drawn_reference);
+  errors = (cc.count == cc_reference.count) ? 0 : 1;
+  if (memcmp(drawn.data, drawn_reference.data, drawn.size) != 0) {
+    errors++;
+  }
+  pixel_image_destroy(&drawn);
+  pixel_image_destroy(&drawn_reference);
+  printf("%-24s %4lux%-4lu %s", "connected components", source->width,
+         source->height, (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+  connected_components_destroy(&cc);
+  connected_components_destroy(&cc_reference);
+  pixel_image_destroy(&binary);
+}
+
+int main()
+{
+  pixel_image source;
+
+  printf("Starting connected components tests\n");
+
+  pixel_image_create(&source, p_U8, GREY, 97, 61, 1, 97);
+  fill_image(&source, 42);
+  test_connected_components_stream(&source);
+  pixel_image_destroy(&source);
+  pixel_image_create(&source, p_U8, GREY, 96, 45, 1, 96);
+  fill_image(&source, 43);
+  test_connected_components_stream(&source);
+  pixel_image_destroy(&source);
+
+  printf("Connected components tests finished with %lu failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,805 @@
+/**
+ * @file cvsu_filter_t.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Testing code for cvsu_filter.c
+ *
+ * Copyright (c) 2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_memory.h"
+#include "cvsu_pixel_image.h"
+#include "cvsu_filter.h"
+#include "cvsu_simd.h"
+#include "cvsu_test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/* the streaming stages fed by the row sources give the same results as the */
+/* functions operating on whole images; the files are written from the image */
+void test_filter_streams(pixel_image *source)
+{
+  pixel_image streamed, expected;
+  pnm_row_source pnm;
+  yuv_row_source yuv;
+  FILE *file;
+  byte *row, value;
+  uint32 x, y, passes, layout;
+  string pnm_name = "cvsu_filter_test.pnm";
+  string yuv_name = "cvsu_filter_test.yuv";
+
+  pixel_image_nullify(&expected);
+  pixel_image_create(&streamed, p_U8, GREY, source->width, source->height, 1,
+                     source->width);
+
+  /* smoothing reading the pnm file again from the beginning */
+  pixel_image_write(source, pnm_name, FALSE);
+  if (pnm_row_source_open(&pnm, pnm_name) != SUCCESS) {
+    printf("%-24s open failed\n", "pnm row source");
+    failures++;
+    pixel_image_destroy(&streamed);
+    return;
+  }
+  for (passes = 0; passes < 4; passes++) {
+    pixel_image_clone(&expected, source);
+    smooth_binomial(source, &expected, passes);
+    smooth_binomial_stream(&pnm_row_source_read, &pnm, &pixel_image_write_row,
+                           &streamed, source->width, source->height, passes);
+    check_threshold(&streamed, &expected, "smooth_binomial_stream");
+    pixel_image_destroy(&expected);
+  }
+  pnm_row_source_close(&pnm);
+  remove(pnm_name);
+
+  /* threshold of the second frame of raw yuv files in all layouts */
+  pixel_image_clone(&expected, source);
+  threshold(source, &expected, 128);
+  for (layout = 0; layout < 3; layout++) {
+    /* packed layouts store pixels in pairs */
+    if (layout != YUV_PLANAR_420 && (source->width & 1) != 0) {
+      continue;
+    }
+    file = fopen(yuv_name, "wb");
+    for (y = 0; y < 2 * source->height; y++) {
+      row = (byte *)source->rows[y % source->height];
+      for (x = 0; x < source->width; x++) {
+        /* the first frame is inverted to catch wrong frame offsets */
+        value = (byte)((y < source->height) ? 255 - row[x] : row[x]);
+        if (layout == YUV_PACKED_UYVY) {
+          fputc((int)(x & 0x3f), file);
+          fputc(value, file);
+        }
+        else
+        if (layout == YUV_PACKED_YUYV) {
+          fputc(value, file);
+          fputc((int)(x & 0x3f), file);
+        }
+        else {
+          fputc(value, file);
+        }
+      }
+      if (layout == YUV_PLANAR_420 &&
+          (y == source->height - 1 || y == 2 * source->height - 1)) {
+        for (x = 0; x < 2 * ((source->width + 1) / 2) *
+             ((source->height + 1) / 2); x++) {
+          fputc(0x80, file);
+        }
+      }
+    }
+    fclose(file);
+    yuv_row_source_open(&yuv, yuv_name, (yuv_file_layout)layout,
+                        source->width, source->height, 1);
+    pixel_image_clear(&streamed);
+    threshold_stream(&yuv_row_source_read, &yuv, &pixel_image_write_row,
+                     &streamed, source->width, source->height, 128);
+    check_threshold(&streamed, &expected, "yuv row source");
+    yuv_row_source_close(&yuv);
+    remove(yuv_name);
+  }
+
+  pixel_image_destroy(&expected);
+  pixel_image_destroy(&streamed);
+}
+
+/* the original smoothing with separate in-place sweeps over the image */
+void reference_smooth_binomial(pixel_image *target, uint32 passes)
+{
+  uint32 x, y, pass, step, stride;
+  byte prev, curr, next, *pos;
+
+  step = target->step;
+  stride = target->stride;
+  for (pass = 0; pass < passes; pass++) {
+    for (y = 0; y < target->height; y++) {
+      pos = (byte *)target->rows[y];
+      prev = pos[0];
+      curr = pos[step];
+      for (x = 1; x < target->width - 1; x++) {
+        next = pos[(x + 1) * step];
+        pos[x * step] = (byte)((prev >> 2) + (curr >> 1) + (next >> 2));
+        prev = curr;
+        curr = next;
+      }
+    }
+    for (x = 0; x < target->width; x++) {
+      pos = (byte *)target->rows[0] + x * step;
+      prev = pos[0];
+      curr = pos[stride];
+      for (y = 1; y < target->height - 1; y++) {
+        next = pos[(y + 1) * stride];
+        pos[y * stride] = (byte)((prev >> 2) + (curr >> 1) + (next >> 2));
+        prev = curr;
+        curr = next;
+      }
+    }
+  }
+}
+
+/* the single sweep smoothing gives the same result as the original sweeps */
+/* with all simd levels, also when smoothing in place                      */
+void test_smooth_binomial(pixel_image *source, string name)
+{
+  pixel_image expected, smoothed;
+  uint32 passes, y, errors;
+  simd_level level, max_level;
+
+  errors = 0;
+  max_level = simd_get_level();
+  for (level = s_NONE; level <= max_level; level++) {
+    simd_set_max_level(level);
+    for (passes = 0; passes < 4; passes++) {
+      pixel_image_clone(&expected, source);
+      pixel_image_copy(&expected, source);
+      reference_smooth_binomial(&expected, passes);
+      pixel_image_clone(&smoothed, source);
+      smooth_binomial(source, &smoothed, passes);
+      for (y = 0; y < source->height; y++) {
+        if (memcmp(smoothed.rows[y], expected.rows[y],
+                   source->width * source->step) != 0) errors++;
+      }
+      smooth_binomial(&smoothed, &smoothed, 0);
+      pixel_image_copy(&smoothed, source);
+      smooth_binomial(&smoothed, &smoothed, passes);
+      for (y = 0; y < source->height; y++) {
+        if (memcmp(smoothed.rows[y], expected.rows[y],
+                   source->width * source->step) != 0) errors++;
+      }
+      pixel_image_destroy(&smoothed);
+      pixel_image_destroy(&expected);
+    }
+  }
+  simd_set_max_level(max_level);
+  printf("%-24s %4lux%-4lu %s", name, source->width, source->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* smoothing a channel view with a non-zero offset changes only that      */
+/* channel, and smoothing with a buffer image does not allocate memory     */
+void test_smooth_binomial_channels(pixel_image *source, string name)
+{
+  pixel_image expected, smoothed, buffer;
+  pixel_image source_view, expected_view, smoothed_view;
+  uint32 c, passes, y, errors, allocations;
+
+  errors = 0;
+  pixel_image_nullify(&expected);
+  pixel_image_nullify(&smoothed);
+  pixel_image_clone(&expected, source);
+  pixel_image_clone(&smoothed, source);
+  pixel_image_create(&buffer, p_U8, GREY, source->width, 4 * 3 + 1, 1,
+                     source->width);
+  for (c = 0; c < source->step; c++) {
+    for (passes = 1; passes <= 3; passes++) {
+      pixel_image_copy(&expected, source);
+      pixel_image_copy(&smoothed, source);
+      pixel_image_init(&source_view, source->data, p_U8, GREY, 0, 0,
+                       source->width, source->height, c, source->step,
+                       source->stride, source->size);
+      source_view.parent = source;
+      pixel_image_init(&expected_view, expected.data, p_U8, GREY, 0, 0,
+                       expected.width, expected.height, c, expected.step,
+                       expected.stride, expected.size);
+      expected_view.parent = &expected;
+      pixel_image_init(&smoothed_view, smoothed.data, p_U8, GREY, 0, 0,
+                       smoothed.width, smoothed.height, c, smoothed.step,
+                       smoothed.stride, smoothed.size);
+      smoothed_view.parent = &smoothed;
+      reference_smooth_binomial(&expected_view, passes);
+      allocations = memory_get_allocation_count();
+      if (smooth_binomial_with_buffer(&source_view, &smoothed_view, passes,
+                                      &buffer) != SUCCESS) errors++;
+      if (memory_get_allocation_count() != allocations) errors++;
+      for (y = 0; y < source->height; y++) {
+        if (memcmp(smoothed.rows[y], expected.rows[y],
+                   source->width * source->step) != 0) errors++;
+      }
+      pixel_image_destroy(&smoothed_view);
+      pixel_image_destroy(&expected_view);
+      pixel_image_destroy(&source_view);
+    }
+  }
+  pixel_image_destroy(&buffer);
+  pixel_image_destroy(&smoothed);
+  pixel_image_destroy(&expected);
+  printf("%-24s %4lux%-4lu %s", name, source->width, source->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* the fused gradient matches sobel_x and sobel_y, and the orientation     */
+/* sector agrees with atan2 except within a small margin of sector borders */
+void test_sobel_gradient(pixel_image *source, string name)
+{
+  pixel_image grey, sx, sy, dx, dy, magnitude, orientation;
+  uint32 x, y, width, height, errors;
+  sint32 gx, gy;
+  double pi, angle, sector;
+  simd_level level, max_level;
+
+  errors = 0;
+  pi = 4 * atan(1.0);
+  width = source->width;
+  height = source->height;
+  pixel_image_create(&grey, p_U8, GREY, width, height, 1, width);
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      ((byte *)grey.rows[y])[x] =
+          ((byte *)source->rows[y])[x * source->step];
+    }
+  }
+  pixel_image_create(&sx, p_S32, GREY, width, height, 1, width);
+  pixel_image_create(&sy, p_S32, GREY, width, height, 1, width);
+  pixel_image_clear(&sx);
+  pixel_image_clear(&sy);
+  if (width >= 3 && height >= 3) {
+    sobel_x(&grey, &sx);
+    sobel_y(&grey, &sy);
+  }
+  pixel_image_create(&dx, p_S16, GREY, width, height, 1, width);
+  pixel_image_create(&dy, p_S16, GREY, width, height, 1, width);
+  pixel_image_create(&magnitude, p_U16, GREY, width, height, 1, width);
+  pixel_image_create(&orientation, p_U8, GREY, width, height, 1, width);
+  max_level = simd_get_level();
+  for (level = s_NONE; level <= max_level; level++) {
+    simd_set_max_level(level);
+    /* the border pixels are zeroed whatever the outputs contained */
+    memset(dx.data, 0xff, width * height * sizeof(sint16));
+    memset(dy.data, 0xff, width * height * sizeof(sint16));
+    memset(magnitude.data, 0xff, width * height * sizeof(uint16));
+    memset(orientation.data, 0xff, width * height);
+    if (sobel_gradient(source, &dx, &dy, &magnitude, &orientation) != SUCCESS) {
+      errors++;
+    }
+    for (y = 0; y < height; y++) {
+      for (x = 0; x < width; x++) {
+        gx = (sint32)((long *)sx.rows[y])[x];
+        gy = (sint32)((long *)sy.rows[y])[x];
+        if (((sint16 *)dx.rows[y])[x] != gx) errors++;
+        if (((sint16 *)dy.rows[y])[x] != gy) errors++;
+        if (((uint16 *)magnitude.rows[y])[x] !=
+            (uint16)((float)sqrt((double)(gx * gx + gy * gy)) + 0.5f)) errors++;
+        if (gx == 0 && gy == 0) {
+          if (((byte *)orientation.rows[y])[x] != 0) errors++;
+          continue;
+        }
+        angle = atan2((double)gy, (double)gx);
+        if (angle < 0) angle += 2 * pi;
+        sector = (angle + pi / 8) / (pi / 4);
+        if (fabs(sector - floor(sector + 0.5)) > 0.001 &&
+            ((byte *)orientation.rows[y])[x] != (byte)((uint32)sector % 8)) {
+          errors++;
+        }
+      }
+    }
+    /* the outputs are optional */
+    if (sobel_gradient(source, NULL, &dy, NULL, NULL) != SUCCESS) errors++;
+  }
+  simd_set_max_level(max_level);
+  pixel_image_destroy(&orientation);
+  pixel_image_destroy(&magnitude);
+  pixel_image_destroy(&dy);
+  pixel_image_destroy(&dx);
+  pixel_image_destroy(&sy);
+  pixel_image_destroy(&sx);
+  pixel_image_destroy(&grey);
+  printf("%-24s %4lux%-4lu %s", name, source->width, source->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* applies the stages of a chain one by one to the whole image */
+void reference_filter_chain(filter_chain *chain, pixel_image *source,
+                            pixel_image *target)
+{
+  pixel_image images[2];
+  pixel_image *input, *output;
+  uint32 i;
+
+  pixel_image_create(&images[0], p_U8, GREY, source->width, source->height,
+                     1, source->width);
+  pixel_image_copy(&images[0], source);
+  input = &images[0];
+  for (i = 0; i < chain->count; i++) {
+    output = &images[(i + 1) % 2];
+    if (i > 0) {
+      pixel_image_destroy(output);
+    }
+    pixel_image_create(output, (chain->stages[i].type == f_SMOOTH_BINOMIAL ||
+                                chain->stages[i].type == f_THRESHOLD) ? p_U8 :
+                       p_S32, GREY, source->width, source->height, 1,
+                       source->width);
+    pixel_image_clear(output);
+    switch (chain->stages[i].type) {
+    case f_SMOOTH_BINOMIAL:
+      smooth_binomial(input, output, chain->stages[i].param);
+      break;
+    case f_SOBEL_X:
+      sobel_x(input, output);
+      break;
+    case f_ABS_SOBEL_Y:
+      abs_sobel_y(input, output);
+      break;
+    case f_EXTREMA_X:
+      extrema_x(input, output);
+      break;
+    case f_THRESHOLD:
+      threshold(input, output, (byte)chain->stages[i].param);
+      break;
+    default:
+      break;
+    }
+    input = output;
+  }
+  pixel_image_copy(target, input);
+  pixel_image_destroy(&images[0]);
+  pixel_image_destroy(&images[1]);
+}
+
+/* the chain filtered in bands gives the same result as the stages applied */
+/* one by one, with any band height and number of threads                  */
+void test_filter_chain(pixel_image *source)
+{
+  filter_chain chain;
+  pixel_image expected, filtered;
+  pixel_type type;
+  uint32 i, y, band, threads, row_size, errors;
+  uint32 band_heights[4] = { 0, 1, 5, 64 };
+
+  errors = 0;
+  for (i = 0; i < 4; i++) {
+    filter_chain_create(&chain, 1);
+    switch (i) {
+    case 0:
+      filter_chain_add(&chain, f_SMOOTH_BINOMIAL, 2);
+      filter_chain_add(&chain, f_SOBEL_X, 0);
+      filter_chain_add(&chain, f_EXTREMA_X, 0);
+      break;
+    case 1:
+      filter_chain_add(&chain, f_SMOOTH_BINOMIAL, 1);
+      filter_chain_add(&chain, f_THRESHOLD, 128);
+      break;
+    case 2:
+      filter_chain_add(&chain, f_ABS_SOBEL_Y, 0);
+      filter_chain_add(&chain, f_EXTREMA_X, 0);
+      break;
+    default:
+      filter_chain_add(&chain, f_SMOOTH_BINOMIAL, 0);
+      filter_chain_add(&chain, f_SMOOTH_BINOMIAL, 3);
+      filter_chain_add(&chain, f_THRESHOLD, 100);
+      break;
+    }
+    type = (i % 2 == 0) ? p_S32 : p_U8;
+    row_size = source->width * (uint32)((type == p_U8) ? 1 : sizeof(long));
+    pixel_image_create(&expected, type, GREY, source->width, source->height,
+                       1, source->width);
+    pixel_image_create(&filtered, type, GREY, source->width, source->height,
+                       1, source->width);
+    reference_filter_chain(&chain, source, &expected);
+    for (band = 0; band < 4; band++) {
+      chain.band_height = band_heights[band];
+      for (threads = 1; threads <= 4; threads++) {
+        pixel_image_clear(&filtered);
+        if (filter_chain_run(&chain, source, &filtered, threads) != SUCCESS) {
+          errors++;
+        }
+        for (y = 0; y < source->height; y++) {
+          if (memcmp(filtered.rows[y], expected.rows[y], row_size) != 0) {
+            errors++;
+          }
+        }
+      }
+    }
+    pixel_image_destroy(&filtered);
+    pixel_image_destroy(&expected);
+    filter_chain_destroy(&chain);
+  }
+
+  /* the types of consecutive stages must match */
+  filter_chain_create(&chain, 2);
+  filter_chain_add(&chain, f_SOBEL_X, 0);
+  filter_chain_add(&chain, f_THRESHOLD, 10);
+  pixel_image_create(&filtered, p_U8, GREY, source->width, source->height, 1,
+                     source->width);
+  if (filter_chain_run(&chain, source, &filtered, 1) == SUCCESS) errors++;
+  pixel_image_destroy(&filtered);
+  filter_chain_destroy(&chain);
+
+  printf("%-24s %4lux%-4lu %s", "filter_chain", source->width, source->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* finds the extrema along scanlines as the original scalar loops did; the */
+/* value after a turn of direction is written, other values are set to 0   */
+void reference_extrema(pixel_image *source, pixel_image *target,
+                       truth_value horizontal)
+{
+  uint32 scan, i, lines, length;
+  long prev, value, *pos, *out;
+  sint32 dir;
+
+  lines = IS_TRUE(horizontal) ? source->height : source->width;
+  length = IS_TRUE(horizontal) ? source->width : source->height;
+  for (scan = 0; scan < lines; scan++) {
+    dir = 0;
+    for (i = 0; i + 1 < length; i++) {
+      if (IS_TRUE(horizontal)) {
+        pos = (long *)source->rows[scan] + i;
+        out = (long *)target->rows[scan] + i;
+        prev = pos[0];
+        value = pos[1];
+      }
+      else {
+        pos = (long *)source->rows[i] + scan;
+        out = (long *)target->rows[i] + scan;
+        prev = pos[0];
+        value = ((long *)source->rows[i + 1])[scan];
+      }
+      if (i > 0) {
+        *out = ((value < prev && dir > 0) || (value > prev && dir < 0)) ?
+            value : 0;
+      }
+      if (value != prev) {
+        dir = (value > prev) ? 1 : -1;
+      }
+    }
+  }
+}
+
+/* the vector and threaded extrema give the same result as the original */
+/* loops, also with long plateaus and when filtering in place          */
+void test_extrema(pixel_image *source)
+{
+  pixel_image values, expected, found;
+  uint32 x, y, pass, threads, width, height, errors, allocations;
+  simd_level level, max_level;
+
+  errors = 0;
+  width = source->width;
+  height = source->height;
+  pixel_image_create(&values, p_S32, GREY, width, height, 1, width);
+  pixel_image_create(&expected, p_S32, GREY, width, height, 1, width);
+  pixel_image_create(&found, p_S32, GREY, width, height, 1, width);
+  /* coarse values give plateaus, and large values need all 64 bits */
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      ((long *)values.rows[y])[x] =
+          ((long)(((byte *)source->rows[y])[x] / 64) - 2) * 1000000007L +
+          (long)((x + y) % 2);
+    }
+  }
+  max_level = simd_get_level();
+  for (pass = 0; pass < 2; pass++) {
+    pixel_image_clear(&expected);
+    reference_extrema(&values, &expected, (pass == 0) ? TRUE : FALSE);
+    for (level = s_NONE; level <= max_level; level++) {
+      simd_set_max_level(level);
+      for (threads = 1; threads <= 4; threads++) {
+        pixel_image_clear(&found);
+        allocations = memory_get_allocation_count();
+        if (pass == 0) {
+          extrema_x_parallel(&values, &found, threads);
+        }
+        else {
+          extrema_y_parallel(&values, &found, threads);
+        }
+        /* a single thread does not allocate memory */
+        if (threads == 1 &&
+            memory_get_allocation_count() != allocations) errors++;
+        for (y = 0; y < height; y++) {
+          if (memcmp(found.rows[y], expected.rows[y],
+                     width * sizeof(long)) != 0) errors++;
+        }
+        /* the first and last lines are kept in place */
+        pixel_image_copy(&found, &values);
+        if (pass == 0) {
+          extrema_x_parallel(&found, &found, threads);
+        }
+        else {
+          extrema_y_parallel(&found, &found, threads);
+        }
+        for (y = 0; y < height; y++) {
+          for (x = 0; x < width; x++) {
+            if ((pass == 0 && (x == 0 || x == width - 1)) ||
+                (pass == 1 && (y == 0 || y == height - 1))) {
+              if (((long *)found.rows[y])[x] !=
+                  ((long *)values.rows[y])[x]) errors++;
+            }
+            else
+            if (((long *)found.rows[y])[x] !=
+                ((long *)expected.rows[y])[x]) errors++;
+          }
+        }
+      }
+    }
+  }
+  simd_set_max_level(max_level);
+  pixel_image_destroy(&found);
+  pixel_image_destroy(&expected);
+  pixel_image_destroy(&values);
+  printf("%-24s %4lux%-4lu %s", "extrema", width, height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* maps a coordinate outside the image as the border policy says, or to -1 */
+/* for zero padding                                                         */
+sint32 reference_border(sint32 i, sint32 size, convolution_border border)
+{
+  sint32 period;
+
+  if (i >= 0 && i < size) return i;
+  if (border == c_ZERO) return -1;
+  if (border == c_CLAMP || size == 1) return (i < 0) ? 0 : size - 1;
+  period = 2 * (size - 1);
+  i = ((i % period) + period) % period;
+  return (i < size) ? i : period - i;
+}
+
+real32 reference_pixel(pixel_image *image, sint32 x, sint32 y)
+{
+  switch (image->type) {
+  case p_U8: return (real32)((byte *)image->rows[y])[x];
+  case p_S16: return (real32)((sint16 *)image->rows[y])[x];
+  default: return ((real32 *)image->rows[y])[x];
+  }
+}
+
+/* convolves with plain loops, rows first and then columns, summing in the */
+/* same order as the library does                                          */
+void reference_convolve(pixel_image *source, pixel_image *target,
+                        real32 *weights_x, sint32 radius_x,
+                        real32 *weights_y, sint32 radius_y,
+                        convolution_border border)
+{
+  sint32 x, y, k, i, width, height;
+  pixel_image rows;
+  real32 sum;
+
+  width = (sint32)source->width;
+  height = (sint32)source->height;
+  pixel_image_create(&rows, p_F32, GREY, source->width, source->height, 1,
+                     source->width);
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      sum = 0;
+      for (k = 0; k <= 2 * radius_x; k++) {
+        i = reference_border(x - radius_x + k, width, border);
+        sum += weights_x[k] * ((i < 0) ? 0 : reference_pixel(source, i, y));
+      }
+      ((real32 *)rows.rows[y])[x] = sum;
+    }
+  }
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      sum = 0;
+      for (k = 0; k <= 2 * radius_y; k++) {
+        i = reference_border(y - radius_y + k, height, border);
+        sum += weights_y[k] * ((i < 0) ? 0 : ((real32 *)rows.rows[i])[x]);
+      }
+      switch (target->type) {
+      case p_U8:
+        ((byte *)target->rows[y])[x] = (byte)((sum < 0) ? 0 :
+            (sum > 255) ? 255 : floor(sum + 0.5));
+        break;
+      case p_S16:
+        ((sint16 *)target->rows[y])[x] = (sint16)((sum < -32768) ? -32768 :
+            (sum > 32767) ? 32767 : (sum < 0) ? -floor(-sum + 0.5) :
+            floor(sum + 0.5));
+        break;
+      default:
+        ((real32 *)target->rows[y])[x] = sum;
+        break;
+      }
+    }
+  }
+  pixel_image_destroy(&rows);
+}
+
+/* the separable convolution matches plain loops for all border policies, */
+/* pixel types, kernel sizes, vector levels and thread counts, and        */
+/* reproduces the sobel filter inside the image                           */
+void test_convolve_separable(pixel_image *source)
+{
+  pixel_image images[3], expected, found, dx;
+  pixel_type types[3] = { p_U8, p_S16, p_F32 };
+  sint32 radii_x[3] = { 1, 2, 5 };
+  sint32 radii_y[3] = { 1, 3, 0 };
+  real32 weights[11], sobel_x[3] = { -1, 0, 1 }, sobel_y[3] = { 1, 2, 1 };
+  uint32 x, y, k, i, b, r, threads, width, height, errors;
+  convolution_border border;
+  simd_level level, max_level;
+  byte value;
+
+  errors = 0;
+  width = source->width;
+  height = source->height;
+  for (i = 0; i < 3; i++) {
+    pixel_image_create(&images[i], types[i], GREY, width, height, 1, width);
+  }
+  /* signed and fractional values, with some that saturate the targets */
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      value = ((byte *)source->rows[y])[x];
+      ((byte *)images[0].rows[y])[x] = value;
+      ((sint16 *)images[1].rows[y])[x] = (sint16)(((sint32)value - 128) * 100);
+      ((real32 *)images[2].rows[y])[x] = (real32)value / 7 - 10;
+    }
+  }
+  /* asymmetric weights show if the kernel is flipped */
+  for (k = 0; k < 11; k++) {
+    weights[k] = (real32)(k % 4 + 1) / 8 - (real32)(k % 3) / 5;
+  }
+  max_level = simd_get_level();
+  for (b = 0; b < 3; b++) {
+    border = (b == 0) ? c_CLAMP : (b == 1) ? c_REFLECT : c_ZERO;
+    for (r = 0; r < 3; r++) {
+      /* the nine border and kernel pairs cover all pairs of types */
+      i = b * 3 + r;
+      pixel_image_create(&expected, types[i / 3], GREY, width, height, 1,
+                         width);
+      pixel_image_create(&found, types[i / 3], GREY, width, height, 1, width);
+      reference_convolve(&images[i % 3], &expected, weights, radii_x[r],
+                         weights + 1, radii_y[r], border);
+      for (level = s_NONE; level <= max_level; level++) {
+        simd_set_max_level(level);
+        for (threads = 1; threads <= 3; threads += 2) {
+          pixel_image_clear(&found);
+          if (convolve_separable(&images[i % 3], &found, weights,
+                                 (uint32)radii_x[r], weights + 1,
+                                 (uint32)radii_y[r], border, threads)
+              != SUCCESS) {
+            errors++;
+          }
+          for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++) {
+              if (reference_pixel(&found, (sint32)x, (sint32)y) !=
+                  reference_pixel(&expected, (sint32)x, (sint32)y)) errors++;
+            }
+          }
+        }
+      }
+      pixel_image_destroy(&found);
+      pixel_image_destroy(&expected);
+    }
+  }
+  simd_set_max_level(max_level);
+  /* the sobel filter is exact inside the image */
+  pixel_image_create(&dx, p_S16, GREY, width, height, 1, width);
+  pixel_image_create(&found, p_S16, GREY, width, height, 1, width);
+  if (sobel_gradient(&images[0], &dx, NULL, NULL, NULL) != SUCCESS) errors++;
+  if (convolve_separable(&images[0], &found, sobel_x, 1, sobel_y, 1, c_CLAMP,
+                         1) != SUCCESS) errors++;
+  for (y = 1; y + 1 < height; y++) {
+    for (x = 1; x + 1 < width; x++) {
+      if (((sint16 *)found.rows[y])[x] != ((sint16 *)dx.rows[y])[x]) errors++;
+    }
+  }
+  pixel_image_destroy(&found);
+  pixel_image_destroy(&dx);
+  for (i = 0; i < 3; i++) {
+    pixel_image_destroy(&images[i]);
+  }
+  printf("%-24s %4lux%-4lu %s", "convolve_separable", width, height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+int main()
+{
+  pixel_image source, view;
+  uint32 i, c;
+
+  printf("Starting filter tests\n");
+
+  for (i = 0; i < TEST_SIZE_COUNT; i++) {
+    pixel_image_create(&source, p_U8, GREY, test_widths[i], test_heights[i], 1,
+                       test_widths[i]);
+    fill_image(&source, i + 1);
+    if (test_widths[i] > 1 && test_heights[i] > 1) {
+      test_smooth_binomial(&source, "smooth_binomial");
+    }
+    test_sobel_gradient(&source, "sobel_gradient");
+    if (test_widths[i] > 2 && test_heights[i] > 2) {
+      test_filter_chain(&source);
+    }
+    test_extrema(&source);
+    test_convolve_separable(&source);
+    pixel_image_destroy(&source);
+  }
+
+  /* streamed images keep only a band of rows in memory */
+  pixel_image_create(&source, p_U8, GREY, 97, 61, 1, 97);
+  fill_image(&source, 42);
+  test_filter_streams(&source);
+  pixel_image_destroy(&source);
+  pixel_image_create(&source, p_U8, GREY, 96, 45, 1, 96);
+  fill_image(&source, 43);
+  test_filter_streams(&source);
+  pixel_image_destroy(&source);
+
+  /* all channels of multi-channel images are handled */
+  pixel_image_create(&source, p_U8, RGB, 37, 23, 3, 3 * 37);
+  fill_image(&source, 7);
+  test_smooth_binomial(&source, "smooth_binomial rgb");
+  test_smooth_binomial_channels(&source, "smooth_binomial channels");
+  test_sobel_gradient(&source, "sobel_gradient rgb");
+  /* channel views with a non-zero offset */
+  for (c = 1; c < source.step; c++) {
+    pixel_image_init(&view, source.data, p_U8, GREY, 0, 0, source.width,
+                     source.height, c, source.step, source.stride, source.size);
+    view.parent = &source;
+    test_sobel_gradient(&view, "sobel_gradient channel");
+    pixel_image_destroy(&view);
+  }
+  pixel_image_destroy(&source);
+
+  printf("Filter tests finished with %lu failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,805 @@
+/**
+ * @file cvsu_integral_t.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Testing code for cvsu_integral.c
+ *
+ * Copyright (c) 2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_memory.h"
+#include "cvsu_pixel_image.h"
+#include "cvsu_integral.h"
+#include "cvsu_simd.h"
+#include "cvsu_test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/* integral values of all storages are exact in integral_value */
+#define I_1(i) integral_image_get_value_1(target, (i))
+#define I_2(i) integral_image_get_value_2(target, (i))
+
+/* calculate the integrals naively, summing all pixels above and left */
+void check_integral(integral_image *target, string name)
+{
+  uint32 x, y, c, pos, channels, channel_step, errors;
+  integral_value sum1, sum2, value;
+  pixel_image *source;
+
+  source = target->original;
+  channels = source->step;
+  channel_step = target->step / channels;
+  errors = 0;
+  for (c = 0; c < channels; c++) {
+    for (x = 0; x <= target->width; x++) {
+      pos = x * target->step + c * channel_step;
+      if (I_1(pos) != 0 || I_2(pos) != 0) errors++;
+    }
+    for (y = 0; y < target->height; y++) {
+      sum1 = 0;
+      sum2 = 0;
+      pos = (y + 1) * target->stride + c * channel_step;
+      if (I_1(pos) != 0 || I_2(pos) != 0) errors++;
+      for (x = 0; x < target->width; x++) {
+        value = (integral_value)((byte *)source->rows[y])[x * channels + c];
+        sum1 += value;
+        sum2 += value * value;
+        pos += target->step;
+        if (I_1(pos) != I_1(pos - target->stride) + sum1) errors++;
+        if (I_2(pos) != I_2(pos - target->stride) + sum2) errors++;
+      }
+    }
+  }
+  printf("%-24s %4lux%-4lu %s", name, target->width, target->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* compare the integrals element by element, any difference is an error */
+void check_identical(integral_image *target, integral_image *reference,
+                     string name)
+{
+  uint32 i, errors, size_1, size_2;
+
+  switch (target->storage) {
+  case i_EXACT:
+    size_1 = sizeof(EI_1_t);
+    size_2 = sizeof(EI_2_t);
+    break;
+  case i_SMALL:
+    size_1 = sizeof(SI_1_t);
+    size_2 = sizeof(SI_2_t);
+    break;
+  case i_TILED:
+    size_1 = sizeof(TI_t);
+    size_2 = sizeof(TI_t);
+    break;
+  default:
+    size_1 = sizeof(integral_value);
+    size_2 = sizeof(integral_value);
+  }
+  errors = 0;
+  for (i = 0; i < target->I_1.size; i++) {
+    if (memcmp(((byte *)target->I_1.data) + i * size_1,
+               ((byte *)reference->I_1.data) + i * size_1, size_1) != 0) errors++;
+  }
+  /* interleaved I_2 is one value shorter than I_1 */
+  for (i = 0; i < target->I_2.size; i++) {
+    if (memcmp(((byte *)target->I_2.data) + i * size_2,
+               ((byte *)reference->I_2.data) + i * size_2, size_2) != 0) errors++;
+  }
+  printf("%-24s %4lux%-4lu %s", name, target->width, target->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+void test_integral_update(pixel_image *source, integral_layout layout,
+                          string name)
+{
+  integral_image I;
+  simd_level level, max_level;
+
+  integral_image_nullify(&I);
+  if (integral_image_create_with_layout(&I, source, i_REAL, layout) !=
+      SUCCESS) {
+    printf("%-24s create failed\n", name);
+    failures++;
+    return;
+  }
+  max_level = simd_get_level();
+  for (level = s_NONE; level <= max_level; level++) {
+    simd_set_max_level(level);
+    integral_image_update(&I);
+    printf("%-6s ", simd_level_name(level));
+    check_integral(&I, name);
+  }
+  simd_set_max_level(max_level);
+  integral_image_destroy(&I);
+}
+
+/* integer storages and interleaved layout must give exactly the same */
+/* statistics as real storage with separate layout */
+void test_integral_statistics(pixel_image *source, integral_storage storage,
+                              integral_layout layout, string name)
+{
+  integral_image I, reference;
+  integral_box_batch batch;
+  statistics stat, reference_stat;
+  simd_level level, max_level;
+  sint32 x, y, size;
+  uint32 c, i, errors, allocations;
+
+  integral_image_nullify(&I);
+  integral_image_nullify(&reference);
+  if (integral_image_create_with_layout(&I, source, storage, layout) !=
+      SUCCESS) {
+    printf("%-24s create failed\n", name);
+    failures++;
+    return;
+  }
+  integral_image_create(&reference, source);
+  integral_image_update(&I);
+  integral_image_update(&reference);
+  /* later updates reuse the buffers of the first one */
+  errors = 0;
+  allocations = memory_get_allocation_count();
+  integral_image_update(&I);
+  if (memory_get_allocation_count() != allocations) errors++;
+  check_integral(&I, name);
+  integral_box_batch_create(&batch,
+                            (source->height / 3 + 5) * (source->width / 5 + 5));
+  max_level = simd_get_level();
+
+  for (c = 0; c < source->step; c++) {
+    for (size = 1; size <= 9; size += 4) {
+      batch.count = 0;
+      for (y = -size; y < (signed)source->height; y += 3) {
+        for (x = -size; x < (signed)source->width; x += 5) {
+          batch.x[batch.count] = x;
+          batch.y[batch.count] = y;
+          batch.dx[batch.count] = size;
+          batch.dy[batch.count] = size;
+          batch.count++;
+        }
+      }
+      /* batch queries must give the same results with all simd levels */
+      for (level = s_NONE; level <= max_level; level++) {
+        simd_set_max_level(level);
+        integral_image_calculate_batch(&I, &batch, c);
+        for (i = 0; i < batch.count; i++) {
+          integral_image_calculate_statistics(&reference, &reference_stat,
+                                              batch.x[i], batch.y[i],
+                                              size, size, c);
+          if (batch.mean[i] != reference_stat.mean ||
+              batch.variance[i] != reference_stat.variance) errors++;
+          if (batch.N[i] > 0 && (batch.N[i] != reference_stat.N ||
+                                 batch.sum[i] != reference_stat.sum ||
+                                 batch.deviation[i] !=
+                                 reference_stat.deviation)) errors++;
+        }
+      }
+      simd_set_max_level(max_level);
+      for (y = -size; y < (signed)source->height; y += 3) {
+        for (x = -size; x < (signed)source->width; x += 5) {
+          integral_image_calculate_statistics(&I, &stat, x, y, size, size, c);
+          integral_image_calculate_statistics(&reference, &reference_stat,
+                                              x, y, size, size, c);
+          if (stat.mean != reference_stat.mean ||
+              stat.variance != reference_stat.variance) errors++;
+          /* sums are set only for valid rectangles */
+          if (integral_image_create_rect(&I, x, y, size, size, c).valid != 0 &&
+              (stat.sum != reference_stat.sum ||
+               stat.sum2 != reference_stat.sum2)) errors++;
+          if (integral_image_calculate_mean(&I, x, y, size, size, c) !=
+              reference_stat.mean) errors++;
+          if (integral_image_calculate_variance(&I, x, y, size, size, c) !=
+              reference_stat.variance) errors++;
+        }
+      }
+    }
+  }
+  printf("%-31s %4lux%-4lu %s", "statistics", I.width, I.height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+  integral_box_batch_destroy(&batch);
+  integral_image_destroy(&reference);
+  integral_image_destroy(&I);
+}
+
+/* the higher order integrals are built on the first query after an update, */
+/* and the moments must match the ones calculated from naive sums */
+void test_higher_statistics(pixel_image *source, integral_layout layout,
+                            string name)
+{
+  integral_image I;
+  statistics stat;
+  integral_value skewness, kurtosis, N, mean, var, sum1, sum2, sum3, sum4;
+  integral_value value, m3, m4, expected_skewness, expected_kurtosis;
+  uint32 c, x, y, px, py, size, errors;
+
+  integral_image_nullify(&I);
+  integral_image_create_with_layout(&I, source, i_REAL, layout);
+  integral_image_update(&I);
+  errors = 0;
+  if (I.I_3.data != NULL) errors++;
+  for (c = 0; c < source->step; c++) {
+    for (size = 1; size <= 5; size += 2) {
+      for (y = 0; y + size <= source->height; y += 2) {
+        for (x = 0; x + size <= source->width; x += 3) {
+          integral_image_calculate_higher_statistics(&I, &stat, &skewness,
+              &kurtosis, (sint32)x, (sint32)y, (sint32)size, (sint32)size, c);
+          sum1 = sum2 = sum3 = sum4 = 0;
+          for (py = y; py < y + size; py++) {
+            for (px = x; px < x + size; px++) {
+              value = (integral_value)
+                  ((byte *)source->rows[py])[px * source->step + c];
+              sum1 += value;
+              sum2 += value * value;
+              sum3 += value * value * value;
+              sum4 += value * value * value * value;
+            }
+          }
+          N = (integral_value)(size * size);
+          mean = sum1 / N;
+          var = (sum2 / N) - mean*mean;
+          if (var < 0) var = 0;
+          m3 = sum3 / N - 3 * mean * (sum2 / N) + 2 * mean * mean * mean;
+          m4 = sum4 / N - 4 * mean * (sum3 / N) + 6 * mean * mean * (sum2 / N)
+             - 3 * mean * mean * mean * mean;
+          expected_skewness = 0;
+          expected_kurtosis = 0;
+          if (var > 0) {
+            expected_skewness = m3 / (var * sqrt(var));
+            expected_kurtosis = m4 / (var * var);
+          }
+          if (stat.mean != mean || skewness != expected_skewness ||
+              kurtosis != expected_kurtosis) errors++;
+        }
+      }
+    }
+  }
+  /* the higher order integrals take one value per channel and pixel */
+  if (I.I_3.size != source->step * (source->width + 1) * (source->height + 1))
+    errors++;
+  /* a new update must invalidate the higher order integrals */
+  integral_image_update(&I);
+  if (IS_TRUE(I.higher_order_updated)) errors++;
+  printf("%-24s %4lux%-4lu %s", name, I.width, I.height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+  integral_image_destroy(&I);
+}
+
+void test_integral_update_parallel(pixel_image *source,
+                                   integral_storage storage,
+                                   integral_layout layout, string name)
+{
+  integral_image I, reference;
+  uint32 threads, allocations;
+
+  integral_image_nullify(&I);
+  integral_image_nullify(&reference);
+  integral_image_create_with_layout(&I, source, storage, layout);
+  integral_image_create_with_layout(&reference, source, storage, layout);
+  if (storage == i_SMALL) {
+    small_integral_image_update(&reference);
+  }
+  else {
+    integral_image_update(&reference);
+  }
+  integral_image_update(&I);
+  for (threads = 1; threads <= 8; threads++) {
+    /* make sure old values don't hide errors */
+    pixel_image_clear(&I.I_1);
+    pixel_image_clear(&I.I_2);
+    /* running the tasks in parallel does not allocate memory */
+    allocations = memory_get_allocation_count();
+    integral_image_update_parallel(&I, threads);
+    if (memory_get_allocation_count() != allocations) {
+      printf("%-24s %lu thr. allocated memory\n", name, threads);
+      failures++;
+    }
+    printf("%lu thr. ", threads);
+    check_identical(&I, &reference, name);
+  }
+  integral_image_destroy(&reference);
+  integral_image_destroy(&I);
+}
+
+/* sum the pixels of each rotated rectangle naively, using the rectangle */
+/* coordinates u and v along the diagonals relative to the top corner */
+void check_tilted(integral_image *target, string name)
+{
+  pixel_image *source;
+  statistics stat;
+  sint32 x, y, w, h, px, py, u, v, width, height, errors, valid;
+  integral_value N, sum1, sum2, value;
+
+  source = target->original;
+  width = (sint32)target->width;
+  height = (sint32)target->height;
+  errors = 0;
+  for (w = 1; w <= 3; w++) {
+    for (h = 1; h <= 3; h++) {
+      for (y = -1; y <= height; y++) {
+        for (x = -1; x <= width; x++) {
+          if (integral_image_calculate_tilted_statistics(target, &stat, x, y,
+                                                         w, h) != SUCCESS) {
+            errors++;
+          }
+          valid = 1;
+          N = 0;
+          sum1 = 0;
+          sum2 = 0;
+          for (py = y; py < y + w + h; py++) {
+            for (px = x - h; px <= x + w; px++) {
+              u = (px - x) + (py - y);
+              v = (py - y) - (px - x);
+              if (u < 0 || u >= 2 * w || v < 0 || v >= 2 * h) continue;
+              if (px < 0 || px >= width || py < 0 || py >= height) {
+                /* rectangles crossing the border are not valid */
+                valid = 0;
+                continue;
+              }
+              value = (integral_value)((byte *)source->rows[py])[px];
+              N += 1;
+              sum1 += value;
+              sum2 += value * value;
+            }
+          }
+          if (valid == 0) {
+            if (stat.N != 0) errors++;
+          }
+          else if (stat.N != N || stat.sum != sum1 || stat.sum2 != sum2) {
+            errors++;
+          }
+        }
+      }
+    }
+  }
+  printf("%-24s %4lux%-4lu %s", name, target->width, target->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%ld errors)\n", errors);
+    failures++;
+  }
+}
+
+void test_integral_tilted(pixel_image *source)
+{
+  integral_image I;
+  pixel_image frame;
+  statistics stat;
+  uint32 threads, allocations;
+
+  integral_image_nullify(&I);
+  integral_image_create(&I, source);
+  /* the tilted statistics fail until the tilted integrals are enabled */
+  if (integral_image_calculate_tilted_statistics(&I, &stat, 1, 0, 1, 1) ==
+      SUCCESS || stat.N != 0) {
+    printf("%-24s succeeded without tilted integrals\n", "tilted statistics");
+    failures++;
+  }
+  integral_image_enable_tilted(&I);
+  pixel_image_nullify(&frame);
+  pixel_image_clone(&frame, source);
+  pixel_image_copy(&frame, source);
+  /* the tilted state is allocated with the tilted integrals, not per update */
+  allocations = memory_get_allocation_count();
+  integral_image_update(&I);
+  integral_image_update_from_reader(&I, &pixel_image_read_row, &frame);
+  if (memory_get_allocation_count() != allocations) {
+    printf("%-24s allocated memory\n", "tilted update");
+    failures++;
+  }
+  check_tilted(&I, "tilted update");
+  for (threads = 2; threads <= 4; threads++) {
+    pixel_image_clear(&I.T_1);
+    pixel_image_clear(&I.T_2);
+    allocations = memory_get_allocation_count();
+    integral_image_update_parallel(&I, threads);
+    if (memory_get_allocation_count() != allocations) {
+      printf("%-24s allocated memory\n", "tilted parallel");
+      failures++;
+    }
+    printf("%lu thr. ", threads);
+    check_tilted(&I, "tilted parallel");
+  }
+  pixel_image_destroy(&frame);
+  integral_image_destroy(&I);
+}
+
+/* change pixels within rectangles of the frame, copy the changes into the */
+/* image of the integral, and compare the incremental and full updates     */
+void test_integral_update_rect(pixel_image *source, integral_layout layout,
+                               string name)
+{
+  integral_image I, reference;
+  pixel_image frame, previous;
+  sint32 x, y, dx, dy, cx, cy, cdx, cdy;
+  uint32 i, px, py, errors, allocations;
+  byte *pos;
+
+  pixel_image_clone(&frame, source);
+  pixel_image_clone(&previous, source);
+  pixel_image_copy(&frame, source);
+  pixel_image_copy(&previous, source);
+  integral_image_nullify(&I);
+  integral_image_nullify(&reference);
+  integral_image_create_with_layout(&I, &previous, i_REAL, layout);
+  integral_image_create_with_layout(&reference, &frame, i_REAL, layout);
+  if (source->step == 1) {
+    integral_image_enable_tilted(&I);
+    integral_image_enable_tilted(&reference);
+  }
+  integral_image_update(&I);
+  /* after the first changed rectangle, the updates do not allocate memory */
+  integral_image_update_rect(&I, 0, 0, 1, 1);
+  allocations = memory_get_allocation_count();
+  errors = 0;
+  for (i = 0; i < 8; i++) {
+    /* the rectangles cover corners, borders, single pixels and no pixels */
+    cx = (sint32)((i * 5) % source->width);
+    cy = (sint32)((i * 3) % source->height);
+    cdx = (sint32)(i % 4);
+    cdy = (sint32)((i + 1) % 3);
+    for (py = (uint32)cy; py < (uint32)(cy + cdy) && py < source->height;
+         py++) {
+      pos = (byte *)frame.rows[py];
+      for (px = (uint32)cx * source->step;
+           px < (uint32)(cx + cdx) * source->step &&
+           px < source->width * source->step; px++) {
+        pos[px] = (byte)(pos[px] + 1 + i);
+      }
+    }
+    pixel_image_copy_changes(&previous, &frame, &x, &y, &dx, &dy);
+    if (cx + cdx > (sint32)source->width) cdx = (sint32)source->width - cx;
+    if (cy + cdy > (sint32)source->height) cdy = (sint32)source->height - cy;
+    if (cdx > 0 && cdy > 0 &&
+        (x != cx || y != cy || dx != cdx || dy != cdy)) errors++;
+    if ((cdx == 0 || cdy == 0) && (dx != 0 || dy != 0)) errors++;
+    integral_image_update_rect(&I, x, y, dx, dy);
+  }
+  if (memory_get_allocation_count() != allocations) errors++;
+  integral_image_update(&reference);
+  printf("changed rect ");
+  check_identical(&I, &reference, name);
+  if (I.T_1.data != NULL &&
+      memcmp(I.T_1.data, reference.T_1.data,
+             I.T_1.size * sizeof(integral_value)) != 0) {
+    printf("%-24s tilted integrals differ\n", name);
+    errors++;
+  }
+  if (errors > 0) {
+    printf("%-24s changed rectangle FAILED (%lu errors)\n", name, errors);
+    failures++;
+  }
+  integral_image_destroy(&reference);
+  integral_image_destroy(&I);
+  pixel_image_destroy(&previous);
+  pixel_image_destroy(&frame);
+}
+
+/* aligned images have aligned rows and replicated borders, and their */
+/* integrals are the same as those of regular images */
+void test_aligned_image(pixel_image *source, uint32 border, string name)
+{
+  pixel_image aligned;
+  integral_image I;
+  sint32 x, y, sx, sy, w, h, c;
+  uint32 errors;
+
+  if (pixel_image_create_aligned(&aligned, p_U8, source->format,
+                                 source->width, source->height, source->step,
+                                 border) != SUCCESS) {
+    printf("%-24s create failed\n", name);
+    failures++;
+    return;
+  }
+  pixel_image_copy(&aligned, source);
+  pixel_image_replicate_border(&aligned);
+  errors = 0;
+  w = (sint32)source->width;
+  h = (sint32)source->height;
+  for (y = -(sint32)border; y < h + (sint32)border; y++) {
+    if (((size_t)((byte *)aligned.data + (uint32)(y + (sint32)border) *
+                  aligned.stride + aligned.dx * aligned.step) %
+         MEMORY_ALIGNMENT) != 0) errors++;
+    sy = (y < 0) ? 0 : ((y >= h) ? h - 1 : y);
+    for (x = -(sint32)border; x < w + (sint32)border; x++) {
+      sx = (x < 0) ? 0 : ((x >= w) ? w - 1 : x);
+      for (c = 0; c < (sint32)source->step; c++) {
+        if (((byte *)aligned.rows[0])[y * (sint32)aligned.stride +
+                                       x * (sint32)aligned.step + c] !=
+            ((byte *)source->rows[sy])[sx * (sint32)source->step + c])
+          errors++;
+      }
+    }
+  }
+  integral_image_nullify(&I);
+  integral_image_create(&I, &aligned);
+  integral_image_update(&I);
+  for (y = 0; y <= h; y++) {
+    if (((size_t)I.I_1.rows[y] % MEMORY_ALIGNMENT) != 0) errors++;
+  }
+  printf("aligned ");
+  check_integral(&I, name);
+  integral_image_destroy(&I);
+  pixel_image_destroy(&aligned);
+  if (errors > 0) {
+    printf("%-24s aligned image FAILED (%lu errors)\n", name, errors);
+    failures++;
+  }
+}
+
+/* the fused conversion and update equals converting and then updating */
+void test_integral_from_yuv422(uint32 width, uint32 height, string name)
+{
+  pixel_image grey, uyvy, converted;
+  integral_image I, reference;
+
+  pixel_image_create(&grey, p_U8, GREY, width, height, 1, width);
+  pixel_image_create(&uyvy, p_U8, UYVY, width, height, 2, 2 * width);
+  fill_image(&uyvy, width + 3);
+  pixel_image_clone(&converted, &grey);
+  integral_image_nullify(&I);
+  integral_image_nullify(&reference);
+  integral_image_create(&I, &converted);
+  integral_image_create(&reference, &grey);
+  convert_uyvy16_to_grey8(&uyvy, &grey);
+  integral_image_update(&reference);
+  integral_image_update_from_yuv422(&I, &uyvy, 1);
+  if (memcmp(converted.data, grey.data, width * height) != 0) {
+    printf("%-24s conversion FAILED\n", name);
+    failures++;
+  }
+  check_identical(&I, &reference, name);
+  integral_image_destroy(&reference);
+  integral_image_destroy(&I);
+  pixel_image_destroy(&converted);
+  pixel_image_destroy(&uyvy);
+  pixel_image_destroy(&grey);
+}
+
+/* the integral updated from the rows of a pnm file equals the integral of */
+/* the image the file was written from                                     */
+void test_integral_from_reader(pixel_image *source)
+{
+  integral_image I, reference;
+  pixel_image grey;
+  pnm_row_source pnm;
+  string pnm_name = "cvsu_integral_test.pnm";
+
+  pixel_image_write(source, pnm_name, FALSE);
+  if (pnm_row_source_open(&pnm, pnm_name) != SUCCESS) {
+    printf("%-24s open failed\n", "pnm row source");
+    failures++;
+    return;
+  }
+  pixel_image_create(&grey, p_U8, GREY, source->width, source->height, 1,
+                     source->width);
+  integral_image_create(&reference, source);
+  integral_image_update(&reference);
+  integral_image_create(&I, &grey);
+  integral_image_update_from_reader(&I, &pnm_row_source_read, &pnm);
+  check_identical(&I, &reference, "pnm row source");
+  integral_image_destroy(&I);
+  integral_image_destroy(&reference);
+  pixel_image_destroy(&grey);
+  pnm_row_source_close(&pnm);
+  remove(pnm_name);
+}
+
+/* streaming thresholds must give the same result as the in-memory ones */
+void test_integral_stream(pixel_image *source, sint32 radius)
+{
+  integral_image I;
+  pixel_image reference, streamed;
+  uint32 mode;
+  truth_value flag1, flag2;
+  simd_level level, max_level;
+
+  integral_image_nullify(&I);
+  pixel_image_nullify(&reference);
+  integral_image_create(&I, source);
+  integral_image_update(&I);
+  pixel_image_create(&streamed, p_U8, GREY, source->width, source->height, 1,
+                     source->width);
+
+  /* all simd levels of the in-memory version are compared */
+  max_level = simd_get_level();
+  for (mode = 0; mode < 4 * (max_level + 1); mode++) {
+    flag1 = (mode & 1) ? TRUE : FALSE;
+    flag2 = (mode & 2) ? TRUE : FALSE;
+    level = (simd_level)(mode / 4);
+    simd_set_max_level(level);
+    printf("%-6s ", simd_level_name(level));
+    integral_image_threshold_sauvola(&I, &reference, flag1, radius, 0.2,
+                                     flag2, 64, flag1);
+    integral_stream_threshold_sauvola(&pixel_image_read_row, source,
+                                      &pixel_image_write_row, &streamed,
+                                      source->width, source->height, flag1,
+                                      radius, 0.2, flag2, 64, flag1);
+    check_threshold(&streamed, &reference, "stream sauvola");
+    pixel_image_destroy(&reference);
+  }
+  for (mode = 0; mode < 2; mode++) {
+    flag1 = (mode & 1) ? TRUE : FALSE;
+    integral_image_threshold_feng(&I, &reference, FALSE, radius, 3, flag1,
+                                  0.1);
+    integral_stream_threshold_feng(&pixel_image_read_row, source,
+                                   &pixel_image_write_row, &streamed,
+                                   source->width, source->height, FALSE,
+                                   radius, 3, flag1, 0.1);
+    check_threshold(&streamed, &reference, "stream feng");
+    pixel_image_destroy(&reference);
+  }
+  simd_set_max_level(max_level);
+
+  /* parallel thresholds are compared to the streamed ones */
+  for (mode = 0; mode < 4; mode++) {
+    flag1 = (mode & 1) ? TRUE : FALSE;
+    flag2 = (mode & 2) ? TRUE : FALSE;
+    integral_stream_threshold_sauvola(&pixel_image_read_row, source,
+                                      &pixel_image_write_row, &streamed,
+                                      source->width, source->height, flag1,
+                                      radius, 0.2, flag2, 64, flag1);
+    integral_image_threshold_sauvola_parallel(&I, &reference, flag1, radius,
+                                              0.2, flag2, 64, flag1, mode + 2);
+    check_threshold(&reference, &streamed, "parallel sauvola");
+    pixel_image_destroy(&reference);
+    integral_stream_threshold_feng(&pixel_image_read_row, source,
+                                   &pixel_image_write_row, &streamed,
+                                   source->width, source->height, flag1,
+                                   radius, 3, flag2, 0.1);
+    integral_image_threshold_feng_parallel(&I, &reference, flag1, radius, 3,
+                                           flag2, 0.1, mode + 2);
+    check_threshold(&reference, &streamed, "parallel feng");
+    pixel_image_destroy(&reference);
+  }
+
+  pixel_image_destroy(&streamed);
+  integral_image_destroy(&I);
+}
+
+int main()
+{
+  pixel_image source, roi;
+  uint32 i;
+
+  printf("Starting integral image tests\n");
+
+  /* exact I_1 values take 32 bits also where long is 64 bits */
+  if (sizeof(EI_1_t) != 4) {
+    printf("%-24s FAILED\n", "exact I_1 size");
+    failures++;
+  }
+
+  for (i = 0; i < TEST_SIZE_COUNT; i++) {
+    pixel_image_create(&source, p_U8, GREY, test_widths[i], test_heights[i], 1,
+                       test_widths[i]);
+    fill_image(&source, i + 1);
+    test_integral_update(&source, l_SEPARATE, "integral_image_update");
+    test_integral_update(&source, l_INTERLEAVED, "interleaved update");
+    test_integral_update_parallel(&source, i_REAL, l_SEPARATE,
+                                  "integral_image parallel");
+    test_integral_update_parallel(&source, i_SMALL, l_SEPARATE,
+                                  "small_integral parallel");
+    test_integral_update_parallel(&source, i_EXACT, l_SEPARATE,
+                                  "exact_integral parallel");
+    test_integral_update_parallel(&source, i_REAL, l_INTERLEAVED,
+                                  "interleaved parallel");
+    test_integral_statistics(&source, i_REAL, l_INTERLEAVED,
+                             "interleaved statistics");
+    test_integral_statistics(&source, i_EXACT, l_SEPARATE,
+                             "exact_integral update");
+    test_integral_statistics(&source, i_TILED, l_SEPARATE,
+                             "tiled_integral update");
+    test_integral_update_rect(&source, l_SEPARATE, "integral_image");
+    test_integral_update_rect(&source, l_INTERLEAVED, "interleaved");
+    test_aligned_image(&source, 2, "aligned image");
+    test_integral_from_yuv422(test_widths[i], test_heights[i],
+                              "fused yuv422 update");
+    if (test_widths[i] * test_heights[i] <= 1024) {
+      test_integral_tilted(&source);
+      test_higher_statistics(&source, l_SEPARATE, "higher statistics");
+    }
+    pixel_image_destroy(&source);
+  }
+
+  /* streamed images keep only a band of rows in memory */
+  pixel_image_create(&source, p_U8, GREY, 97, 61, 1, 97);
+  fill_image(&source, 42);
+  test_integral_stream(&source, 4);
+  test_integral_stream(&source, 40);
+  test_integral_stream(&source, 0);
+  test_integral_stream(&source, 50);
+  test_integral_from_reader(&source);
+  pixel_image_destroy(&source);
+  pixel_image_create(&source, p_U8, GREY, 96, 45, 1, 96);
+  fill_image(&source, 43);
+  test_integral_from_reader(&source);
+  pixel_image_destroy(&source);
+
+  /* roi images have gaps between rows */
+  pixel_image_create(&source, p_U8, GREY, 64, 32, 1, 64);
+  fill_image(&source, 99);
+  pixel_image_create_roi(&roi, &source, 3, 5, 45, 21);
+  test_integral_update(&roi, l_SEPARATE, "integral_image_update roi");
+  test_integral_update(&roi, l_INTERLEAVED, "interleaved update roi");
+  test_integral_update_parallel(&roi, i_REAL, l_SEPARATE,
+                                "integral_image parallel");
+  test_integral_statistics(&roi, i_EXACT, l_SEPARATE, "exact_integral roi");
+  test_integral_statistics(&roi, i_TILED, l_SEPARATE, "tiled_integral roi");
+  test_integral_tilted(&roi);
+  pixel_image_destroy(&roi);
+  pixel_image_destroy(&source);
+
+  /* all channels of multi-channel images are handled */
+  pixel_image_create(&source, p_U8, RGB, 37, 23, 3, 3 * 37);
+  fill_image(&source, 7);
+  test_integral_update(&source, l_SEPARATE, "integral_image_update rgb");
+  test_integral_update(&source, l_INTERLEAVED, "interleaved update rgb");
+  test_integral_update_parallel(&source, i_REAL, l_SEPARATE,
+                                "integral_image parallel");
+  test_integral_update_parallel(&source, i_REAL, l_INTERLEAVED,
+                                "interleaved parallel");
+  test_integral_statistics(&source, i_REAL, l_INTERLEAVED,
+                           "interleaved statistics");
+  test_integral_statistics(&source, i_EXACT, l_SEPARATE,
+                           "exact_integral rgb");
+  test_integral_statistics(&source, i_TILED, l_SEPARATE,
+                           "tiled_integral rgb");
+  test_integral_update_parallel(&source, i_SMALL, l_SEPARATE,
+                                "small_integral parallel");
+  test_integral_update_parallel(&source, i_EXACT, l_SEPARATE,
+                                "exact_integral parallel");
+  test_higher_statistics(&source, l_SEPARATE, "higher statistics rgb");
+  test_integral_update_rect(&source, l_SEPARATE, "integral_image rgb");
+  test_integral_update_rect(&source, l_INTERLEAVED, "interleaved rgb");
+  test_aligned_image(&source, 5, "aligned image rgb");
+  test_higher_statistics(&source, l_INTERLEAVED, "interleaved higher rgb");
+  pixel_image_destroy(&source);
+
+  printf("Integral image tests finished with %lu failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,389 @@
+/**
+ * @file cvsu_pixel_image_t.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Testing code for cvsu_pixel_image.c
+ *
+ * Copyright (c) 2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_memory.h"
+#include "cvsu_pixel_image.h"
+#include "cvsu_simd.h"
+#include "cvsu_test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* converts the source with all simd levels and compares to scalar results */
+typedef result (*convert_function)(const pixel_image *, pixel_image *);
+
+uint32 check_conversion(convert_function convert, pixel_image *source,
+                        pixel_format format, uint32 step)
+{
+  pixel_image reference, target;
+  simd_level level, max_level;
+  uint32 y, errors;
+
+  pixel_image_create(&reference, p_U8, format, source->width, source->height,
+                     step, step * source->width);
+  pixel_image_create(&target, p_U8, format, source->width, source->height,
+                     step, step * source->width);
+  max_level = simd_get_level();
+  simd_set_max_level(s_NONE);
+  convert(source, &reference);
+  errors = 0;
+  for (level = s_SSE2; level <= max_level; level++) {
+    simd_set_max_level(level);
+    pixel_image_clear(&target);
+    convert(source, &target);
+    for (y = 0; y < source->height; y++) {
+      if (memcmp(target.rows[y], reference.rows[y], step * source->width) != 0)
+        errors++;
+    }
+  }
+  simd_set_max_level(max_level);
+  pixel_image_destroy(&target);
+  pixel_image_destroy(&reference);
+  return errors;
+}
+
+void test_conversions(uint32 width, uint32 height, string name)
+{
+  pixel_image grey, rgb, yuv, uyvy;
+  uint32 errors;
+
+  pixel_image_create(&grey, p_U8, GREY, width, height, 1, width);
+  pixel_image_create(&rgb, p_U8, RGB, width, height, 3, 3 * width);
+  pixel_image_create(&yuv, p_U8, YUV, width, height, 3, 3 * width);
+  pixel_image_create(&uyvy, p_U8, UYVY, width, height, 2, 2 * width);
+  fill_image(&grey, width);
+  fill_image(&rgb, width + 1);
+  fill_image(&yuv, width + 2);
+  fill_image(&uyvy, width + 3);
+  errors = 0;
+  errors += check_conversion(&convert_grey8_to_grey24, &grey, RGB, 3);
+  errors += check_conversion(&convert_grey8_to_yuv24, &grey, YUV, 3);
+  errors += check_conversion(&convert_rgb24_to_grey8, &rgb, GREY, 1);
+  errors += check_conversion(&convert_rgb24_to_yuv24, &rgb, YUV, 3);
+  errors += check_conversion(&convert_yuv24_to_rgb24, &yuv, RGB, 3);
+  errors += check_conversion(&convert_yuv24_to_grey8, &yuv, GREY, 1);
+  errors += check_conversion(&convert_uyvy16_to_grey8, &uyvy, GREY, 1);
+  errors += check_conversion(&convert_yuyv16_to_grey8, &uyvy, GREY, 1);
+  if (width % 2 == 0) {
+    errors += check_conversion(&convert_uyvy16_to_yuv24, &uyvy, YUV, 3);
+  }
+
+  printf("%-24s %4lux%-4lu %s", name, width, height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+  pixel_image_destroy(&uyvy);
+  pixel_image_destroy(&yuv);
+  pixel_image_destroy(&rgb);
+  pixel_image_destroy(&grey);
+}
+
+/* images written through a mapping are read back the same with both the */
+/* mapped and the stdio readers */
+void test_mapped_pnm(pixel_image *source, string name)
+{
+  pixel_image mapped, read;
+  uint32 y, errors;
+  string file_name = "cvsu_mapped_test.pnm";
+
+  pixel_image_nullify(&mapped);
+  pixel_image_nullify(&read);
+  errors = 0;
+  if (pixel_image_write_mapped(source, file_name) != SUCCESS ||
+      pixel_image_read_mapped(&mapped, file_name) != SUCCESS) {
+    printf("%-24s mapping failed\n", name);
+    failures++;
+    return;
+  }
+  pixel_image_read(&read, file_name);
+  if (mapped.width != source->width || mapped.height != source->height ||
+      mapped.format != source->format || read.width != source->width ||
+      read.height != source->height) {
+    errors++;
+  }
+  else {
+    for (y = 0; y < source->height; y++) {
+      if (memcmp(mapped.rows[y], source->rows[y],
+                 source->width * source->step) != 0) errors++;
+      if (memcmp(read.rows[y], source->rows[y],
+                 source->width * source->step) != 0) errors++;
+    }
+  }
+  pixel_image_destroy(&read);
+  pixel_image_destroy(&mapped);
+  remove(file_name);
+  printf("%-24s %4lux%-4lu %s", name, source->width, source->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* the row reader and writer access only the channel at the view offset */
+void test_row_channels(pixel_image *source, string name)
+{
+  pixel_image copy, source_view, copy_view;
+  byte row[256];
+  uint32 c, x, y, errors;
+  byte *copy_pos, *source_pos;
+
+  errors = 0;
+  pixel_image_nullify(&copy);
+  pixel_image_clone(&copy, source);
+  for (c = 0; c < source->step; c++) {
+    pixel_image_init(&source_view, source->data, p_U8, GREY, 0, 0,
+                     source->width, source->height, c, source->step,
+                     source->stride, source->size);
+    source_view.parent = source;
+    pixel_image_init(&copy_view, copy.data, p_U8, GREY, 0, 0, copy.width,
+                     copy.height, c, copy.step, copy.stride, copy.size);
+    copy_view.parent = &copy;
+    for (y = 0; y < source->height; y++) {
+      pixel_image_read_row(&source_view, y, row);
+      source_pos = (byte *)source->rows[y];
+      for (x = 0; x < source->width; x++) {
+        if (row[x] != source_pos[x * source->step + c]) errors++;
+        row[x] = (byte)(255 - row[x]);
+      }
+      pixel_image_write_row(&copy_view, y, row);
+    }
+    pixel_image_destroy(&copy_view);
+    pixel_image_destroy(&source_view);
+  }
+  /* after writing every channel inverted, nothing else was touched */
+  for (y = 0; y < source->height; y++) {
+    source_pos = (byte *)source->rows[y];
+    copy_pos = (byte *)copy.rows[y];
+    for (x = 0; x < source->width * source->step; x++) {
+      if ((int)copy_pos[x] + (int)source_pos[x] != 255) errors++;
+    }
+  }
+  pixel_image_destroy(&copy);
+  printf("%-24s %4lux%-4lu %s", name, source->width, source->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* headers with zero, oversized or overflowing fields are rejected by both */
+/* the mapped reader and the row source                                     */
+void test_invalid_pnm_headers(string name)
+{
+  pixel_image mapped;
+  pnm_row_source rows;
+  uint32 i, errors;
+  FILE *file;
+  string file_name = "cvsu_invalid_test.pnm";
+  string headers[] = {
+    "P1\n2 2\n1 0 1 1\n",
+    "P4\n8 2\n",
+    "P5\n0 2\n255\n",
+    "P5\n2 0\n255\n",
+    "P5\n2 2\n0\n",
+    "P5\n2147483648 2\n255\n",
+    "P5\n9223372036854775808 2\n255\n",
+    "P6\n2147483647 2147483647\n255\n",
+    "P6\n1431655766 1\n255\n"
+  };
+
+  errors = 0;
+  for (i = 0; i < sizeof(headers) / sizeof(headers[0]); i++) {
+    file = fopen(file_name, "wb");
+    if (file == NULL) {
+      errors++;
+      break;
+    }
+    fputs(headers[i], file);
+    fputs("some pixel data to make the file non-trivial", file);
+    fclose(file);
+    pixel_image_nullify(&mapped);
+    if (pixel_image_read_mapped(&mapped, file_name) == SUCCESS) {
+      errors++;
+      pixel_image_destroy(&mapped);
+    }
+    if (pnm_row_source_open(&rows, file_name) == SUCCESS) {
+      errors++;
+      pnm_row_source_close(&rows);
+    }
+  }
+  /* images of zero or overflowing size can't be created either */
+  pixel_image_nullify(&mapped);
+  if (pixel_image_create_mapped(&mapped, file_name, GREY, 0, 2) == SUCCESS ||
+      pixel_image_create_mapped(&mapped, file_name, GREY, 2, 0) == SUCCESS ||
+      pixel_image_create_mapped(&mapped, file_name, RGB, 2147483647UL,
+                                2147483647UL) == SUCCESS) {
+    errors++;
+    pixel_image_destroy(&mapped);
+  }
+  remove(file_name);
+  printf("%-24s %s", name, (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* the single-pass statistics match the separate whole-image functions and */
+/* a naive histogram with any number of threads                            */
+void test_image_statistics(pixel_image *source, string name)
+{
+  image_statistics stat;
+  uint32 histogram[256];
+  uint32 i, x, y, offset, threads, errors;
+  sint32 width, height;
+  integral_value variance;
+
+  errors = 0;
+  width = (signed)source->width;
+  height = (signed)source->height;
+  for (offset = 0; offset < source->step; offset++) {
+    memset(histogram, 0, sizeof(histogram));
+    for (y = 0; y < source->height; y++) {
+      for (x = 0; x < source->width; x++) {
+        histogram[((byte *)source->rows[y])[x * source->step + offset]]++;
+      }
+    }
+    for (threads = 1; threads <= 4; threads++) {
+      pixel_image_calculate_statistics_byte_parallel(source, offset, &stat,
+                                                     threads);
+      for (i = 0; i < 256; i++) {
+        if (stat.histogram[i] != histogram[i]) errors++;
+      }
+      if ((integral_value)stat.min != pixel_image_find_min_byte(source, 0, 0,
+          width, height, offset)) errors++;
+      if ((integral_value)stat.max != pixel_image_find_max_byte(source, 0, 0,
+          width, height, offset)) errors++;
+      if (stat.stat.mean != pixel_image_calculate_mean_byte(source, 0, 0,
+          width, height, offset)) errors++;
+      /* the statistics clamp the variance to zero */
+      variance = pixel_image_calculate_variance_byte(source, 0, 0, width,
+                                                     height, offset);
+      if (stat.stat.variance != ((variance < 0) ? 0 : variance)) errors++;
+      if (stat.stat.N != (integral_value)(width * height)) errors++;
+    }
+  }
+  printf("%-24s %4lux%-4lu %s", name, source->width, source->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* the min, max, mean and variance of rectangles that do not cover the full */
+/* image are the same as when calculated naively from the rows              */
+void test_rect_statistics(pixel_image *source, string name)
+{
+  sint32 x, y, dx, dy, px, py;
+  uint32 c, errors;
+  integral_value value, min, max, sum1, sum2, N, mean, variance;
+
+  errors = 0;
+  for (c = 0; c < source->step; c++) {
+    for (y = 0; y < (sint32)source->height; y += 3) {
+      for (x = 0; x < (sint32)source->width; x += 2) {
+        for (dy = 1; y + dy <= (sint32)source->height; dy += 4) {
+          for (dx = 1; x + dx <= (sint32)source->width; dx += 5) {
+            min = 255;
+            max = 0;
+            sum1 = 0;
+            sum2 = 0;
+            for (py = y; py < y + dy; py++) {
+              for (px = x; px < x + dx; px++) {
+                value = (integral_value)
+                    ((byte *)source->rows[py])[(uint32)px * source->step + c];
+                if (value < min) min = value;
+                if (value > max) max = value;
+                sum1 += value;
+                sum2 += value * value;
+              }
+            }
+            N = (integral_value)(dx * dy);
+            mean = sum1 / N;
+            variance = sum2 / N - mean * mean;
+            if (pixel_image_find_min_byte(source, x, y, dx, dy, c) != min ||
+                pixel_image_find_max_byte(source, x, y, dx, dy, c) != max ||
+                pixel_image_calculate_mean_byte(source, x, y, dx, dy, c) !=
+                mean ||
+                pixel_image_calculate_variance_byte(source, x, y, dx, dy, c) !=
+                variance) errors++;
+          }
+        }
+      }
+    }
+  }
+  printf("%-24s %4lux%-4lu %s", name, source->width, source->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+int main()
+{
+  pixel_image source;
+  uint32 i;
+
+  printf("Starting pixel image tests\n");
+
+  for (i = 0; i < TEST_SIZE_COUNT; i++) {
+    pixel_image_create(&source, p_U8, GREY, test_widths[i], test_heights[i], 1,
+                       test_widths[i]);
+    fill_image(&source, i + 1);
+    test_conversions(test_widths[i], test_heights[i], "color conversions");
+    test_mapped_pnm(&source, "mapped pnm");
+    test_image_statistics(&source, "image statistics");
+    pixel_image_destroy(&source);
+  }
+
+  /* all channels of multi-channel images are handled */
+  pixel_image_create(&source, p_U8, RGB, 37, 23, 3, 3 * 37);
+  fill_image(&source, 7);
+  test_rect_statistics(&source, "rect statistics rgb");
+  test_mapped_pnm(&source, "mapped pnm rgb");
+  test_image_statistics(&source, "image statistics rgb");
+  test_row_channels(&source, "row channels rgb");
+  pixel_image_destroy(&source);
+
+  test_invalid_pnm_headers("invalid pnm headers");
+
+  printf("Pixel image tests finished with %lu failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file cvsu_pyramid_t.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Testing code for cvsu_pyramid.c
+ *
+ * Copyright (c) 2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_memory.h"
+#include "cvsu_pixel_image.h"
+#include "cvsu_integral.h"
+#include "cvsu_pyramid.h"
+#include "cvsu_simd.h"
+#include "cvsu_test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* the integrals of the coarsest level are the same as when updated from */
+/* the level image separately                                            */
+uint32 check_pyramid_integral(pixel_image_pyramid *pyramid)
+{
+  integral_image *I, reference;
+  uint32 errors;
+
+  I = &pyramid->integrals[pyramid->level_count - 1];
+  integral_image_nullify(&reference);
+  integral_image_create(&reference, &pyramid->levels[pyramid->level_count - 1]);
+  integral_image_update(&reference);
+  errors = 0;
+  if (memcmp(I->I_1.data, reference.I_1.data,
+             I->I_1.size * sizeof(integral_value)) != 0) errors++;
+  if (memcmp(I->I_2.data, reference.I_2.data,
+             I->I_2.size * sizeof(integral_value)) != 0) errors++;
+  integral_image_destroy(&reference);
+  return errors;
+}
+
+/* each pyramid level is the rounded average of 2x2 blocks of the previous */
+/* level, and the pyramid can be updated again with a new frame */
+void test_pyramid(pixel_image *source, string name)
+{
+  pixel_image_pyramid pyramid;
+  pixel_image *fine, *coarse;
+  simd_level level, max_level;
+  uint32 i, x, y, c, x_2, y_2, sum, step, frame, errors;
+
+  pixel_image_pyramid_nullify(&pyramid);
+  if (pixel_image_pyramid_create(&pyramid, source, 3, TRUE) != SUCCESS) {
+    printf("%-24s create failed\n", name);
+    failures++;
+    return;
+  }
+  errors = 0;
+  step = source->step;
+  max_level = simd_get_level();
+  for (level = s_NONE, frame = 0; level <= max_level; level++, frame++) {
+    simd_set_max_level(level);
+    fill_image(source, frame + 11);
+    pixel_image_pyramid_update(&pyramid, source);
+    for (i = 1; i < pyramid.level_count; i++) {
+      fine = &pyramid.levels[i - 1];
+      coarse = &pyramid.levels[i];
+      if (coarse->width != (fine->width + 1) / 2 ||
+          coarse->height != (fine->height + 1) / 2) errors++;
+      for (y = 0; y < coarse->height; y++) {
+        y_2 = (2 * y + 1 < fine->height) ? 2 * y + 1 : 2 * y;
+        for (x = 0; x < coarse->width; x++) {
+          x_2 = (2 * x + 1 < fine->width) ? 2 * x + 1 : 2 * x;
+          for (c = 0; c < step; c++) {
+            sum = (uint32)((byte *)fine->rows[2 * y])[2 * x * step + c] +
+                  ((byte *)fine->rows[2 * y])[x_2 * step + c] +
+                  ((byte *)fine->rows[y_2])[2 * x * step + c] +
+                  ((byte *)fine->rows[y_2])[x_2 * step + c];
+            if (((byte *)coarse->rows[y])[x * step + c] != (sum + 2) / 4)
+              errors++;
+          }
+        }
+      }
+    }
+  }
+  simd_set_max_level(max_level);
+  errors += check_pyramid_integral(&pyramid);
+  pixel_image_pyramid_destroy(&pyramid);
+  printf("%-24s %4lux%-4lu %s", name, source->width, source->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* creating with invalid parameters fails without touching the garbage in */
+/* the uninitialized pyramid                                             */
+void test_pyramid_invalid(pixel_image *source)
+{
+  pixel_image_pyramid pyramid;
+  uint32 errors;
+
+  errors = 0;
+  memset(&pyramid, 0xff, sizeof(pyramid));
+  if (pixel_image_pyramid_create(&pyramid, source, 0, TRUE) == SUCCESS)
+    errors++;
+  if (pyramid.levels != NULL || pyramid.integrals != NULL) errors++;
+  printf("%-24s %4lux%-4lu %s", "pyramid invalid", source->width,
+         source->height, (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+int main()
+{
+  pixel_image source;
+  uint32 i;
+
+  printf("Starting pyramid tests\n");
+
+  for (i = 0; i < TEST_SIZE_COUNT; i++) {
+    if (test_widths[i] < 4 || test_heights[i] < 4) {
+      continue;
+    }
+    pixel_image_create(&source, p_U8, GREY, test_widths[i], test_heights[i], 1,
+                       test_widths[i]);
+    fill_image(&source, i + 1);
+    test_pyramid(&source, "pyramid level");
+    pixel_image_destroy(&source);
+  }
+
+  pixel_image_create(&source, p_U8, RGB, 37, 23, 3, 3 * 37);
+  fill_image(&source, 7);
+  test_pyramid(&source, "pyramid level rgb");
+  test_pyramid_invalid(&source);
+  pixel_image_destroy(&source);
+
+  printf("Pyramid tests finished with %lu failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+/**
+ * @file cvsu_quad_forest_t.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Testing code for cvsu_quad_forest.c
+ *
+ * Copyright (c) 2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_memory.h"
+#include "cvsu_pixel_image.h"
+#include "cvsu_integral.h"
+#include "cvsu_quad_forest.h"
+#include "cvsu_test_util.h"
+
+#include <stdio.h>
+#include <math.h>
+
+/* the forest used in the tests has 4x3 root trees of size 16, with the grid */
+/* centered so that the image has a margin of 3 columns and 2 rows           */
+#define FOREST_WIDTH 70
+#define FOREST_HEIGHT 53
+#define FOREST_TREE_SIZE 16
+#define FOREST_DX 3
+#define FOREST_DY 2
+
+/* counts the root trees that have different statistics in the two forests */
+uint32 check_root_statistics(quad_forest *forest, quad_forest *reference)
+{
+  statistics *stat, *expected;
+  uint32 pos, size, errors;
+
+  errors = 0;
+  if (forest->rows != reference->rows || forest->cols != reference->cols) {
+    return 1;
+  }
+  size = forest->rows * forest->cols;
+  for (pos = 0; pos < size; pos++) {
+    stat = &forest->roots[pos]->stat;
+    expected = &reference->roots[pos]->stat;
+    if (stat->N != expected->N || stat->sum != expected->sum ||
+        stat->sum2 != expected->sum2 || stat->mean != expected->mean ||
+        stat->variance != expected->variance ||
+        stat->deviation != expected->deviation) errors++;
+  }
+  return errors;
+}
+
+/* after updating with a changed frame, the root statistics are the same as */
+/* with a full update of the frame, and only the roots overlapping the      */
+/* changed pixels are reported as changed                                   */
+void test_update_frame(quad_forest *forest, pixel_image *frame, string name,
+                       coord left, coord right, coord top, coord bottom)
+{
+  quad_forest reference;
+  uint32 errors;
+
+  errors = 0;
+  quad_forest_nullify(&reference);
+  if (quad_forest_update_frame(forest, frame) != SUCCESS) errors++;
+  if (forest->changed.left != left || forest->changed.right != right ||
+      forest->changed.top != top || forest->changed.bottom != bottom) errors++;
+  if (quad_forest_create(&reference, frame, FOREST_TREE_SIZE, 4) != SUCCESS) {
+    errors++;
+  }
+  else {
+    pixel_image_copy(reference.source, frame);
+    quad_forest_update(&reference);
+    errors += check_root_statistics(forest, &reference);
+  }
+  quad_forest_destroy(&reference);
+  printf("%-24s %4lux%-4lu %s", name, frame->width, frame->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* counts the differences between the statistics of a tree and the same */
+/* rectangle calculated directly from the integral image                */
+uint32 check_tree_statistics(quad_forest *forest, quad_tree *tree)
+{
+  statistics expected;
+
+  integral_image_calculate_statistics(&forest->integral, &expected,
+                                      (sint32)tree->x, (sint32)tree->y,
+                                      (sint32)tree->size, (sint32)tree->size,
+                                      0);
+  if (tree->stat.N != expected.N || tree->stat.sum != expected.sum ||
+      tree->stat.sum2 != expected.sum2 ||
+      fabs(tree->stat.mean - expected.mean) > 0.0001 ||
+      fabs(tree->stat.variance - expected.variance) > 0.0001 ||
+      fabs(tree->stat.deviation - expected.deviation) > 0.0001) return 1;
+  return 0;
+}
+
+/* the statistics of the root trees, and of the child trees at each level */
+/* down to single pixels, match the statistics of the same rectangles     */
+void test_child_statistics(quad_forest *forest, string name)
+{
+  quad_tree parent, children[4];
+  uint32 pos, size, i, level, errors;
+
+  errors = 0;
+  size = forest->rows * forest->cols;
+  for (pos = 0; pos < size; pos++) {
+    errors += check_tree_statistics(forest, forest->roots[pos]);
+    parent = *forest->roots[pos];
+    for (level = 0; parent.size > 1; level++) {
+      if (quad_tree_get_child_statistics(forest, &parent, children) !=
+          SUCCESS) {
+        errors++;
+        break;
+      }
+      for (i = 0; i < 4; i++) {
+        /* the children are in the order nw, ne, sw, se */
+        if (children[i].size != parent.size / 2 ||
+            children[i].x != parent.x + (i % 2) * children[i].size ||
+            children[i].y != parent.y + (i / 2) * children[i].size) errors++;
+        errors += check_tree_statistics(forest, &children[i]);
+      }
+      /* a different child is divided next in each tree and level */
+      parent = children[(pos + level) % 4];
+      parent.nw = NULL;
+    }
+  }
+  printf("%-24s %4lux%-4lu %s", name, forest->source->width,
+         forest->source->height, (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+/* changes one pixel of the frame to a value different from the original */
+void change_pixel(pixel_image *frame, uint32 x, uint32 y)
+{
+  byte *pos;
+
+  pos = (byte *)frame->rows[y] + x;
+  *pos = (byte)(*pos ^ 0x80);
+}
+
+/* fills the image with a diagonal step edge through (cx,cy); with the 45 */
+/* degree direction the bright side is down and right of the line x+y=c,  */
+/* with the 135 degree direction it is down and left of the line x-y=c    */
+void fill_diagonal_edge(pixel_image *target, sint32 cx, sint32 cy,
+                        truth_value d45, byte dark, byte bright)
+{
+  sint32 x, y;
+  truth_value is_bright;
+
+  for (y = 0; y < (sint32)target->height; y++) {
+    for (x = 0; x < (sint32)target->width; x++) {
+      if (IS_TRUE(d45)) {
+        is_bright = (x + y >= cx + cy) ? TRUE : FALSE;
+      }
+      else {
+        is_bright = (x - y <= cx - cy) ? TRUE : FALSE;
+      }
+      ((byte *)target->rows[y])[x] = IS_TRUE(is_bright) ? bright : dark;
+    }
+  }
+}
+
+/* the diagonal responses of a tree centered on a diagonal step edge have */
+/* the sign of the step and the magnitude of the difference of the sides, */
+/* and without the tilted integrals the magnitude only uses dx and dy     */
+void test_edge_response(truth_value d45, byte dark, byte bright, string name)
+{
+  pixel_image image;
+  quad_forest forest, plain;
+  quad_tree *tree, *plain_tree;
+  integral_value step, across, along, mag;
+  uint32 errors;
+
+  errors = 0;
+  pixel_image_create(&image, p_U8, GREY, 64, 64, 1, 64);
+  /* the root tree at col 1, row 1 covers 16..31 and is centered at 24 */
+  fill_diagonal_edge(&image, 24, 24, d45, dark, bright);
+  quad_forest_nullify(&forest);
+  quad_forest_nullify(&plain);
+  quad_forest_create(&forest, &image, 16, 4);
+  quad_forest_create(&plain, &image, 16, 4);
+  if (integral_image_enable_tilted(&forest.integral) != SUCCESS) errors++;
+  pixel_image_copy(forest.source, &image);
+  pixel_image_copy(plain.source, &image);
+  quad_forest_update(&forest);
+  quad_forest_update(&plain);
+  tree = forest.roots[forest.cols + 1];
+  plain_tree = plain.roots[plain.cols + 1];
+  if (quad_tree_get_edge_response(&forest, tree, NULL, NULL) != SUCCESS)
+    errors++;
+  if (quad_tree_get_edge_response(&plain, plain_tree, NULL, NULL) != SUCCESS)
+    errors++;
+
+  /* both boxes are uniform, so the variance is clamped to 1 */
+  step = (integral_value)bright - (integral_value)dark;
+  across = IS_TRUE(d45) ? tree->edge.d45 : tree->edge.d135;
+  along = IS_TRUE(d45) ? tree->edge.d135 : tree->edge.d45;
+  if (fabs(across - step) > 0.0001 || fabs(along) > 0.0001) errors++;
+  mag = sqrt((tree->edge.dx * tree->edge.dx + tree->edge.dy * tree->edge.dy +
+              tree->edge.d45 * tree->edge.d45 +
+              tree->edge.d135 * tree->edge.d135) / 2);
+  if (fabs(tree->edge.mag - mag) > 0.0001) errors++;
+
+  if (plain_tree->edge.d45 != 0 || plain_tree->edge.d135 != 0) errors++;
+  if (plain_tree->edge.dx != tree->edge.dx ||
+      plain_tree->edge.dy != tree->edge.dy) errors++;
+  mag = sqrt(plain_tree->edge.dx * plain_tree->edge.dx +
+             plain_tree->edge.dy * plain_tree->edge.dy);
+  if (plain_tree->edge.mag != mag) errors++;
+
+  quad_forest_destroy(&plain);
+  quad_forest_destroy(&forest);
+  printf("%-24s %4lux%-4lu %s", name, image.width, image.height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+  pixel_image_destroy(&image);
+}
+
+int main()
+{
+  pixel_image source, frame;
+  quad_forest forest;
+  coord cols, rows;
+
+  printf("Starting quad forest tests\n");
+
+  pixel_image_create(&source, p_U8, GREY, FOREST_WIDTH, FOREST_HEIGHT, 1,
+                     FOREST_WIDTH);
+  fill_image(&source, 5);
+  pixel_image_clone(&frame, &source);
+  pixel_image_copy(&frame, &source);
+  quad_forest_nullify(&forest);
+  quad_forest_create(&forest, &source, FOREST_TREE_SIZE, 4);
+  cols = (coord)forest.cols;
+  rows = (coord)forest.rows;
+  if (forest.dx != FOREST_DX || forest.dy != FOREST_DY) {
+    printf("unexpected forest grid %lux%lu+%lu+%lu\n", forest.cols,
+           forest.rows, forest.dx, forest.dy);
+    failures++;
+  }
+
+  /* the first frame causes a full update */
+  test_update_frame(&forest, &frame, "update frame first", 0, cols, 0, rows);
+  test_child_statistics(&forest, "child statistics");
+  test_update_frame(&forest, &frame, "update frame empty", 0, 0, 0, 0);
+
+  change_pixel(&frame, FOREST_DX + 20, FOREST_DY + 5);
+  test_update_frame(&forest, &frame, "update frame pixel", 1, 2, 0, 1);
+
+  /* the pixels on both sides of the edge between two trees */
+  change_pixel(&frame, FOREST_DX + 15, FOREST_DY + 16);
+  change_pixel(&frame, FOREST_DX + 16, FOREST_DY + 16);
+  test_update_frame(&forest, &frame, "update frame tree edge", 0, 2, 1, 2);
+
+  /* the margin outside the grid does not belong to any tree */
+  change_pixel(&frame, 0, FOREST_DY + 20);
+  test_update_frame(&forest, &frame, "update frame margin", 0, 0, 1, 2);
+
+  /* the range of changes from corner to corner covers all trees */
+  change_pixel(&frame, 0, 0);
+  change_pixel(&frame, FOREST_WIDTH - 1, FOREST_HEIGHT - 1);
+  test_update_frame(&forest, &frame, "update frame border", 0, cols, 0, rows);
+  test_child_statistics(&forest, "child statistics frame");
+
+  quad_forest_destroy(&forest);
+  pixel_image_destroy(&frame);
+  pixel_image_destroy(&source);
+
+  test_edge_response(TRUE, 20, 220, "edge response d45");
+  test_edge_response(TRUE, 220, 20, "edge response d45 neg");
+  test_edge_response(FALSE, 20, 220, "edge response d135");
+  test_edge_response(FALSE, 220, 20, "edge response d135 neg");
+
+  printf("Quad forest tests finished with %lu failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
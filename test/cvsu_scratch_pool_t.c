@@ -0,0 +1,113 @@
+/**
+ * @file cvsu_scratch_pool_t.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Testing code for cvsu_scratch_pool.c
+ *
+ * Copyright (c) 2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "cvsu_config.h"
+#include "cvsu_macros.h"
+#include "cvsu_memory.h"
+#include "cvsu_pixel_image.h"
+#include "cvsu_filter.h"
+#include "cvsu_scratch_pool.h"
+#include "cvsu_test_util.h"
+
+#include <stdio.h>
+
+/* after the first frame, frames processed with images from the scratch pool */
+/* do not allocate memory; nested scopes only release their own images      */
+void test_scratch_pool(pixel_image *source)
+{
+  scratch_pool pool;
+  pixel_image *grey, *binary, *inner, *outer;
+  uint32 frame, count, allocations, errors;
+
+  errors = 0;
+  scratch_pool_create(&pool, 1);
+  allocations = 0;
+  for (frame = 0; frame < 4; frame++) {
+    if (frame == 2) {
+      allocations = memory_get_allocation_count();
+    }
+    scratch_pool_begin(&pool);
+    scratch_pool_acquire(&pool, &grey, p_U8, GREY, source->width,
+                         source->height, 1);
+    scratch_pool_acquire(&pool, &binary, p_U8, GREY, source->width,
+                         source->height, 1);
+    if (grey == binary) errors++;
+    pixel_image_convert(source, grey);
+    threshold(grey, binary, 128);
+    scratch_pool_end(&pool);
+  }
+  if (memory_get_allocation_count() != allocations) errors++;
+  if (pool.count != 2) errors++;
+
+  scratch_pool_begin(&pool);
+  scratch_pool_acquire(&pool, &outer, p_U8, GREY, source->width,
+                       source->height, 1);
+  scratch_pool_begin(&pool);
+  scratch_pool_acquire(&pool, &inner, p_U8, GREY, source->width,
+                       source->height, 1);
+  scratch_pool_end(&pool);
+  count = pool.count;
+  scratch_pool_acquire(&pool, &grey, p_U8, GREY, source->width,
+                       source->height, 1);
+  if (grey != inner || grey == outer || pool.count != count) errors++;
+  scratch_pool_release(&pool, grey);
+  scratch_pool_acquire(&pool, &binary, p_U8, GREY, source->width,
+                       source->height, 1);
+  if (binary != grey) errors++;
+  scratch_pool_acquire(&pool, &grey, p_U8, GREY, source->width,
+                       source->height, 1);
+  if (pool.count != 3) errors++;
+  scratch_pool_end(&pool);
+  scratch_pool_destroy(&pool);
+
+  printf("%-24s %4lux%-4lu %s", "scratch pool", source->width, source->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
+
+int main()
+{
+  pixel_image source;
+
+  printf("Starting scratch pool tests\n");
+
+  pixel_image_create(&source, p_U8, RGB, 37, 23, 3, 3 * 37);
+  fill_image(&source, 7);
+  test_scratch_pool(&source);
+  pixel_image_destroy(&source);
+
+  printf("Scratch pool tests finished with %lu failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file cvsu_test_util.c
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Shared fixtures of the cvsu test programs
+ *
+ * Copyright (c) 2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cvsu_test_util.h"
+
+#include <stdio.h>
+
+uint32 test_widths[TEST_SIZE_COUNT] = { 1, 7, 8, 17, 33, 640, 1023 };
+uint32 test_heights[TEST_SIZE_COUNT] = { 1, 3, 8, 9, 2, 480, 7 };
+
+uint32 failures = 0;
+
+void fill_image(pixel_image *target, uint32 seed)
+{
+  uint32 x, y;
+  byte *pos;
+
+  for (y = 0; y < target->height; y++) {
+    pos = (byte *)target->rows[y];
+    for (x = 0; x < target->width * target->step; x++) {
+      seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+      pos[x] = (byte)(seed >> 16);
+    }
+  }
+}
+
+void check_threshold(pixel_image *result_image, pixel_image *reference,
+                     string name)
+{
+  uint32 x, y, errors;
+
+  errors = 0;
+  for (y = 0; y < reference->height; y++) {
+    for (x = 0; x < reference->width; x++) {
+      if (((byte *)result_image->rows[y])[x] != ((byte *)reference->rows[y])[x]) {
+        errors++;
+      }
+    }
+  }
+  printf("%-24s %4lux%-4lu %s", name, reference->width, reference->height,
+         (errors == 0) ? "ok\n" : "FAILED");
+  if (errors > 0) {
+    printf(" (%lu errors)\n", errors);
+    failures++;
+  }
+}
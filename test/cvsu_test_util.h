@@ -0,0 +1,55 @@
+/**
+ * @file cvsu_test_util.h
+ * @author Matti J. Eskelinen <matti.j.eskelinen@gmail.com>
+ * @brief Shared fixtures of the cvsu test programs
+ *
+ * Copyright (c) 2013, Matti Johannes Eskelinen
+ * All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived from this
+ *     software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDER BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CVSU_TEST_UTIL_H
+#   define CVSU_TEST_UTIL_H
+
+#include "cvsu_types.h"
+#include "cvsu_pixel_image.h"
+
+/* the image sizes used by the tests, chosen to cover the edge cases of the */
+/* vector kernels and of images with a single row or column                 */
+#define TEST_SIZE_COUNT 7
+
+extern uint32 test_widths[TEST_SIZE_COUNT];
+extern uint32 test_heights[TEST_SIZE_COUNT];
+
+/* the number of failed tests, reported by the main function of each test */
+extern uint32 failures;
+
+/* fills all channels of a byte image with pseudo-random values */
+void fill_image(pixel_image *target, uint32 seed);
+
+/* compares two single-channel byte images and reports the result */
+void check_threshold(pixel_image *result_image, pixel_image *reference,
+                     string name);
+
+#endif /* CVSU_TEST_UTIL_H */
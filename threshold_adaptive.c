@@ -43,11 +43,12 @@ void print_usage()
   printf("threshold_adaptive\n");
   printf("Segments images using Feng's improved Sauvola adaptive thresholding.\n\n");
   printf("Usage:\n\n");
-  printf("threshold_adaptive radius multiplier source target\n");
+  printf("threshold_adaptive radius multiplier source target [threads]\n");
   printf("  radius: size of neighborhood used for determining threshold (>= 1)\n");
   printf("  multiplier: size of the larger neighborhood is multiplier*radius (> 1)\n");
   printf("  source: source image file to process\n");
-  printf("  target: target image file to generate\n\n");
+  printf("  target: target image file to generate\n");
+  printf("  threads: number of threads used for thresholding (>= 1)\n\n");
 }
 
 int main(int argc, char *argv[])
@@ -58,7 +59,7 @@ int main(int argc, char *argv[])
   pixel_image dst_image;
   integral_image integral;
   connected_components components;
-  uint32 radius;
+  uint32 radius, threads;
   integral_value multiplier, alpha;
   string source_file, target_file;
 
@@ -84,6 +85,15 @@ int main(int argc, char *argv[])
     }
     source_file = argv[3];
     target_file = argv[4];
+    threads = 1;
+    if (argc > 5) {
+      scan_result = sscanf(argv[5], "%lu", &threads);
+      if (scan_result != 1 || threads < 1) {
+        printf("\nError: failed to parse parameter threads\n\n");
+        print_usage();
+        return 1;
+      }
+    }
     if (radius < 1) {
       printf("\nError: radius may not be smaller than 1\n\n");
       print_usage();
@@ -114,10 +124,11 @@ int main(int argc, char *argv[])
   printf("create integral...\n");
   CHECK(integral_image_create(&integral, &src_image));
   printf("updating integral...\n");
-  CHECK(integral_image_update(&integral));
+  CHECK(integral_image_update_parallel(&integral, threads));
   printf("thresholding...\n");
-  CHECK(integral_image_threshold_feng(&integral, &tmp_image, TRUE,
-                                      ((signed)radius), multiplier, TRUE, alpha));
+  CHECK(integral_image_threshold_feng_parallel(&integral, &tmp_image, TRUE,
+                                               ((signed)radius), multiplier,
+                                               TRUE, alpha, threads));
   printf("creating connected components...\n");
   CHECK(connected_components_create(&components, &tmp_image));
   printf("updating connected components...\n");